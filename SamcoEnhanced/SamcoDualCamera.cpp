@@ -0,0 +1,146 @@
+/*!
+ * @file SamcoDualCamera.cpp
+ * @brief Samco Prow Enhanced light gun with two IR positioning cameras.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include "SamcoDualCamera.h"
+
+SamcoDualCamera::SamcoDualCamera(DFRobotIRPositionEx& first, DFRobotIRPositionEx& second) :
+    first(first), second(second)
+{
+}
+
+void SamcoDualCamera::beginConfig(uint32_t clock, DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Sensitivity_e sensitivity)
+{
+    first.beginConfig(clock, format, sensitivity);
+    second.beginConfig(clock, format, sensitivity);
+}
+
+bool SamcoDualCamera::pollConfig()
+{
+    // step both cameras every call so the configurations run together
+    const bool firstDone = first.pollConfig();
+    const bool secondDone = second.pollConfig();
+    if(!firstDone || !secondDone) {
+        return false;
+    }
+    cameraCount = second.configResult() == DFRobotIRPositionEx::Error_Success ? 2 : 1;
+    return true;
+}
+
+void SamcoDualCamera::queueSensitivity(DFRobotIRPositionEx::Sensitivity_e sensitivity)
+{
+    first.queueSensitivity(sensitivity);
+    // a missing second camera isn't read so a write would never go
+    if(cameraCount > 1) {
+        second.queueSensitivity(sensitivity);
+    }
+}
+
+void SamcoDualCamera::startAtomic(DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Retry_e retry)
+{
+    if(cameraCount > 1) {
+        activeIndex ^= 1;
+    }
+    camera(activeIndex).startAtomic(format, retry);
+}
+
+bool SamcoDualCamera::pollAtomic()
+{
+    DFRobotIRPositionEx& cam = camera(activeIndex);
+    if(!cam.pollAtomic()) {
+        return false;
+    }
+    if(cam.atomicResult() >= DFRobotIRPositionEx::Error_Success) {
+        update(activeIndex, cam.xPositions(), cam.yPositions(), cam.seen(), micros());
+    } else {
+        lost(activeIndex);
+    }
+    return true;
+}
+
+int SamcoDualCamera::readAtomic(DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Retry_e retry)
+{
+    startAtomic(format, retry);
+    while(!pollAtomic());
+    return atomicResult();
+}
+
+unsigned int SamcoDualCamera::update(unsigned int index, const int* x, const int* y, unsigned int seen, uint32_t us)
+{
+    // the tracking keeps each LED's identity, only the LEDs seen in this read count
+    SamcoPositionEnhanced& tracker = trackers[index];
+    tracker.begin(x, y, seen, MouseMaxX / 2, MouseMaxY / 2);
+    ledMask[index] = 0;
+    for(unsigned int i = 0; i < 4; ++i) {
+        if(tracker.testSee(i) & 1) {
+            ledMask[index] |= 1 << i;
+        }
+    }
+    readUs[index] = us;
+
+    const unsigned int other = index ^ 1;
+    const bool fresh = cameraCount > 1 && ledMask[other] && us - readUs[other] <= MaxAgeUs;
+
+    // learn the offset while both cameras see every LED, the reads are up to a frame apart
+    // so the gun moving one way and then back averages out
+    if(fresh && ledMask[0] == 0x0F && ledMask[1] == 0x0F) {
+        // the trackers mirror X
+        const int dx = trackers[1].testMedianX() - trackers[0].testMedianX();
+        const int dy = trackers[0].testMedianY() - trackers[1].testMedianY();
+        if(learned) {
+            // the sums keep the fraction bits so the offset settles on the measured offset
+            offSumX += dx - (offSumX >> OffsetShift);
+            offSumY += dy - (offSumY >> OffsetShift);
+        } else {
+            offSumX = dx * (1 << OffsetShift);
+            offSumY = dy * (1 << OffsetShift);
+            learned = true;
+        }
+        offX = (offSumX + (1 << (OffsetShift - 1))) >> OffsetShift;
+        offY = (offSumY + (1 << (OffsetShift - 1))) >> OffsetShift;
+    }
+
+    fusedSeen = 0;
+    filledMask = 0;
+    for(unsigned int i = 0; i < 4; ++i) {
+        // not seen, like the camera
+        fusedX[i] = 0x3FF;
+        fusedY[i] = 0x3FF;
+        if(ledMask[index] & (1 << i)) {
+            fuse(index, i);
+        } else if(fresh && learned && (ledMask[other] & (1 << i))) {
+            fuse(other, i);
+            filledMask |= fusedSeen & (1 << i);
+        }
+    }
+    return fusedSeen;
+}
+
+void SamcoDualCamera::fuse(unsigned int index, unsigned int led)
+{
+    // back to camera pixels in 1/4 pixels, the second camera moved into the view of the first
+    int x = MouseMaxX - trackers[index].testX(led);
+    int y = trackers[index].testY(led);
+    if(index) {
+        x += offX;
+        y += offY;
+    }
+    x = (x + CamToMouseMult / 2) >> CamToMouseShift;
+    y = (y + CamToMouseMult / 2) >> CamToMouseShift;
+
+    // a point outside the first camera's view can't be a camera point
+    if(x >= 0 && x <= CamMaxX && y >= 0 && y <= CamMaxY) {
+        fusedX[led] = x;
+        fusedY[led] = y;
+        fusedSeen |= 1 << led;
+    }
+}
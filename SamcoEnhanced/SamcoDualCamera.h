@@ -0,0 +1,143 @@
+/*!
+ * @file SamcoDualCamera.h
+ * @brief Samco Prow Enhanced light gun with two IR positioning cameras.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCODUALCAMERA_H_
+#define _SAMCODUALCAMERA_H_
+
+#include <stdint.h>
+#include <DFRobotIRPositionEx.h>
+#include <SamcoPositionEnhanced.h>
+
+/// @brief Two IR cameras on their own IIC buses, read in turn with their points fused into one set.
+/// @details The cameras are configured together and the split-phase reads alternate between them,
+/// so with the cameras out of phase there are twice the reads of one camera.
+/// Each camera tracks the LEDs with its own SamcoPositionEnhanced so a point keeps its LED between
+/// the cameras. The second camera's points are moved into the view of the first by an offset learned
+/// while both cameras see all 4 LEDs, and an LED the newest read missed is filled in from the other
+/// camera's last read if it is recent. The fused points are in the first camera's pixels and in LED order,
+/// so the position engines and the calibration use them like the points of one camera.
+/// This has the same read and points calls as DFRobotIRPositionEx.
+class SamcoDualCamera
+{
+public:
+    /// @brief Longest time the other camera's read fills in LEDs and learns the offset, about a camera frame
+    static constexpr uint32_t MaxAgeUs = 5000;
+
+    /// @brief Each learn moves the offset 1 / (1 << OffsetShift) of the way to the measured offset
+    static constexpr int OffsetShift = 3;
+
+    /// @brief Constructor
+    /// @param first Camera the points are fused in the view of
+    /// @param second Camera on the other bus
+    SamcoDualCamera(DFRobotIRPositionEx& first, DFRobotIRPositionEx& second);
+
+    /// @brief Start the configuration of both cameras, see DFRobotIRPositionEx::beginConfig()
+    void beginConfig(uint32_t clock, DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Sensitivity_e sensitivity);
+
+    /// @brief Perform the next configuration step of both cameras
+    /// @return True when both are done, then count() is the number of cameras read
+    bool pollConfig();
+
+    /// @brief Number of cameras read, 2 if the second camera configured, otherwise only the first is read
+    unsigned int count() const { return cameraCount; }
+
+    /// @brief Camera by index, 0 for the first camera
+    DFRobotIRPositionEx& camera(unsigned int index) { return index ? second : first; }
+
+    /// @brief Index of the camera of the current or last read
+    unsigned int active() const { return activeIndex; }
+
+    /// @brief Queue a sensitivity change on the cameras, see DFRobotIRPositionEx::queueSensitivity()
+    void queueSensitivity(DFRobotIRPositionEx::Sensitivity_e sensitivity);
+
+    /// @brief Start a split-phase read of the next camera, see DFRobotIRPositionEx::startAtomic()
+    void startAtomic(DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Retry_e retry);
+
+    /// @brief Perform the next IIC transaction of the read, the points are fused when it succeeds
+    /// @return True if the read completed with this call
+    bool pollAtomic();
+
+    /// @brief Check if a split-phase read is in progress
+    bool atomicBusy() const { return (activeIndex ? second : first).atomicBusy(); }
+
+    /// @brief Get the result of the last completed read, an error code from DFRobotIRPositionEx::Errors_e
+    int atomicResult() const { return (activeIndex ? second : first).atomicResult(); }
+
+    /// @brief Read the next camera to completion, for the calibration and processing mode
+    /// @return An error code from DFRobotIRPositionEx::Errors_e
+    int readAtomic(DFRobotIRPositionEx::DataFormat_e format, DFRobotIRPositionEx::Retry_e retry);
+
+    /// @brief Fuse the points of a successful read, pollAtomic() calls this
+    /// @param index Camera of the read
+    /// @param x X positions of the read
+    /// @param y Y positions of the read
+    /// @param seen Seen bit mask of the read
+    /// @param us Time of the read
+    /// @return Bit mask of the fused LEDs
+    unsigned int update(unsigned int index, const int* x, const int* y, unsigned int seen, uint32_t us);
+
+    /// @brief Forget the last read of a camera, its LEDs are not filled in
+    void lost(unsigned int index) { ledMask[index] = 0; }
+
+    /// @brief True once the offset of the second camera is learned
+    bool offsetLearned() const { return learned; }
+
+    /// @brief Offset added to the second camera's points in 1/4 camera pixels
+    int offsetX() const { return offX; }
+    int offsetY() const { return offY; }
+
+    /// @brief Fused X positions in LED order, top left, top right, bottom left, bottom right
+    const int* xPositions() const { return fusedX; }
+
+    /// @brief Fused Y positions in LED order
+    const int* yPositions() const { return fusedY; }
+
+    /// @brief Bit mask of the fused LEDs
+    unsigned int seen() const { return fusedSeen; }
+
+    /// @brief Bit mask of the fused LEDs filled in from the other camera
+    unsigned int filled() const { return filledMask; }
+
+private:
+    DFRobotIRPositionEx& first;
+    DFRobotIRPositionEx& second;
+
+    /// @brief LED tracking of each camera
+    SamcoPositionEnhanced trackers[2];
+
+    /// @brief LEDs each camera saw in its last read
+    unsigned int ledMask[2] = {0, 0};
+
+    /// @brief Time of each camera's last read
+    uint32_t readUs[2] = {0, 0};
+
+    unsigned int cameraCount = 1;
+    unsigned int activeIndex = 0;
+
+    bool learned = false;
+    int offX = 0;
+    int offY = 0;
+
+    /// @brief Offset filter sums, the offset with OffsetShift fraction bits
+    int offSumX = 0;
+    int offSumY = 0;
+
+    int fusedX[4] = {0x3FF, 0x3FF, 0x3FF, 0x3FF};
+    int fusedY[4] = {0x3FF, 0x3FF, 0x3FF, 0x3FF};
+    unsigned int fusedSeen = 0;
+    unsigned int filledMask = 0;
+
+    /// @brief Put an LED from a camera's last read in the fused points
+    void fuse(unsigned int index, unsigned int led);
+};
+
+#endif // _SAMCODUALCAMERA_H_
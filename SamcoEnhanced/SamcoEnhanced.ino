@@ -22,6 +22,13 @@
  *  Start + Down: Normal gun mode (averaging disabled)
  *  Start + Up: Normal gun with averaging, toggles between the 2 averaging modes (use serial monitor to see the setting)
  *  Start + A: Processing mode for use with the Processing sketch
+ *  Start + Left: Predictive gun mode, leads the position by the measured latency
+ *  Start + B: One-Euro gun mode, adaptive smoothing from the speed
+ *  Select + Up/Down: Increase/decrease the One-Euro minimum cutoff (use serial monitor to see the setting)
+ *  Select + Right/Left: Increase/decrease the One-Euro speed coefficient (use serial monitor to see the setting)
+ *  Select + A: Custom filter mode, steps through the filter pipeline presets (use serial monitor to see the setting)
+ *  B + Right: Print and clear the latency statistics, if LATENCY_STATS is defined
+ *  Start + Right: Toggle the position engine between Samco and homography (use serial monitor to see the setting)
  *  B + Down: Decrease IR camera sensitivity (use serial monitor to see the setting)
  *  B + Up: Increase IR camera sensitivity (use serial monitor to see the setting)
  *  Reload: Exit pause mode
@@ -84,13 +91,31 @@
 #include <BasicKeyboard.h>
 #include <LightgunButtons.h>
 #include <SamcoPositionEnhanced.h>
+#include <SamcoHomography.h>
 #include <SamcoConst.h>
+#ifdef PROCESSING_BINARY
+#include <SamcoTelemetry.h>
+#endif // PROCESSING_BINARY
 #include "SamcoColours.h"
 #include "SamcoPreferences.h"
+#include "SamcoFilter.h"
+#include "SamcoMouseMap.h"
+#include "SamcoLatency.h"
+#include "SamcoScheduler.h"
+#include "SamcoDualCamera.h"
+#ifdef CORE1_CAMERA
+#include "SamcoPositionRing.h"
+#endif // CORE1_CAMERA
+#ifdef USB_SOF_SYNC
+#include "SamcoSofSync.h"
+#endif // USB_SOF_SYNC
 
 #ifdef ARDUINO_ARCH_RP2040
 #include <hardware/pwm.h>
 #include <hardware/irq.h>
+#ifdef USB_SOF_SYNC
+#include <hardware/structs/usb.h>
+#endif // USB_SOF_SYNC
 
 // declare PWM ISR
 void rp2040pwmIrq(void);
@@ -101,9 +126,41 @@ void rp2040pwmIrq(void);
 //#define DEBUG_SERIAL 1
 //#define DEBUG_SERIAL 2
 
-// extra position glitch filtering, 
-// not required after discoverving the DFRobotIRPositionEx atomic read technique
-//#define EXTRA_POS_GLITCH_FILTER
+// lock the IR camera timer to the camera update phase so a single read per frame is atomic,
+// requires a hardware timer
+//#define IR_CAM_PHASE_LOCK
+
+// adjust the IR camera gain from the blob sizes so all 4 points stay seen as the room light changes,
+// reads the extended data format for the sizes
+//#define IR_CAM_AUTO_EXPOSURE
+
+// read a second IR camera on Wire, interleaved with the first camera, and fuse the positions
+// only for the ItsyBitsy RP2040 where the first camera is on Wire1
+//#define IR_CAM_DUAL
+
+// place the LEDs that are not seen by fitting the last full rectangle to the 2 or 3 seen LEDs,
+// keeps the position accurate with LEDs off the edge of the camera view
+//#define POS_RIGID_MODEL
+
+// read the IR camera and calculate the position on core1 so core0 only services the buttons and USB,
+// only for the RP2040 and a single camera
+//#define CORE1_CAMERA
+
+// collect the mouse and keyboard changes into as few reports as possible and send them from
+// the HID task when the host takes the last report, rather than a report for each change
+//#define HID_FRAME_COMMIT
+
+// time the IR camera reads from the USB start of frame so each read completes just before
+// the host polls for the report, not with CORE1_CAMERA or IR_CAM_PHASE_LOCK
+//#define USB_SOF_SYNC
+
+// send the Processing mode output as binary frames, one per camera read, instead of text,
+// see the SamcoTelemetry library for the format and a decoder
+//#define PROCESSING_BINARY
+
+// measure the latency of each stage from the camera tick to the USB report,
+// the histograms are printed and cleared from pause mode
+//#define LATENCY_STATS
 
 // numbered index of physcial buttons, must match ButtonDesc[] order
 enum ButtonIndex_e {
@@ -206,6 +263,23 @@ constexpr uint32_t IRSensitivityDownBtnMask = BtnMask_B | BtnMask_Down;
 constexpr uint32_t RunModeNormalBtnMask = BtnMask_Start | BtnMask_Down;
 constexpr uint32_t RunModeAverageBtnMask = BtnMask_Start | BtnMask_Up;
 constexpr uint32_t RunModeProcessingBtnMask = BtnMask_Start | BtnMask_A;
+constexpr uint32_t RunModePredictBtnMask = BtnMask_Start | BtnMask_Left;
+constexpr uint32_t RunModeEuroBtnMask = BtnMask_Start | BtnMask_B;
+
+// button combo to step through the filter pipeline presets
+constexpr uint32_t FilterPresetBtnMask = BtnMask_Select | BtnMask_A;
+
+// button combo to print and clear the latency statistics
+constexpr uint32_t LatencyPrintBtnMask = BtnMask_B | BtnMask_Right;
+
+// button combinations to adjust the One-Euro filter parameters
+constexpr uint32_t EuroCutoffUpBtnMask = BtnMask_Select | BtnMask_Up;
+constexpr uint32_t EuroCutoffDownBtnMask = BtnMask_Select | BtnMask_Down;
+constexpr uint32_t EuroBetaUpBtnMask = BtnMask_Select | BtnMask_Right;
+constexpr uint32_t EuroBetaDownBtnMask = BtnMask_Select | BtnMask_Left;
+
+// button combo to toggle the position engine
+constexpr uint32_t PosEngineBtnMask = BtnMask_Start | BtnMask_Right;
 
 // colour when no IR points are seen
 constexpr uint32_t IRSeen0Color = WikiColor::Amber;
@@ -222,24 +296,55 @@ enum RunMode_e {
     RunMode_Normal = 0,         ///< Normal gun mode, no averaging
     RunMode_Average = 1,        ///< 2 frame moving average
     RunMode_Average2 = 2,       ///< weighted average with 3 frames
-    RunMode_ProfileMax = 2,     ///< maximum mode allowed for profiles
-    RunMode_Processing = 3,     ///< Processing test mode
+    RunMode_Predict = 3,        ///< alpha-beta filter leading the position by the pipeline latency
+    RunMode_Euro = 4,           ///< One-Euro adaptive low-pass filter
+    RunMode_Custom = 5,         ///< filter pipeline stored in the profile
+    RunMode_ProfileMax = 5,     ///< maximum mode allowed for profiles
+    RunMode_Processing = 6,     ///< Processing test mode
     RunMode_Count
 };
 
+// pipelines of the run modes, the custom mode uses the profile pipeline
+constexpr uint32_t RunModeFilterStages[RunMode_ProfileMax + 1] = {
+    0,
+    FilterStages(FilterStage_Average),
+    FilterStages(FilterStage_Average2),
+    FilterStages(FilterStage_Predict),
+    FilterStages(FilterStage_Euro),
+    0
+};
+
+// custom pipeline presets that can be selected in pause mode
+constexpr uint32_t FilterPresets[] = {
+    FilterStages(FilterStage_Glitch, FilterStage_Average2),
+    FilterStages(FilterStage_Glitch, FilterStage_Euro),
+    FilterStages(FilterStage_Glitch, FilterStage_Euro, FilterStage_Predict, FilterStage_Clamp),
+    FilterStages(FilterStage_Glitch, FilterStage_Average, FilterStage_DeadZone),
+    FilterStages(FilterStage_Clamp, FilterStage_Average2, FilterStage_DeadZone)
+};
+constexpr unsigned int FilterPresetCount = sizeof(FilterPresets) / sizeof(FilterPresets[0]);
+
+// position engines
+// note that this is a 2 bit value when stored in the profiles
+enum PosEngine_e {
+    PosEngine_Samco = 0,        ///< LED median with tilt correction
+    PosEngine_Homography = 1,   ///< camera center mapped through the LED rectangle homography
+    PosEngine_Count
+};
+
 // profiles
 // defaults can be populated here, or not worry about these values and just save to flash/EEPROM
 // if you have original Samco calibration values, multiply by 4 for the center position and
 // scale is multiplied by 1000 and stored as an unsigned integer, see SamcoPreferences::Calibration_t
 SamcoPreferences::ProfileData_t profileData[ProfileCount] = {
-    {1619, 950, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {1233, 950, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {1538, 855, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {1147, 855, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0},
-    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, 0, 0}
+    {1619, 950, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {1233, 950, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {1538, 855, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {1147, 855, MouseMaxX / 2, MouseMaxY / 2, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0},
+    {0, 0, 0, 0, DFRobotIRPositionEx::Sensitivity_Default, RunMode_Normal, PosEngine_Samco, 0, 0}
 };
 /*SamcoPreferences::ProfileData_t profileData[profileCount] = {
     {1619, 950, 1899, 1531, DFRobotIRPositionEx::Sensitivity_Max, RunMode_Average},
@@ -291,38 +396,79 @@ constexpr float ScaleStep = 0.001;
 
 int finalX = 0;         // Values after tilt correction
 int finalY = 0;
+float finalH = 0.0f;    // height of the 4 points for the scale
 
 int moveXAxis = 0;      // Unconstrained mouse postion
 int moveYAxis = 0;               
-int moveXAxisArr[3] = {0, 0, 0};
-int moveYAxisArr[3] = {0, 0, 0};
-int moveIndex = 0;
 
-int conMoveXAxis = 0;   // Constrained mouse postion
-int conMoveYAxis = 0;
+// camera to mouse mapping of each axis, the reciprocal is recomputed only when the mapped width
+// or the center changes so each frame maps with multiplies instead of the divide in map()
+SamcoMouseMap mouseMapX;
+SamcoMouseMap mouseMapY;
 
-unsigned int lastSeen = 0;
+// position filter pipeline of the run mode
+SamcoFilterPipeline filterPipeline;
 
-#ifdef EXTRA_POS_GLITCH_FILTER
-int badFinalTick = 0;
-int badMoveTick = 0;
-int badFinalCount = 0;
-int badMoveCount = 0;
+// the profile doesn't set the prediction time so the pipeline leads by the measured latency
+bool filterHorizonMeasured = true;
 
 // number of consecutive bad move values to filter
 constexpr unsigned int BadMoveCountThreshold = 3;
 
 // Used to filter out large jumps/glitches
 constexpr int BadMoveThreshold = 49 * CamToMouseMult;
-#endif // EXTRA_POS_GLITCH_FILTER
+
+// dead zone size in mouse units
+constexpr int DeadZoneSize = 2 * CamToMouseMult;
+
+// predictive run mode defaults, used when the profile value is 0
+constexpr unsigned int PredictAlphaDefault = 128;   // position gain * 256
+constexpr unsigned int PredictBetaDefault = 32;     // velocity gain * 256
+
+// HID endpoint poll interval in ms, 1 ms halves the wait for the host but doubles the USB traffic
+constexpr uint8_t UsbPollIntervalMs = 2;
+
+#ifdef USB_SOF_SYNC
+// time from an IR camera read completing to the host poll, covers the position calculation,
+// filters and queuing the report with a margin for the loop time
+constexpr uint32_t SofSyncLeadUs = 300;
+
+// USB poll added to the measured latency for the prediction horizon, the read is timed to the poll
+constexpr unsigned long PredictUsbLatencyUs = SofSyncLeadUs;
+#else
+// USB poll interval added to the measured latency for the prediction horizon
+constexpr unsigned long PredictUsbLatencyUs = 1000;
+#endif // USB_SOF_SYNC
+
+// One-Euro run mode defaults, used when the profile value is 0
+constexpr unsigned int EuroMinCutoffDefault = 20;   // minimum cutoff in 0.05Hz steps
+constexpr unsigned int EuroBetaDefault = 40;        // cutoff increase per speed in 0.0005 steps
+
+// step sizes for adjusting the One-Euro parameters
+constexpr unsigned int EuroMinCutoffStep = 2;
+constexpr unsigned int EuroBetaStep = 4;
+
+// IIC read time of the IR camera position for the prediction horizon
+unsigned long irReadStartUs = 0;
+unsigned long irReadUs = 0;
+
+int conMoveXAxis = 0;   // Constrained mouse postion
+int conMoveYAxis = 0;
+
+unsigned int lastSeen = 0;
 
 // profile in use
 unsigned int selectedProfile = 0;
 
 // IR positioning camera
 #ifdef ARDUINO_ADAFRUIT_ITSYBITSY_RP2040
+// IIC pins for the camera, also used to clear a stuck bus
+constexpr int IRCamSdaPin = 2;
+constexpr int IRCamSclPin = 3;
 DFRobotIRPositionEx dfrIRPos(Wire1);
 #else
+constexpr int IRCamSdaPin = SDA;
+constexpr int IRCamSclPin = SCL;
 //DFRobotIRPosition myDFRobotIRPosition;
 DFRobotIRPositionEx dfrIRPos(Wire);
 #endif
@@ -330,6 +476,84 @@ DFRobotIRPositionEx dfrIRPos(Wire);
 // Samco positioning
 SamcoPositionEnhanced mySamco;
 
+// homography positioning
+SamcoHomography myHomography;
+
+#ifdef IR_CAM_DUAL
+#if !defined(ARDUINO_ADAFRUIT_ITSYBITSY_RP2040)
+#error IR_CAM_DUAL requires the first IR camera on Wire1
+#elif defined(IR_CAM_PHASE_LOCK)
+#error IR_CAM_DUAL can not be used with IR_CAM_PHASE_LOCK
+#endif
+
+// second IR positioning camera
+DFRobotIRPositionEx dfrIRPos2(Wire);
+
+// both cameras read in turn, the points fused in the view of the first camera
+SamcoDualCamera dualCam(dfrIRPos, dfrIRPos2);
+
+// camera reads and points
+typedef SamcoDualCamera IrCam_t;
+#else
+typedef DFRobotIRPositionEx IrCam_t;
+#endif // IR_CAM_DUAL
+
+#ifdef CORE1_CAMERA
+#if !defined(SAMCO_RP2040)
+#error CORE1_CAMERA requires an RP2040
+#elif defined(IR_CAM_DUAL)
+#error CORE1_CAMERA can not be used with IR_CAM_DUAL
+#endif
+
+// positions from core1 to core0
+SamcoPositionRing positionRing;
+
+// open while the run mode camera task is active, core1 only uses the camera while it's open
+SamcoCoreGate core1Gate;
+#endif // CORE1_CAMERA
+
+#ifdef USB_SOF_SYNC
+#if !defined(SAMCO_SAMD21) && !defined(SAMCO_SAMD51) && !defined(SAMCO_ATMEGA32U4) && !defined(SAMCO_RP2040)
+#error USB_SOF_SYNC requires a board with a readable USB frame number
+#elif defined(CORE1_CAMERA)
+#error USB_SOF_SYNC can not be used with CORE1_CAMERA
+#elif defined(IR_CAM_PHASE_LOCK)
+#error USB_SOF_SYNC can not be used with IR_CAM_PHASE_LOCK
+#endif
+
+// USB start of frame and host poll timing
+SamcoSofSync sofSync;
+
+// start time of the next IR camera read, valid while irReadSlotPending is set
+uint32_t irReadSlotUs = 0;
+bool irReadSlotPending = false;
+
+// time the last IR camera read completed, for the sample age
+uint32_t irReadDoneUs = 0;
+
+#ifdef USE_TINYUSB
+// HID endpoint ready on the last SOF task run, the host took a report when it becomes ready
+bool sofHidReady = true;
+#endif // USE_TINYUSB
+
+#define IR_CAM_SLOT_REACHED() IrCamSlotReached()
+#else
+#define IR_CAM_SLOT_REACHED() true
+#endif // USB_SOF_SYNC
+
+#ifdef PROCESSING_BINARY
+// Processing mode frame and its encoded bytes, kept between frames for the sequence number
+SamcoTelemetry::Frame_t processingFrame = {};
+uint8_t processingBuf[SamcoTelemetry::FrameSize];
+#endif // PROCESSING_BINARY
+
+// IR camera errors are reported at most once per this interval
+constexpr unsigned long IRCamErrorReportMs = 1000;
+
+// millis() of the last IR camera error report, and errors since the report
+unsigned long irCamErrorMs = 0;
+unsigned int irCamErrorCount = 0;
+
 // operating modes
 enum GunMode_e {
     GunMode_Init = -1,
@@ -351,9 +575,20 @@ static const char* RunModeLabels[RunMode_Count] = {
     "Normal",
     "Averaging",
     "Averaging2",
+    "Predict",
+    "One-Euro",
+    "Custom",
     "Processing"
 };
 
+// position engine
+PosEngine_e posEngine = PosEngine_Samco;
+
+static const char* PosEngineLabels[PosEngine_Count] = {
+    "Samco",
+    "Homography"
+};
+
 // preferences saved in non-volatile memory, populated with defaults 
 SamcoPreferences::Preferences_t SamcoPreferences::preferences = {
     profileData, ProfileCount, // profiles
@@ -428,6 +663,13 @@ SamcoPreferences samcoPreferences;
 // number of times the IR camera will update per second
 constexpr unsigned int IRCamUpdateRate = 209;
 
+#ifdef IR_CAM_AUTO_EXPOSURE
+// auto-exposure requires the sizes from the extended data format
+constexpr DFRobotIRPositionEx::DataFormat_e IRCamDataFormat = DFRobotIRPositionEx::DataFormat_Extended;
+#else
+constexpr DFRobotIRPositionEx::DataFormat_e IRCamDataFormat = DFRobotIRPositionEx::DataFormat_Basic;
+#endif // IR_CAM_AUTO_EXPOSURE
+
 #ifdef SAMCO_NO_HW_TIMER
 // use the millis() or micros() counter instead
 unsigned long irPosUpdateTime = 0;
@@ -443,15 +685,69 @@ unsigned int irPosUpdateTick = 0;
 volatile unsigned int irPosUpdateTick = 0;
 #endif // SAMCO_NO_HW_TIMER
 
+#if defined(IR_CAM_PHASE_LOCK) && !defined(SAMCO_NO_HW_TIMER)
+#define IR_CAM_PHASE_UPDATE() IrCamPhaseUpdate()
+#else
+#define IR_CAM_PHASE_UPDATE()
+#endif // IR_CAM_PHASE_LOCK
+
+#ifdef LATENCY_STATS
+// latency histograms of the position pipeline
+SamcoLatency latency;
+
+// time irPosUpdateTick was set
+volatile unsigned long irPosTickUs = 0;
+
+#define LATENCY_TICK() irPosTickUs = micros()
+#define LATENCY_STAMP(s, us) latency.stamp(SamcoLatency::s, us)
+#else
+#define LATENCY_TICK()
+#define LATENCY_STAMP(s, us)
+#endif // LATENCY_STATS
+
 #ifdef DEBUG_SERIAL
 static unsigned long serialDbMs = 0;
 static unsigned long frameCount = 0;
 static unsigned long irPosCount = 0;
+static bool camStartupPrinted = false;
 #endif
 
 // used for periodic serial prints
 unsigned long lastPrintMillis = 0;
 
+// task periods and budgets in microseconds, a task that runs longer than its budget counts an overrun
+constexpr uint32_t CameraTaskBudgetUs = 1000;
+constexpr uint32_t CalCameraTaskBudgetUs = 3000;
+constexpr uint32_t ButtonsTaskPeriodUs = 1000;
+constexpr uint32_t ButtonsTaskBudgetUs = 250;
+constexpr uint32_t PauseButtonsTaskBudgetUs = 2000;
+constexpr uint32_t UsbTaskPeriodUs = 2000;
+constexpr uint32_t UsbTaskBudgetUs = 1000;
+constexpr uint32_t HidTaskBudgetUs = 100;
+constexpr uint32_t SofTaskBudgetUs = 50;
+constexpr uint32_t LedTaskPeriodUs = 10000;
+constexpr uint32_t LedTaskBudgetUs = 500;
+constexpr uint32_t SerialTaskPeriodUs = 10000;
+constexpr uint32_t SerialTaskBudgetUs = 2000;
+
+// runs the tasks of the current mode from loop()
+SamcoScheduler scheduler([]() -> uint32_t { return micros(); });
+
+// last seen value shown by the LED
+unsigned int ledSeen = 0;
+
+// center calibration states
+enum CalCenterState_e {
+    CalCenter_Wait = 0,         ///< wait for the trigger
+    CalCenter_Accumulate,       ///< accumulate the center position while the trigger is held
+    CalCenter_WaitRelease       ///< wait for the trigger to release
+};
+CalCenterState_e calCenterState = CalCenter_Wait;
+unsigned long calCenterMs = 0;
+unsigned int calCenterXAcc = 0;
+unsigned int calCenterYAcc = 0;
+unsigned int calCenterCount = 0;
+
 #ifdef USE_TINYUSB
 
 // USB HID Report ID
@@ -497,8 +793,8 @@ void setup()
 
 #ifdef ARDUINO_ADAFRUIT_ITSYBITSY_RP2040
     // ensure Wire1 SDA and SCL are correct
-    Wire1.setSDA(2);
-    Wire1.setSCL(3);
+    Wire1.setSDA(IRCamSdaPin);
+    Wire1.setSCL(IRCamSclPin);
 #endif
 
     // initialize buttons
@@ -516,11 +812,35 @@ void setup()
     // use values from preferences
     ApplyInitialPrefs();
 
-    // Start IR Camera with basic data format
-    dfrIRPos.begin(DFROBOT_IR_IIC_CLOCK, DFRobotIRPositionEx::DataFormat_Basic, irSensitivity);
+    // Start IR Camera, the configuration runs while USB starts up
+    IrCam().beginConfig(DFROBOT_IR_IIC_CLOCK, IRCamDataFormat, irSensitivity);
+    dfrIRPos.autoRecover(true, IRCamSdaPin, IRCamSclPin);
+#ifdef IR_CAM_AUTO_EXPOSURE
+    dfrIRPos.autoExposure(true);
+#endif // IR_CAM_AUTO_EXPOSURE
+#ifdef IR_CAM_DUAL
+    dfrIRPos2.autoRecover(true, PIN_WIRE0_SDA, PIN_WIRE0_SCL);
+#ifdef IR_CAM_AUTO_EXPOSURE
+    dfrIRPos2.autoExposure(true);
+#endif // IR_CAM_AUTO_EXPOSURE
+#endif // IR_CAM_DUAL
+#ifdef POS_RIGID_MODEL
+    mySamco.rigidModel(true);
+#endif // POS_RIGID_MODEL
+#if defined(IR_CAM_PHASE_LOCK) && !defined(SAMCO_NO_HW_TIMER)
+    dfrIRPos.phaseLock(true, 1000000UL / IRCamUpdateRate);
+#endif // IR_CAM_PHASE_LOCK
+#ifdef USB_SOF_SYNC
+#ifdef USE_TINYUSB
+    sofSync.begin(UsbPollIntervalMs, SofSyncLeadUs);
+#else
+    // the Arduino HID endpoint is polled every frame
+    sofSync.begin(1, SofSyncLeadUs);
+#endif // USE_TINYUSB
+#endif // USB_SOF_SYNC
     
 #ifdef USE_TINYUSB
-    usbHid.setPollInterval(2);
+    usbHid.setPollInterval(UsbPollIntervalMs);
     usbHid.setReportDescriptor(hidReportDesc, sizeof(hidReportDesc));
     //usb_hid.setStringDescriptor("TinyUSB HID Composite");
 
@@ -529,7 +849,12 @@ void setup()
 
     Serial.begin(115200);
     
+#ifdef HID_FRAME_COMMIT
+    AbsMouse5.init(MouseMaxX, MouseMaxY, false);
+    BasicKeyboard.setAutoReport(false);
+#else
     AbsMouse5.init(MouseMaxX, MouseMaxY, true);
+#endif // HID_FRAME_COMMIT
    
     // sanity to ensure the cal prefs is populated with at least 1 entry
     // in case the table is zero'd out
@@ -551,14 +876,25 @@ void setup()
 
 #ifdef USE_TINYUSB
     // wait until device mounted
-    while(!USBDevice.mounted()) { yield(); }
+    while(!USBDevice.mounted()) {
+        IrCam().pollConfig();
+        yield();
+    }
 #else
     // was getting weird hangups... maybe nothing, or maybe related to dragons, so wait a bit
     delay(100);
 #endif
 
+    // finish the IR camera configuration if it isn't ready yet
+    while(!IrCam().pollConfig()) { yield(); }
+
+#ifdef IR_CAM_DUAL
+    // the cameras alternate so the timer runs at twice the rate if the second camera is available
+    startIrCamTimer(IRCamUpdateRate * dualCam.count());
+#else
     // IR camera maxes out motion detection at ~300Hz, and millis() isn't good enough
     startIrCamTimer(IRCamUpdateRate);
+#endif // IR_CAM_DUAL
 
     // this will turn off the DotStar/RGB LED and ensure proper transition to Run
     SetMode(GunMode_Run);
@@ -579,6 +915,38 @@ void startIrCamTimer(int frequencyHz)
 #endif
 }
 
+#if defined(IR_CAM_PHASE_LOCK) && !defined(SAMCO_NO_HW_TIMER)
+// retune the IR camera timer when the camera phase estimate changes
+void IrCamPhaseUpdate()
+{
+    if(dfrIRPos.phaseChanged()) {
+        if(dfrIRPos.phaseState() == DFRobotIRPositionEx::PhaseState_Locked) {
+            setIrCamTimerPeriod(dfrIRPos.phaseSamplePeriod(), dfrIRPos.phaseSampleDelay(micros()), true);
+        } else {
+            // keep the timer phase so the sample time keeps sweeping across the camera update
+            setIrCamTimerPeriod(dfrIRPos.phaseSamplePeriod(), 0, false);
+        }
+    }
+}
+
+// set the IR camera timer period, and if restart is true the delay until the next tick
+void setIrCamTimerPeriod(unsigned long periodUs, unsigned long delayUs, bool restart)
+{
+    if(delayUs > periodUs) {
+        delayUs = periodUs;
+    }
+#if defined(SAMCO_SAMD21)
+    setTimerPeriod(&TC4->COUNT16, periodUs, delayUs, restart);
+#elif defined(SAMCO_SAMD51)
+    setTimerPeriod(&TC3->COUNT16, periodUs, delayUs, restart);
+#elif defined(SAMCO_ATMEGA32U4)
+    setTimer3Period(periodUs, delayUs, restart);
+#elif defined(SAMCO_RP2040)
+    rp2040SetPWMTimerPeriod(0, periodUs, delayUs, restart);
+#endif
+}
+#endif // IR_CAM_PHASE_LOCK
+
 #if defined(SAMCO_SAMD21)
 void startTimerEx(TcCount16* ptc, uint16_t gclkCtrlId, IRQn_Type irqn, int frequencyHz)
 {
@@ -621,6 +989,7 @@ void TC4_Handler()
         TC4->COUNT16.INTFLAG.bit.MC0 = 1;
 
         irPosUpdateTick = 1;
+        LATENCY_TICK();
     }
 }
 #endif // SAMCO_SAMD21
@@ -667,6 +1036,7 @@ void TC3_Handler()
         TC3->COUNT16.INTFLAG.bit.MC0 = 1;
 
         irPosUpdateTick = 1;
+        LATENCY_TICK();
     }
 }
 #endif // SAMCO_SAMD51
@@ -687,6 +1057,34 @@ void setTimerFrequency(TcCount16* ptc, int frequencyHz)
     while(ptc->SYNCBUSY.bit.STATUS == 1);
 #endif
 }
+
+#ifdef IR_CAM_PHASE_LOCK
+void setTimerPeriod(TcCount16* ptc, unsigned long periodUs, unsigned long delayUs, bool restart)
+{
+    // the count is 16 bits, the longest phase lock period of 4785us + 1/16 is ~15300 counts at 48MHz / 16
+    // and ~38100 at 120MHz / 16, so only a SAMD51 overclocked past 200MHz would need the limit
+    const uint32_t compareValue = min((uint32_t)((uint64_t)F_CPU * periodUs / (TIMER_PRESCALER_DIV * 1000000ULL)), (uint32_t)0xFFFF);
+    const uint32_t delayValue = min((uint32_t)((uint64_t)F_CPU * delayUs / (TIMER_PRESCALER_DIV * 1000000ULL)), compareValue);
+
+    // the count restarts at the compare value so start the count at
+    // the delay before the compare value to time the next tick
+    ptc->CC[0].reg = compareValue;
+#if defined(SAMCO_SAMD21)
+    while(ptc->STATUS.bit.SYNCBUSY == 1);
+#elif defined(SAMCO_SAMD51)
+    while(ptc->SYNCBUSY.bit.STATUS == 1);
+#endif
+    if(!restart) {
+        return;
+    }
+    ptc->COUNT.reg = compareValue - delayValue;
+#if defined(SAMCO_SAMD21)
+    while(ptc->STATUS.bit.SYNCBUSY == 1);
+#elif defined(SAMCO_SAMD51)
+    while(ptc->SYNCBUSY.bit.STATUS == 1);
+#endif
+}
+#endif // IR_CAM_PHASE_LOCK
 #endif
 
 #ifdef SAMCO_ATMEGA32U4
@@ -709,14 +1107,40 @@ void startTimer3(unsigned long frequencyHz)
 ISR(TIMER3_COMPA_vect)
 {
     irPosUpdateTick = 1;
+    LATENCY_TICK();
+}
+
+#ifdef IR_CAM_PHASE_LOCK
+void setTimer3Period(unsigned long periodUs, unsigned long delayUs, bool restart)
+{
+    const uint16_t compareValue = (F_CPU / 1000000UL) * periodUs / 8UL;
+    const uint16_t delayValue = (F_CPU / 1000000UL) * delayUs / 8UL;
+
+    noInterrupts();
+    OCR3A = compareValue;
+    if(restart) {
+        TCNT3 = compareValue - delayValue;
+    }
+    interrupts();
 }
+#endif // IR_CAM_PHASE_LOCK
 #endif // SAMCO_ATMEGA32U4
 
 #ifdef ARDUINO_ARCH_RP2040
+// PWM clock divider used for the IR camera timer
+float rp2040PWMClkDiv = 1.0f;
+
+#ifdef IR_CAM_PHASE_LOCK
+// the phase lock can lengthen the period by up to 1/16 so the wrap needs room for it
+constexpr uint32_t RP2040PWMWrapMax = 65535UL * 16 / 17;
+#else
+constexpr uint32_t RP2040PWMWrapMax = 65535;
+#endif // IR_CAM_PHASE_LOCK
+
 void rp2040EnablePWMTimer(unsigned int slice_num, unsigned int frequency)
 {
     pwm_config pwmcfg = pwm_get_default_config();
-    float clkdiv = (float)clock_get_hz(clk_sys) / (float)(65535 * frequency);
+    float clkdiv = (float)clock_get_hz(clk_sys) / (float)(RP2040PWMWrapMax * frequency);
     if(clkdiv < 1.0f) {
         clkdiv = 1.0f;
     } else {
@@ -727,6 +1151,7 @@ void rp2040EnablePWMTimer(unsigned int slice_num, unsigned int frequency)
     // set the clock divider in the config and fetch the actual value that is used
     pwm_config_set_clkdiv(&pwmcfg, clkdiv);
     clkdiv = (float)pwmcfg.div / (float)(1u << PWM_CH1_DIV_INT_LSB);
+    rp2040PWMClkDiv = clkdiv;
     
     // calculate wrap value that will trigger the IRQ for the target frequency
     pwm_config_set_wrap(&pwmcfg, (float)clock_get_hz(clk_sys) / (frequency * clkdiv));
@@ -740,7 +1165,25 @@ void rp2040pwmIrq(void)
 {
     pwm_hw->intr = 0xff;
     irPosUpdateTick = 1;
+    LATENCY_TICK();
 }
+
+#ifdef IR_CAM_PHASE_LOCK
+void rp2040SetPWMTimerPeriod(unsigned int slice_num, unsigned long periodUs, unsigned long delayUs, bool restart)
+{
+    const float ticksPerUs = (float)clock_get_hz(clk_sys) / (1000000.0f * rp2040PWMClkDiv);
+
+    // the wrap is 16 bits, and the counter can't start before 0
+    const uint16_t wrap = (uint16_t)min(ticksPerUs * periodUs, 65535.0f);
+    const uint16_t delay = (uint16_t)min(ticksPerUs * delayUs, (float)wrap);
+
+    // the IRQ triggers on wrap so start the counter at the delay before the wrap value
+    pwm_set_wrap(slice_num, wrap);
+    if(restart) {
+        pwm_set_counter(slice_num, wrap - delay);
+    }
+}
+#endif // IR_CAM_PHASE_LOCK
 #endif
 
 #ifdef SAMCO_NO_HW_TIMER
@@ -750,6 +1193,7 @@ void NoHardwareTimerCamTickMicros()
     if(us - irPosUpdateTime >= 1000000UL / IRCamUpdateRate) {
         irPosUpdateTime = us;
         irPosUpdateTick = 1;
+        LATENCY_TICK();
     }
 }
 
@@ -759,108 +1203,106 @@ void NoHardwareTimerCamTickMillis()
     if(ms - irPosUpdateTime >= (1000UL + (IRCamUpdateRate / 2)) / IRCamUpdateRate) {
         irPosUpdateTime = ms;
         irPosUpdateTick = 1;
+        LATENCY_TICK();
     }
 }
 #endif // SAMCO_NO_HW_TIMER
 
-// Periodic yield to run USB tasks. Maybe only required for TinyUSB.
-unsigned long lastYieldMillis = 0;
-inline void USBYield()
+// USB task, periodic yield to run USB tasks. Maybe only required for TinyUSB.
+void TaskUsb()
 {
     // how frequently should yield() be called? gallop2WhoKnows
     // I searched the TinyUSB GitHub discussions and didn't find a definitive answer
-    if(millis() - lastYieldMillis >= 2) {
-        yield();
-        lastYieldMillis = millis();
+    yield();
+}
+
+// HID task, sends the next mouse or keyboard report if the host took the last one,
+// with auto report this sends the reports the USB stack couldn't take at the time of the change
+void TaskHid()
+{
+    // the keyboard only has reports for key changes so it goes first, the mouse position is the latest either way,
+    // but the keyboard doesn't take two reports in a row while the mouse waits
+    static bool keyboardLast = false;
+    if(keyboardLast && AbsMouse5.commit()) {
+        keyboardLast = false;
+        return;
+    }
+    if(BasicKeyboard.commit()) {
+        keyboardLast = true;
+    } else if(AbsMouse5.commit()) {
+        keyboardLast = false;
     }
 }
 
-void loop()
+#ifdef USB_SOF_SYNC
+// current USB frame number from the USB controller
+uint16_t UsbFrameNumber()
 {
-    USBYield();
+#if defined(SAMCO_SAMD21) || defined(SAMCO_SAMD51)
+    return USB->DEVICE.FNUM.bit.FNUM;
+#elif defined(SAMCO_ATMEGA32U4)
+    return UDFNUM;
+#elif defined(SAMCO_RP2040)
+    return usb_hw->sof_rd & USB_SOF_RD_BITS;
+#endif
+}
 
-    SAMCO_NO_HW_TIMER_UPDATE();
-    
-    // poll/update button states with 1ms interval so debounce mask is more effective
-    buttons.Poll(1);
-    buttons.Repeat();
+// SOF task, follows the USB frame number and learns when the host takes the reports
+void TaskSof()
+{
+    const uint32_t us = micros();
+    sofSync.frame(UsbFrameNumber(), us);
+#ifdef USE_TINYUSB
+    const bool ready = tud_hid_ready();
+    if(ready && !sofHidReady) {
+        sofSync.polled(us);
+    }
+    sofHidReady = ready;
+#endif // USE_TINYUSB
+}
 
-    switch(gunMode) {
-        case GunMode_Pause:
-            if(buttons.pressedReleased == ExitPauseModeBtnMask) {
-                SetMode(GunMode_Run);
-            } else if(buttons.pressedReleased == BtnMask_Trigger) {
-                SetMode(GunMode_CalCenter);
-            } else if(buttons.pressedReleased == RunModeNormalBtnMask) {
-                SetRunMode(RunMode_Normal);
-            } else if(buttons.pressedReleased == RunModeAverageBtnMask) {
-                SetRunMode(runMode == RunMode_Average ? RunMode_Average2 : RunMode_Average);
-            } else if(buttons.pressedReleased == RunModeProcessingBtnMask) {
-                SetRunMode(RunMode_Processing);
-            } else if(buttons.pressedReleased == IRSensitivityUpBtnMask) {
-                IncreaseIrSensitivity();
-            } else if(buttons.pressedReleased == IRSensitivityDownBtnMask) {
-                DecreaseIrSensitivity();
-            } else if(buttons.pressedReleased == SaveBtnMask) {
-                SavePreferences();
-            } else {
-                SelectCalProfileFromBtnMask(buttons.pressedReleased);
-            }
+// true once the IR camera read can start so it completes the lead time before a host poll
+bool IrCamSlotReached()
+{
+    const uint32_t us = micros();
+    if(!irReadSlotPending) {
+        irReadSlotPending = true;
+        irReadSlotUs = sofSync.readSlot(us, irReadUs);
+    }
+    if((int32_t)(us - irReadSlotUs) < 0) {
+        return false;
+    }
+    irReadSlotPending = false;
+    return true;
+}
+#endif // USB_SOF_SYNC
 
-            PrintResults();
-            
-            break;
-        case GunMode_CalCenter:
-            AbsMouse5.move(MouseMaxX / 2, MouseMaxY / 2);
-            if(buttons.pressedReleased & CancelCalBtnMask) {
-                CancelCalibration();
-            } else if(buttons.pressedReleased == SkipCalCenterBtnMask) {
-                Serial.println("Calibrate Center skipped");
-                SetMode(GunMode_CalVert);
-            } else if(buttons.pressed & BtnMask_Trigger) {
-                // trigger pressed, begin center cal 
-                CalCenter();
-                // extra delay to wait for trigger to release (though not required)
-                SetModeWaitNoButtons(GunMode_CalVert, 500);
-            }
-            break;
-        case GunMode_CalVert:
-            if(buttons.pressedReleased & CancelCalBtnMask) {
-                CancelCalibration();
-            } else {
-                if(buttons.pressed & BtnMask_Trigger) {
-                    SetMode(GunMode_CalHoriz);
-                } else {
-                    CalVert();
-                }
-            }
-            break;
-        case GunMode_CalHoriz:
-            if(buttons.pressedReleased & CancelCalBtnMask) {
-                CancelCalibration();
-            } else {
-                if(buttons.pressed & BtnMask_Trigger) {
-                    ApplyCalToProfile();
-                    SetMode(GunMode_Run);
-                } else {
-                    CalHoriz();
-                }
-            }
-            break;
-        default:
-            /* ---------------------- LET'S GO --------------------------- */
-            switch(runMode) {
-            case RunMode_Processing:
-                ExecRunModeProcessing();
-                break;
-            case RunMode_Average:
-            case RunMode_Average2:
-            case RunMode_Normal:
-            default:
-                ExecRunMode();
-                break;
-            }
-            break;
+// LED task, applies the IR seen colour so the LED writes are kept out of the camera task
+void TaskLed()
+{
+    if(!lastSeen != !ledSeen) {
+        SetLedColorFromMode();
+    }
+}
+
+// serial task, periodic prints for the current mode
+void TaskSerial()
+{
+    switch(gunMode) {
+    case GunMode_Pause:
+        PrintResults();
+        break;
+    case GunMode_CalCenter:
+        if(calCenterState == CalCenter_Accumulate) {
+            PrintCalInterval();
+        }
+        break;
+    case GunMode_CalVert:
+    case GunMode_CalHoriz:
+        PrintCalInterval();
+        break;
+    default:
+        break;
     }
 
 #ifdef DEBUG_SERIAL
@@ -868,184 +1310,494 @@ void loop()
 #endif // DEBUG_SERIAL
 }
 
-/*        -----------------------------------------------        */
-/* --------------------------- METHODS ------------------------- */
-/*        -----------------------------------------------        */
-
-void ExecRunMode()
+// pause mode buttons task
+void TaskPauseButtons()
 {
-#ifdef DEBUG_SERIAL
-    Serial.print("exec run mode ");
-    Serial.println(RunModeLabels[runMode]);
-#endif
-    moveIndex = 0;
-    buttons.ReportEnable();
-    for(;;) {
-        USBYield();
+    // poll/update button states with 1ms interval so debounce mask is more effective
+    buttons.Poll(1);
+    buttons.Repeat();
 
-        buttons.Poll(0);
+    if(buttons.pressedReleased == ExitPauseModeBtnMask) {
+        SetMode(GunMode_Run);
+    } else if(buttons.pressedReleased == BtnMask_Trigger) {
+        SetMode(GunMode_CalCenter);
+    } else if(buttons.pressedReleased == RunModeNormalBtnMask) {
+        SetRunMode(RunMode_Normal);
+    } else if(buttons.pressedReleased == RunModeAverageBtnMask) {
+        SetRunMode(runMode == RunMode_Average ? RunMode_Average2 : RunMode_Average);
+    } else if(buttons.pressedReleased == RunModeProcessingBtnMask) {
+        SetRunMode(RunMode_Processing);
+    } else if(buttons.pressedReleased == RunModePredictBtnMask) {
+        SetRunMode(RunMode_Predict);
+    } else if(buttons.pressedReleased == RunModeEuroBtnMask) {
+        SetRunMode(RunMode_Euro);
+    } else if(buttons.pressedReleased == FilterPresetBtnMask) {
+        NextFilterPreset();
+#ifdef LATENCY_STATS
+    } else if(buttons.pressedReleased == LatencyPrintBtnMask) {
+        PrintLatency();
+#endif // LATENCY_STATS
+    } else if(buttons.pressedReleased == EuroCutoffUpBtnMask) {
+        AdjustEuroParams(EuroMinCutoffStep, 0);
+    } else if(buttons.pressedReleased == EuroCutoffDownBtnMask) {
+        AdjustEuroParams(-(int)EuroMinCutoffStep, 0);
+    } else if(buttons.pressedReleased == EuroBetaUpBtnMask) {
+        AdjustEuroParams(0, EuroBetaStep);
+    } else if(buttons.pressedReleased == EuroBetaDownBtnMask) {
+        AdjustEuroParams(0, -(int)EuroBetaStep);
+    } else if(buttons.pressedReleased == PosEngineBtnMask) {
+        SetPosEngine(posEngine == PosEngine_Samco ? PosEngine_Homography : PosEngine_Samco);
+    } else if(buttons.pressedReleased == IRSensitivityUpBtnMask) {
+        IncreaseIrSensitivity();
+    } else if(buttons.pressedReleased == IRSensitivityDownBtnMask) {
+        DecreaseIrSensitivity();
+    } else if(buttons.pressedReleased == SaveBtnMask) {
+        SavePreferences();
+    } else {
+        SelectCalProfileFromBtnMask(buttons.pressedReleased);
+    }
+}
 
-        SAMCO_NO_HW_TIMER_UPDATE();
-        if(irPosUpdateTick) {
-            irPosUpdateTick = 0;
-            GetPosition();
-            
-            int halfHscale = (int)(mySamco.h() * xScale + 0.5f) / 2;
-            moveXAxis = map(finalX, xCenter + halfHscale, xCenter - halfHscale, 0, MouseMaxX);
-            halfHscale = (int)(mySamco.h() * yScale + 0.5f) / 2;
-            moveYAxis = map(finalY, yCenter + halfHscale, yCenter - halfHscale, 0, MouseMaxY);
-
-            switch(runMode) {
-            case RunMode_Average:
-                // 2 position moving average
-                moveIndex ^= 1;
-                moveXAxisArr[moveIndex] = moveXAxis;
-                moveYAxisArr[moveIndex] = moveYAxis;
-                moveXAxis = (moveXAxisArr[0] + moveXAxisArr[1]) / 2;
-                moveYAxis = (moveYAxisArr[0] + moveYAxisArr[1]) / 2;
-                break;
-            case RunMode_Average2:
-                // weighted average of current position and previous 2
-                if(moveIndex < 2) {
-                    ++moveIndex;
-                } else {
-                    moveIndex = 0;
-                }
-                moveXAxisArr[moveIndex] = moveXAxis;
-                moveYAxisArr[moveIndex] = moveYAxis;
-                moveXAxis = (moveXAxis + moveXAxisArr[0] + moveXAxisArr[1] + moveXAxisArr[1] + 2) / 4;
-                moveYAxis = (moveYAxis + moveYAxisArr[0] + moveYAxisArr[1] + moveYAxisArr[1] + 2) / 4;
-                break;
-            case RunMode_Normal:
-            default:
-                break;
-            }
+// calibration camera task
+void TaskCalCamera()
+{
+    SAMCO_NO_HW_TIMER_UPDATE();
 
+    switch(gunMode) {
+    case GunMode_CalCenter:
+        // center pointer
+        if(calCenterState != CalCenter_WaitRelease) {
+            AbsMouse5.move(MouseMaxX / 2, MouseMaxY / 2);
+        }
+        // accumulate center position over a bit of time for some averaging
+        if(calCenterState == CalCenter_Accumulate && GetPositionIfReady()) {
+            calCenterXAcc += finalX;
+            calCenterYAcc += finalY;
+            calCenterCount++;
+            
+            xCenter = finalX;
+            yCenter = finalY;
+        }
+        break;
+    case GunMode_CalVert:
+        if(GetPositionIfReady()) {
+            int halfH = (int)(finalH * yScale + 0.5f) / 2;
+            moveYAxis = map(finalY, yCenter + halfH, yCenter - halfH, 0, MouseMaxY);
+            conMoveXAxis = MouseMaxX / 2;
+            conMoveYAxis = constrain(moveYAxis, 0, MouseMaxY);
+            AbsMouse5.move(conMoveXAxis, conMoveYAxis);
+        }
+        break;
+    case GunMode_CalHoriz:
+        if(GetPositionIfReady()) {    
+            int halfH = (int)(finalH * xScale + 0.5f) / 2;
+            moveXAxis = map(finalX, xCenter + halfH, xCenter - halfH, 0, MouseMaxX);
             conMoveXAxis = constrain(moveXAxis, 0, MouseMaxX);
-            conMoveYAxis = constrain(moveYAxis, 0, MouseMaxY);                
+            conMoveYAxis = MouseMaxY / 2;
             AbsMouse5.move(conMoveXAxis, conMoveYAxis);
-            
-#ifdef DEBUG_SERIAL
-            ++irPosCount;
-#endif // DEBUG_SERIAL
         }
+        break;
+    default:
+        break;
+    }
+}
 
-        if(buttons.pressedReleased == EnterPauseModeBtnMask) {
-            SetMode(GunMode_Pause);
-            buttons.ReportDisable();
-            AbsMouse5.releaseAll();
-            BasicKeyboard.releaseAll();
-            return;
+// calibration buttons task
+void TaskCalButtons()
+{
+    buttons.Poll(1);
+    buttons.Repeat();
+
+    switch(gunMode) {
+    case GunMode_CalCenter:
+        CalCenter();
+        break;
+    case GunMode_CalVert:
+        if(buttons.pressedReleased & CancelCalBtnMask) {
+            CancelCalibration();
+        } else if(buttons.pressed & BtnMask_Trigger) {
+            SetMode(GunMode_CalHoriz);
+        } else {
+            CalVert();
         }
+        break;
+    case GunMode_CalHoriz:
+        if(buttons.pressedReleased & CancelCalBtnMask) {
+            CancelCalibration();
+        } else if(buttons.pressed & BtnMask_Trigger) {
+            ApplyCalToProfile();
+            SetMode(GunMode_Run);
+        } else {
+            CalHoriz();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef CORE1_CAMERA
+// core1 reads the IR camera and calculates the position while the gate is open
+void loop1()
+{
+    if(!core1Gate.enter()) {
+        return;
+    }
+
+    if(irPosUpdateTick) {
+        irPosUpdateTick = 0;
+
+        SamcoPositionRing::Position_t pos;
+#ifdef LATENCY_STATS
+        pos.tickUs = irPosTickUs;
+#else
+        pos.tickUs = micros();
+#endif // LATENCY_STATS
+        pos.readStartUs = micros();
+        pos.error = ReadIrCamAtomic();
+        pos.readUs = micros();
+        IR_CAM_PHASE_UPDATE();
+        if(pos.error == DFRobotIRPositionEx::Error_Success) {
+            pos.seen = CalcPosition(pos.x, pos.y, pos.h);
+        }
+        pos.positionUs = micros();
+        positionRing.push(pos);
+    }
+
+    core1Gate.leave();
+}
+
+// run mode camera task, takes the newest position from core1
+void TaskRunCamera()
+{
+    SamcoPositionRing::Position_t pos;
+    if(!positionRing.popLatest(pos)) {
+        return;
+    }
+
+    LATENCY_STAMP(Stamp_Tick, pos.tickUs);
+    LATENCY_STAMP(Stamp_Read, pos.readUs);
+    // average the IIC read time over 8 frames
+    irReadUs = (irReadUs * 7 + (pos.readUs - pos.readStartUs)) / 8;
+    if(pos.error == DFRobotIRPositionEx::Error_Success) {
+        finalX = pos.x;
+        finalY = pos.y;
+        finalH = pos.h;
+        UpdateLastSeen(pos.seen);
+    } else if(pos.error != DFRobotIRPositionEx::Error_DataMismatch) {
+        ReportIrCamError();
+    }
+    LATENCY_STAMP(Stamp_Position, pos.positionUs);
 
+    RunModeMove();
+}
+#else
+// run mode camera task
+void TaskRunCamera()
+{
+    SAMCO_NO_HW_TIMER_UPDATE();
+    if(irPosUpdateTick && !IrCam().atomicBusy() && IR_CAM_SLOT_REACHED()) {
+        irPosUpdateTick = 0;
+        // start the camera read, the IIC transactions are spread over the task runs
+        // with IR_CAM_DUAL the cameras alternate each tick
+        IrCam().startAtomic(IRCamDataFormat, DFRobotIRPositionEx::Retry_2);
+        irReadStartUs = micros();
+        LATENCY_STAMP(Stamp_Tick, irPosTickUs);
+    }
+
+    if(IrCam().atomicBusy() && IrCam().pollAtomic()) {
+        LATENCY_STAMP(Stamp_Read, micros());
+        IR_CAM_PHASE_UPDATE();
+        // average the IIC read time over 8 frames
+        irReadUs = (irReadUs * 7 + (micros() - irReadStartUs)) / 8;
+#ifdef USB_SOF_SYNC
+        irReadDoneUs = micros();
+#endif // USB_SOF_SYNC
+        UpdatePosition(IrCam().atomicResult());
+        LATENCY_STAMP(Stamp_Position, micros());
+
+        RunModeMove();
+    }
+}
+#endif // CORE1_CAMERA
+
+// map, filter and move the mouse to the latest position
+void RunModeMove()
+{
+    mouseMapX.update((int)(finalH * xScale + 0.5f) / 2, xCenter, MouseMaxX);
+    mouseMapY.update((int)(finalH * yScale + 0.5f) / 2, yCenter, MouseMaxY);
+    moveXAxis = mouseMapX.map(finalX);
+    moveYAxis = mouseMapY.map(finalY);
+
+    ApplyFilterPipeline(moveXAxis, moveYAxis);
+
+    conMoveXAxis = constrain(moveXAxis, 0, MouseMaxX);
+    conMoveYAxis = constrain(moveYAxis, 0, MouseMaxY);                
+#ifdef LATENCY_STATS
+    latency.stamp(SamcoLatency::Stamp_Move, micros());
+    const uint32_t lastReportUs = AbsMouse5.reportMicros();
+#endif // LATENCY_STATS
+    AbsMouse5.move(conMoveXAxis, conMoveYAxis);
+#ifdef HID_FRAME_COMMIT
+    // send now if the host is ready so the latency stats see the report, otherwise the HID task sends it
+    AbsMouse5.commit();
+#endif // HID_FRAME_COMMIT
+#ifdef USB_SOF_SYNC
+    sofSync.sampled(irReadDoneUs, micros());
+#endif // USB_SOF_SYNC
+#ifdef LATENCY_STATS
+    // a frame that doesn't move the mouse, or has to wait for the host, doesn't send a report
+    if(AbsMouse5.reportMicros() != lastReportUs) {
+        latency.stamp(SamcoLatency::Stamp_Report, AbsMouse5.reportMicros());
+    } else {
+        latency.cancel();
+    }
+#endif // LATENCY_STATS
+    
 #ifdef DEBUG_SERIAL
-        ++frameCount;
-        PrintDebugSerial();
+    ++irPosCount;
 #endif // DEBUG_SERIAL
+}
+
+// run mode buttons task
+void TaskRunButtons()
+{
+    buttons.Poll(0);
+
+    if(buttons.pressedReleased == EnterPauseModeBtnMask) {
+        SetMode(GunMode_Pause);
+        buttons.ReportDisable();
+        AbsMouse5.releaseAll();
+        BasicKeyboard.releaseAll();
     }
 }
 
 // from Samco_4IR_Test_BETA sketch
 // for use with the Samco_4IR_Processing_Sketch_BETA Processing sketch
-void ExecRunModeProcessing()
+void TaskProcessingCamera()
 {
+#ifndef PROCESSING_BINARY
     // constant offset added to output values
     const int processingOffset = 100;
+#endif // PROCESSING_BINARY
 
-    buttons.ReportDisable();
-    for(;;) {
-        USBYield();
-
-        buttons.Poll(1);
-        if(buttons.pressedReleased & EnterPauseModeProcessingBtnMask) {
-            SetMode(GunMode_Pause);
-            return;
-        }
-
-        SAMCO_NO_HW_TIMER_UPDATE();
-        if(irPosUpdateTick) {
-            irPosUpdateTick = 0;
-        
-            int error = dfrIRPos.basicAtomic(DFRobotIRPositionEx::Retry_2);
-            if(error == DFRobotIRPositionEx::Error_Success) {
-                mySamco.begin(dfrIRPos.xPositions(), dfrIRPos.yPositions(), dfrIRPos.seen(), MouseMaxX / 2, MouseMaxY / 2);
-                UpdateLastSeen();
-                for(int i = 0; i < 4; i++) {
-                    Serial.print(map(mySamco.testX(i), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
-                    Serial.print(",");
-                    Serial.print(map(mySamco.testY(i), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
-                    Serial.print(",");
-                }
-                Serial.print(map(mySamco.x(), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
-                Serial.print(",");
-                Serial.print(map(mySamco.y(), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
+    SAMCO_NO_HW_TIMER_UPDATE();
+    if(irPosUpdateTick) {
+        irPosUpdateTick = 0;
+    
+        int error = ReadIrCamAtomic();
+#ifdef PROCESSING_BINARY
+        processingFrame.us = micros();
+#endif // PROCESSING_BINARY
+        IR_CAM_PHASE_UPDATE();
+        if(error == DFRobotIRPositionEx::Error_Success) {
+            mySamco.begin(IrCam().xPositions(), IrCam().yPositions(), IrCam().seen(), MouseMaxX / 2, MouseMaxY / 2);
+            UpdateLastSeen(mySamco.seen());
+#ifdef PROCESSING_BINARY
+            SendProcessingFrame();
+#else
+            for(int i = 0; i < 4; i++) {
+                Serial.print(map(mySamco.testX(i), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
                 Serial.print(",");
-                Serial.print(map(mySamco.testMedianX(), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
+                Serial.print(map(mySamco.testY(i), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
                 Serial.print(",");
-                Serial.println(map(mySamco.testMedianY(), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
-            } else if(error == DFRobotIRPositionEx::Error_IICerror) {
-                Serial.println("Device not available!");
             }
+            Serial.print(map(mySamco.x(), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
+            Serial.print(",");
+            Serial.print(map(mySamco.y(), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
+            Serial.print(",");
+            Serial.print(map(mySamco.testMedianX(), 0, MouseMaxX, CamMaxX, 0) + processingOffset);
+            Serial.print(",");
+            Serial.println(map(mySamco.testMedianY(), 0, MouseMaxY, CamMaxY, 0) + processingOffset);
+#endif // PROCESSING_BINARY
+        } else if(error == DFRobotIRPositionEx::Error_IICerror || error == DFRobotIRPositionEx::Error_Recovering) {
+            ReportIrCamError();
         }
     }
 }
 
-// center calibration with a bit of averaging
-void CalCenter()
+#ifdef PROCESSING_BINARY
+// send the camera points and the position engine outputs as a binary frame
+void SendProcessingFrame()
 {
-    unsigned int xAcc = 0;
-    unsigned int yAcc = 0;
-    unsigned int count = 0;
-    unsigned long ms = millis();
-    
-    // accumulate center position over a bit of time for some averaging
-    while(millis() - ms < 333) {
-        // center pointer
-        AbsMouse5.move(MouseMaxX / 2, MouseMaxY / 2);
-        
-        // get position
-        if(GetPositionIfReady()) {
-            xAcc += finalX;
-            yAcc += finalY;
-            count++;
-            
-            xCenter = finalX;
-            yCenter = finalY;
-            PrintCalInterval();
-        }
+    SamcoTelemetry::Frame_t& frame = processingFrame;
+    for(unsigned int i = 0; i < 4; ++i) {
+        frame.rawX[i] = IrCam().xPositions()[i];
+        frame.rawY[i] = IrCam().yPositions()[i];
+        frame.pointX[i] = mySamco.testX(i);
+        frame.pointY[i] = mySamco.testY(i);
+    }
+    frame.camSeen = IrCam().seen();
+    frame.engineSeen = mySamco.seen();
+    frame.engine = posEngine;
+    frame.x = mySamco.x();
+    frame.y = mySamco.y();
+    frame.medianX = mySamco.testMedianX();
+    frame.medianY = mySamco.testMedianY();
+    myHomography.begin(IrCam().xPositions(), IrCam().yPositions(), IrCam().seen(), MouseMaxX / 2, MouseMaxY / 2);
+    frame.homX = myHomography.x();
+    frame.homY = myHomography.y();
+
+    // skip the frame rather than wait if the host isn't keeping up, it sees the missing sequence number
+    if(Serial.availableForWrite() >= (int)SamcoTelemetry::FrameSize) {
+        Serial.write(processingBuf, SamcoTelemetry::encode(frame, processingBuf));
+    }
+    ++frame.seq;
+}
+#endif // PROCESSING_BINARY
 
-        // poll buttons
-        buttons.Poll(1);
-        
-        // if trigger not pressed then break out of loop early
-        if(!(buttons.debounced & BtnMask_Trigger)) {
-            break;
-        }
+// Processing mode buttons task
+void TaskProcessingButtons()
+{
+    buttons.Poll(1);
+    if(buttons.pressedReleased & EnterPauseModeProcessingBtnMask) {
+        SetMode(GunMode_Pause);
     }
+}
 
-    // unexpected, but make sure x and y positions are accumulated
-    if(count) {
-        xCenter = xAcc / count;
-        yCenter = yAcc / count;
-    } else {
-        Serial.print("Unexpected Center calibration failure, no center position was acquired!");
-        // just continue anyway
+// task sets for each mode, the first task of each set runs first after a mode change
+const SamcoScheduler::Task_t RunTasks[] = {
+    {TaskRunCamera, 0, CameraTaskBudgetUs, "camera"},
+#ifdef USB_SOF_SYNC
+    {TaskSof, 0, SofTaskBudgetUs, "SOF"},
+#endif // USB_SOF_SYNC
+    {TaskRunButtons, 0, ButtonsTaskBudgetUs, "buttons"},
+    {TaskHid, 0, HidTaskBudgetUs, "HID"},
+    {TaskUsb, UsbTaskPeriodUs, UsbTaskBudgetUs, "USB"},
+    {TaskLed, LedTaskPeriodUs, LedTaskBudgetUs, "LED"},
+    {TaskSerial, SerialTaskPeriodUs, SerialTaskBudgetUs, "serial"}
+};
+
+const SamcoScheduler::Task_t ProcessingTasks[] = {
+    {TaskProcessingCamera, 0, CalCameraTaskBudgetUs, "camera"},
+    {TaskProcessingButtons, ButtonsTaskPeriodUs, ButtonsTaskBudgetUs, "buttons"},
+    {TaskHid, 0, HidTaskBudgetUs, "HID"},
+    {TaskUsb, UsbTaskPeriodUs, UsbTaskBudgetUs, "USB"},
+    {TaskLed, LedTaskPeriodUs, LedTaskBudgetUs, "LED"},
+    {TaskSerial, SerialTaskPeriodUs, SerialTaskBudgetUs, "serial"}
+};
+
+const SamcoScheduler::Task_t PauseTasks[] = {
+    {TaskPauseButtons, ButtonsTaskPeriodUs, PauseButtonsTaskBudgetUs, "buttons"},
+    {TaskHid, 0, HidTaskBudgetUs, "HID"},
+    {TaskUsb, UsbTaskPeriodUs, UsbTaskBudgetUs, "USB"},
+    {TaskSerial, SerialTaskPeriodUs, SerialTaskBudgetUs, "serial"}
+};
+
+const SamcoScheduler::Task_t CalTasks[] = {
+    {TaskCalCamera, 0, CalCameraTaskBudgetUs, "camera"},
+    {TaskCalButtons, ButtonsTaskPeriodUs, ButtonsTaskBudgetUs, "buttons"},
+    {TaskHid, 0, HidTaskBudgetUs, "HID"},
+    {TaskUsb, UsbTaskPeriodUs, UsbTaskBudgetUs, "USB"},
+    {TaskSerial, SerialTaskPeriodUs, SerialTaskBudgetUs, "serial"}
+};
+
+void loop()
+{
+    scheduler.run();
+
+#ifdef DEBUG_SERIAL
+    ++frameCount;
+#endif // DEBUG_SERIAL
+}
+
+/*        -----------------------------------------------        */
+/* --------------------------- METHODS ------------------------- */
+/*        -----------------------------------------------        */
+
+// swap in the task set for the current mode
+void BeginModeTasks()
+{
+#ifdef CORE1_CAMERA
+    // wait for core1 to finish with the camera before another mode reads it or changes its settings
+    core1Gate.close();
+#endif // CORE1_CAMERA
+
+    switch(gunMode) {
+    case GunMode_Pause:
+        scheduler.begin(PauseTasks, sizeof(PauseTasks) / sizeof(PauseTasks[0]));
+        break;
+    case GunMode_CalCenter:
+    case GunMode_CalVert:
+    case GunMode_CalHoriz:
+        scheduler.begin(CalTasks, sizeof(CalTasks) / sizeof(CalTasks[0]));
+        break;
+    case GunMode_Run:
+        if(runMode == RunMode_Processing) {
+            buttons.ReportDisable();
+            scheduler.begin(ProcessingTasks, sizeof(ProcessingTasks) / sizeof(ProcessingTasks[0]));
+        } else {
+#ifdef DEBUG_SERIAL
+            Serial.print("exec run mode ");
+            Serial.println(RunModeLabels[runMode]);
+#endif
+            BeginFilterPipeline();
+            buttons.ReportEnable();
+            scheduler.begin(RunTasks, sizeof(RunTasks) / sizeof(RunTasks[0]));
+#ifdef CORE1_CAMERA
+            positionRing.clear();
+            core1Gate.open();
+#endif // CORE1_CAMERA
+#ifdef USB_SOF_SYNC
+            // the SOF task hasn't been following the frames, don't start the read from an old slot
+            irReadSlotPending = false;
+#endif // USB_SOF_SYNC
+        }
+        break;
+    default:
+        break;
     }
+}
 
-    PrintCalInterval();
+// center calibration with a bit of averaging, the camera task accumulates the positions
+void CalCenter()
+{
+    switch(calCenterState) {
+    case CalCenter_Wait:
+        if(buttons.pressedReleased & CancelCalBtnMask) {
+            CancelCalibration();
+        } else if(buttons.pressedReleased == SkipCalCenterBtnMask) {
+            Serial.println("Calibrate Center skipped");
+            SetMode(GunMode_CalVert);
+        } else if(buttons.pressed & BtnMask_Trigger) {
+            // trigger pressed, begin center cal 
+            calCenterXAcc = 0;
+            calCenterYAcc = 0;
+            calCenterCount = 0;
+            calCenterMs = millis();
+            calCenterState = CalCenter_Accumulate;
+        }
+        break;
+    case CalCenter_Accumulate:
+        // accumulate for a bit of time, or until the trigger is released
+        if(millis() - calCenterMs >= 333 || !(buttons.debounced & BtnMask_Trigger)) {
+            // unexpected, but make sure x and y positions are accumulated
+            if(calCenterCount) {
+                xCenter = calCenterXAcc / calCenterCount;
+                yCenter = calCenterYAcc / calCenterCount;
+            } else {
+                Serial.print("Unexpected Center calibration failure, no center position was acquired!");
+                // just continue anyway
+            }
+            PrintCalInterval();
+
+            calCenterMs = millis();
+            calCenterState = CalCenter_WaitRelease;
+        }
+        break;
+    case CalCenter_WaitRelease:
+    default:
+        // extra delay to wait for trigger to release (though not required)
+        if(!buttons.debounced || millis() - calCenterMs >= 500) {
+            SetMode(GunMode_CalVert);
+        }
+        break;
+    }
 }
 
-// vertical calibration 
+// vertical calibration, the camera task moves the pointer
 void CalVert()
 {
-    if(GetPositionIfReady()) {
-        int halfH = (int)(mySamco.h() * yScale + 0.5f) / 2;
-        moveYAxis = map(finalY, yCenter + halfH, yCenter - halfH, 0, MouseMaxY);
-        conMoveXAxis = MouseMaxX / 2;
-        conMoveYAxis = constrain(moveYAxis, 0, MouseMaxY);
-        AbsMouse5.move(conMoveXAxis, conMoveYAxis);
-    }
-    
     if(buttons.repeat & BtnMask_B) {
         yScale = yScale + ScaleStep;
     }
@@ -1061,21 +1813,11 @@ void CalVert()
     } else if(buttons.pressedReleased == BtnMask_Down) {
         yCenter++;
     }
-    
-    PrintCalInterval();
 }
 
-// horizontal calibration 
+// horizontal calibration, the camera task moves the pointer
 void CalHoriz()
 {
-    if(GetPositionIfReady()) {    
-        int halfH = (int)(mySamco.h() * xScale + 0.5f) / 2;
-        moveXAxis = map(finalX, xCenter + halfH, xCenter - halfH, 0, MouseMaxX);
-        conMoveXAxis = constrain(moveXAxis, 0, MouseMaxX);
-        conMoveYAxis = MouseMaxY / 2;
-        AbsMouse5.move(conMoveXAxis, conMoveYAxis);
-    }
-
     if(buttons.repeat & BtnMask_B) {
         xScale = xScale + ScaleStep;
     }
@@ -1091,8 +1833,6 @@ void CalHoriz()
     } else if(buttons.pressedReleased == BtnMask_Right) {
         xCenter++;
     }
-
-    PrintCalInterval();
 }
 
 // Helper to get position if the update tick is set
@@ -1110,59 +1850,89 @@ bool GetPositionIfReady()
 // Updates finalX and finalY values
 void GetPosition()
 {
-    int error = dfrIRPos.basicAtomic(DFRobotIRPositionEx::Retry_2);
-    if(error == DFRobotIRPositionEx::Error_Success) {
-        mySamco.begin(dfrIRPos.xPositions(), dfrIRPos.yPositions(), dfrIRPos.seen(), xCenter, yCenter);
-#ifdef EXTRA_POS_GLITCH_FILTER
-        if((abs(mySamco.X() - finalX) > BadMoveThreshold || abs(mySamco.Y() - finalY) > BadMoveThreshold) && badFinalTick < BadMoveCountThreshold) {
-            ++badFinalTick;
-        } else {
-            if(badFinalTick) {
-                badFinalCount++;
-                badFinalTick = 0;
-            }
-            finalX = mySamco.X();
-            finalY = mySamco.Y();
-        }
+    const int error = ReadIrCamAtomic();
+    IR_CAM_PHASE_UPDATE();
+    UpdatePosition(error);
+}
+
+// IR positioning camera reads and points, with IR_CAM_DUAL both cameras in turn with their points fused
+IrCam_t& IrCam()
+{
+#ifdef IR_CAM_DUAL
+    return dualCam;
+#else
+    return dfrIRPos;
+#endif // IR_CAM_DUAL
+}
+
+// Atomically read the IR positioning camera in the configured data format
+int ReadIrCamAtomic()
+{
+#ifdef IR_CAM_DUAL
+    // the next camera, so the calibration and processing mode see both
+    return dualCam.readAtomic(IRCamDataFormat, DFRobotIRPositionEx::Retry_2);
 #else
-        finalX = mySamco.x();
-        finalY = mySamco.y();
-#endif // EXTRA_POS_GLITCH_FILTER
+    if(IRCamDataFormat == DFRobotIRPositionEx::DataFormat_Extended) {
+        return dfrIRPos.extendedAtomic(DFRobotIRPositionEx::Retry_2);
+    }
+    return dfrIRPos.basicAtomic(DFRobotIRPositionEx::Retry_2);
+#endif // IR_CAM_DUAL
+}
 
-        UpdateLastSeen();
+// Update the tilt adjusted position from a completed IR positioning camera read
+// Updates finalX and finalY values
+void UpdatePosition(int error)
+{
+    if(error == DFRobotIRPositionEx::Error_Success) {
+        UpdateLastSeen(CalcPosition(finalX, finalY, finalH));
 #if DEBUG_SERIAL == 2
         Serial.print(finalX);
         Serial.print(' ');
         Serial.print(finalY);
         Serial.print("   ");
-        Serial.println(mySamco.h());
+        Serial.println(finalH);
 #endif
     } else if(error != DFRobotIRPositionEx::Error_DataMismatch) {
-        Serial.println("Device not available!");
+        ReportIrCamError();
     }
 }
 
-// wait up to given amount of time for no buttons to be pressed before setting the mode
-void SetModeWaitNoButtons(GunMode_e newMode, unsigned long maxWait)
+// Report an IR camera error, limited so a disconnected camera doesn't flood the serial port
+// The camera recovers by itself so this is only informational
+void ReportIrCamError()
 {
-    unsigned long ms = millis();
-    while(buttons.debounced && (millis() - ms < maxWait)) {
-        buttons.Poll(1);
+    ++irCamErrorCount;
+    if(millis() - irCamErrorMs >= IRCamErrorReportMs) {
+        irCamErrorMs = millis();
+        Serial.print("Device not available! errors ");
+        Serial.println(irCamErrorCount);
+        irCamErrorCount = 0;
     }
-    SetMode(newMode);
 }
 
-// update the last seen value
-// only to be called during run mode since this will modify the LED colour
-void UpdateLastSeen() {
-    if(lastSeen != mySamco.seen()) {
-        if(!lastSeen && mySamco.seen()) {
-            LedOff();
-        } else if(lastSeen && !mySamco.seen()) {
-            SetLedPackedColor(IRSeen0Color);
-        }
-        lastSeen = mySamco.seen();
-    }
+// Calculate the position from the points of the last successful read
+// Returns the seen bit mask
+unsigned int CalcPosition(int& x, int& y, float& h)
+{
+    if(posEngine == PosEngine_Homography) {
+        // the homography maps the camera center, the calibration center is applied after
+        myHomography.begin(IrCam().xPositions(), IrCam().yPositions(), IrCam().seen(), MouseMaxX / 2, MouseMaxY / 2);
+        x = myHomography.x();
+        y = myHomography.y();
+        h = myHomography.h();
+        return myHomography.seen();
+    }
+
+    mySamco.begin(IrCam().xPositions(), IrCam().yPositions(), IrCam().seen(), xCenter, yCenter);
+    x = mySamco.x();
+    y = mySamco.y();
+    h = mySamco.h();
+    return mySamco.seen();
+}
+
+// update the last seen value, the LED task shows it in run mode
+void UpdateLastSeen(unsigned int seen) {
+    lastSeen = seen;
 }
 
 void SetMode(GunMode_e newMode)
@@ -1198,6 +1968,7 @@ void SetMode(GunMode_e newMode)
     case GunMode_CalVert:
         break;
     case GunMode_CalCenter:
+        calCenterState = CalCenter_Wait;
         break;
     case GunMode_Pause:
         stateFlags |= StateFlag_SavePreferencesEn | StateFlag_PrintSelectedProfile;
@@ -1205,6 +1976,130 @@ void SetMode(GunMode_e newMode)
     }
 
     SetLedColorFromMode();
+    BeginModeTasks();
+}
+
+// set new position engine and apply it to the selected profile
+void SetPosEngine(PosEngine_e newEngine)
+{
+    if(newEngine >= PosEngine_Count) {
+        return;
+    }
+
+    if(profileData[selectedProfile].posEngine != newEngine) {
+        profileData[selectedProfile].posEngine = newEngine;
+        stateFlags |= StateFlag_SavePreferencesEn;
+    }
+
+    if(posEngine != newEngine) {
+        posEngine = newEngine;
+        if(!(stateFlags & StateFlag_PrintSelectedProfile)) {
+            PrintPosEngine();
+        }
+    }
+}
+
+// the measured latency is the IIC read time, half a camera frame for the average age of the exposure, and the USB poll
+uint32_t FilterHorizonUs()
+{
+    return irReadUs + 500000UL / IRCamUpdateRate + PredictUsbLatencyUs;
+}
+
+// decode the pipeline of the run mode with the settings of the selected profile and reset the stages,
+// called before the run loop so a frame doesn't gather the settings
+void BeginFilterPipeline()
+{
+    const SamcoPreferences::ProfileData_t& profile = profileData[selectedProfile];
+    SamcoFilterPipeline::Params_t params;
+    params.glitchThreshold = BadMoveThreshold;
+    params.glitchFrames = BadMoveCountThreshold;
+    params.deadZone = DeadZoneSize;
+    params.maxX = MouseMaxX;
+    params.maxY = MouseMaxY;
+    params.predictAlpha = profile.predictAlpha ? profile.predictAlpha : PredictAlphaDefault;
+    params.predictBeta = profile.predictBeta ? profile.predictBeta : PredictBetaDefault;
+    params.predictHorizonUs = profile.predictMs * 1000UL;
+    params.euroMinCutoff = profile.euroMinCutoff ? profile.euroMinCutoff : EuroMinCutoffDefault;
+    params.euroBeta = profile.euroBeta ? profile.euroBeta : EuroBetaDefault;
+    filterHorizonMeasured = !profile.predictMs;
+    if(filterHorizonMeasured) {
+        params.predictHorizonUs = FilterHorizonUs();
+    }
+    filterPipeline.begin(runMode == RunMode_Custom ? profile.filterStages : RunModeFilterStages[runMode <= RunMode_ProfileMax ? runMode : RunMode_Normal], params);
+}
+
+// run the position through the stages of the pipeline
+void ApplyFilterPipeline(int& x, int& y)
+{
+    if(filterHorizonMeasured) {
+        filterPipeline.predictHorizon(FilterHorizonUs());
+    }
+    filterPipeline.apply(x, y, micros());
+}
+
+// adjust the One-Euro parameters of the selected profile
+void AdjustEuroParams(int cutoffStep, int betaStep)
+{
+    SamcoPreferences::ProfileData_t& profile = profileData[selectedProfile];
+    const int cutoff = constrain((int)(profile.euroMinCutoff ? profile.euroMinCutoff : EuroMinCutoffDefault) + cutoffStep, 1, 255);
+    const int beta = constrain((int)(profile.euroBeta ? profile.euroBeta : EuroBetaDefault) + betaStep, 1, 255);
+    if(profile.euroMinCutoff != cutoff || profile.euroBeta != beta) {
+        profile.euroMinCutoff = cutoff;
+        profile.euroBeta = beta;
+        stateFlags |= StateFlag_SavePreferencesEn;
+    }
+    PrintEuroParams();
+}
+
+void PrintEuroParams()
+{
+    const SamcoPreferences::ProfileData_t& profile = profileData[selectedProfile];
+    Serial.print("One-Euro min cutoff: ");
+    Serial.print((profile.euroMinCutoff ? profile.euroMinCutoff : EuroMinCutoffDefault) * 0.05f, 2);
+    Serial.print("Hz, beta: ");
+    Serial.println((profile.euroBeta ? profile.euroBeta : EuroBetaDefault) * 0.0005f, 4);
+}
+
+// apply the next filter pipeline preset to the selected profile and use the custom run mode
+void NextFilterPreset()
+{
+    unsigned int preset = 0;
+    while(preset < FilterPresetCount && FilterPresets[preset] != profileData[selectedProfile].filterStages) {
+        ++preset;
+    }
+    preset = preset + 1 < FilterPresetCount ? preset + 1 : 0;
+
+    profileData[selectedProfile].filterStages = FilterPresets[preset];
+    stateFlags |= StateFlag_SavePreferencesEn;
+    SetRunMode(RunMode_Custom);
+    PrintFilterStages();
+}
+
+static const char* FilterStageLabels[FilterStage_Count] = {
+    "None",
+    "Glitch",
+    "Averaging",
+    "Averaging2",
+    "Predict",
+    "One-Euro",
+    "Dead zone",
+    "Clamp"
+};
+
+void PrintFilterStages()
+{
+    Serial.print("Filter pipeline:");
+    uint32_t stages = profileData[selectedProfile].filterStages;
+    if(!stages) {
+        Serial.print(' ');
+        Serial.print(FilterStageLabels[FilterStage_None]);
+    }
+    for(unsigned int i = 0; stages && i < FilterStageMax; ++i) {
+        Serial.print(' ');
+        Serial.print(FilterStageLabels[stages & ((1 << FilterStageBits) - 1)]);
+        stages >>= FilterStageBits;
+    }
+    Serial.println();
 }
 
 // set new run mode and apply it to the selected profile
@@ -1260,12 +2155,66 @@ void PrintResults()
         PrintSelectedProfile();
         PrintIrSensitivity();
         PrintRunMode();
+        if(runMode == RunMode_Euro) {
+            PrintEuroParams();
+        } else if(runMode == RunMode_Custom) {
+            PrintFilterStages();
+        }
+        PrintPosEngine();
         PrintCal();
     }
         
     lastPrintMillis = millis();
 }
 
+#ifdef LATENCY_STATS
+// print the latency histograms then clear them for the next measurement
+void PrintLatency()
+{
+    for(unsigned int i = 0; i < SamcoLatency::Stage_Count; ++i) {
+        const SamcoLatencyHistogram& stage = latency.stage(i);
+        Serial.print(SamcoLatency::StageLabel(i));
+        Serial.print(" us min/avg/max/p99: ");
+        Serial.print(stage.min());
+        Serial.print('/');
+        Serial.print(stage.avg());
+        Serial.print('/');
+        Serial.print(stage.max());
+        Serial.print('/');
+        Serial.print(stage.percentile(99));
+        Serial.print(", count ");
+        Serial.println(stage.count());
+    }
+    latency.reset();
+#ifdef USB_SOF_SYNC
+    PrintSampleAge();
+#endif // USB_SOF_SYNC
+}
+#endif // LATENCY_STATS
+
+#ifdef USB_SOF_SYNC
+// print the age of the IR camera samples when the host polls the report then clear it
+void PrintSampleAge()
+{
+    const SamcoLatencyHistogram& age = sofSync.sampleAge();
+    Serial.print("sample age us min/avg/max/p99: ");
+    Serial.print(age.min());
+    Serial.print('/');
+    Serial.print(age.avg());
+    Serial.print('/');
+    Serial.print(age.max());
+    Serial.print('/');
+    Serial.print(age.percentile(99));
+    Serial.print(", count ");
+    Serial.print(age.count());
+    Serial.print(", poll phase ");
+    Serial.print(sofSync.pollPhase());
+    Serial.print(", offset us ");
+    Serial.println(sofSync.pollOffset());
+    sofSync.resetStats();
+}
+#endif // USB_SOF_SYNC
+
 void PrintCalInterval()
 {
     if(millis() - lastPrintMillis < 100) {
@@ -1295,6 +2244,14 @@ void PrintRunMode()
     }
 }
 
+void PrintPosEngine()
+{
+    if(posEngine < PosEngine_Count) {
+        Serial.print("Position engine: ");
+        Serial.println(PosEngineLabels[posEngine]);
+    }
+}
+
 // helper in case this changes
 float CalScalePrefToFloat(uint16_t scale)
 {
@@ -1351,7 +2308,9 @@ void PrintPreferences()
             Serial.print(" IR: ");
             Serial.print((unsigned int)profileData[i].irSensitivity);
             Serial.print(" Mode: ");
-            Serial.println((unsigned int)profileData[i].runMode);
+            Serial.print((unsigned int)profileData[i].runMode);
+            Serial.print(" Engine: ");
+            Serial.println((unsigned int)profileData[i].posEngine);
         }
     }
 }
@@ -1429,6 +2388,10 @@ void VerifyPreferences()
         if(profileData[i].runMode >= RunMode_Count) {
             profileData[i].runMode = RunMode_Normal;
         }
+
+        if(profileData[i].posEngine >= PosEngine_Count) {
+            profileData[i].posEngine = PosEngine_Samco;
+        }
     }
 
     // if default profile is not valid, use current selected profile instead
@@ -1455,6 +2418,11 @@ void ApplyInitialPrefs()
         if(profileData[selectedProfile].runMode < RunMode_Count) {
             runMode = (RunMode_e)profileData[selectedProfile].runMode;
         }
+
+        // set the position engine
+        if(profileData[selectedProfile].posEngine < PosEngine_Count) {
+            posEngine = (PosEngine_e)profileData[selectedProfile].posEngine;
+        }
     }
 }
 
@@ -1542,7 +2510,8 @@ void SetIrSensitivity(uint8_t sensitivity)
 
     if(irSensitivity != (DFRobotIRPositionEx::Sensitivity_e)sensitivity) {
         irSensitivity = (DFRobotIRPositionEx::Sensitivity_e)sensitivity;
-        dfrIRPos.sensitivityLevel(irSensitivity);
+        // the camera registers are written between the next position reads
+        IrCam().queueSensitivity(irSensitivity);
         if(!(stateFlags & StateFlag_PrintSelectedProfile)) {
             PrintIrSensitivity();
         }
@@ -1596,6 +2565,11 @@ bool SelectCalProfile(unsigned int profile)
         SetRunMode((RunMode_e)profileData[profile].runMode);
     }
 
+    // set position engine
+    if(profileData[profile].posEngine < PosEngine_Count) {
+        SetPosEngine((PosEngine_e)profileData[profile].posEngine);
+    }
+
     SetLedColorFromMode();
 
     // enable save to allow setting new default profile
@@ -1690,6 +2664,7 @@ void SetLedColorFromMode()
         SetLedPackedColor(profileDesc[selectedProfile].color);
         break;
     case GunMode_Run:
+        ledSeen = lastSeen;
         if(lastSeen) {
             LedOff();
         } else {
@@ -1706,12 +2681,15 @@ void PrintDebugSerial()
 {
     // only print every second
     if(millis() - serialDbMs >= 1000 && Serial.dtr()) {
-#ifdef EXTRA_POS_GLITCH_FILTER
-        Serial.print("bad final count ");
-        Serial.print(badFinalCount);
-        Serial.print(", bad move count ");
-        Serial.println(badMoveCount);
-#endif // EXTRA_POS_GLITCH_FILTER
+        if(!camStartupPrinted) {
+            camStartupPrinted = true;
+            Serial.print("IR camera startup us ");
+            Serial.print(dfrIRPos.configTime());
+            Serial.print(", result ");
+            Serial.println(dfrIRPos.configResult());
+        }
+        Serial.print("bad move count ");
+        Serial.println(filterPipeline.badMoves());
         Serial.print("mode ");
         Serial.print(gunMode);
         Serial.print(", IR pos fps ");
@@ -1723,6 +2701,95 @@ void PrintDebugSerial()
         Serial.print(conMoveXAxis);
         Serial.print(",");
         Serial.println(conMoveYAxis);
+#if defined(IR_CAM_PHASE_LOCK) && !defined(SAMCO_NO_HW_TIMER)
+        Serial.print("IR phase ");
+        Serial.print(dfrIRPos.phaseState());
+        Serial.print(", period ");
+        Serial.print(dfrIRPos.phasePeriod());
+        Serial.print(", error ");
+        Serial.print(dfrIRPos.phaseError());
+        Serial.print(", mismatch ");
+        Serial.println(dfrIRPos.mismatchRate());
+#endif // IR_CAM_PHASE_LOCK
+#ifdef IR_CAM_AUTO_EXPOSURE
+        Serial.print("IR gain ");
+        Serial.println(dfrIRPos.exposureGain());
+#endif // IR_CAM_AUTO_EXPOSURE
+
+        // IR camera IIC telemetry for the last second
+        DFRobotIRPositionEx::Telemetry_t irTelemetry;
+        dfrIRPos.telemetry(irTelemetry, true);
+        Serial.print("IR atomic ");
+        Serial.print(irTelemetry.atomicReads);
+        Serial.print(", reads ");
+        Serial.print(irTelemetry.reads);
+        Serial.print(", retries ");
+        Serial.print(irTelemetry.retries);
+        Serial.print(", mismatch ");
+        Serial.print(irTelemetry.mismatchUsed);
+        Serial.print("/");
+        Serial.print(irTelemetry.mismatchErrors);
+        Serial.print(", IIC errors ");
+        Serial.print(irTelemetry.iicErrors);
+        Serial.print(", short ");
+        Serial.print(irTelemetry.shortReads);
+        Serial.print(", NACK ");
+        Serial.print(irTelemetry.nacks);
+        Serial.print(", bytes ");
+        Serial.print(irTelemetry.bytes);
+        Serial.print(", max us ");
+        Serial.print(irTelemetry.latencyMax);
+        Serial.print(", recoveries ");
+        Serial.print(irTelemetry.recoveries);
+        Serial.print(", recovery max us ");
+        Serial.print(irTelemetry.recoveryMax);
+        Serial.print(", recovery steps ");
+        Serial.print(irTelemetry.recoverySteps);
+        Serial.print(", us hist");
+        for(unsigned int i = 0; i < DFRobotIRPositionEx::TelemetryHistSize; ++i) {
+            Serial.print(" ");
+            Serial.print(irTelemetry.latencyHist[i]);
+        }
+        Serial.println();
+
+        // task run counts, overruns, late releases and max run time for the last second
+        Serial.print("tasks");
+        for(unsigned int i = 0; i < scheduler.taskCount(); ++i) {
+            const SamcoScheduler::TaskStats_t& stats = scheduler.stats(i);
+            Serial.print(" ");
+            Serial.print(scheduler.task(i).label);
+            Serial.print(" ");
+            Serial.print(stats.runs);
+            Serial.print("/");
+            Serial.print(stats.overruns);
+            Serial.print("/");
+            Serial.print(stats.late);
+            Serial.print("/");
+            Serial.print(stats.maxUs);
+        }
+        Serial.println();
+        scheduler.resetStats();
+        Serial.print("HID mouse reports ");
+        Serial.print(AbsMouse5.reportCount());
+        Serial.print(", saved ");
+        Serial.print(AbsMouse5.savedCount());
+        Serial.print(", coalesced ");
+        Serial.print(AbsMouse5.coalescedCount());
+        Serial.print(", keyboard reports ");
+        Serial.print(BasicKeyboard.reportCount());
+        Serial.print(", saved ");
+        Serial.print(BasicKeyboard.savedCount());
+        Serial.print(", coalesced ");
+        Serial.println(BasicKeyboard.coalescedCount());
+#ifdef CORE1_CAMERA
+        Serial.print("core1 positions dropped ");
+        Serial.print(positionRing.dropped());
+        Serial.print(", skipped ");
+        Serial.println(positionRing.skipped());
+#endif // CORE1_CAMERA
+#ifdef USB_SOF_SYNC
+        PrintSampleAge();
+#endif // USB_SOF_SYNC
         
         frameCount = 0;
         irPosCount = 0;
@@ -0,0 +1,197 @@
+/*!
+ * @file SamcoFilter.cpp
+ * @brief Samco Prow Enhanced light gun position filters.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include "SamcoFilter.h"
+
+void SamcoPredictFilter::apply(int& x, int& y, uint32_t us, unsigned int alpha, unsigned int beta, uint32_t horizonUs)
+{
+    const uint32_t dt = us - lastUs;
+    lastUs = us;
+
+    if(restart || dt == 0 || dt > ResetUs) {
+        restart = false;
+        posX = x;
+        posY = y;
+        velX = 0.0f;
+        velY = 0.0f;
+        return;
+    }
+
+    const float a = alpha * (1.0f / 256);
+    const float b = beta * (1.0f / 256);
+
+    // correct the position predicted from the last velocity by the measured residual
+    const float rx = x - (posX + velX * dt);
+    const float ry = y - (posY + velY * dt);
+    posX += velX * dt + a * rx;
+    posY += velY * dt + a * ry;
+    velX += b * rx / dt;
+    velY += b * ry / dt;
+
+    x = round(posX + velX * horizonUs);
+    y = round(posY + velY * horizonUs);
+}
+
+// alpha = 1 / (1 + tau / Te) where tau = 1 / (2 pi fc)
+SamcoEuroFilter::Value_t SamcoEuroFilter::Alpha(uint32_t cutoff, uint32_t periodUs)
+{
+#ifdef SAMCO_POSITION_FIXED
+    // 2 pi fc Te * 1e7, with pi as 3217 / 1024
+    const uint64_t w = ((uint64_t)cutoff * periodUs * 3217) >> 10;
+    return (Value_t)((w << 16) / (w + 10000000));
+#else
+    const float w = cutoff * (float)periodUs * (PI * 1.0e-7f);
+    return w / (w + 1.0f);
+#endif // SAMCO_POSITION_FIXED
+}
+
+int SamcoEuroFilter::FilterAxis(int pos, Value_t& value, Value_t& speed, uint32_t dt, uint32_t minCutoff, uint32_t beta)
+{
+#ifdef SAMCO_POSITION_FIXED
+    const Value_t raw = (Value_t)(((int64_t)(((int32_t)pos << Shift) - value) * 1000000) / dt);
+    speed += (Value_t)(((int64_t)(raw - speed) * Alpha(SpeedCutoff, dt)) >> 16);
+    const uint32_t cutoff = minCutoff + (uint32_t)(((uint64_t)abs(speed) * beta) / (100 << Shift));
+    value += (Value_t)(((int64_t)(((int32_t)pos << Shift) - value) * Alpha(cutoff, dt)) >> 16);
+    return (value + (1 << (Shift - 1))) >> Shift;
+#else
+    const Value_t raw = (pos - value) * 1000000.0f / dt;
+    speed += (raw - speed) * Alpha(SpeedCutoff, dt);
+    const uint32_t cutoff = minCutoff + (uint32_t)(fabs(speed) * beta * 0.01f);
+    value += (pos - value) * Alpha(cutoff, dt);
+    return round(value);
+#endif // SAMCO_POSITION_FIXED
+}
+
+void SamcoEuroFilter::apply(int& x, int& y, uint32_t us, uint32_t minCutoff, uint32_t beta)
+{
+    const uint32_t dt = us - lastUs;
+    lastUs = us;
+
+    if(restart || dt == 0 || dt > ResetUs) {
+        restart = false;
+#ifdef SAMCO_POSITION_FIXED
+        valueX = (Value_t)x << Shift;
+        valueY = (Value_t)y << Shift;
+#else
+        valueX = x;
+        valueY = y;
+#endif // SAMCO_POSITION_FIXED
+        speedX = 0;
+        speedY = 0;
+        return;
+    }
+
+    x = FilterAxis(x, valueX, speedX, dt, minCutoff, beta);
+    y = FilterAxis(y, valueY, speedY, dt, minCutoff, beta);
+}
+
+void SamcoFilterPipeline::begin(uint32_t stages, const Params_t& stageParams)
+{
+    stageCount = 0;
+    while(stages && stageCount < FilterStageMax) {
+        const unsigned int s = stages & ((1 << FilterStageBits) - 1);
+        if(s == FilterStage_None) {
+            break;
+        }
+        stage[stageCount++] = s;
+        stages >>= FilterStageBits;
+    }
+    params = stageParams;
+
+    // the run modes without a stage or with one of the averages don't need the loop
+    if(stageCount == 0) {
+        inlineStage = FilterStage_None;
+    } else if(stageCount == 1 && (stage[0] == FilterStage_Average || stage[0] == FilterStage_Average2)) {
+        inlineStage = stage[0];
+    } else {
+        inlineStage = FilterStage_Count;
+    }
+
+    moveIndex = 0;
+    avgIndex = 0;
+    glitchReset = true;
+    deadZoneReset = true;
+    predict.reset();
+    euro.reset();
+}
+
+void SamcoFilterPipeline::applyStages(int& x, int& y, uint32_t us)
+{
+    for(unsigned int i = 0; i < stageCount; ++i) {
+        switch(stage[i]) {
+        case FilterStage_Glitch:
+            glitch(x, y);
+            break;
+        case FilterStage_Average:
+            average(x, y);
+            break;
+        case FilterStage_Average2:
+            average2(x, y);
+            break;
+        case FilterStage_Predict:
+            predict.apply(x, y, us, params.predictAlpha, params.predictBeta, params.predictHorizonUs);
+            break;
+        case FilterStage_Euro:
+            euro.apply(x, y, us, params.euroMinCutoff, params.euroBeta);
+            break;
+        case FilterStage_DeadZone:
+            deadZone(x, y);
+            break;
+        case FilterStage_Clamp:
+            x = constrain(x, 0, params.maxX);
+            y = constrain(y, 0, params.maxY);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void SamcoFilterPipeline::glitch(int& x, int& y)
+{
+    if(glitchReset) {
+        glitchReset = false;
+    } else if((abs(x - glitchX) > params.glitchThreshold || abs(y - glitchY) > params.glitchThreshold) && badMoveTick < params.glitchFrames) {
+        ++badMoveTick;
+        x = glitchX;
+        y = glitchY;
+        return;
+    } else if(badMoveTick) {
+        badMoveCount++;
+        badMoveTick = 0;
+    }
+    glitchX = x;
+    glitchY = y;
+}
+
+void SamcoFilterPipeline::deadZone(int& x, int& y)
+{
+    if(deadZoneReset) {
+        deadZoneReset = false;
+        deadZoneX = x;
+        deadZoneY = y;
+    } else {
+        if(x > deadZoneX + params.deadZone) {
+            deadZoneX = x - params.deadZone;
+        } else if(x < deadZoneX - params.deadZone) {
+            deadZoneX = x + params.deadZone;
+        }
+        if(y > deadZoneY + params.deadZone) {
+            deadZoneY = y - params.deadZone;
+        } else if(y < deadZoneY - params.deadZone) {
+            deadZoneY = y + params.deadZone;
+        }
+    }
+    x = deadZoneX;
+    y = deadZoneY;
+}
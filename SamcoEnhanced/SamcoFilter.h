@@ -0,0 +1,251 @@
+/*!
+ * @file SamcoFilter.h
+ * @brief Samco Prow Enhanced light gun position filters.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOFILTER_H_
+#define _SAMCOFILTER_H_
+
+#include <stdint.h>
+#include <SamcoBoard.h>
+
+/// @brief Position filter pipeline stages
+/// @details This is a 3 bit value when stored in the profiles.
+enum FilterStage_e {
+    FilterStage_None = 0,       ///< end of the pipeline
+    FilterStage_Glitch = 1,     ///< hold the position for a few frames through a large jump
+    FilterStage_Average = 2,    ///< 2 frame moving average
+    FilterStage_Average2 = 3,   ///< weighted average with 3 frames
+    FilterStage_Predict = 4,    ///< alpha-beta filter leading the position by the pipeline latency
+    FilterStage_Euro = 5,       ///< One-Euro adaptive low-pass filter
+    FilterStage_DeadZone = 6,   ///< hold the position until it moves beyond a small distance
+    FilterStage_Clamp = 7,      ///< constrain the position to the screen edges
+    FilterStage_Count
+};
+
+/// @brief Number of stages in a pipeline
+constexpr unsigned int FilterStageMax = 5;
+
+/// @brief Bits for each stage in the profile
+constexpr unsigned int FilterStageBits = 3;
+
+/// @brief Pack the stages in order for the profile, first stage in the low bits
+constexpr uint32_t FilterStages(FilterStage_e s0, FilterStage_e s1 = FilterStage_None, FilterStage_e s2 = FilterStage_None,
+    FilterStage_e s3 = FilterStage_None, FilterStage_e s4 = FilterStage_None)
+{
+    return s0 | (s1 << FilterStageBits) | (s2 << (FilterStageBits * 2)) | (s3 << (FilterStageBits * 3)) | (s4 << (FilterStageBits * 4));
+}
+
+/// @brief Alpha-beta filter that estimates the velocity and leads the position by the pipeline latency
+/// @details The timestamps are passed in so the same code runs with micros() on the board
+/// or with a simulated clock on a host.
+class SamcoPredictFilter
+{
+public:
+    /// @brief Start over if the position stops updating for longer than this
+    static constexpr uint32_t ResetUs = 50000;
+
+    /// @brief Start over from the next position
+    void reset() { restart = true; }
+
+    /// @brief Filter a position
+    /// @param x X position, replaced with the predicted position
+    /// @param y Y position, replaced with the predicted position
+    /// @param us Time of the position in microseconds
+    /// @param alpha Position gain * 256
+    /// @param beta Velocity gain * 256
+    /// @param horizonUs Time to lead the position by in microseconds
+    void apply(int& x, int& y, uint32_t us, unsigned int alpha, unsigned int beta, uint32_t horizonUs);
+
+private:
+    float posX = 0.0f;      ///< filtered position
+    float posY = 0.0f;
+    float velX = 0.0f;      ///< velocity in mouse units per microsecond
+    float velY = 0.0f;
+    uint32_t lastUs = 0;
+    bool restart = true;
+};
+
+/// @brief One-Euro adaptive low-pass filter, the cutoff rises with the speed so it smooths
+/// heavily while the gun is still and barely at all while it moves quickly
+/// @details Boards without an FPU (SAMCO_POSITION_FIXED) use fixed-point with Shift fraction bits.
+/// The timestamps are passed in like SamcoPredictFilter.
+class SamcoEuroFilter
+{
+public:
+#ifdef SAMCO_POSITION_FIXED
+    /// @brief Fixed-point value with Shift fraction bits
+    typedef int32_t Value_t;
+    static constexpr int Shift = 8;
+#else
+    typedef float Value_t;
+#endif // SAMCO_POSITION_FIXED
+
+    /// @brief Start over if the position stops updating for longer than this
+    static constexpr uint32_t ResetUs = SamcoPredictFilter::ResetUs;
+
+    /// @brief Cutoff of the speed low-pass in 0.05Hz steps
+    static constexpr unsigned int SpeedCutoff = 20;
+
+    /// @brief Start over from the next position
+    void reset() { restart = true; }
+
+    /// @brief Filter a position
+    /// @param x X position, replaced with the filtered position
+    /// @param y Y position, replaced with the filtered position
+    /// @param us Time of the position in microseconds
+    /// @param minCutoff Minimum cutoff in 0.05Hz steps
+    /// @param beta Cutoff increase per speed in 0.0005 steps
+    void apply(int& x, int& y, uint32_t us, uint32_t minCutoff, uint32_t beta);
+
+    /// @brief Low-pass smoothing factor for a cutoff in 0.05Hz steps and the period in microseconds
+    /// @return Factor, fixed-point is 1 << 16 for 1
+    static Value_t Alpha(uint32_t cutoff, uint32_t periodUs);
+
+private:
+    /// @brief Filter one axis
+    static int FilterAxis(int pos, Value_t& value, Value_t& speed, uint32_t dt, uint32_t minCutoff, uint32_t beta);
+
+    Value_t valueX = 0;     ///< filtered position
+    Value_t valueY = 0;
+    Value_t speedX = 0;     ///< filtered speed in mouse units per second
+    Value_t speedY = 0;
+    uint32_t lastUs = 0;
+    bool restart = true;
+};
+
+/// @brief Runs the position through the filter stages packed in a profile, in order
+/// @details The stages and their settings are decoded once in begin() when the run mode or profile changes,
+/// so a frame has no decoding or settings to gather.
+class SamcoFilterPipeline
+{
+public:
+    /// @brief Settings of the stages
+    typedef struct Params_s {
+        int glitchThreshold;            ///< jump in mouse units the glitch stage holds through
+        unsigned int glitchFrames;      ///< most frames the glitch stage holds for
+        int deadZone;                   ///< dead zone size in mouse units
+        int maxX;                       ///< clamp stage limits
+        int maxY;
+        unsigned int predictAlpha;      ///< alpha-beta filter gains * 256
+        unsigned int predictBeta;
+        uint32_t predictHorizonUs;      ///< time to lead the position by
+        uint32_t euroMinCutoff;         ///< One-Euro minimum cutoff in 0.05Hz steps
+        uint32_t euroBeta;              ///< One-Euro cutoff increase per speed in 0.0005 steps
+    } Params_t;
+
+    /// @brief Decode the stages, keep the settings and start over from the next position
+    /// @param stages Stages packed with FilterStages()
+    /// @param params Settings of the stages
+    void begin(uint32_t stages, const Params_t& params);
+
+    /// @brief Change the time the predict stage leads the position by without starting over
+    /// @details For a horizon from the measured latency that changes every frame.
+    void predictHorizon(uint32_t horizonUs) { params.predictHorizonUs = horizonUs; }
+
+    /// @brief Filter a position
+    /// @details No stages or a single averaging stage is a switch inline like the run mode switch
+    /// it replaced, other pipelines run the stage loop.
+    /// @param x X position, replaced with the filtered position
+    /// @param y Y position, replaced with the filtered position
+    /// @param us Time of the position in microseconds
+    inline void apply(int& x, int& y, uint32_t us)
+    {
+        switch(inlineStage) {
+        case FilterStage_None:
+            break;
+        case FilterStage_Average:
+            average(x, y);
+            break;
+        case FilterStage_Average2:
+            average2(x, y);
+            break;
+        default: {
+            // copies so only this path takes the address of the position
+            int px = x, py = y;
+            applyStages(px, py, us);
+            x = px;
+            y = py;
+            break;
+        }
+        }
+    }
+
+    /// @brief Number of stages
+    unsigned int count() const { return stageCount; }
+
+    /// @brief Jumps the glitch stage held through that didn't stay
+    unsigned int badMoves() const { return badMoveCount; }
+
+private:
+    /// @brief Run the position through each stage in turn
+    void applyStages(int& x, int& y, uint32_t us);
+
+    /// @brief 2 position moving average
+    inline void average(int& x, int& y)
+    {
+        avgIndex ^= 1;
+        avgX[avgIndex] = x;
+        avgY[avgIndex] = y;
+        x = (avgX[0] + avgX[1]) / 2;
+        y = (avgY[0] + avgY[1]) / 2;
+    }
+
+    /// @brief Weighted average of current position and previous 2
+    inline void average2(int& x, int& y)
+    {
+        if(moveIndex < 2) {
+            ++moveIndex;
+        } else {
+            moveIndex = 0;
+        }
+        moveX[moveIndex] = x;
+        moveY[moveIndex] = y;
+        x = (x + moveX[0] + moveX[1] + moveX[1] + 2) / 4;
+        y = (y + moveY[0] + moveY[1] + moveY[1] + 2) / 4;
+    }
+
+    /// @brief Hold the last position through a large jump for a few frames, a jump that stays is accepted
+    void glitch(int& x, int& y);
+
+    /// @brief Hold the position until it moves beyond the dead zone, then follow at the edge of the dead zone
+    void deadZone(int& x, int& y);
+
+    uint8_t stage[FilterStageMax];
+    unsigned int stageCount = 0;
+    // the stage apply() runs inline, FilterStage_Count for the stage loop
+    unsigned int inlineStage = FilterStage_None;
+    Params_t params = {};
+
+    // moving averages
+    int avgX[2] = {0, 0};
+    int avgY[2] = {0, 0};
+    int avgIndex = 0;
+    int moveX[3] = {0, 0, 0};
+    int moveY[3] = {0, 0, 0};
+    int moveIndex = 0;
+
+    // glitch stage
+    int glitchX = 0;
+    int glitchY = 0;
+    unsigned int badMoveTick = 0;
+    unsigned int badMoveCount = 0;
+    bool glitchReset = true;
+
+    // dead zone held position
+    int deadZoneX = 0;
+    int deadZoneY = 0;
+    bool deadZoneReset = true;
+
+    SamcoPredictFilter predict;
+    SamcoEuroFilter euro;
+};
+
+#endif // _SAMCOFILTER_H_
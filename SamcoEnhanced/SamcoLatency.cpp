@@ -0,0 +1,137 @@
+/*!
+ * @file SamcoLatency.cpp
+ * @brief Samco Prow Enhanced light gun pipeline latency histograms.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoLatency.h"
+
+// must match Stage_e order
+const char* const SamcoLatency::StageLabels[SamcoLatency::Stage_Count] = {
+    "IIC read",
+    "Position",
+    "Move",
+    "USB report",
+    "Total"
+};
+
+unsigned int SamcoLatencyHistogram::Bucket(uint32_t us)
+{
+    if(us < 16) {
+        return us;
+    }
+
+    // 4 buckets for each power of 2 from the 2 bits below the highest set bit, stopping at bit 31 as a shift by 32 is undefined
+    unsigned int msb = 4;
+    while(msb < 31 && us >> (msb + 1)) {
+        ++msb;
+    }
+    const unsigned int bucket = 16 + (msb - 4) * 4 + ((us >> (msb - 2)) & 3);
+    return bucket < BucketCount ? bucket : BucketCount - 1;
+}
+
+uint32_t SamcoLatencyHistogram::BucketMax(unsigned int bucket)
+{
+    if(bucket < 16) {
+        return bucket;
+    }
+    if(bucket >= BucketCount - 1) {
+        return UINT32_MAX;
+    }
+    const unsigned int msb = 4 + (bucket - 16) / 4;
+    // 32 bit before the shift, unsigned int is 16 bits on AVR
+    return ((uint32_t)(5 + (bucket - 16) % 4) << (msb - 2)) - 1;
+}
+
+void SamcoLatencyHistogram::add(uint32_t us)
+{
+    const unsigned int bucket = Bucket(us);
+    if(buckets[bucket] == UINT16_MAX) {
+        // halve the counts to keep the proportions when a bucket fills
+        for(unsigned int i = 0; i < BucketCount; ++i) {
+            buckets[i] /= 2;
+        }
+    }
+    ++buckets[bucket];
+
+    if(!total || us < minUs) {
+        minUs = us;
+    }
+    if(us > maxUs) {
+        maxUs = us;
+    }
+    sumUs += us;
+    ++total;
+}
+
+void SamcoLatencyHistogram::reset()
+{
+    for(unsigned int i = 0; i < BucketCount; ++i) {
+        buckets[i] = 0;
+    }
+    total = 0;
+    minUs = 0;
+    maxUs = 0;
+    sumUs = 0;
+}
+
+uint32_t SamcoLatencyHistogram::percentile(unsigned int pct) const
+{
+    uint32_t count = 0;
+    for(unsigned int i = 0; i < BucketCount; ++i) {
+        count += buckets[i];
+    }
+    if(!count) {
+        return 0;
+    }
+
+    // smallest bucket with at least pct percent of the values at or below it
+    const uint32_t target = (count * pct + 99) / 100;
+    uint32_t sum = 0;
+    for(unsigned int i = 0; i < BucketCount; ++i) {
+        sum += buckets[i];
+        if(sum >= target) {
+            const uint32_t us = BucketMax(i);
+            return us < maxUs ? us : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+void SamcoLatency::stamp(Stamp_e s, uint32_t us)
+{
+    if(s >= Stamp_Count) {
+        return;
+    }
+
+    // the tick starts a new frame
+    if(s == Stamp_Tick) {
+        stamped = 0;
+    }
+    stamps[s] = us;
+    stamped |= 1 << s;
+
+    if(s == Stamp_Report) {
+        if(stamped == (1 << Stamp_Count) - 1) {
+            for(unsigned int i = Stage_Read; i <= Stage_Report; ++i) {
+                stages[i].add(stamps[i + 1] - stamps[i]);
+            }
+            stages[Stage_Total].add(stamps[Stamp_Report] - stamps[Stamp_Tick]);
+        }
+        stamped = 0;
+    }
+}
+
+void SamcoLatency::reset()
+{
+    for(unsigned int i = 0; i < Stage_Count; ++i) {
+        stages[i].reset();
+    }
+    stamped = 0;
+}
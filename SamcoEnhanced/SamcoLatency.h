@@ -0,0 +1,115 @@
+/*!
+ * @file SamcoLatency.h
+ * @brief Samco Prow Enhanced light gun pipeline latency histograms.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOLATENCY_H_
+#define _SAMCOLATENCY_H_
+
+#include <stdint.h>
+
+/// @brief Histogram of latencies in microseconds with min, average, max and percentiles
+/// @details Values below 16 have their own bucket, larger values have 4 buckets for each power of 2
+/// so a percentile is within 25% of the actual value.
+class SamcoLatencyHistogram
+{
+public:
+    /// @brief Number of buckets, the last bucket counts anything over about 1 second
+    static constexpr unsigned int BucketCount = 80;
+
+    /// @brief Add a latency
+    void add(uint32_t us);
+
+    /// @brief Clear all values
+    void reset();
+
+    /// @brief Number of values
+    uint32_t count() const { return total; }
+
+    /// @brief Minimum value, 0 if there are no values
+    uint32_t min() const { return total ? minUs : 0; }
+
+    /// @brief Maximum value
+    uint32_t max() const { return maxUs; }
+
+    /// @brief Average value, 0 if there are no values
+    uint32_t avg() const { return total ? (uint32_t)(sumUs / total) : 0; }
+
+    /// @brief Percentile from the histogram
+    /// @param pct Percentile from 1 to 100
+    /// @return Upper bound of the bucket the percentile falls in, limited to the maximum value
+    uint32_t percentile(unsigned int pct) const;
+
+private:
+    /// @brief Bucket index of a latency
+    static unsigned int Bucket(uint32_t us);
+
+    /// @brief Largest latency in a bucket
+    static uint32_t BucketMax(unsigned int bucket);
+
+    uint16_t buckets[BucketCount] = {0};
+    uint32_t total = 0;
+    uint32_t minUs = 0;
+    uint32_t maxUs = 0;
+    uint64_t sumUs = 0;
+};
+
+/// @brief Latency of each stage of the position pipeline from the camera tick to the USB report
+/// @details The timestamps are passed in so the same code runs with micros() on the board
+/// or with a simulated clock on a host.
+class SamcoLatency
+{
+public:
+    /// @brief Timestamps in pipeline order
+    enum Stamp_e {
+        Stamp_Tick = 0,     ///< camera update tick asserted
+        Stamp_Read,         ///< IIC read complete
+        Stamp_Position,     ///< position calculated
+        Stamp_Move,         ///< mouse position queued
+        Stamp_Report,       ///< HID report accepted
+        Stamp_Count
+    };
+
+    /// @brief Stages between the timestamps, plus the total
+    enum Stage_e {
+        Stage_Read = 0,     ///< tick to IIC read complete
+        Stage_Position,     ///< IIC read to position
+        Stage_Move,         ///< position to mouse position queued
+        Stage_Report,       ///< queued to HID report accepted
+        Stage_Total,        ///< tick to HID report accepted
+        Stage_Count
+    };
+
+    /// @brief Record a timestamp, the stages are added when the report timestamp completes a frame
+    void stamp(Stamp_e s, uint32_t us);
+
+    /// @brief Drop the timestamps of the current frame, for a frame that doesn't get a report
+    void cancel() { stamped = 0; }
+
+    /// @brief Clear all histograms
+    void reset();
+
+    /// @brief Histogram of a stage
+    const SamcoLatencyHistogram& stage(unsigned int s) const { return stages[s]; }
+
+    /// @brief Label of a stage
+    static const char* StageLabel(unsigned int s) { return s < Stage_Count ? StageLabels[s] : ""; }
+
+private:
+    static const char* const StageLabels[Stage_Count];
+
+    SamcoLatencyHistogram stages[Stage_Count];
+    uint32_t stamps[Stamp_Count];
+
+    /// @brief Bit mask of timestamps recorded for the current frame
+    unsigned int stamped = 0;
+};
+
+#endif // _SAMCOLATENCY_H_
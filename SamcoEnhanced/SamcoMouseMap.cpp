@@ -0,0 +1,30 @@
+/*!
+ * @file SamcoMouseMap.cpp
+ * @brief Samco Prow Enhanced light gun camera to mouse mapping.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoMouseMap.h"
+
+void SamcoMouseMap::update(int halfWidth, int center, int outMax)
+{
+    if(halfWidth == half && center == centre && outMax == out) {
+        return;
+    }
+    half = halfWidth;
+    centre = center;
+    out = outMax;
+    offset = center + halfWidth;
+    mult = Mult(outMax, halfWidth * 2);
+}
+
+uint64_t SamcoMouseMap::Mult(int outMax, int width)
+{
+    return width > 0 ? (((uint64_t)outMax << 32) + width - 1) / width : 0;
+}
@@ -0,0 +1,61 @@
+/*!
+ * @file SamcoMouseMap.h
+ * @brief Samco Prow Enhanced light gun camera to mouse mapping.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOMOUSEMAP_H_
+#define _SAMCOMOUSEMAP_H_
+
+#include <stdint.h>
+
+/// @brief Maps one axis of the camera position to mouse units with a reciprocal instead of a divide
+/// @details The reciprocal is only recomputed when the mapped width or the center changes,
+/// and the map is 16x16 bit multiplies so boards without a 64 bit multiply don't call a helper.
+class SamcoMouseMap
+{
+public:
+    /// @brief Set the mapping, recomputed only if the half width or center changed
+    /// @param halfWidth Half the camera width that maps to the mouse range
+    /// @param center Camera position of the center
+    /// @param outMax Mouse position at the low edge of the width
+    void update(int halfWidth, int center, int outMax);
+
+    /// @brief Same result as map(pos, center + halfWidth, center - halfWidth, 0, outMax)
+    /// @details Exact while the position is within 0xFFFF of the offset, further than that
+    /// maps to the same place as 0xFFFF which is well off screen.
+    int map(int pos) const
+    {
+        const int d = pos - offset;
+        const uint32_t q = MulHi(d < 0 ? -d : d, mult);
+        return d < 0 ? (int)q : -(int)q;
+    }
+
+    /// @brief Reciprocal of the width with 32 fraction bits, rounded up so the map is exact
+    static uint64_t Mult(int outMax, int width);
+
+    /// @brief (value * mult) >> 32 with 32 bit multiplies
+    /// @param value Clamped to 0xFFFF
+    /// @param mult Multiplier below 1 << 47
+    static uint32_t MulHi(uint32_t value, uint64_t mult)
+    {
+        const uint32_t v = value < 0xFFFF ? value : 0xFFFF;
+        const uint32_t lo = (uint32_t)mult;
+        return v * (uint32_t)(mult >> 32) + ((v * (lo >> 16) + ((v * (lo & 0xFFFF)) >> 16)) >> 16);
+    }
+
+private:
+    int half = -1;
+    int centre = 0;
+    int out = 0;
+    int offset = 0;     ///< position that maps to 0
+    uint64_t mult = 0;  ///< outMax / width with 32 fraction bits
+};
+
+#endif // _SAMCOMOUSEMAP_H_
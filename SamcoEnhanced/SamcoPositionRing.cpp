@@ -0,0 +1,74 @@
+/*!
+ * @file SamcoPositionRing.cpp
+ * @brief Samco Prow Enhanced light gun position handoff between cores.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoPositionRing.h"
+
+#ifndef __AVR__
+
+bool SamcoPositionRing::push(const Position_t& pos)
+{
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) >= Size) {
+        droppedCount.store(droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+    entries[h & Mask] = pos;
+    // publish the entry
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool SamcoPositionRing::pop(Position_t& pos)
+{
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    pos = entries[t & Mask];
+    // release the entry back to the producer
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t SamcoPositionRing::popLatest(Position_t& pos)
+{
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    const uint32_t h = head.load(std::memory_order_acquire);
+    if(t == h) {
+        return 0;
+    }
+    pos = entries[(h - 1) & Mask];
+    tail.store(h, std::memory_order_release);
+    skippedCount += h - t - 1;
+    return h - t;
+}
+
+void SamcoCoreGate::close()
+{
+    request.store(false, std::memory_order_seq_cst);
+    // the worker sets running before it checks the request so it either sees the request
+    // cleared or this sees it running
+    while(running.load(std::memory_order_seq_cst)) {
+    }
+}
+
+bool SamcoCoreGate::enter()
+{
+    running.store(true, std::memory_order_seq_cst);
+    if(!request.load(std::memory_order_seq_cst)) {
+        running.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+#endif // __AVR__
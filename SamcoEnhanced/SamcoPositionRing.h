@@ -0,0 +1,108 @@
+/*!
+ * @file SamcoPositionRing.h
+ * @brief Samco Prow Enhanced light gun position handoff between cores.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOPOSITIONRING_H_
+#define _SAMCOPOSITIONRING_H_
+
+// the AVR toolchain doesn't have <atomic>, and the ring is only used on the RP2040
+#ifndef __AVR__
+
+#include <stdint.h>
+#include <atomic>
+
+/// @brief Lock-free single producer, single consumer ring of timestamped positions
+/// @details One core pushes positions and the other core takes them. Only loads and stores
+/// are used on the indexes so this works on a Cortex-M0+ without atomic read-modify-write.
+/// When the ring is full the new position is dropped and counted.
+class SamcoPositionRing
+{
+public:
+    /// @brief Number of entries, must be a power of 2
+    static constexpr uint32_t Size = 8;
+
+    /// @brief Position from a camera read
+    typedef struct Position_s {
+        int x;                  ///< position
+        int y;
+        float h;                ///< height of the 4 points for the scale
+        unsigned int seen;      ///< seen bit mask
+        int error;              ///< camera read result, the position is only valid on success
+        uint32_t tickUs;        ///< camera update tick
+        uint32_t readStartUs;   ///< IIC read start
+        uint32_t readUs;        ///< IIC read complete
+        uint32_t positionUs;    ///< position calculated
+    } Position_t;
+
+    /// @brief Add a position, producer only
+    /// @return false if the ring is full and the position is dropped
+    bool push(const Position_t& pos);
+
+    /// @brief Take the oldest position, consumer only
+    /// @return false if the ring is empty
+    bool pop(Position_t& pos);
+
+    /// @brief Take the newest position and discard any older ones, consumer only
+    /// @return Number of positions taken, 0 if the ring is empty
+    uint32_t popLatest(Position_t& pos);
+
+    /// @brief Discard all positions, consumer only
+    void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+    /// @brief Positions dropped because the ring was full
+    uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    /// @brief Positions discarded by popLatest()
+    uint32_t skipped() const { return skippedCount; }
+
+private:
+    static constexpr uint32_t Mask = Size - 1;
+    static_assert((Size & Mask) == 0, "Size must be a power of 2");
+
+    Position_t entries[Size];
+
+    /// @brief Free running index of the next entry to write, written by the producer
+    std::atomic<uint32_t> head{0};
+
+    /// @brief Free running index of the next entry to read, written by the consumer
+    std::atomic<uint32_t> tail{0};
+
+    std::atomic<uint32_t> droppedCount{0};
+    uint32_t skippedCount = 0;
+};
+
+/// @brief Gate that lets one core stop the other core's work and wait until it is idle
+/// @details The worker brackets each unit of work with enter() and leave(). Once close()
+/// returns the worker is outside the work and won't enter again until open().
+class SamcoCoreGate
+{
+public:
+    /// @brief Allow the worker to run
+    void open() { request.store(true, std::memory_order_seq_cst); }
+
+    /// @brief Stop the worker and wait for it to leave the current unit of work
+    void close();
+
+    /// @brief Worker enters a unit of work
+    /// @return false if the gate is closed and the work must be skipped
+    bool enter();
+
+    /// @brief Worker leaves a unit of work
+    void leave() { running.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> request{false};
+    std::atomic<bool> running{false};
+};
+
+#endif // __AVR__
+
+#endif // _SAMCOPOSITIONRING_H_
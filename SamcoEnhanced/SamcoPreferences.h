@@ -48,8 +48,15 @@ public:
         uint32_t yCenter : 12;
         uint32_t irSensitivity : 3;
         uint32_t runMode : 5;
-        uint32_t reserved;
-        uint32_t reserved2;
+        uint32_t posEngine : 2;
+        uint32_t predictAlpha : 8;  ///< Predict mode position gain * 256, 0 for the default
+        uint32_t predictBeta : 8;   ///< Predict mode velocity gain * 256, 0 for the default
+        uint32_t predictMs : 5;     ///< Predict mode horizon in ms, 0 to use the measured latency
+        uint32_t euroMinCutoff : 8; ///< One-Euro mode minimum cutoff in 0.05Hz steps, 0 for the default
+        uint32_t reserved : 1;
+        uint32_t euroBeta : 8;      ///< One-Euro mode speed coefficient in 0.0005 steps, 0 for the default
+        uint32_t filterStages : 15; ///< Custom mode filter pipeline, 3 bits for each stage, first stage in the low bits
+        uint32_t reserved2 : 9;
     } __attribute__ ((packed)) ProfileData_t;
 
     /// @brief Preferences that can be stored in flash
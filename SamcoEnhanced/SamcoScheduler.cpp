@@ -0,0 +1,93 @@
+/*!
+ * @file SamcoScheduler.cpp
+ * @brief Samco Prow Enhanced light gun cooperative task scheduler.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoScheduler.h"
+
+void SamcoScheduler::begin(const Task_t* tasks, unsigned int count)
+{
+    this->tasks = tasks;
+    this->count = count < MaxTasks ? count : MaxTasks;
+    ++generation;
+
+    const uint32_t now = clock();
+    for(unsigned int i = 0; i < this->count; ++i) {
+        state[i].releaseUs = now;
+    }
+    resetStats();
+}
+
+bool SamcoScheduler::run()
+{
+    const uint32_t now = clock();
+
+    // the due task released the longest time ago
+    unsigned int next = count;
+    uint32_t nextWait = 0;
+    for(unsigned int i = 0; i < count; ++i) {
+        const uint32_t wait = now - state[i].releaseUs;
+        if((int32_t)wait >= 0 && (next == count || wait > nextWait)) {
+            next = i;
+            nextWait = wait;
+        }
+    }
+    if(next == count) {
+        return false;
+    }
+
+    const Task_t& task = tasks[next];
+    const unsigned int gen = generation;
+    task.func();
+    const uint32_t end = clock();
+
+    // the task swapped the task set so its state is gone
+    if(gen != generation) {
+        return true;
+    }
+
+    TaskState_t& ts = state[next];
+    const uint32_t elapsed = end - now;
+    ++ts.stats.runs;
+    if(elapsed > ts.stats.maxUs) {
+        ts.stats.maxUs = elapsed;
+    }
+    if(task.budgetUs && elapsed > task.budgetUs) {
+        ++ts.stats.overruns;
+    }
+
+    if(!task.periodUs) {
+        ts.releaseUs = end;
+    } else {
+        ts.releaseUs += task.periodUs;
+        if((int32_t)(now - ts.releaseUs) >= 0) {
+            // missed a release, start the period again rather than running back to back
+            ++ts.stats.late;
+            ts.releaseUs = now + task.periodUs;
+        }
+    }
+    return true;
+}
+
+uint32_t SamcoScheduler::overruns() const
+{
+    uint32_t total = 0;
+    for(unsigned int i = 0; i < count; ++i) {
+        total += state[i].stats.overruns;
+    }
+    return total;
+}
+
+void SamcoScheduler::resetStats()
+{
+    for(unsigned int i = 0; i < count; ++i) {
+        state[i].stats = TaskStats_t{0, 0, 0, 0};
+    }
+}
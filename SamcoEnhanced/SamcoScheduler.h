@@ -0,0 +1,97 @@
+/*!
+ * @file SamcoScheduler.h
+ * @brief Samco Prow Enhanced light gun cooperative task scheduler.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOSCHEDULER_H_
+#define _SAMCOSCHEDULER_H_
+
+#include <stdint.h>
+
+/// @brief Deadline based cooperative scheduler
+/// @details Each call to run() runs the due task with the earliest release time to completion.
+/// A task with a period of 0 is released again as soon as it completes so these tasks
+/// take turns with each other and with any periodic task that is due.
+/// The clock is passed in so the same code runs with micros() on the board
+/// or with a simulated clock on a host.
+class SamcoScheduler
+{
+public:
+    /// @brief Task function
+    typedef void (*TaskFunc_t)();
+
+    /// @brief Clock function returning microseconds
+    typedef uint32_t (*ClockFunc_t)();
+
+    /// @brief Task definition
+    typedef struct Task_s {
+        TaskFunc_t func;        ///< task function
+        uint32_t periodUs;      ///< release period, 0 to run on every pass
+        uint32_t budgetUs;      ///< run time before an overrun is counted, 0 for no limit
+        const char* label;      ///< label for stats
+    } Task_t;
+
+    /// @brief Task statistics
+    typedef struct TaskStats_s {
+        uint32_t runs;          ///< number of times run
+        uint32_t overruns;      ///< runs that exceeded the budget
+        uint32_t late;          ///< periodic releases that were missed by more than a period
+        uint32_t maxUs;         ///< longest run time
+    } TaskStats_t;
+
+    /// @brief Maximum tasks in a task set
+    static constexpr unsigned int MaxTasks = 8;
+
+    /// @brief Constructor
+    /// @param clock Microsecond clock
+    explicit SamcoScheduler(ClockFunc_t clock) : clock(clock) {}
+
+    /// @brief Swap in a task set, all tasks are released immediately
+    /// @details Can be called from a task, the running task completes normally.
+    /// @param tasks Task definitions, must remain valid while the set is active
+    /// @param count Number of tasks, limited to MaxTasks
+    void begin(const Task_t* tasks, unsigned int count);
+
+    /// @brief Run the due task with the earliest release time
+    /// @return true if a task ran
+    bool run();
+
+    /// @brief Number of tasks in the active set
+    unsigned int taskCount() const { return count; }
+
+    /// @brief Task definition from the active set
+    const Task_t& task(unsigned int i) const { return tasks[i]; }
+
+    /// @brief Statistics of a task in the active set
+    const TaskStats_t& stats(unsigned int i) const { return state[i].stats; }
+
+    /// @brief Total overruns in the active set
+    uint32_t overruns() const;
+
+    /// @brief Clear the statistics of the active set
+    void resetStats();
+
+private:
+    typedef struct TaskState_s {
+        uint32_t releaseUs;
+        TaskStats_t stats;
+    } TaskState_t;
+
+    ClockFunc_t clock;
+    const Task_t* tasks = nullptr;
+    unsigned int count = 0;
+
+    /// @brief Incremented on each begin() to detect a task swapping the set
+    unsigned int generation = 0;
+
+    TaskState_t state[MaxTasks];
+};
+
+#endif // _SAMCOSCHEDULER_H_
@@ -0,0 +1,151 @@
+/*!
+ * @file SamcoSofSync.cpp
+ * @brief Samco Prow Enhanced light gun USB start of frame synchronised sampling.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoSofSync.h"
+
+// a frame number change seen later than this after the last one may have wrapped the frame number
+constexpr uint32_t FrameGapUs = 1000000UL;
+
+// polls that must agree on a new phase before it's used, so a late observation doesn't move it
+constexpr unsigned int PhaseVotes = 4;
+
+void SamcoSofSync::begin(unsigned int pollFrames, uint32_t leadUs)
+{
+    this->pollFrames = pollFrames ? pollFrames : 1;
+    this->leadUs = leadUs;
+    phase = 0;
+    phaseCandidate = 0;
+    phaseCount = 0;
+    pollOffsetUs = 0;
+    polledSeen = false;
+}
+
+void SamcoSofSync::frame(uint16_t frameNumber, uint32_t us)
+{
+    frameNumber &= FrameMask;
+    if(!frameSeen) {
+        // the frame started some time before the first read so wait for a change
+        frameSeen = true;
+        lastFrameNumber = frameNumber;
+        return;
+    }
+    if(frameNumber == lastFrameNumber) {
+        return;
+    }
+    lastFrameNumber = frameNumber;
+
+    const uint32_t gap = us - frameSeenUs;
+    frameSeenUs = us;
+    if(!isSynced || gap > FrameGapUs) {
+        isSynced = true;
+        sofUs = us;
+        frameNum = frameNumber;
+        return;
+    }
+
+    const uint32_t pred = sofUs + ((frameNumber - frameNum) & FrameMask) * FrameUs;
+    const int32_t e = (int32_t)(us - pred);
+    if(e < 0) {
+        // seen earlier than predicted, this is the best estimate yet
+        sofUs = us;
+    } else if(e < (int32_t)FrameUs) {
+        // seen late by the loop time, drift slowly towards it in case the clocks differ
+        sofUs = pred + (uint32_t)e / 16;
+    } else {
+        // a long task delayed the read so the time says nothing
+        sofUs = pred;
+    }
+    frameNum = frameNumber;
+}
+
+int32_t SamcoSofSync::framesSince(uint32_t us) const
+{
+    const int32_t elapsed = (int32_t)(us - sofUs);
+    if(elapsed >= 0) {
+        return elapsed / (int32_t)FrameUs;
+    }
+    return -(int32_t)((-elapsed + FrameUs - 1) / FrameUs);
+}
+
+void SamcoSofSync::polled(uint32_t us)
+{
+    if(!isSynced) {
+        return;
+    }
+
+    const int32_t n = framesSince(us);
+    const uint32_t offset = us - (sofUs + n * FrameUs);
+    const unsigned int p = (frameNum + n) & (pollFrames - 1);
+
+    if(!polledSeen) {
+        polledSeen = true;
+        phase = p;
+        pollOffsetUs = offset;
+        return;
+    }
+
+    if(p != phase) {
+        if(p != phaseCandidate) {
+            phaseCandidate = p;
+            phaseCount = 0;
+        }
+        if(++phaseCount >= PhaseVotes) {
+            phase = p;
+            pollOffsetUs = offset;
+            phaseCount = 0;
+        }
+        return;
+    }
+    phaseCount = 0;
+
+    // the earliest observation is closest to the poll, drift slowly later in case the host moved it
+    if(offset < pollOffsetUs) {
+        pollOffsetUs = offset;
+    } else {
+        pollOffsetUs += (offset - pollOffsetUs) / 16;
+    }
+}
+
+uint32_t SamcoSofSync::nextPoll(uint32_t us) const
+{
+    if(!isSynced) {
+        return us;
+    }
+
+    int32_t n = framesSince(us - pollOffsetUs);
+    for(unsigned int i = 0; i <= pollFrames; ++i, ++n) {
+        if(((frameNum + n) & (pollFrames - 1)) == phase) {
+            const uint32_t poll = sofUs + n * FrameUs + pollOffsetUs;
+            if((int32_t)(poll - us) >= 0) {
+                return poll;
+            }
+        }
+    }
+    // not reached, the poll frame repeats within the interval
+    return us;
+}
+
+uint32_t SamcoSofSync::readSlot(uint32_t us, uint32_t readUs) const
+{
+    if(!isSynced) {
+        return us;
+    }
+    return nextPoll(us + readUs + leadUs) - readUs - leadUs;
+}
+
+void SamcoSofSync::sampled(uint32_t sampleUs, uint32_t reportUs)
+{
+    if(!isSynced) {
+        return;
+    }
+    ages.add(nextPoll(reportUs) - sampleUs);
+}
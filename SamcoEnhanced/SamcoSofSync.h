@@ -0,0 +1,108 @@
+/*!
+ * @file SamcoSofSync.h
+ * @brief Samco Prow Enhanced light gun USB start of frame synchronised sampling.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOSOFSYNC_H_
+#define _SAMCOSOFSYNC_H_
+
+#include <stdint.h>
+#include "SamcoLatency.h"
+
+/// @brief Tracks the USB start of frame timing and the host poll cadence so a camera read
+/// can be timed to finish just before the host polls for the report.
+/// @details The SOF time is estimated from the USB frame number, read as often as possible.
+/// A frame number change is seen a little after the SOF so the estimate follows the earliest
+/// observations and slowly drifts later to follow the clock difference.
+/// The poll frame and the time into the frame are learned from when the host takes a report.
+/// The times are passed in so the same code runs with micros() on the board
+/// or with a simulated clock and SOF source on a host.
+class SamcoSofSync
+{
+public:
+    /// @brief Full speed USB frame period
+    static constexpr uint32_t FrameUs = 1000;
+
+    /// @brief Frame number bits
+    static constexpr uint16_t FrameMask = 0x7FF;
+
+    /// @brief Set the poll interval and the lead time
+    /// @param pollFrames Host poll interval in frames, must be a power of 2
+    /// @param leadUs Time between the read completing and the host poll,
+    /// for the position calculation and queuing the report
+    void begin(unsigned int pollFrames, uint32_t leadUs);
+
+    /// @brief Update with the current USB frame number
+    /// @param frameNumber Frame number from the USB controller
+    /// @param us Current time
+    void frame(uint16_t frameNumber, uint32_t us);
+
+    /// @brief The host took a report
+    /// @param us Time the report was seen to be taken
+    void polled(uint32_t us);
+
+    /// @brief True once the SOF timing is known
+    bool synced() const { return isSynced; }
+
+    /// @brief Estimated time of the next host poll
+    /// @param us Time to find the next poll from
+    /// @return Time of the first poll at or after us, or us if not synced
+    uint32_t nextPoll(uint32_t us) const;
+
+    /// @brief Time to start a read so it completes the lead time before a host poll
+    /// @param us Earliest time the read can start
+    /// @param readUs Expected read time
+    /// @return Start time at or after us, or us if not synced
+    uint32_t readSlot(uint32_t us, uint32_t readUs) const;
+
+    /// @brief Record the age of a sample at the host poll that takes its report
+    /// @param sampleUs Time the camera read completed
+    /// @param reportUs Time the report was queued
+    void sampled(uint32_t sampleUs, uint32_t reportUs);
+
+    /// @brief Sample age histogram
+    const SamcoLatencyHistogram& sampleAge() const { return ages; }
+
+    /// @brief Clear the sample age histogram
+    void resetStats() { ages.reset(); }
+
+    /// @brief Estimated SOF time of the last frame
+    uint32_t sofMicros() const { return sofUs; }
+
+    /// @brief Learned poll frame phase, frame number modulo the poll interval
+    unsigned int pollPhase() const { return phase; }
+
+    /// @brief Learned time from the SOF to the host poll
+    uint32_t pollOffset() const { return pollOffsetUs; }
+
+private:
+    /// @brief Frames from the last SOF to the frame containing a time, negative for an earlier frame
+    int32_t framesSince(uint32_t us) const;
+
+    uint32_t pollFrames = 1;
+    uint32_t leadUs = 0;
+
+    uint32_t sofUs = 0;
+    uint16_t frameNum = 0;
+    uint16_t lastFrameNumber = 0;
+    uint32_t frameSeenUs = 0;
+    bool frameSeen = false;
+    bool isSynced = false;
+
+    unsigned int phase = 0;
+    unsigned int phaseCandidate = 0;
+    unsigned int phaseCount = 0;
+    uint32_t pollOffsetUs = 0;
+    bool polledSeen = false;
+
+    SamcoLatencyHistogram ages;
+};
+
+#endif // _SAMCOSOFSYNC_H_
@@ -12,6 +12,7 @@
 #include <HID.h>
 #endif
 
+#include <Arduino.h>
 #include "AbsMouse5.h"
 
 #if defined(_USING_HID)
@@ -52,7 +53,8 @@ static const uint8_t _AbsMouse5HIDReportDescriptor[] PROGMEM = {
 AbsMouse5_ AbsMouse5(1);
 #endif // _USING_HID
 
-AbsMouse5_::AbsMouse5_(uint8_t reportId) : _reportId(reportId), _buttons(0), _x(0), _y(0), _width(32767l), _height(32767l), _autoReport(true)
+AbsMouse5_::AbsMouse5_(uint8_t reportId) : _reportId(reportId), _buttons(0), _reportedButtons(0), _x(0), _y(0), _xMult(ScaleMult(32767)), _yMult(ScaleMult(32767)),
+	_reportUs(0), _reportCount(0), _savedCount(0), _coalescedCount(0), _changes(0), _pending(false), _autoReport(true), _edgeHead(0), _edgeCount(0)
 {
 #if defined(_USING_HID)
 	static HIDSubDescriptor descriptor(_AbsMouse5HIDReportDescriptor, sizeof(_AbsMouse5HIDReportDescriptor));
@@ -60,44 +62,151 @@ AbsMouse5_::AbsMouse5_(uint8_t reportId) : _reportId(reportId), _buttons(0), _x(
 #endif // _USING_HID
 }
 
+uint64_t AbsMouse5_::ScaleMult(uint16_t max)
+{
+	// rounded up so the multiply gives the same result as 32767 * value / max for any 16 bit value
+	return max ? ((32767ull << 32) + max - 1) / max : 0;
+}
+
+uint16_t AbsMouse5_::Scale(uint16_t value, uint64_t mult)
+{
+	const uint32_t lo = (uint32_t)mult;
+	return (uint16_t)(value * (uint32_t)(mult >> 32) + ((value * (lo >> 16) + ((value * (lo & 0xFFFF)) >> 16)) >> 16));
+}
+
 void AbsMouse5_::init(uint16_t width, uint16_t height, bool autoReport)
 {
-	_width = width;
-	_height = height;
+	_xMult = ScaleMult(width);
+	_yMult = ScaleMult(height);
 	_autoReport = autoReport;
 }
 
-void AbsMouse5_::report(void)
+void AbsMouse5_::send(uint8_t buttons)
 {
+#if defined(_USING_HID) || defined(USE_TINYUSB)
 	uint8_t buffer[5];
-	buffer[0] = _buttons;
+	buffer[0] = buttons;
 	buffer[1] = (uint8_t)_x;
 	buffer[2] = (uint8_t)(_x >> 8);
 	buffer[3] = (uint8_t)_y;
 	buffer[4] = (uint8_t)(_y >> 8);
+#endif // _USING_HID || USE_TINYUSB
 #if defined(_USING_HID)
 	// the descriptor above and Arduino Mouse library use a fixed report ID of 1
 	HID().SendReport(1, buffer, 5);
 #endif // _USING_HID
 #if defined(USE_TINYUSB)
-	if (TinyUSBDevice.suspended())  {
-		TinyUSBDevice.remoteWakeup();
-	}
-	while (!tud_hid_ready()) yield();
 	tud_hid_report(_reportId, buffer, 5);
+#endif // USE_TINYUSB
+	_reportUs = micros();
+
+	++_reportCount;
+	if(_changes > 1) {
+		_savedCount += _changes - 1;
+	}
+	_changes = 0;
+	_reportedButtons = buttons;
+#if defined(USE_TINYUSB)
 	yield();
 #endif // USE_TINYUSB
 }
 
+bool AbsMouse5_::ready()
+{
+#if defined(USE_TINYUSB)
+	if(TinyUSBDevice.suspended()) {
+		// wake the host, the reports stay pending until the bus resumes
+		TinyUSBDevice.remoteWakeup();
+		return false;
+	}
+	// false until the host takes the previous report
+	return tud_hid_ready();
+#else
+	return true;
+#endif // USE_TINYUSB
+}
+
+void AbsMouse5_::report()
+{
+	while(_edgeCount && ready()) {
+		sendQueued();
+	}
+	if(!_edgeCount && ready()) {
+		send(_buttons);
+		_pending = false;
+	}
+}
+
+bool AbsMouse5_::commit()
+{
+	if(!_pending && !_edgeCount) {
+		return false;
+	}
+	if(!ready()) {
+		return false;
+	}
+	if(_edgeCount) {
+		sendQueued();
+	} else {
+		send(_buttons);
+		_pending = false;
+	}
+	return true;
+}
+
+void AbsMouse5_::sendQueued()
+{
+	send(_edgeQueue[_edgeHead]);
+	_edgeHead = (_edgeHead + 1) % EdgeQueueSize;
+	--_edgeCount;
+}
+
+uint8_t AbsMouse5_::lastButtons() const
+{
+	return _edgeCount ? _edgeQueue[(_edgeHead + _edgeCount - 1) % EdgeQueueSize] : _reportedButtons;
+}
+
+void AbsMouse5_::coalesceQueued()
+{
+	// drop the oldest queued press and release pair, the buttons go back to the state before it
+	uint8_t before = _reportedButtons;
+	for(unsigned int i = 0; i + 1 < _edgeCount; ++i) {
+		const uint8_t first = _edgeQueue[(_edgeHead + i) % EdgeQueueSize];
+		if(_edgeQueue[(_edgeHead + i + 1) % EdgeQueueSize] == before) {
+			for(unsigned int j = i; j + 2 < _edgeCount; ++j) {
+				_edgeQueue[(_edgeHead + j) % EdgeQueueSize] = _edgeQueue[(_edgeHead + j + 2) % EdgeQueueSize];
+			}
+			_edgeCount -= 2;
+			++_coalescedCount;
+			return;
+		}
+		before = first;
+	}
+
+	// no pair goes back to an earlier state, the newest queued change shares a report with the next
+	--_edgeCount;
+	++_coalescedCount;
+}
+
+void AbsMouse5_::queueButtons()
+{
+	if(_edgeCount == EdgeQueueSize) {
+		// the host is far behind, merge changes it hasn't seen rather than wait for it
+		coalesceQueued();
+	}
+	_edgeQueue[(_edgeHead + _edgeCount) % EdgeQueueSize] = _buttons;
+	++_edgeCount;
+}
+
 void AbsMouse5_::move(uint16_t x, uint16_t y)
 {
-	x = (uint16_t)((32767ul * ((uint32_t)x)) / _width);
-	y = (uint16_t)((32767ul * ((uint32_t)y)) / _height);
+	x = Scale(x, _xMult);
+	y = Scale(y, _yMult);
 
 	if(x != _x || y != _y) {
 		_x = x;
 		_y = y;
-		autoreport();
+		changed();
 	}
 }
 
@@ -105,8 +214,12 @@ void AbsMouse5_::press(uint8_t button)
 {
 	const uint8_t new_buttons = _buttons | button;
 	if(new_buttons != _buttons) {
+		// a button changing back before its last change was sent, queue the last change
+		if((new_buttons ^ _buttons) & (_buttons ^ lastButtons())) {
+			queueButtons();
+		}
 		_buttons = new_buttons;
-		autoreport();
+		changed();
 	}
 }
 
@@ -114,7 +227,11 @@ void AbsMouse5_::release(uint8_t button)
 {
 	const uint8_t new_buttons = _buttons & ~button;
 	if(new_buttons != _buttons) {
+		// a button changing back before its last change was sent, queue the last change
+		if((new_buttons ^ _buttons) & (_buttons ^ lastButtons())) {
+			queueButtons();
+		}
 		_buttons = new_buttons;
-		autoreport();
+		changed();
 	}
 }
@@ -63,14 +63,48 @@
 // 5 button absolute mouse
 class AbsMouse5_
 {
+public:
+	/// @brief Number of button states that can wait for the host in frame commit mode.
+	static constexpr unsigned int EdgeQueueSize = 8;
+
 private:
 	const uint8_t _reportId;
 	uint8_t _buttons;
+	uint8_t _reportedButtons;
 	uint16_t _x;
 	uint16_t _y;
-	uint32_t _width;
-	uint32_t _height;
+	uint64_t _xMult;
+	uint64_t _yMult;
+	uint32_t _reportUs;
+	uint32_t _reportCount;
+	uint32_t _savedCount;
+	uint32_t _coalescedCount;
+	uint16_t _changes;
+	bool _pending;
 	bool _autoReport;
+	uint8_t _edgeQueue[EdgeQueueSize];
+	uint8_t _edgeHead;
+	uint8_t _edgeCount;
+
+	/// @brief Send a USB report with the given buttons and the current position.
+	void send(uint8_t buttons);
+
+	/// @brief Send the oldest queued report.
+	void sendQueued();
+
+	/// @brief True if the USB stack can take a report now. Asks a suspended host for a remote wakeup.
+	bool ready();
+
+	/// @brief Make room in the full queue without waiting for the host.
+	/// @details Drops the oldest queued press and release pair, or merges the newest
+	/// queued change into the next report if no pair goes back to an earlier state.
+	void coalesceQueued();
+
+	/// @brief Buttons of the last queued report, or the last sent report if none are queued.
+	uint8_t lastButtons() const;
+
+	/// @brief Queue the current buttons for their own report.
+	void queueButtons();
 
 	/// @brief Call report() if auto report is enabled.
 	inline void autoreport() {
@@ -79,6 +113,13 @@ private:
 		}
 	}
 
+	/// @brief Note a state change then call autoreport().
+	inline void changed() {
+		++_changes;
+		_pending = true;
+		autoreport();
+	}
+
 public:
 	/// @brief Constructor.
 	/// @param[in] reportId TinyUSB report ID. Ignored when using Arduino HID.
@@ -91,9 +132,52 @@ public:
 	/// False to require explicit call to report().
 	void init(uint16_t widthMax = 32767, uint16_t heightMax = 32767, bool autoReport = true);
 	
-	/// @brief Send a USB report.
+	/// @brief Set automatic report when the mouse state changes.
+	/// @param autoReport True to call report() any time the mouse state changes.
+	/// False to require explicit call to report() or commit().
+	void setAutoReport(bool autoReport) { _autoReport = autoReport; }
+
+	/// @brief Send the queued reports and a report of the current state.
+	/// @details With TinyUSB this sends what the USB stack can take without waiting for the host,
+	/// the rest stays pending for the next report() or commit().
 	void report();
 
+	/// @brief Send the next report if there is one and the USB stack can take it.
+	/// @details For use with auto report disabled, all the changes since the last report
+	/// go in one report. With TinyUSB this doesn't wait for the host to take the previous report,
+	/// the changes stay pending for the next commit instead.
+	/// A suspended device asks the host for a remote wakeup and keeps the changes pending.
+	/// A button that changes back before its last change is sent queues the last change
+	/// for its own report, so no click is lost. The queued reports are sent in order before
+	/// the current state and they all carry the latest position. If the host falls so far behind
+	/// that the queue is full, a press and release it hasn't seen are merged, see coalescedCount().
+	/// @return True if a report was sent.
+	bool commit();
+
+	/// @brief True if the state changed since the last report or there are queued reports.
+	bool pending() const { return _pending || _edgeCount; }
+
+	/// @brief Number of reports sent.
+	uint32_t reportCount() const { return _reportCount; }
+
+	/// @brief Number of state changes that shared a report with another change.
+	uint32_t savedCount() const { return _savedCount; }
+
+	/// @brief Number of queued changes merged because the queue was full.
+	/// @details Each is usually a click the host never saw.
+	uint32_t coalescedCount() const { return _coalescedCount; }
+
+	/// @brief micros() time the last report was accepted by the USB stack.
+	uint32_t reportMicros() const { return _reportUs; }
+
+	/// @brief Scale multiplier from the range to 32767 with 32 fraction bits.
+	/// @details Rounded up so Scale() gives the same result as 32767 * value / max for any 16 bit value.
+	static uint64_t ScaleMult(uint16_t max);
+
+	/// @brief Scale a position to 32767 with a multiplier from ScaleMult().
+	/// @details (value * mult) >> 32 in 16x16 bit multiplies, a 64 bit multiply is a helper call on the M0.
+	static uint16_t Scale(uint16_t value, uint64_t mult);
+
 	/// @brief Move the mouse X and Y positions.
 	/// @param x X position
 	/// @param y Y position
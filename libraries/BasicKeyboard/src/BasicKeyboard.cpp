@@ -68,31 +68,170 @@ static const uint8_t _hidRawKbReportDescriptor[] PROGMEM = {
 BasicKeyboard_ BasicKeyboard(2);
 #endif // _USING_HID
 
-BasicKeyboard_::BasicKeyboard_(uint8_t reportId) : _reportId(reportId), _autoReport(true)
+BasicKeyboard_::BasicKeyboard_(uint8_t reportId) : _reportId(reportId), _reportCount(0), _savedCount(0), _coalescedCount(0), _changes(0), _pending(false), _autoReport(true),
+    _keyQueueHead(0), _keyQueueCount(0)
 {
     memset(&_keyReport, 0, sizeof(_keyReport));
+    memset(&_reportedKeys, 0, sizeof(_reportedKeys));
 #if defined(_USING_HID)
 	static HIDSubDescriptor descriptor(_hidRawKbReportDescriptor, sizeof(_hidRawKbReportDescriptor));
 	HID().AppendDescriptor(&descriptor);
 #endif // _USING_HID
 }
   
-void BasicKeyboard_::report()
+void BasicKeyboard_::send(const KeyReport_t& keyReport)
 {
 #if defined(_USING_HID)
     // the descriptor above, copied from the Arduino Keyboard library, use a fixed report ID value of 2
-	HID().SendReport(2, &_keyReport, sizeof(_keyReport));
+	HID().SendReport(2, &keyReport, sizeof(keyReport));
 #endif // _USING_HID
 #if defined(USE_TINYUSB)
-    if (TinyUSBDevice.suspended())  {
-        TinyUSBDevice.remoteWakeup();
+    tud_hid_keyboard_report(_reportId, keyReport.modifiers, keyReport.keys);
+#endif // USE_TINYUSB
+
+    ++_reportCount;
+    if (_changes > 1) {
+        _savedCount += _changes - 1;
     }
-    while (!tud_hid_ready()) yield();
-    tud_hid_keyboard_report(_reportId, _keyReport.modifiers, _keyReport.keys);
+    _changes = 0;
+    _reportedKeys = keyReport;
+#if defined(USE_TINYUSB)
     yield();
 #endif // USE_TINYUSB
 }
 
+bool BasicKeyboard_::ready()
+{
+#if defined(USE_TINYUSB)
+    if (TinyUSBDevice.suspended()) {
+        // wake the host, the reports stay pending until the bus resumes
+        TinyUSBDevice.remoteWakeup();
+        return false;
+    }
+    // false until the host takes the previous report
+    return tud_hid_ready();
+#else
+    return true;
+#endif // USE_TINYUSB
+}
+
+void BasicKeyboard_::report()
+{
+    while (_keyQueueCount && ready()) {
+        sendQueued();
+    }
+    if (!_keyQueueCount && ready()) {
+        send(_keyReport);
+        _pending = false;
+    }
+}
+
+bool BasicKeyboard_::commit()
+{
+    if (!_pending && !_keyQueueCount) {
+        return false;
+    }
+    if (!ready()) {
+        return false;
+    }
+    if (_keyQueueCount) {
+        sendQueued();
+    } else {
+        send(_keyReport);
+        _pending = false;
+    }
+    return true;
+}
+
+void BasicKeyboard_::sendQueued()
+{
+    send(_keyQueue[_keyQueueHead]);
+    _keyQueueHead = (_keyQueueHead + 1) % KeyQueueSize;
+    --_keyQueueCount;
+}
+
+const KeyReport_t& BasicKeyboard_::lastKeys() const
+{
+    return _keyQueueCount ? _keyQueue[(_keyQueueHead + _keyQueueCount - 1) % KeyQueueSize] : _reportedKeys;
+}
+
+void BasicKeyboard_::coalesceQueued()
+{
+    // drop the oldest queued press and release pair, the keys go back to the state before it
+    const KeyReport_t* before = &_reportedKeys;
+    for (unsigned int i = 0; i + 1 < _keyQueueCount; ++i) {
+        const KeyReport_t* first = &_keyQueue[(_keyQueueHead + i) % KeyQueueSize];
+        if (!memcmp(&_keyQueue[(_keyQueueHead + i + 1) % KeyQueueSize], before, sizeof(KeyReport_t))) {
+            for (unsigned int j = i; j + 2 < _keyQueueCount; ++j) {
+                _keyQueue[(_keyQueueHead + j) % KeyQueueSize] = _keyQueue[(_keyQueueHead + j + 2) % KeyQueueSize];
+            }
+            _keyQueueCount -= 2;
+            ++_coalescedCount;
+            return;
+        }
+        before = first;
+    }
+
+    // no pair goes back to an earlier state, the newest queued change shares a report with the next
+    --_keyQueueCount;
+    ++_coalescedCount;
+}
+
+void BasicKeyboard_::queueKeys(const KeyReport_t& keyReport)
+{
+    if (_keyQueueCount == KeyQueueSize) {
+        // the host is far behind, merge changes it hasn't seen rather than wait for it
+        coalesceQueued();
+    }
+    _keyQueue[(_keyQueueHead + _keyQueueCount) % KeyQueueSize] = keyReport;
+    ++_keyQueueCount;
+}
+
+bool BasicKeyboard_::isKeyInReport(const KeyReport_t& keyReport, uint8_t key)
+{
+    for (unsigned int i = 0; i < sizeof(keyReport.keys); ++i) {
+        if (keyReport.keys[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BasicKeyboard_::changesPending(const KeyReport_t& before) const
+{
+    const KeyReport_t& last = lastKeys();
+    if ((before.modifiers ^ _keyReport.modifiers) & (before.modifiers ^ last.modifiers)) {
+        return true;
+    }
+
+    // keys pressed or released by this change
+    for (unsigned int i = 0; i < sizeof(before.keys); ++i) {
+        const uint8_t released = before.keys[i];
+        if (released && !isKeyInReport(_keyReport, released) && !isKeyInReport(last, released)) {
+            return true;
+        }
+        const uint8_t pressed = _keyReport.keys[i];
+        if (pressed && !isKeyInReport(before, pressed) && isKeyInReport(last, pressed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BasicKeyboard_::changed(const KeyReport_t& before)
+{
+    if (!_autoReport && !memcmp(&before, &_keyReport, sizeof(_keyReport))) {
+        return;
+    }
+    if (changesPending(before)) {
+        // keep the last change for its own report, with TinyUSB auto report can leave changes pending too
+        queueKeys(before);
+    }
+    ++_changes;
+    _pending = true;
+    autoreport();
+}
+
 bool BasicKeyboard_::prepareKeyPress(uint8_t key)
 {
     if (key > KEY_RIGHTMETA || !key) {
@@ -120,27 +259,30 @@ bool BasicKeyboard_::prepareKeyPress(uint8_t key)
 
 bool BasicKeyboard_::press(uint8_t key)
 {
+    const KeyReport_t before = _keyReport;
     bool success = prepareKeyPress(key);
     if (success) {
-        autoreport();
+        changed(before);
     }
     return success;
 }
 
 bool BasicKeyboard_::press(uint8_t modMask, uint8_t key)
 {
+    const KeyReport_t before = _keyReport;
     bool success = prepareKeyPress(key);
     if (success) {
         _keyReport.modifiers |= modMask;
-        autoreport();
+        changed(before);
     }
     return success;
 }
 
 void BasicKeyboard_::pressModifers(uint8_t modMask)
 {
+    const KeyReport_t before = _keyReport;
     _keyReport.modifiers |= modMask;
-    autoreport();
+    changed(before);
 }
 
 bool BasicKeyboard_::prepareKeyRelease(uint8_t key)
@@ -167,31 +309,35 @@ bool BasicKeyboard_::prepareKeyRelease(uint8_t key)
 
 bool BasicKeyboard_::release(uint8_t key) 
 {
+    const KeyReport_t before = _keyReport;
     bool success = prepareKeyRelease(key);
     if (success) {
-        autoreport();
+        changed(before);
     }
     return success;
 }
 
 bool BasicKeyboard_::release(uint8_t modMask, uint8_t key) 
 {
+    const KeyReport_t before = _keyReport;
     bool success = prepareKeyRelease(key);
     if (success) {
         _keyReport.modifiers &= ~modMask;
-        autoreport();
+        changed(before);
     }
     return success;
 }
 
 void BasicKeyboard_::releaseModifers(uint8_t modMask)
 {
+    const KeyReport_t before = _keyReport;
     _keyReport.modifiers &= ~modMask;
-    autoreport();
+    changed(before);
 }
 
 void BasicKeyboard_::releaseAll()
 {
+    const KeyReport_t before = _keyReport;
     memset(&_keyReport, 0, sizeof(_keyReport));
-    autoreport();
+    changed(before);
 }
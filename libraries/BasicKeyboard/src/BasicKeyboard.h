@@ -52,10 +52,44 @@ typedef struct
 
 class BasicKeyboard_
 {
+public:
+    /// @brief Number of key states that can wait for the host with auto report disabled.
+    static constexpr unsigned int KeyQueueSize = 8;
+
 private:
     const uint8_t _reportId;
     KeyReport_t _keyReport;
+    KeyReport_t _reportedKeys;
+    uint32_t _reportCount;
+    uint32_t _savedCount;
+    uint32_t _coalescedCount;
+    uint16_t _changes;
+    bool _pending;
     bool _autoReport;
+    KeyReport_t _keyQueue[KeyQueueSize];
+    uint8_t _keyQueueHead;
+    uint8_t _keyQueueCount;
+
+    /// @brief Send a USB report.
+    /// @param keyReport Report data.
+    void send(const KeyReport_t& keyReport);
+
+    /// @brief Send the oldest queued report.
+    void sendQueued();
+
+    /// @brief True if the USB stack can take a report now. Asks a suspended host for a remote wakeup.
+    bool ready();
+
+    /// @brief Make room in the full queue without waiting for the host.
+    /// @details Drops the oldest queued press and release pair, or merges the newest
+    /// queued change into the next report if no pair goes back to an earlier state.
+    void coalesceQueued();
+
+    /// @brief Report data of the last queued report, or the last sent report if none are queued.
+    const KeyReport_t& lastKeys() const;
+
+    /// @brief Queue report data for its own report.
+    void queueKeys(const KeyReport_t& keyReport);
     
     /// @brief Call report() if auto report is enabled.
     inline void autoreport() {
@@ -64,6 +98,18 @@ private:
         }
     }
 
+    /// @brief Note a change to the report data then call autoreport().
+    /// @param before Report data before the change.
+    void changed(const KeyReport_t& before);
+
+    /// @brief Check if a change touches a key that already changed since the last queued or sent report.
+    /// @param before Report data before the change.
+    /// @return True if a key or modifier changes back before its last change was sent.
+    bool changesPending(const KeyReport_t& before) const;
+
+    /// @brief Check if a key is in the report data.
+    static bool isKeyInReport(const KeyReport_t& keyReport, uint8_t keyCode);
+
     /// @brief Update the report data with a key press.
     /// @param keyCode Key code.
     /// @return True for success.
@@ -82,12 +128,39 @@ public:
 
     /// @brief Set automatic report when keys are pressed or released.
     /// @param autoReport True to call report() any time a key is pressed or released.
-    /// False to require explicit call to report().
+    /// False to require explicit call to report() or commit().
     void setAutoReport(bool autoReport) { _autoReport = autoReport; }
 
-    /// @brief Send a USB report.
+    /// @brief Send the queued reports and a report of the current keys.
+    /// @details With TinyUSB this sends what the USB stack can take without waiting for the host,
+    /// the rest stays pending for the next report() or commit().
     void report();
 
+    /// @brief Send the next report if there is one and the USB stack can take it.
+    /// @details For use with auto report disabled, all the changes since the last report
+    /// go in one report. With TinyUSB this doesn't wait for the host to take the previous report,
+    /// the changes stay pending for the next commit instead.
+    /// A suspended device asks the host for a remote wakeup and keeps the changes pending.
+    /// A key that changes back before its last change is sent queues the last change
+    /// for its own report, so no key press is lost. The queued reports are sent in order.
+    /// If the host falls so far behind that the queue is full, a press and release it hasn't seen
+    /// are merged, see coalescedCount().
+    /// @return True if a report was sent.
+    bool commit();
+
+    /// @brief True if the keys changed since the last report or there are queued reports.
+    bool pending() const { return _pending || _keyQueueCount; }
+
+    /// @brief Number of reports sent.
+    uint32_t reportCount() const { return _reportCount; }
+
+    /// @brief Number of key changes that shared a report with another change.
+    uint32_t savedCount() const { return _savedCount; }
+
+    /// @brief Number of queued changes merged because the queue was full.
+    /// @details Each is usually a key press the host never saw.
+    uint32_t coalescedCount() const { return _coalescedCount; }
+
     /// @brief Press a key.
     /// @param keyCode Key code.
     /// @return True if the key is pressed.
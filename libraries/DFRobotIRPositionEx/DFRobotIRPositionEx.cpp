@@ -8,6 +8,7 @@
  * - Added functions to atomically read the position data
  * - Added sensitivity settings
  * - Added IIC clock setting, appears to work up to at least 1MHz
+ * - Added full data format with intensity and bounding box
  *
  * @copyright [DFRobot](http://www.dfrobot.com), 2016
  * @copyright Mike "Prow" Lynch, 2021
@@ -26,97 +27,585 @@
 // data lengths
 constexpr unsigned int DFRIRdata_LengthBasic = 11;
 constexpr unsigned int DFRIRdata_LengthExtended = 13;
-constexpr unsigned int DFRIRdata_LengthFull = 9 * 4 + 1;
+constexpr unsigned int DFRIRdata_LengthFullFrame = 9;
+constexpr unsigned int DFRIRdata_LengthFull = DFRIRdata_LengthFullFrame * 4 + 1;
+
+// remainder of a time in microseconds divided by a period in 1/16 microseconds, in 1/16 microseconds,
+// reduced before the shift so a time past 2^28 microseconds doesn't overflow 32 bits
+static inline uint32_t DFRIRphaseRemainderQ4(uint32_t us, uint32_t periodQ4)
+{
+    return ((us % periodQ4) << 4) % periodQ4;
+}
+
+// maximum valid Y position
+constexpr int DFRIRdata_MaxY = 767;
+
+// position data register
+constexpr uint8_t DFRIRdata_RegPosition = 0x36;
+
+// largest IIC read that fits the Wire buffer, AVR only has a 32 byte buffer
+#if defined(ARDUINO_ARCH_SAMD) || defined(ARDUINO_ARCH_RP2040)
+constexpr unsigned int DFRIRdata_ChunkMax = DFRIRdata_LengthFull;
+#elif defined(BUFFER_LENGTH)
+constexpr unsigned int DFRIRdata_ChunkMax = BUFFER_LENGTH;
+#else
+constexpr unsigned int DFRIRdata_ChunkMax = 32;
+#endif
+
+// longer reads are split into chunks that end on a full frame
+constexpr unsigned int DFRIRdata_ChunkLength = DFRIRdata_ChunkMax >= DFRIRdata_LengthFull ? DFRIRdata_LengthFull
+    : 1 + ((DFRIRdata_ChunkMax - 1) / DFRIRdata_LengthFullFrame) * DFRIRdata_LengthFullFrame;
+
+// telemetry counters, build with DFROBOT_IR_TELEMETRY=0 to leave them out
+#ifndef DFROBOT_IR_TELEMETRY
+#define DFROBOT_IR_TELEMETRY 1
+#endif
+constexpr bool DFRIRtelemetry_Enabled = DFROBOT_IR_TELEMETRY;
 
 // data format mode register values
 constexpr uint8_t DFRIRdata_ModeBasic = 0x11;
 constexpr uint8_t DFRIRdata_ModeExtended = 0x33;
 constexpr uint8_t DFRIRdata_ModeFull = 0x55;
 
-// IIC delay, the Wiki says to use at least 50ms, but the original source uses 10
-constexpr unsigned long DFRIRdata_IICdelay = 10;
+// configuration: minimum time between register writes while the camera latches the last one,
+// the delay the original library slept after each write (the DFRobot wiki says at least 50ms)
+constexpr unsigned long DFRIRconfig_SettleUs = 10000;
 
-// maximum valid Y position
-constexpr int DFRIRdata_MaxY = 767;
+// configuration: time to retry a register write that isn't acknowledged while the camera is busy,
+// from the end of the settle time
+constexpr unsigned long DFRIRconfig_WriteTimeoutUs = 20000;
+
+// configuration: maximum time for the camera to return a valid frame
+constexpr unsigned long DFRIRconfig_TimeoutUs = 250000;
+
+// bus recovery: consecutive reads with an IIC error before the recovery starts
+constexpr uint8_t DFRIRrecover_ErrorCount = 3;
+
+// bus recovery: wait after a failed recovery attempt before the next attempt
+constexpr unsigned long DFRIRrecover_RetryUs = 100000;
+
+// bus recovery: SCL pulses to clock out a byte that is holding SDA low, 8 data bits and the ACK
+constexpr unsigned int DFRIRrecover_ClockPulses = 9;
+
+// bus recovery: half of the SCL period when clearing the bus, 100kHz
+constexpr unsigned int DFRIRrecover_HalfClockUs = 5;
 
-DFRobotIRPositionEx::DFRobotIRPositionEx(TwoWire& _wire) : wire(_wire), seenFlags(0)
+// sensitivity data from http://wiibrew.org/wiki/Wiimote#IR_Camera
+// register 0x07 is 0 for all of the settings so 0x06 to 0x08 is written as one block
+// the levels only write 0x06 to 0x08 and 0x1A, custom blocks write all of block 1 and block 2
+static const uint8_t DFRIRsens_Reg06[3] = {0x90, 0x90, 0xFF};
+static const uint8_t DFRIRsens_Reg08[3] = {0xC0, 0x41, 0x0C};
+static const uint8_t DFRIRsens_Reg1A[3] = {0x40, 0x40, 0x00};
+
+// auto-exposure: frames accumulated for each gain update
+constexpr uint8_t DFRIRae_Interval = 16;
+
+// auto-exposure: average blob size above this reduces the gain
+constexpr unsigned int DFRIRae_SizeHigh = 6;
+
+// auto-exposure: average blob size below this increases the gain while points are missing
+constexpr unsigned int DFRIRae_SizeLow = 3;
+
+// auto-exposure: gain register limits, smaller is more gain, the most sensitive level uses 0x0C
+constexpr unsigned int DFRIRae_GainMin = 0x0C;
+constexpr unsigned int DFRIRae_GainMax = 0xFE;
+
+// phase tracking: single reads between compared reads when locked
+constexpr uint8_t DFRIRphase_VerifyInterval = 8;
+
+// phase tracking: detected updates within this many microseconds of the estimate are in lock
+constexpr long DFRIRphase_LockWindowUs = 200;
+
+// phase tracking: consecutive updates in the lock window required to lock
+constexpr uint8_t DFRIRphase_LockCount = 4;
+
+// phase tracking: correction applied by each verify read when locked, this starts at the initial
+// step, halves each time the direction changes, and doubles when the direction repeats
+constexpr unsigned int DFRIRphase_StepInitUs = 64;
+constexpr unsigned int DFRIRphase_StepMinUs = 8;
+constexpr unsigned int DFRIRphase_StepMaxUs = 64;
+
+// phase tracking: consecutive verify reads that don't see the camera update before the lock is dropped
+// if the points are not moving the update can't be seen, but then a torn read is harmless anyway
+constexpr uint8_t DFRIRphase_MaxMissed = 16;
+
+// phase tracking: minimum camera periods between detected updates to correct the period estimate
+constexpr unsigned long DFRIRphase_MinPeriods = 4;
+
+// phase tracking: detected updates further apart than this restart the phase estimate
+constexpr unsigned long DFRIRphase_MaxGapUs = 4000000;
+
+// check for the data of a camera that isn't running, a real frame never has all points at 0,0
+static bool frameBlank(const uint8_t* data, unsigned int length)
+{
+    for(unsigned int i = 1; i < length; ++i) {
+        if(data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// mode register value for a data format
+static uint8_t formatMode(DFRobotIRPositionEx::DataFormat_e format)
 {
+    switch(format) {
+    case DFRobotIRPositionEx::DataFormat_Extended:
+        return DFRIRdata_ModeExtended;
+    case DFRobotIRPositionEx::DataFormat_Full:
+        return DFRIRdata_ModeFull;
+    case DFRobotIRPositionEx::DataFormat_Basic:
+    default:
+        return DFRIRdata_ModeBasic;
+    }
+}
+
+// IIC data length for a data format
+static unsigned int formatLength(DFRobotIRPositionEx::DataFormat_e format)
+{
+    switch(format) {
+    case DFRobotIRPositionEx::DataFormat_Extended:
+        return DFRIRdata_LengthExtended;
+    case DFRobotIRPositionEx::DataFormat_Full:
+        return DFRIRdata_LengthFull;
+    case DFRobotIRPositionEx::DataFormat_Basic:
+    default:
+        return DFRIRdata_LengthBasic;
+    }
+}
+
+DFRobotIRPositionEx::DFRobotIRPositionEx(TwoWire& _wire) : wire(_wire), seenFlags(0),
+    readState(ReadState_Idle), readFormat(DataFormat_Basic), readRetry(Retry_1s), readAttempt(0),
+    readIndex(0), readError(Error_Success), readCallback(nullptr), readCallbackContext(nullptr),
+    configState(ConfigState_Idle), configFormat(DataFormat_Basic),
+    configPendingMask(0), sensCustom(false), aeEnabled(false), aeFrames(0), aeSeenSum(0), aeSizeSum(0), configStepStart(0), configWriteTime(0), configStart(0), configDuration(0), configError(Error_Success),
+    iicClock(400000), recoverEnabled(false), recoverActive(false), recoverErrors(0), recoverSda(-1), recoverScl(-1),
+    recoverStart(0), recoverRetry(0), recoverDuration(0),
+    readStart(0), readDuration(0), readMismatch(false), phaseMode(PhaseState_Off), phaseLockCount(0),
+    phaseVerify(0), phaseMissed(0), phaseDir(0), phaseStep(0), phaseUpdated(false), phaseValid(false),
+    phaseMargin(0), phaseNominal(0), phasePeriodQ4(0), phaseUpdateTime(0), phaseSampleStart(0), phaseSampleSeen(false), phaseErr(0), mismatchAvg(0), atomicStart(0)
+{
+    resetTelemetry();
 }
 
 DFRobotIRPositionEx::~DFRobotIRPositionEx()
 {
 }
 
-void DFRobotIRPositionEx::writeTwoIICByte(uint8_t first, uint8_t second)
+bool DFRobotIRPositionEx::writeTwoIICByte(uint8_t first, uint8_t second)
 {
     wire.beginTransmission(IRAddress);
     wire.write(first);
     wire.write(second);
-    wire.endTransmission();
+    if(DFRIRtelemetry_Enabled) {
+        counters.bytes += 2;
+    }
+    if(wire.endTransmission() != 0) {
+        if(DFRIRtelemetry_Enabled) {
+            ++counters.nacks;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool DFRobotIRPositionEx::writeIICBlock(uint8_t reg, const uint8_t* data, unsigned int length)
+{
+    wire.beginTransmission(IRAddress);
+    wire.write(reg);
+    wire.write(data, length);
+    if(DFRIRtelemetry_Enabled) {
+        counters.bytes += length + 1;
+    }
+    if(wire.endTransmission() != 0) {
+        if(DFRIRtelemetry_Enabled) {
+            ++counters.nacks;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool DFRobotIRPositionEx::configSettled() const
+{
+    return micros() - configWriteTime >= DFRIRconfig_SettleUs;
+}
+
+bool DFRobotIRPositionEx::writeConfig(unsigned int step, unsigned long timeoutUs)
+{
+    // the camera may still be latching the last write, a blocking write waits like the original delay
+    if(!configSettled()) {
+        if(!timeoutUs) {
+            return false;
+        }
+        delayMicroseconds(DFRIRconfig_SettleUs - (micros() - configWriteTime));
+    }
+
+    const unsigned long start = micros();
+    do {
+        bool ack = true;
+        switch(step) {
+        case ConfigState_Stop:
+            // stop camera?
+            ack = writeTwoIICByte(0x30, 0x01);
+            break;
+        case ConfigState_Sensitivity:
+            if(sensCustom) {
+                ack = writeIICBlock(0x00, sensBlock1, sizeof(sensBlock1));
+            } else {
+                ack = writeIICBlock(0x06, &sensBlock1[6], 3);
+            }
+            break;
+        case ConfigState_Sensitivity2:
+            ack = writeIICBlock(0x1A, sensBlock2, sensCustom ? sizeof(sensBlock2) : 1);
+            break;
+        case ConfigState_Mode:
+            ack = writeTwoIICByte(0x33, formatMode((DataFormat_e)configFormat));
+            break;
+        case ConfigState_Start:
+            // start camera?
+            ack = writeTwoIICByte(0x30, 0x08);
+            break;
+        default:
+            break;
+        }
+        if(ack) {
+            configWriteTime = micros();
+            return true;
+        }
+    } while(micros() - start < timeoutUs);
+    return false;
 }
 
 void DFRobotIRPositionEx::dataFormat(DataFormat_e format)
 {
-    uint8_t mode = format ? DFRIRdata_ModeExtended : DFRIRdata_ModeBasic;
-    writeTwoIICByte(0x33, mode);
-    delay(DFRIRdata_IICdelay);
+    configFormat = format;
+    writeConfig(ConfigState_Mode, DFRIRconfig_WriteTimeoutUs);
 }
 
-void DFRobotIRPositionEx::sensitivityLevel(Sensitivity_e sensitivity)
+void DFRobotIRPositionEx::sensitivityPreset(unsigned int sensitivity)
 {
-    // sensitivity data from http://wiibrew.org/wiki/Wiimote#IR_Camera
-    static const uint8_t reg06[3] = {0x90, 0x90, 0xFF};
-    static const uint8_t reg08[3] = {0xC0, 0x41, 0x0C};
-    static const uint8_t reg1A[3] = {0x40, 0x40, 0x00};
     if(sensitivity > Sensitivity_Max) {
         sensitivity = Sensitivity_Max;
     }
-    writeTwoIICByte(0x06, reg06[sensitivity]);
-    delay(DFRIRdata_IICdelay);
-    writeTwoIICByte(0x08, reg08[sensitivity]);
-    delay(DFRIRdata_IICdelay);
-    writeTwoIICByte(0x1A, reg1A[sensitivity]);
-    delay(DFRIRdata_IICdelay);
+    memset(sensBlock1, 0, sizeof(sensBlock1));
+    memset(sensBlock2, 0, sizeof(sensBlock2));
+    sensBlock1[6] = DFRIRsens_Reg06[sensitivity];
+    sensBlock1[8] = DFRIRsens_Reg08[sensitivity];
+    sensBlock2[0] = DFRIRsens_Reg1A[sensitivity];
+    sensCustom = false;
+}
+
+void DFRobotIRPositionEx::sensitivityLevel(Sensitivity_e sensitivity)
+{
+    sensitivityPreset(sensitivity);
+    writeConfig(ConfigState_Sensitivity, DFRIRconfig_WriteTimeoutUs);
+    writeConfig(ConfigState_Sensitivity2, DFRIRconfig_WriteTimeoutUs);
 }
 
 void DFRobotIRPositionEx::begin(uint32_t clock, DataFormat_e format, Sensitivity_e sensitivity)
+{
+    beginConfig(clock, format, sensitivity);
+    while(!pollConfig()) {
+        yield();
+    }
+}
+
+void DFRobotIRPositionEx::beginConfig(uint32_t clock, DataFormat_e format, Sensitivity_e sensitivity)
+{
+    iicClock = clock;
+    beginWire();
+    sensitivityPreset(sensitivity);
+    configFormat = format;
+    startConfig();
+}
+
+void DFRobotIRPositionEx::beginWire()
 {
     // looking under the covers, the Wire default is only 100kHz (on AVR and SAMD), so allow a custom setting
     // so close to the code being 100% portable... yes the order you call setClock() appears to differ for the RP2040
 #ifdef ARDUINO_ARCH_RP2040
     // For RP2040 the clock must be set before calling begin()
-    wire.setClock(clock);
+    wire.setClock(iicClock);
     wire.begin();
 #else
     // For AVR and SAMD the clock must be changed after begin()
     wire.begin();
-    wire.setClock(clock);
+    wire.setClock(iicClock);
 #endif
-    // stop camera?
-    writeTwoIICByte(0x30,0x01);
-    delay(DFRIRdata_IICdelay);
-    sensitivityLevel(sensitivity);
-    dataFormat(format);
-    // start camera?
-    writeTwoIICByte(0x30,0x08);
+}
 
-    delay(100);
+void DFRobotIRPositionEx::startConfig()
+{
+    configPendingMask = 0;
+    configStart = micros();
+    configStepStart = configStart;
+    // the sequence runs after a boot or a bus recovery, the first write doesn't wait
+    configWriteTime = configStart - DFRIRconfig_SettleUs;
+    configDuration = 0;
+    configError = Error_Success;
+    configState = ConfigState_Stop;
 }
 
-void DFRobotIRPositionEx::requestPositionExtended()
+bool DFRobotIRPositionEx::pollConfig()
+{
+    switch(configState) {
+    case ConfigState_Stop:
+    case ConfigState_Sensitivity:
+    case ConfigState_Sensitivity2:
+    case ConfigState_Mode:
+    case ConfigState_Start:
+        // each write waits the settle time after the last one, and if the camera still doesn't
+        // acknowledge it is retried until the step deadline
+        if(writeConfig(configState, 0)) {
+            ++configState;
+            configStepStart = configWriteTime + DFRIRconfig_SettleUs;
+        } else if((long)(micros() - configStepStart) >= (long)DFRIRconfig_WriteTimeoutUs) {
+            return finishConfig(Error_IICerror);
+        }
+        return false;
+
+    case ConfigState_Ready: {
+        const unsigned int length = formatLength((DataFormat_e)configFormat);
+        requestPosition(length);
+        // the data reads as 0 until the camera is running
+        if(readPosition(positionData[0], length) && !frameBlank(positionData[0].receivedBuffer, length)) {
+            configDuration = micros() - configStart;
+            return finishConfig(Error_Success);
+        }
+        if(micros() - configStart >= DFRIRconfig_TimeoutUs) {
+            configDuration = micros() - configStart;
+            return finishConfig(Error_Timeout);
+        }
+        return false;
+    }
+
+    case ConfigState_Done:
+        return true;
+
+    default:
+        // nothing in progress
+        return false;
+    }
+}
+
+void DFRobotIRPositionEx::queueSensitivity(Sensitivity_e sensitivity)
+{
+    sensitivityPreset(sensitivity);
+    configPendingMask |= (1 << ConfigState_Sensitivity) | (1 << ConfigState_Sensitivity2);
+}
+
+void DFRobotIRPositionEx::sensitivityBlocks(const uint8_t* block1, const uint8_t* block2)
+{
+    memcpy(sensBlock1, block1, sizeof(sensBlock1));
+    memcpy(sensBlock2, block2, sizeof(sensBlock2));
+    sensCustom = true;
+    writeConfig(ConfigState_Sensitivity, DFRIRconfig_WriteTimeoutUs);
+    writeConfig(ConfigState_Sensitivity2, DFRIRconfig_WriteTimeoutUs);
+}
+
+void DFRobotIRPositionEx::queueSensitivityBlocks(const uint8_t* block1, const uint8_t* block2)
+{
+    memcpy(sensBlock1, block1, sizeof(sensBlock1));
+    memcpy(sensBlock2, block2, sizeof(sensBlock2));
+    sensCustom = true;
+    configPendingMask |= (1 << ConfigState_Sensitivity) | (1 << ConfigState_Sensitivity2);
+}
+
+void DFRobotIRPositionEx::autoExposure(bool enable)
+{
+    aeEnabled = enable;
+    aeFrames = 0;
+    aeSeenSum = 0;
+    aeSizeSum = 0;
+}
+
+void DFRobotIRPositionEx::exposureUpdate()
+{
+    for(int i = 0; i < 4; ++i) {
+        if(seenFlags & (1 << i)) {
+            ++aeSeenSum;
+            aeSizeSum += unpackedSizes[i];
+        }
+    }
+    if(++aeFrames < DFRIRae_Interval) {
+        return;
+    }
+
+    const unsigned int seenSum = aeSeenSum;
+    const unsigned int sizeSum = aeSizeSum;
+    aeFrames = 0;
+    aeSeenSum = 0;
+    aeSizeSum = 0;
+
+    // nothing to measure if no points are seen, likely pointing away from the screen
+    if(!seenSum) {
+        return;
+    }
+
+    // step by ~6% of the gain value
+    unsigned int gain = sensBlock1[8];
+    const unsigned int step = (gain >> 4) + 1;
+    if(sizeSum > seenSum * DFRIRae_SizeHigh) {
+        // blobs are large, reduce the gain before reflections are seen
+        gain = min(gain + step, DFRIRae_GainMax);
+    } else if(seenSum < 4 * DFRIRae_Interval && sizeSum < seenSum * DFRIRae_SizeLow) {
+        // points are missing and the seen points are small, so the missing points are likely too dim
+        // if the seen points are not small then the missing points are likely out of view
+        gain = gain > DFRIRae_GainMin + step ? gain - step : DFRIRae_GainMin;
+    }
+
+    if(gain != sensBlock1[8]) {
+        // the gain limit must be less than the gain, use the same ratio as the default level
+        // only the gain bytes change, so a level still writes only 0x06 to 0x08 and 0x1A and the
+        // rest of the camera's registers keep their values instead of being written from unset blocks
+        sensBlock1[8] = gain;
+        sensBlock2[0] = gain / 3;
+        configPendingMask |= (1 << ConfigState_Sensitivity) | (1 << ConfigState_Sensitivity2);
+    }
+}
+
+bool DFRobotIRPositionEx::pollPending()
+{
+    if(!configPendingMask || configBusy() || !configSettled()) {
+        return false;
+    }
+
+    // lowest step first, the same order as the configuration sequence
+    unsigned int step = ConfigState_Stop;
+    while(!(configPendingMask & (1 << step))) {
+        ++step;
+    }
+    if(writeConfig(step, 0)) {
+        configPendingMask &= ~(1 << step);
+    }
+    return true;
+}
+
+void DFRobotIRPositionEx::autoRecover(bool enable, int sdaPin, int sclPin)
+{
+    recoverEnabled = enable;
+    recoverSda = sdaPin;
+    recoverScl = sclPin;
+    recoverErrors = 0;
+    if(!enable) {
+        recoverActive = false;
+    }
+}
+
+void DFRobotIRPositionEx::busClear()
+{
+    wire.end();
+    if(recoverSda >= 0 && recoverScl >= 0) {
+        // the lines are open drain, a line is driven low or released to the pull up
+        pinMode(recoverSda, INPUT_PULLUP);
+        pinMode(recoverScl, INPUT_PULLUP);
+
+        // a device holding SDA low is part way through a byte, clock it out until SDA is released
+        for(unsigned int i = 0; i < DFRIRrecover_ClockPulses && digitalRead(recoverSda) == LOW; ++i) {
+            digitalWrite(recoverScl, LOW);
+            pinMode(recoverScl, OUTPUT);
+            delayMicroseconds(DFRIRrecover_HalfClockUs);
+            pinMode(recoverScl, INPUT_PULLUP);
+            delayMicroseconds(DFRIRrecover_HalfClockUs);
+        }
+
+        // STOP, SDA goes high while SCL is high
+        digitalWrite(recoverSda, LOW);
+        pinMode(recoverSda, OUTPUT);
+        delayMicroseconds(DFRIRrecover_HalfClockUs);
+        pinMode(recoverSda, INPUT_PULLUP);
+        delayMicroseconds(DFRIRrecover_HalfClockUs);
+    }
+    beginWire();
+}
+
+bool DFRobotIRPositionEx::pollRecovery()
+{
+    if(configState == ConfigState_Idle || configState == ConfigState_Done) {
+        // start an attempt, waiting out the delay after a failed attempt
+        if((long)(micros() - recoverRetry) < 0) {
+            return false;
+        }
+        busClear();
+        startConfig();
+        return false;
+    }
+
+    if(!pollConfig()) {
+        return false;
+    }
+
+    if(configError != Error_Success) {
+        // the camera didn't start, try again later so a disconnected camera doesn't keep the bus busy
+        recoverRetry = micros() + DFRIRrecover_RetryUs;
+        return false;
+    }
+
+    recoverDuration = micros() - recoverStart;
+    if(DFRIRtelemetry_Enabled) {
+        ++counters.recoveries;
+        if(recoverDuration > counters.recoveryMax) {
+            counters.recoveryMax = recoverDuration;
+        }
+    }
+    recoverActive = false;
+    recoverErrors = 0;
+
+    // the camera restarted with a new update phase
+    if(phaseMode == PhaseState_Locked) {
+        phaseMode = PhaseState_Tracking;
+        phaseLockCount = 0;
+        phaseValid = false;
+        phaseUpdated = true;
+    }
+    return true;
+}
+
+void DFRobotIRPositionEx::telemetry(Telemetry_t& snapshot, bool reset)
+{
+    snapshot = counters;
+    if(reset) {
+        resetTelemetry();
+    }
+}
+
+void DFRobotIRPositionEx::resetTelemetry()
+{
+    memset(&counters, 0, sizeof(counters));
+}
+
+bool DFRobotIRPositionEx::finishConfig(int error)
+{
+    configError = error;
+    configState = ConfigState_Done;
+    return true;
+}
+
+void DFRobotIRPositionEx::requestPosition(unsigned int length, unsigned int offset)
 {
     wire.beginTransmission(IRAddress);
-    wire.write(0x36);
+    wire.write(DFRIRdata_RegPosition + offset);
     wire.endTransmission();
-    wire.requestFrom(IRAddress, DFRIRdata_LengthExtended);
+    wire.requestFrom(IRAddress, min(length - offset, DFRIRdata_ChunkLength));
+    if(DFRIRtelemetry_Enabled) {
+        ++counters.bytes;
+    }
+}
+
+void DFRobotIRPositionEx::requestPositionExtended()
+{
+    requestPosition(DFRIRdata_LengthExtended);
 }
 
 void DFRobotIRPositionEx::requestPositionBasic()
 {
-    wire.beginTransmission(IRAddress);
-    wire.write(0x36);
-    wire.endTransmission();
-    wire.requestFrom(IRAddress, DFRIRdata_LengthBasic);
+    requestPosition(DFRIRdata_LengthBasic);
+}
+
+void DFRobotIRPositionEx::requestPositionFull()
+{
+    requestPosition(DFRIRdata_LengthFull);
 }
 
 bool DFRobotIRPositionEx::availableExtended()
@@ -155,21 +644,53 @@ bool DFRobotIRPositionEx::availableBasicNoSeen()
     return false;
 }
 
+bool DFRobotIRPositionEx::availableFull()
+{
+    if(readPosition(positionData[0], DFRIRdata_LengthFull)) {
+        unpackFullFrameSeen(0);
+        return true;
+    }
+    return false;
+}
+
+bool DFRobotIRPositionEx::availableFullNoSeen()
+{
+    if(readPosition(positionData[0], DFRIRdata_LengthFull)) {
+        unpackFullFrame(0);
+        return true;
+    }
+    return false;
+}
+
 bool DFRobotIRPositionEx::readPosition(PositionData_t& posData, unsigned int length)
 {
-    if(wire.available() == length) {   //read only the data lenth fits.
-        for(int i = 0; i < length; ++i) {
-            posData.receivedBuffer[i] = wire.read();
+    unsigned int offset = 0;
+    unsigned int chunk = min(length, DFRIRdata_ChunkLength);
+    while(wire.available() == chunk) {   //read only the data lenth fits.
+        for(unsigned int i = 0; i < chunk; ++i) {
+            posData.receivedBuffer[offset + i] = wire.read();
+        }
+        if(DFRIRtelemetry_Enabled) {
+            counters.bytes += chunk;
+        }
+        offset += chunk;
+        if(offset >= length) {
+            // looks like the header should always be 0, extra sanity for valid data
+            //if(posData.positionFrame.header != 0) {
+            //    return false;
+            //}
+            return true;
         }
 
-        // looks like the header should always be 0, extra sanity for valid data
-        //if(posData.positionFrame.header != 0) {
-        //    return false;
-        //}
-        return true;
+        // the data didn't fit the Wire buffer so request the next chunk
+        requestPosition(length, offset);
+        chunk = min(length - offset, DFRIRdata_ChunkLength);
     }
 
     // length mismatch, flush the read buffer
+    if(DFRIRtelemetry_Enabled) {
+        ++counters.shortReads;
+    }
     while(wire.available()) {
         wire.read();
     }
@@ -178,150 +699,488 @@ bool DFRobotIRPositionEx::readPosition(PositionData_t& posData, unsigned int len
 
 void DFRobotIRPositionEx::unpackBasicFrame(unsigned int posData)
 {
-    BasicFrame_t& frame = positionData[posData].frame.format.rawBasic[0];
-    int high = frame.high;
-    positionX[0] = (int)frame.x1low | ((high & 0x30) << 4);
-    positionY[0] = (int)frame.y1low | ((high & 0xC0) << 2);
-    positionX[1] = (int)frame.x2low | ((high & 0x03) << 8);
-    positionY[1] = (int)frame.y2low | ((high & 0x0C) << 6);
+    for(int i = 0; i < 2; ++i) {
+        const BasicFrame_t& frame = positionData[posData].frame.format.rawBasic[i];
+        const unsigned int high = frame.high;
+        positionX[i * 2] = (int)frame.x1low | ((high & 0x30) << 4);
+        positionY[i * 2] = (int)frame.y1low | ((high & 0xC0) << 2);
+        positionX[i * 2 + 1] = (int)frame.x2low | ((high & 0x03) << 8);
+        positionY[i * 2 + 1] = (int)frame.y2low | ((high & 0x0C) << 6);
+    }
+}
+
+unsigned int DFRobotIRPositionEx::unpackBasicSeen(const uint8_t* data, int* x, int* y)
+{
+    const BasicFrame_t* frames = (const BasicFrame_t*)data;
+    unsigned int seen = 0;
+    for(int i = 0; i < 2; ++i) {
+        const BasicFrame_t& frame = frames[i];
+        const unsigned int high = frame.high;
 
-    frame = positionData[posData].frame.format.rawBasic[1];
-    high = frame.high;
-    positionX[2] = (int)frame.x1low | ((high & 0x30) << 4);
-    positionY[2] = (int)frame.y1low | ((high & 0xC0) << 2);
-    positionX[3] = (int)frame.x2low | ((high & 0x03) << 8);
-    positionY[3] = (int)frame.y2low | ((high & 0x0C) << 6);
+        // keep the previous position if not seen, Y is greater than the maximum of 767
+        const int y1 = (int)frame.y1low | ((high & 0xC0) << 2);
+        if(y1 <= DFRIRdata_MaxY) {
+            x[i * 2] = (int)frame.x1low | ((high & 0x30) << 4);
+            y[i * 2] = y1;
+            seen |= 1 << (i * 2);
+        }
+        const int y2 = (int)frame.y2low | ((high & 0x0C) << 6);
+        if(y2 <= DFRIRdata_MaxY) {
+            x[i * 2 + 1] = (int)frame.x2low | ((high & 0x03) << 8);
+            y[i * 2 + 1] = y2;
+            seen |= 2 << (i * 2);
+        }
+    }
+    return seen;
 }
 
 void DFRobotIRPositionEx::unpackBasicFrameSeen(unsigned int posData)
 {
-    seenFlags = 0;
-    BasicFrame_t& frame = positionData[posData].frame.format.rawBasic[0];
-    int high = frame.high;
-    int y = (int)frame.y1low | ((high & 0xC0) << 2);
-    if(y <= DFRIRdata_MaxY) {
-        positionY[0] = y;
-        positionX[0] = (int)frame.x1low | ((high & 0x30) << 4);
-        seenFlags |= 0x01;
+    seenFlags = unpackBasicSeen(&positionData[posData].receivedBuffer[1], positionX, positionY);
+}
+
+int DFRobotIRPositionEx::basicAtomic(DFRobotIRPositionEx::Retry_e retry)
+{
+    startAtomic(DataFormat_Basic, retry);
+    while(!pollAtomic());
+    return readError;
+}
+
+void DFRobotIRPositionEx::unpackExtendedFrame(unsigned int posData)
+{
+    for(int i = 0; i < 4; ++i) {
+        ExtendedFrame_t& frame = positionData[posData].frame.format.rawExtended[i];
+        positionX[i] = (int)frame.xLow | ((int)(frame.xyHighSize & 0x30U) << 4);
+        positionY[i] = (int)frame.yLow | ((int)(frame.xyHighSize & 0xC0U) << 2);
+        unpackedSizes[i] = frame.xyHighSize & 0xF;
     }
-    y = (int)frame.y2low | ((high & 0x0C) << 6);
-    if(y <= DFRIRdata_MaxY) {
-        positionY[1] = y;
-        positionX[1] = (int)frame.x2low | ((high & 0x03) << 8);
-        seenFlags |= 0x02;
+}
+
+unsigned int DFRobotIRPositionEx::unpackExtendedSeen(const uint8_t* data, int* x, int* y, int* sizes)
+{
+    const ExtendedFrame_t* frames = (const ExtendedFrame_t*)data;
+    unsigned int seen = 0;
+    for(int i = 0; i < 4; ++i) {
+        const ExtendedFrame_t& frame = frames[i];
+        const unsigned int high = frame.xyHighSize;
+
+        // keep the previous position if not seen, Y is greater than the maximum of 767
+        const int py = (int)frame.yLow | ((int)(high & 0xC0U) << 2);
+        if(py <= DFRIRdata_MaxY) {
+            x[i] = (int)frame.xLow | ((int)(high & 0x30U) << 4);
+            y[i] = py;
+            sizes[i] = high & 0xFU;
+            seen |= 1 << i;
+        }
     }
+    return seen;
+}
 
-    frame = positionData[posData].frame.format.rawBasic[1];
-    high = frame.high;
-    y = (int)frame.y1low | ((high & 0xC0) << 2);
-    if(y <= DFRIRdata_MaxY) {
-        positionY[2] = y;
-        positionX[2] = (int)frame.x1low | ((high & 0x30) << 4);
-        seenFlags |= 0x04;
+void DFRobotIRPositionEx::unpackExtendedFrameSeen(unsigned int posData)
+{
+    seenFlags = unpackExtendedSeen(&positionData[posData].receivedBuffer[1], positionX, positionY, unpackedSizes);
+}
+
+int DFRobotIRPositionEx::extendedAtomic(DFRobotIRPositionEx::Retry_e retry)
+{
+    startAtomic(DataFormat_Extended, retry);
+    while(!pollAtomic());
+    return readError;
+}
+
+void DFRobotIRPositionEx::unpackFullFrame(unsigned int posData)
+{
+    for(int i = 0; i < 4; ++i) {
+        FullFrame_t& frame = positionData[posData].frame.format.rawFull[i];
+        positionX[i] = (int)frame.xLow | ((int)(frame.xyHighSize & 0x30U) << 4);
+        positionY[i] = (int)frame.yLow | ((int)(frame.xyHighSize & 0xC0U) << 2);
+        unpackedSizes[i] = frame.xyHighSize & 0xF;
+        unpackedBoxMinX[i] = frame.xMin & 0x7F;
+        unpackedBoxMinY[i] = frame.yMin & 0x7F;
+        unpackedBoxMaxX[i] = frame.xMax & 0x7F;
+        unpackedBoxMaxY[i] = frame.yMax & 0x7F;
+        unpackedIntensity[i] = frame.intensity;
     }
-    y = (int)frame.y2low | ((high & 0x0C) << 6);
-    if(y <= DFRIRdata_MaxY) {
-        positionY[3] = y;
-        positionX[3] = (int)frame.x2low | ((high & 0x03) << 8);
-        seenFlags |= 0x08;
+}
+
+void DFRobotIRPositionEx::unpackFullFrameSeen(unsigned int posData)
+{
+    unsigned int seen = 0;
+    for(int i = 0; i < 4; ++i) {
+        const FullFrame_t& frame = positionData[posData].frame.format.rawFull[i];
+        const unsigned int high = frame.xyHighSize;
+
+        // keep the previous position if not seen, Y is greater than the maximum of 767
+        const int py = (int)frame.yLow | ((int)(high & 0xC0U) << 2);
+        if(py <= DFRIRdata_MaxY) {
+            positionX[i] = (int)frame.xLow | ((int)(high & 0x30U) << 4);
+            positionY[i] = py;
+            unpackedSizes[i] = high & 0xFU;
+            unpackedBoxMinX[i] = frame.xMin & 0x7F;
+            unpackedBoxMinY[i] = frame.yMin & 0x7F;
+            unpackedBoxMaxX[i] = frame.xMax & 0x7F;
+            unpackedBoxMaxY[i] = frame.yMax & 0x7F;
+            unpackedIntensity[i] = frame.intensity;
+            seen |= 1 << i;
+        }
     }
+    seenFlags = seen;
 }
 
-int DFRobotIRPositionEx::basicAtomic(DFRobotIRPositionEx::Retry_e retry)
+int DFRobotIRPositionEx::fullAtomic(DFRobotIRPositionEx::Retry_e retry)
 {
-    // initial index for positiondata[1]
-    unsigned int index = 0;
-    
-    // initial read in positiondata[0]
-    requestPositionBasic();
-    if(!readPosition(positionData[0], DFRIRdata_LengthBasic)) {
-        return Error_IICerror;
+    startAtomic(DataFormat_Full, retry);
+    while(!pollAtomic());
+    return readError;
+}
+
+void DFRobotIRPositionEx::startAtomic(DataFormat_e format, DFRobotIRPositionEx::Retry_e retry)
+{
+    readFormat = format;
+    readRetry = retry;
+    readAttempt = 0;
+    readIndex = 0;
+    readMismatch = false;
+    if(recoverActive) {
+        readState = ReadState_Recover;
+    } else {
+        readState = configPendingMask ? ReadState_Config : ReadState_First;
     }
+}
+
+bool DFRobotIRPositionEx::pollAtomic()
+{
+    const unsigned int length = formatLength((DataFormat_e)readFormat);
+
+    switch(readState) {
+    case ReadState_Config:
+        // one queued configuration write goes between position reads
+        pollPending();
+        readState = ReadState_First;
+        return false;
+
+    case ReadState_Recover:
+        // one recovery step per read so the loop keeps running, the read continues once the camera is back
+        atomicStart = micros();
+        if(!pollRecovery()) {
+            return finishAtomic(Error_Recovering);
+        }
+        readState = ReadState_First;
+        return false;
+
+    case ReadState_First:
+        // initial read in positiondata[0]
+        readStart = micros();
+        atomicStart = readStart;
+        if(DFRIRtelemetry_Enabled) {
+            ++counters.reads;
+        }
+        requestPosition(length);
+        if(!readPosition(positionData[0], length)) {
+            return finishAtomic(Error_IICerror);
+        }
+        if(recoverEnabled && frameBlank(positionData[0].receivedBuffer, length)) {
+            // the camera was reset so it needs to be configured again
+            return finishAtomic(Error_IICerror);
+        }
+        readDuration = micros() - readStart;
+
+        if(phaseMode == PhaseState_Locked) {
+            // when locked, the read is just after the camera update so the data can't change during the read
+            if(phaseVerify) {
+                // timer must move to the verify sample time for the next read
+                if(!--phaseVerify) {
+                    phaseUpdated = true;
+                }
+                return finishAtomic(Error_Success);
+            }
+
+            // this read started so the compared reads end at the expected update to verify the lock,
+            // and the timer must move back to the normal sample time, verify every frame until the lock settles
+            phaseVerify = phaseStep > DFRIRphase_StepMinUs ? 0 : DFRIRphase_VerifyInterval;
+            phaseUpdated = true;
+        }
+        readState = ReadState_Compare;
+        return false;
 
-    for(unsigned int i = 0, retries = retry >> 1; i <= retries; ++i) {
-        requestPositionBasic();
+    case ReadState_Compare: {
+        const unsigned long start = micros();
+        if(DFRIRtelemetry_Enabled) {
+            counters.retries += readAttempt != 0;
+            ++counters.reads;
+        }
+        requestPosition(length);
 
         // switch to other buffer for next read
-        index ^= 1;
+        readIndex ^= 1;
 
-        if(!readPosition(positionData[index], DFRIRdata_LengthBasic)) {
-            return Error_IICerror;
+        if(!readPosition(positionData[readIndex], length)) {
+            return finishAtomic(Error_IICerror);
         }
 
         // compare but ignore the header byte
-        if(!memcmp(&positionData[0].receivedBuffer[1], &positionData[1].receivedBuffer[1], DFRIRdata_LengthBasic - 1)) {
+        if(!memcmp(&positionData[0].receivedBuffer[1], &positionData[1].receivedBuffer[1], length - 1)) {
             // position data is identical so unpack the data
-            unpackBasicFrameSeen(0);
-            return Error_Success;
+            if(phaseMode == PhaseState_Locked && !readMismatch) {
+                if(++phaseMissed > DFRIRphase_MaxMissed) {
+                    // verify reads keep missing the update so the lock is lost, start over
+                    phaseMode = PhaseState_Tracking;
+                    phaseLockCount = 0;
+                    phaseValid = false;
+                    phaseUpdated = true;
+                } else {
+                    // the update didn't happen before the expected time, so it is late
+                    phaseNudge(true);
+                }
+            }
+            return finishAtomic(Error_Success);
+        }
+
+        if(!readMismatch) {
+            readMismatch = true;
+            if(phaseMode == PhaseState_Locked) {
+                // the update happened before the expected time, so it is early
+                phaseMissed = 0;
+                phaseNudge(false);
+            } else if(phaseMode == PhaseState_Tracking) {
+                phaseDetect(readStart, micros());
+            }
+        }
+        readStart = start;
+
+        // retry until the retries are used up
+        if(++readAttempt <= (readRetry >> 1)) {
+            return false;
+        }
+
+        // if mismatch is allowed then use the last frame
+        return finishAtomic((readRetry & 1) ? Error_SuccessMismatch : Error_DataMismatch);
+    }
+
+    default:
+        // nothing in progress
+        return false;
+    }
+}
+
+bool DFRobotIRPositionEx::finishAtomic(int error)
+{
+    // telemetry, the time histogram buckets double from 128us
+    if(DFRIRtelemetry_Enabled) {
+        const unsigned long latency = micros() - atomicStart;
+        unsigned int bucket = 0;
+        for(unsigned long t = latency >> 7; t && bucket < TelemetryHistSize - 1; t >>= 1) {
+            ++bucket;
+        }
+        ++counters.latencyHist[bucket];
+        if(latency > counters.latencyMax) {
+            counters.latencyMax = latency;
+        }
+        ++counters.atomicReads;
+        if(error == Error_SuccessMismatch) {
+            ++counters.mismatchUsed;
+        } else if(error == Error_DataMismatch) {
+            ++counters.mismatchErrors;
+        } else if(error == Error_IICerror) {
+            ++counters.iicErrors;
+        } else if(error == Error_Recovering) {
+            ++counters.recoverySteps;
+        }
+    }
+
+    // start the bus recovery after consecutive IIC errors
+    if(error == Error_IICerror) {
+        if(recoverEnabled && !recoverActive && ++recoverErrors >= DFRIRrecover_ErrorCount) {
+            recoverActive = true;
+            recoverStart = micros();
+            recoverRetry = recoverStart;
+            configState = ConfigState_Idle;
+        }
+    } else if(error >= Error_Success) {
+        recoverErrors = 0;
+    }
+
+    // only compared reads count towards the mismatch rate
+    if(readState == ReadState_Compare) {
+        phaseSampleStart = atomicStart;
+        phaseSampleSeen = readMismatch;
+        if(readMismatch) {
+            mismatchAvg += (65535 - mismatchAvg) >> 6;
+        } else {
+            mismatchAvg -= mismatchAvg >> 6;
+        }
+    }
+
+    if(error >= Error_Success) {
+        if(readFormat == DataFormat_Extended) {
+            unpackExtendedFrameSeen(readIndex);
+        } else if(readFormat == DataFormat_Full) {
+            unpackFullFrameSeen(readIndex);
+        } else {
+            unpackBasicFrameSeen(readIndex);
+        }
+        if(aeEnabled && readFormat != DataFormat_Basic) {
+            exposureUpdate();
         }
     }
-    
-    if(retry & 1) {
-        unpackBasicFrameSeen(index);
-        return Error_SuccessMismatch;
+    readError = error;
+    readState = ReadState_Done;
+    if(readCallback) {
+        readCallback(*this, error, readCallbackContext);
     }
+    return true;
+}
 
-    return Error_DataMismatch;
+void DFRobotIRPositionEx::phaseLock(bool enable, unsigned long periodUs, unsigned int marginUs)
+{
+    phaseMode = enable ? PhaseState_Tracking : PhaseState_Off;
+    phaseNominal = periodUs;
+    phasePeriodQ4 = periodUs << 4;
+    phaseMargin = marginUs;
+    phaseLockCount = 0;
+    phaseVerify = 0;
+    phaseMissed = 0;
+    phaseValid = false;
+    phaseErr = 0;
+    phaseUpdated = true;
 }
 
-void DFRobotIRPositionEx::unpackExtendedFrame(unsigned int posData)
+void DFRobotIRPositionEx::phaseEvent(unsigned long updateTime)
 {
-    for(int i = 0; i < 4; ++i) {
-        ExtendedFrame_t& frame = positionData[posData].frame.format.rawExtended[i];
-        positionX[i] = (int)frame.xLow | ((int)(frame.xyHighSize & 0x30U) << 4);
-        positionY[i] = (int)frame.yLow | ((int)(frame.xyHighSize & 0xC0U) << 2);
-        unpackedSizes[i] = frame.xyHighSize & 0xF;
+    phaseUpdated = true;
+
+    const unsigned long dt = updateTime - phaseUpdateTime;
+    if(!phaseValid || dt > DFRIRphase_MaxGapUs) {
+        // first detected update, or too long ago to trust the estimate
+        phaseUpdateTime = updateTime;
+        phaseValid = true;
+        phaseLockCount = 0;
+        phaseErr = 0;
+        return;
+    }
+
+    // the sample time sweeps back across one camera period between detected updates,
+    // so the camera periods elapsed is one less than the sample periods elapsed
+    // consecutive samples can both detect the same update which is one period apart
+    const unsigned long samplePeriod = phaseSamplePeriod();
+    const unsigned long m = (dt + (samplePeriod >> 1)) / samplePeriod;
+    const unsigned long n = m > 1 ? m - 1 : 1;
+    const unsigned long predicted = phaseUpdateTime + ((n * phasePeriodQ4) >> 4);
+    const long err = (long)(updateTime - predicted);
+    phaseErr = err;
+
+    // correct the period with half the average error per elapsed period
+    // updates detected only a few periods apart are too noisy to correct the period
+    if(n >= DFRIRphase_MinPeriods) {
+        phaseAdjustPeriod((err * 8) / (long)n);
+    }
+
+    // correct the phase by half the error
+    phaseUpdateTime = predicted + (err / 2);
+
+    if(abs(err) <= DFRIRphase_LockWindowUs) {
+        if(phaseLockCount < DFRIRphase_LockCount) {
+            ++phaseLockCount;
+        } else if(phaseMode != PhaseState_Locked) {
+            phaseMode = PhaseState_Locked;
+            phaseStep = DFRIRphase_StepInitUs;
+            phaseDir = 0;
+            phaseMissed = 0;
+            phaseErr = 0;
+        }
+    } else {
+        // drifted, go back to compared reads
+        phaseLockCount = 0;
+        phaseMode = PhaseState_Tracking;
     }
 }
 
-void DFRobotIRPositionEx::unpackExtendedFrameSeen(unsigned int posData)
+void DFRobotIRPositionEx::phaseDetect(unsigned long windowStart, unsigned long windowEnd)
 {
-    seenFlags = 0;
-    for(int i = 0; i < 4; ++i) {
-        ExtendedFrame_t& frame = positionData[posData].frame.format.rawExtended[i];
-        int y = (int)frame.yLow | ((int)(frame.xyHighSize & 0xC0U) << 2);
-        if(y <= DFRIRdata_MaxY) {
-            positionY[i] = y;
-            positionX[i] = (int)frame.xLow | ((int)(frame.xyHighSize & 0x30U) << 4);
-            unpackedSizes[i] = frame.xyHighSize & 0xF;
-            seenFlags |= 1 << i;
+    // the camera updated some time between the start of the previous read and the end of this read
+    const unsigned long window = windowEnd - windowStart;
+    unsigned long updateTime = windowStart + (window >> 1);
+
+    // the sample time sweeps back across the camera period, so if the last sample was one period ago
+    // the same update is seen by a few samples in a row and only the first one says anything new
+    const unsigned long samplePeriod = phaseSamplePeriod();
+    const unsigned long gap = windowStart - phaseSampleStart;
+    if(gap > (samplePeriod >> 1) && gap < samplePeriod + (samplePeriod >> 1)) {
+        if(phaseSampleSeen) {
+            return;
+        }
+
+        // the last sample didn't see the update so it is in the part of the window the sample swept past,
+        // a read at 400kHz is long so this is much closer than the middle of the window
+        const long step = (long)phasePeriod() - (long)gap;
+        if(step > 0 && (unsigned long)step < window) {
+            updateTime = windowStart + ((unsigned long)step >> 1);
         }
     }
+    phaseEvent(updateTime);
 }
 
-int DFRobotIRPositionEx::extendedAtomic(DFRobotIRPositionEx::Retry_e retry)
+void DFRobotIRPositionEx::phaseNudge(bool late)
 {
-    // initial index for positiondata[1]
-    unsigned int index = 0;
-    
-    // initial read in positiondata[0]
-    requestPositionExtended();
-    if(!readPosition(positionData[0], DFRIRdata_LengthExtended)) {
-        return Error_IICerror;
+    const int8_t dir = late ? 1 : -1;
+    if(dir != phaseDir) {
+        if(phaseStep > DFRIRphase_StepMinUs) {
+            phaseStep >>= 1;
+        }
+    } else if(phaseStep < DFRIRphase_StepMaxUs) {
+        phaseStep <<= 1;
     }
+    phaseDir = dir;
 
-    for(unsigned int i = 0, retries = retry >> 1; i <= retries; ++i) {
-        requestPositionExtended();
+    // the verify reads only tell if the update is early or late, so step the phase
+    // and integrate the steps into the period to follow a camera clock that is a bit off
+    const long correction = late ? (long)phaseStep : -(long)phaseStep;
 
-        // switch to other buffer for next read
-        index ^= 1;
+    // move the estimate forward by whole periods to the most recent update to keep the maths in range,
+    // micros() is 32 bits so the difference is too, an estimate already after the read doesn't move
+    const int32_t since = (int32_t)((uint32_t)readStart - (uint32_t)phaseUpdateTime);
+    uint32_t advance = 0;
+    if(since > 0) {
+        advance = (uint32_t)since - ((DFRIRphaseRemainderQ4((uint32_t)since, phasePeriodQ4) + 15) >> 4);
+    }
+    phaseUpdateTime = (uint32_t)(phaseUpdateTime + advance + correction);
+    phaseAdjustPeriod((correction * 2) / (long)(DFRIRphase_VerifyInterval + 1));
+    phaseErr += (correction - phaseErr) / 8;
+    phaseUpdated = true;
+}
 
-        if(!readPosition(positionData[index], DFRIRdata_LengthExtended)) {
-            return Error_IICerror;
-        }
+void DFRobotIRPositionEx::phaseAdjustPeriod(long correctionQ4)
+{
+    long periodQ4 = (long)phasePeriodQ4 + correctionQ4;
+    const long nominalQ4 = (long)(phaseNominal << 4);
+    // the camera clock shouldn't be off by more than ~6%
+    periodQ4 = constrain(periodQ4, nominalQ4 - (nominalQ4 >> 4), nominalQ4 + (nominalQ4 >> 4));
+    phasePeriodQ4 = (unsigned long)periodQ4;
+}
 
-        // compare but ignore the header byte
-        if(!memcmp(&positionData[0].receivedBuffer[1], &positionData[1].receivedBuffer[1], DFRIRdata_LengthExtended - 1)) {
-            // position data is identical so unpack the data
-            unpackExtendedFrameSeen(index);
-            return Error_Success;
-        }
+unsigned long DFRobotIRPositionEx::phaseSamplePeriod() const
+{
+    const unsigned long period = phasePeriod();
+    if(phaseMode == PhaseState_Locked) {
+        return period;
     }
+    // sweep the sample time across the camera period by about the length of a compared read each frame
+    return period - (period >> 5);
+}
 
-    if(retry & 1) {
-        unpackExtendedFrameSeen(index);
-        return Error_SuccessMismatch;
+unsigned long DFRobotIRPositionEx::phaseSampleDelay(unsigned long now) const
+{
+    // normally sample just after the camera update, but the compared verify reads
+    // must end at the expected update to check if it is early or late
+    uint32_t sampleTime = phaseUpdateTime + phaseMargin;
+    if(phaseMode == PhaseState_Locked && !phaseVerify) {
+        sampleTime = phaseUpdateTime - 2 * readDuration;
     }
 
-    return Error_DataMismatch;
+    // micros() is 32 bits so the time since the sample time is too, it can be many periods
+    const int32_t since = (int32_t)((uint32_t)now - sampleTime);
+    if(since < 0) {
+        return DFRIRphaseRemainderQ4((uint32_t)-since, phasePeriodQ4) >> 4;
+    }
+    return (phasePeriodQ4 - DFRIRphaseRemainderQ4((uint32_t)since, phasePeriodQ4)) >> 4;
 }
@@ -8,6 +8,7 @@
  * - Added functions to atomically read the position data
  * - Added sensitivity settings
  * - Added IIC clock setting, appears to work up to 1MHz
+ * - Added full data format with intensity and bounding box
  *
  * @copyright [DFRobot](http://www.dfrobot.com), 2016
  * @copyright Mike Lynch, 2021
@@ -31,6 +32,33 @@ class TwoWire;
 *  @brief DFRobot IR positioning camera with extended functionality.
 */
 class DFRobotIRPositionEx {
+public:
+    /*!
+    * @brief Number of buckets in the atomic read time histogram.
+    */
+    static constexpr unsigned int TelemetryHistSize = 8;
+
+    /*!
+    * @brief IIC transaction telemetry counters.
+    */
+    typedef struct Telemetry_s {
+        uint32_t atomicReads;       ///< atomic reads completed
+        uint32_t reads;             ///< position reads issued, including compare reads
+        uint32_t retries;           ///< compare reads after the first compare read
+        uint32_t mismatchUsed;      ///< atomic reads that returned Error_SuccessMismatch
+        uint32_t mismatchErrors;    ///< atomic reads that returned Error_DataMismatch
+        uint32_t iicErrors;         ///< atomic reads that returned Error_IICerror
+        uint32_t shortReads;        ///< reads with the wrong length that were flushed
+        uint32_t nacks;             ///< register writes that were not acknowledged
+        uint32_t bytes;             ///< bytes transferred, both directions
+        uint32_t latencyMax;        ///< longest atomic read in microseconds
+        uint32_t recoveries;        ///< bus recoveries that restarted the camera
+        uint32_t recoveryMax;       ///< longest bus recovery in microseconds
+        uint32_t recoverySteps;     ///< atomic reads that returned Error_Recovering, one recovery step each
+        uint32_t latencyHist[TelemetryHistSize]; ///< atomic read time histogram, bucket n is up to 128us << n, the last bucket is everything longer
+    } Telemetry_t;
+
+private:
     const int IRAddress = 0xB0 >> 1; ///< IIC address of the sensor
 
     /*!
@@ -72,12 +100,13 @@ class DFRobotIRPositionEx {
     * @brief Position data structure to be filled from IIC data.
     */
     typedef union PositionData_u {
-        uint8_t receivedBuffer[13]; ///< received buffer for IIC read
+        uint8_t receivedBuffer[37]; ///< received buffer for IIC read
         struct {
             uint8_t header;
             union {
                 ExtendedFrame_t rawExtended[4]; ///< 4 raw extended positions/frames.
                 BasicFrame_t rawBasic[2];       ///< 2 raw basic frames.
+                FullFrame_t rawFull[4];         ///< 4 raw full positions/frames.
             } __attribute__ ((packed)) format;
         } __attribute__ ((packed)) frame;
     }__attribute__ ((packed)) PositionData_t;  
@@ -87,14 +116,119 @@ class DFRobotIRPositionEx {
     *
     * @param first the first byte
     * @param second the second byte
+    * @return True if the sensor acknowledged the write.
+    */
+    bool writeTwoIICByte(uint8_t first, uint8_t second);
+
+    /*!
+    * @brief Write a block of consecutive registers in one IIC transaction.
+    *
+    * @param reg the first register
+    * @param data the register values
+    * @param length number of registers
+    * @return True if the sensor acknowledged the write.
+    */
+    bool writeIICBlock(uint8_t reg, const uint8_t* data, unsigned int length);
+
+    /*!
+    * @brief Check if the settle time after the last configuration write has passed.
     */
-    void writeTwoIICByte(uint8_t first, uint8_t second);
+    bool configSettled() const;
+
+    /*!
+    * @brief Perform a configuration register write, retrying while the sensor doesn't acknowledge.
+    * @details The write waits for the settle time after the last configuration write.
+    *
+    * @param step A value from ConfigState_e.
+    * @param timeoutUs Time to retry the write for in microseconds, 0 for a single attempt
+    * that fails without writing if the settle time hasn't passed.
+    * @return True if the sensor acknowledged the write.
+    */
+    bool writeConfig(unsigned int step, unsigned long timeoutUs);
+
+    /*!
+    * @brief Start the configuration sequence from the stop step with the current settings.
+    */
+    void startConfig();
+
+    /*!
+    * @brief Initialize IIC at the configured clock rate.
+    */
+    void beginWire();
+
+    /*!
+    * @brief Release a stuck bus by clocking SCL until SDA is released, then send a STOP and restart IIC.
+    */
+    void busClear();
+
+    /*!
+    * @brief Perform the next step of the bus recovery.
+    * @return True if the camera is running again.
+    */
+    bool pollRecovery();
+
+    /*!
+    * @brief Complete the configuration sequence with the given error code.
+    * @return Always true.
+    */
+    bool finishConfig(int error);
 
     /*!
     * @brief Request the position data. IIC will block the progress until all the data is recevied.
     */
     bool readPosition(PositionData_t& posData, unsigned int length);
 
+    /*!
+    * @brief Request a given number of position data bytes.
+    * @details Only the first chunk is requested if the length doesn't fit the Wire buffer,
+    * readPosition() requests the remaining chunks.
+    * @param length Total number of bytes.
+    * @param offset Offset of the first byte from the start of the position data.
+    */
+    void requestPosition(unsigned int length, unsigned int offset = 0);
+
+    /*!
+    * @brief Complete the split-phase read with the given error code and call the callback.
+    * @return Always true.
+    */
+    bool finishAtomic(int error);
+
+    /*!
+    * @brief Update the phase tracking from a detected camera update.
+    * @param updateTime micros() value of the detected camera update.
+    */
+    void phaseEvent(unsigned long updateTime);
+
+    /*!
+    * @brief Estimate the camera update time from a compared read that saw the update.
+    * @param windowStart micros() value at the start of the previous read.
+    * @param windowEnd micros() value at the end of the read that saw the update.
+    */
+    void phaseDetect(unsigned long windowStart, unsigned long windowEnd);
+
+    /*!
+    * @brief Step the phase estimate after a verify read when locked.
+    * @param late True if the camera update is later than the estimate.
+    */
+    void phaseNudge(bool late);
+
+    /*!
+    * @brief Adjust the period estimate, limited to a range around the nominal period.
+    * @param correctionQ4 Period correction in 1/16 microseconds.
+    */
+    void phaseAdjustPeriod(long correctionQ4);
+
+    /*!
+    * @brief Fill the sensitivity blocks from a sensitivity level.
+    * @param sensitivity A value from Sensitivity_e.
+    */
+    void sensitivityPreset(unsigned int sensitivity);
+
+    /*!
+    * @brief Update the auto-exposure from the last unpacked frame.
+    */
+    void exposureUpdate();
+
     /*!
     * @brief Unconditionally unpack basic frame from positionData. Does not update seen flags.
     */
@@ -105,6 +239,11 @@ class DFRobotIRPositionEx {
     */
    void unpackExtendedFrame(unsigned int posData);
 
+    /*!
+    * @brief Unconditionally unpack full frame from positionData. Does not update seen flags.
+    */
+   void unpackFullFrame(unsigned int posData);
+
     /*!
     * @brief Unpack basic frame from positionData and update position if seen. Seen flags are updated.
     */
@@ -115,6 +254,11 @@ class DFRobotIRPositionEx {
     */
    void unpackExtendedFrameSeen(unsigned int posData);
 
+    /*!
+    * @brief Unpack full frame from positionData and update position if seen. Seen flags are updated.
+    */
+   void unpackFullFrameSeen(unsigned int posData);
+
     /*!
     * @brief Wire object to use.
     */
@@ -136,15 +280,289 @@ class DFRobotIRPositionEx {
     int positionY[4];
     
     /*!
-    * @brief Unpacked sizes (when extended data format is used).
+    * @brief Unpacked sizes (when extended or full data format is used).
     */
     int unpackedSizes[4];
 
+    /*!
+    * @brief Unpacked intensities (when full data format is used).
+    */
+    int unpackedIntensity[4];
+
+    /*!
+    * @brief Unpacked bounding box minimum and maximum (when full data format is used).
+    */
+    int unpackedBoxMinX[4];
+    int unpackedBoxMinY[4];
+    int unpackedBoxMaxX[4];
+    int unpackedBoxMaxY[4];
+
     /*!
     * @brief Bit mask of seen positions.
     */
     unsigned int seenFlags;
 
+    /*!
+    * @brief Split-phase read state, see ReadState_e.
+    */
+    uint8_t readState;
+
+    /*!
+    * @brief Data format of the split-phase read.
+    */
+    uint8_t readFormat;
+
+    /*!
+    * @brief Retry option of the split-phase read.
+    */
+    uint8_t readRetry;
+
+    /*!
+    * @brief Number of compare reads completed for the split-phase read.
+    */
+    uint8_t readAttempt;
+
+    /*!
+    * @brief positionData index of the last split-phase read.
+    */
+    unsigned int readIndex;
+
+    /*!
+    * @brief Result of the last split-phase read.
+    */
+    int readError;
+
+    /*!
+    * @brief Split-phase read completion callback.
+    */
+    void (*readCallback)(DFRobotIRPositionEx& camera, int error, void* context);
+
+    /*!
+    * @brief Context pointer passed to the split-phase read callback.
+    */
+    void* readCallbackContext;
+
+    /*!
+    * @brief Configuration sequence state, see ConfigState_e.
+    */
+    uint8_t configState;
+
+    /*!
+    * @brief Data format for the configuration sequence.
+    */
+    uint8_t configFormat;
+
+    /*!
+    * @brief Bit mask of configuration steps waiting to be written, bit n is ConfigState_e value n.
+    */
+    uint8_t configPendingMask;
+
+    /*!
+    * @brief Custom sensitivity block 1, registers 0x00 to 0x08.
+    */
+    uint8_t sensBlock1[9];
+
+    /*!
+    * @brief Custom sensitivity block 2, registers 0x1A and 0x1B.
+    */
+    uint8_t sensBlock2[2];
+
+    /*!
+    * @brief True if the custom sensitivity blocks are used instead of the sensitivity level.
+    */
+    bool sensCustom;
+
+    /*!
+    * @brief True if auto-exposure is enabled.
+    */
+    bool aeEnabled;
+
+    /*!
+    * @brief Frames accumulated for the next auto-exposure update.
+    */
+    uint8_t aeFrames;
+
+    /*!
+    * @brief Sum of seen points over the accumulated frames.
+    */
+    uint16_t aeSeenSum;
+
+    /*!
+    * @brief Sum of seen point sizes over the accumulated frames.
+    */
+    uint16_t aeSizeSum;
+
+    /*!
+    * @brief micros() value at the start of the current configuration step, after the settle time.
+    */
+    unsigned long configStepStart;
+
+    /*!
+    * @brief micros() value of the last acknowledged configuration write.
+    */
+    unsigned long configWriteTime;
+
+    /*!
+    * @brief micros() value when the configuration sequence started.
+    */
+    unsigned long configStart;
+
+    /*!
+    * @brief Microseconds from the start of the configuration sequence to the first valid frame.
+    */
+    unsigned long configDuration;
+
+    /*!
+    * @brief Result of the configuration sequence.
+    */
+    int configError;
+
+    /*!
+    * @brief IIC clock rate.
+    */
+    uint32_t iicClock;
+
+    /*!
+    * @brief True if the bus recovery is enabled.
+    */
+    bool recoverEnabled;
+
+    /*!
+    * @brief True while the bus recovery is in progress.
+    */
+    bool recoverActive;
+
+    /*!
+    * @brief Consecutive atomic reads that returned Error_IICerror.
+    */
+    uint8_t recoverErrors;
+
+    /*!
+    * @brief SDA and SCL pins for clearing the bus, -1 if the bus is only restarted.
+    */
+    int recoverSda;
+    int recoverScl;
+
+    /*!
+    * @brief micros() value when the bus recovery started.
+    */
+    unsigned long recoverStart;
+
+    /*!
+    * @brief micros() value when the next recovery attempt is allowed.
+    */
+    unsigned long recoverRetry;
+
+    /*!
+    * @brief Duration of the last bus recovery in microseconds.
+    */
+    unsigned long recoverDuration;
+
+    /*!
+    * @brief micros() value when the last read started.
+    */
+    unsigned long readStart;
+
+    /*!
+    * @brief Duration of the last initial read in microseconds.
+    */
+    unsigned long readDuration;
+
+    /*!
+    * @brief True if the current read detected a data mismatch.
+    */
+    bool readMismatch;
+
+    /*!
+    * @brief Phase tracking state, see PhaseState_e.
+    */
+    uint8_t phaseMode;
+
+    /*!
+    * @brief Consecutive camera updates detected inside the lock window.
+    */
+    uint8_t phaseLockCount;
+
+    /*!
+    * @brief Single reads remaining until the next verify read when locked.
+    */
+    uint8_t phaseVerify;
+
+    /*!
+    * @brief Consecutive verify reads that did not see the camera update.
+    */
+    uint8_t phaseMissed;
+
+    /*!
+    * @brief Direction of the last verify read correction, 1 for late and -1 for early.
+    */
+    int8_t phaseDir;
+
+    /*!
+    * @brief Verify read correction step in microseconds.
+    */
+    uint16_t phaseStep;
+
+    /*!
+    * @brief True if the phase estimate changed since the last phaseChanged() call.
+    */
+    bool phaseUpdated;
+
+    /*!
+    * @brief True once a camera update time has been detected.
+    */
+    bool phaseValid;
+
+    /*!
+    * @brief Delay after the camera update to sample in microseconds.
+    */
+    unsigned int phaseMargin;
+
+    /*!
+    * @brief Nominal camera update period in microseconds.
+    */
+    unsigned long phaseNominal;
+
+    /*!
+    * @brief Estimated camera update period in 1/16 microseconds.
+    */
+    unsigned long phasePeriodQ4;
+
+    /*!
+    * @brief Estimated micros() value of a camera update.
+    */
+    unsigned long phaseUpdateTime;
+
+    /*!
+    * @brief micros() value at the start of the last read while tracking.
+    */
+    unsigned long phaseSampleStart;
+
+    /*!
+    * @brief The last read while tracking saw the camera update.
+    */
+    bool phaseSampleSeen;
+
+    /*!
+    * @brief Phase error in microseconds.
+    */
+    long phaseErr;
+
+    /*!
+    * @brief Moving average of reads with a data mismatch, 65535 is every read.
+    */
+    uint16_t mismatchAvg;
+
+    /*!
+    * @brief micros() value when the atomic read started.
+    */
+    unsigned long atomicStart;
+
+    /*!
+    * @brief Telemetry counters.
+    */
+    Telemetry_t counters;
+
 public:
   
     /*!
@@ -152,8 +570,8 @@ public:
     */
     enum DataFormat_e {
         DataFormat_Basic = 0,       ///< Basic data format.
-        DataFormat_Extended = 1     ///< Extended data format that includes sizes.
-        //DataFormat_Full = 3       ///< Full data format
+        DataFormat_Extended = 1,    ///< Extended data format that includes sizes.
+        DataFormat_Full = 3         ///< Full data format that includes sizes, intensity and bounding box.
     };
 
     /*!
@@ -176,6 +594,8 @@ public:
         Error_Success = 0,        ///< Success
         Error_IICerror = -1,      ///< IIC error
         Error_DataMismatch = -2,  ///< Data mismatch
+        Error_Timeout = -3,       ///< Camera didn't return a valid frame in time
+        Error_Recovering = -4,    ///< Bus recovery step done, no position data until the camera is running again
     };
 
     /*!
@@ -192,6 +612,49 @@ public:
         Retry_2s = 5    ///< 2 retries, if mismatch then use last frame and return Error_SuccessMismatch
     };
     
+    /*!
+    * @brief Split-phase atomic read state.
+    */
+    enum ReadState_e {
+        ReadState_Idle = 0,     ///< No read started
+        ReadState_First = 1,    ///< Next transaction is the initial read
+        ReadState_Compare = 2,  ///< Next transaction is a read to compare with the previous read
+        ReadState_Done = 3,     ///< Read complete, result available from atomicResult()
+        ReadState_Config = 4,   ///< Next transaction is a queued configuration write
+        ReadState_Recover = 5   ///< Next transaction is a bus recovery step
+    };
+
+    /*!
+    * @brief Configuration sequence state.
+    */
+    enum ConfigState_e {
+        ConfigState_Idle = 0,           ///< No configuration started
+        ConfigState_Stop = 1,           ///< Next step stops the camera
+        ConfigState_Sensitivity = 2,    ///< Next step writes the sensitivity block at 0x06
+        ConfigState_Sensitivity2 = 3,   ///< Next step writes the sensitivity block at 0x1A
+        ConfigState_Mode = 4,           ///< Next step writes the data format
+        ConfigState_Start = 5,          ///< Next step starts the camera
+        ConfigState_Ready = 6,          ///< Polling for the first valid frame
+        ConfigState_Done = 7            ///< Configuration complete, result available from configResult()
+    };
+
+    /*!
+    * @brief Phase tracking state.
+    */
+    enum PhaseState_e {
+        PhaseState_Off = 0,         ///< Phase tracking disabled
+        PhaseState_Tracking = 1,    ///< Learning the camera update period and phase, every read is compared
+        PhaseState_Locked = 2       ///< Locked to the camera update, one read per frame with a periodic verify read
+    };
+
+    /*!
+    * @brief Split-phase read completion callback.
+    * @param camera The camera that completed the read.
+    * @param error An error code from Errors_e.
+    * @param context Context pointer given to atomicCallback().
+    */
+    typedef void (*ReadCallback_t)(DFRobotIRPositionEx& camera, int error, void* context);
+
     /*!
     * @brief Constructor
     */
@@ -201,22 +664,141 @@ public:
     * @brief Destructor
     */
     ~DFRobotIRPositionEx();
+
+    /*!
+    * @brief Unpack basic format position data, keeping the previous position of a point that isn't seen.
+    * @details A point that isn't seen reads as all 1s, with Y over the maximum of 767.
+    * @param[in] data The 10 bytes of data after the header byte.
+    * @param[in,out] x 4 X positions.
+    * @param[in,out] y 4 Y positions.
+    * @return Seen flags, bit n is set if point n was seen.
+    */
+    static unsigned int unpackBasicSeen(const uint8_t* data, int* x, int* y);
+
+    /*!
+    * @brief Unpack extended format position data, keeping the previous position and size of a point that isn't seen.
+    * @details Same as unpackBasicSeen() for the extended format.
+    * @param[in] data The 12 bytes of data after the header byte.
+    * @param[in,out] x 4 X positions.
+    * @param[in,out] y 4 Y positions.
+    * @param[in,out] sizes 4 sizes.
+    * @return Seen flags, bit n is set if point n was seen.
+    */
+    static unsigned int unpackExtendedSeen(const uint8_t* data, int* x, int* y, int* sizes);
   
     /*!
     * @brief Initialize the sensor.
+    * @details Blocks until the configuration sequence completes, see beginConfig().
     * @param[in] clock IIC clock rate. Defaults to 400kHz. Works up to at least 1MHz.
     * @param[in] format Initial data format. Defaults to basic.
     * @param[in] sensitivity Initial camera sensitivity.
     */
     void begin(uint32_t clock = 400000, DataFormat_e format = DataFormat_Basic, Sensitivity_e sensitivity = Sensitivity_Default);
 
+    /*!
+    * @brief Initialize IIC and start the configuration sequence without blocking.
+    * @details Each pollConfig() call performs one step of the sequence. Each register write waits a
+    * settle time after the last one without blocking, and is retried while the sensor doesn't acknowledge,
+    * then the position data is polled until the camera returns a valid frame.
+    * @param[in] clock IIC clock rate. Defaults to 400kHz. Works up to at least 1MHz.
+    * @param[in] format Initial data format. Defaults to basic.
+    * @param[in] sensitivity Initial camera sensitivity.
+    */
+    void beginConfig(uint32_t clock = 400000, DataFormat_e format = DataFormat_Basic, Sensitivity_e sensitivity = Sensitivity_Default);
+
+    /*!
+    * @brief Perform the next step of the configuration sequence.
+    * @return True if the configuration is complete.
+    */
+    bool pollConfig();
+
+    /*!
+    * @brief Check if the configuration sequence is in progress.
+    */
+    bool configBusy() const { return configState != ConfigState_Idle && configState != ConfigState_Done; }
+
+    /*!
+    * @brief Get the result of the configuration sequence.
+    * @return An error code from Errors_e.
+    */
+    int configResult() const { return configError; }
+
+    /*!
+    * @brief Get the time the camera took to start.
+    * @return Microseconds from the start of the configuration sequence to the first valid frame.
+    */
+    unsigned long configTime() const { return configDuration; }
+
+    /*!
+    * @brief Queue a sensitivity change instead of writing it immediately.
+    * @details The registers are written one per pollPending() call. Each split-phase read does one
+    * queued write before the position read, so a change is spread over the following camera ticks.
+    * Queuing again before the writes complete only writes the last value.
+    */
+    void queueSensitivity(Sensitivity_e sensitivity);
+
+    /*!
+    * @brief Set custom sensitivity blocks.
+    * @details See http://wiibrew.org/wiki/Wiimote#IR_Camera for the register meanings. Block 1 is
+    * registers 0x00 to 0x08 where 0x06 is the maximum blob size and 0x08 is the gain (smaller is more gain).
+    * Block 2 is registers 0x1A and 0x1B, the gain limit (must be less than the gain) and the minimum blob size.
+    * @param[in] block1 9 bytes for block 1.
+    * @param[in] block2 2 bytes for block 2.
+    */
+    void sensitivityBlocks(const uint8_t* block1, const uint8_t* block2);
+
+    /*!
+    * @brief Queue custom sensitivity blocks instead of writing them immediately.
+    * @details Same as queueSensitivity() but with custom blocks, see sensitivityBlocks().
+    * @param[in] block1 9 bytes for block 1.
+    * @param[in] block2 2 bytes for block 2.
+    */
+    void queueSensitivityBlocks(const uint8_t* block1, const uint8_t* block2);
+
+    /*!
+    * @brief Enable or disable auto-exposure.
+    * @details Auto-exposure adjusts the gain in the sensitivity blocks from the blob sizes, so it requires
+    * the Extended or Full data format and the split-phase or atomic reads. The gain is increased while
+    * some points are missing and the seen points are small, and decreased while the blobs are large.
+    * Changes are queued, see queueSensitivity(). The current sensitivity is the starting point, with a
+    * sensitivity level only the gain registers are written, with custom blocks the whole blocks are written.
+    * @param[in] enable True to enable auto-exposure.
+    */
+    void autoExposure(bool enable);
+
+    /*!
+    * @brief Check if auto-exposure is enabled.
+    */
+    bool autoExposureEnabled() const { return aeEnabled; }
+
+    /*!
+    * @brief Get the current gain register value (smaller is more gain).
+    */
+    unsigned int exposureGain() const { return sensBlock1[8]; }
+
+    /*!
+    * @brief Check if there are queued configuration writes.
+    */
+    bool configPending() const { return configPendingMask != 0; }
+
+    /*!
+    * @brief Perform the next queued configuration write.
+    * @details A write that isn't acknowledged stays queued and is retried on the next call.
+    * Nothing is written until the settle time after the last configuration write has passed,
+    * so the camera isn't relied on to refuse writes while it latches the last one.
+    * @return True if a write was performed.
+    */
+    bool pollPending();
+
     /*!
     * @brief Set the data format.
+    * @details Blocks only while the write is retried.
     */
     void dataFormat(DataFormat_e format);
 
     /*!
     * @brief Set the sensitivity.
+    * @details The registers are written in bursts and blocks only while the writes are retried.
     */
     void sensitivityLevel(Sensitivity_e sensitivity);
 
@@ -232,6 +814,12 @@ public:
     */
     void requestPositionBasic();
 
+    /*!
+    * @brief Request the full position data that includes sizes, intensity and bounding box.
+    * @details You must set the format to DataFormat_Full.
+    */
+    void requestPositionFull();
+
     /*!
     * @brief After requesting the extended position, and the data read from the sensor is ready, True will be returned.
     *
@@ -270,6 +858,27 @@ public:
     */
     bool availableBasicNoSeen();
 
+    /*!
+    * @brief After requesting the full position, and the data read from the sensor is ready, True will be returned.
+    * @details The data doesn't fit the Wire buffer on some boards, then the rest of the data is requested
+    * and read in chunks.
+    *
+    * @return Whether data reading is ready.
+    * @retval true Is ready
+    * @retval false Is not ready
+    */
+    bool availableFull();
+
+    /*!
+    * @brief Same as availableFull() but uncondionally unpacks the positions and doesn't update the seen flags.
+    * @details Useful if you want the unpacked data for analysis.
+    *
+    * @return Whether data reading is ready.
+    * @retval true Is ready
+    * @retval false Is not ready
+    */
+    bool availableFullNoSeen();
+
     /*!
     * @brief Atomically update basic position data.
     * @details Since there is no aparent signalling to synchronize the read when the position updates,
@@ -290,6 +899,158 @@ public:
     */
     int extendedAtomic(DFRobotIRPositionEx::Retry_e retries = DFRobotIRPositionEx::Retry_1s);
 
+    /*!
+    * @brief Atomically update full position data that includes the size, intensity and bounding box.
+    * @details Same workaround as extendedAtomic(). Each read may be split into chunks to fit the Wire buffer.
+    * @param[in] retries Number of extra times to retry getting and matching the position.
+    * @return An error code from Errors_e. 
+    */
+    int fullAtomic(DFRobotIRPositionEx::Retry_e retries = DFRobotIRPositionEx::Retry_1s);
+
+    /*!
+    * @brief Start a split-phase atomic read.
+    * @details This is the same workaround as basicAtomic() and extendedAtomic() except that each
+    * call to pollAtomic() performs only one IIC transaction. Other work can be done between
+    * transactions instead of blocking for all of the reads. Any read already in progress is abandoned.
+    * A full data format read that is split into chunks is done in a single pollAtomic() call.
+    * @param[in] format Data format to read, must match the format set in the camera.
+    * @param[in] retry Number of extra times to retry getting and matching the position.
+    */
+    void startAtomic(DataFormat_e format, DFRobotIRPositionEx::Retry_e retry = DFRobotIRPositionEx::Retry_1s);
+
+    /*!
+    * @brief Perform the next IIC transaction of a split-phase read.
+    * @details A queued configuration write is performed before the initial read, see queueSensitivity().
+    * When the read completes the positions are unpacked, the callback is called (if set),
+    * and the result is available from atomicResult().
+    * @return True if the read completed with this call.
+    */
+    bool pollAtomic();
+
+    /*!
+    * @brief Check if a split-phase read is in progress.
+    */
+    bool atomicBusy() const { return readState != ReadState_Idle && readState != ReadState_Done; }
+
+    /*!
+    * @brief Get the split-phase read state.
+    * @return A value from ReadState_e.
+    */
+    unsigned int atomicState() const { return readState; }
+
+    /*!
+    * @brief Get the result of the last completed split-phase read.
+    * @return An error code from Errors_e.
+    */
+    int atomicResult() const { return readError; }
+
+    /*!
+    * @brief Set a callback for when a split-phase read completes.
+    * @param[in] callback Callback function, or NULL to disable.
+    * @param[in] context Context pointer passed to the callback.
+    */
+    void atomicCallback(ReadCallback_t callback, void* context = 0) { readCallback = callback; readCallbackContext = context; }
+
+    /*!
+    * @brief Enable or disable the automatic bus recovery.
+    * @details After a few consecutive split-phase or atomic reads fail, or the camera returns the blank
+    * data of a camera that was reset (for example a brown out), the bus is cleared and the configuration
+    * sequence runs again with the current settings. Each read during the recovery performs one step and
+    * returns Error_Recovering until the camera is running again, so the recovery doesn't block the loop.
+    * The steps count in the recoverySteps telemetry, not iicErrors.
+    * A failed attempt is retried after a short wait so a disconnected camera doesn't keep the bus busy.
+    * If the pins are given, SCL is clocked until a device holding SDA low releases it. Otherwise only
+    * IIC is restarted.
+    * @param[in] enable True to enable the bus recovery.
+    * @param[in] sdaPin SDA pin of the IIC bus, or -1.
+    * @param[in] sclPin SCL pin of the IIC bus, or -1.
+    */
+    void autoRecover(bool enable, int sdaPin = -1, int sclPin = -1);
+
+    /*!
+    * @brief Check if the bus recovery is in progress.
+    */
+    bool recovering() const { return recoverActive; }
+
+    /*!
+    * @brief Get the duration of the last bus recovery in microseconds.
+    */
+    unsigned long recoveryTime() const { return recoverDuration; }
+
+    /*!
+    * @brief Enable or disable phase tracking.
+    * @details The camera updates the position data at its own rate (~209Hz) and the atomic read workaround
+    * is required because the data can update during a read. Phase tracking learns the camera update
+    * period and phase from the times the compared reads mismatch. While tracking, only the sample timer period
+    * should change to phaseSamplePeriod() so the sample time keeps sweeping across the camera update.
+    * Once locked, the sample timer should be restarted using phaseSamplePeriod() and phaseSampleDelay()
+    * so the camera is read just after it updates.
+    * Then the split-phase reads use a single read per frame, with a compared read every few frames
+    * to detect drift. Tracking drops back to compared reads if the camera update drifts from the estimate.
+    * @param[in] enable True to enable phase tracking.
+    * @param[in] periodUs Nominal camera update period in microseconds.
+    * @param[in] marginUs Time after the camera update to sample in microseconds.
+    */
+    void phaseLock(bool enable, unsigned long periodUs = 1000000UL / 209, unsigned int marginUs = 150);
+
+    /*!
+    * @brief Get the phase tracking state.
+    * @return A value from PhaseState_e.
+    */
+    unsigned int phaseState() const { return phaseMode; }
+
+    /*!
+    * @brief Get the estimated camera update period in microseconds.
+    */
+    unsigned long phasePeriod() const { return (phasePeriodQ4 + 8) >> 4; }
+
+    /*!
+    * @brief Get the phase error in microseconds.
+    * @details While tracking this is the difference between the last detected camera update and the
+    * estimated update time. When locked this is the average of the corrections from the verify reads,
+    * which stays near 0 while the lock is good.
+    */
+    long phaseError() const { return phaseErr; }
+
+    /*!
+    * @brief Get the rate of compared reads with a data mismatch.
+    * @return Moving average where 0 is none and 65535 is every read.
+    */
+    unsigned int mismatchRate() const { return mismatchAvg; }
+
+    /*!
+    * @brief Get a snapshot of the telemetry counters.
+    * @details The counters are a few adds per frame. Built with DFROBOT_IR_TELEMETRY=0 they are left out and stay 0.
+    * @param[out] snapshot Copy of the counters.
+    * @param[in] reset True to reset the counters after the copy.
+    */
+    void telemetry(Telemetry_t& snapshot, bool reset = false);
+
+    /*!
+    * @brief Reset the telemetry counters.
+    */
+    void resetTelemetry();
+
+    /*!
+    * @brief Get the period the sample timer should use in microseconds.
+    * @details While tracking this is slightly shorter than the estimated camera period so the
+    * sample time sweeps across the camera update to detect it.
+    */
+    unsigned long phaseSamplePeriod() const;
+
+    /*!
+    * @brief Get the time from now until the next ideal sample time in microseconds.
+    * @details Any time since the last estimate works, the delay is never more than a period.
+    * @param[in] now The current micros() value.
+    */
+    unsigned long phaseSampleDelay(unsigned long now) const;
+
+    /*!
+    * @brief Check if the phase estimate changed since the last call.
+    * @return True if the sample timer should be adjusted.
+    */
+    bool phaseChanged() { bool changed = phaseUpdated; phaseUpdated = false; return changed; }
+
     /*!
     * @brief Get the X position of a point.
     *
@@ -338,6 +1099,58 @@ public:
     */
     const int* sizes() const { return unpackedSizes; }
 
+    /*!
+    * @brief Get the intensity of a point. Must use Full data format.
+    *
+    * @param index The index of the 4 light objects ranging from 0 to 3.
+    *
+    * @return The 8 bit intensity corresponing to the index.
+    */
+    int intensity(int index) const { return unpackedIntensity[index]; }
+
+    /*!
+    * @brief Get the bounding box minimum X of a point. Must use Full data format.
+    *
+    * @param index The index of the 4 light objects ranging from 0 to 3.
+    *
+    * @return The 7 bit bounding box minimum X corresponing to the index.
+    */
+    int boxMinX(int index) const { return unpackedBoxMinX[index]; }
+
+    /*!
+    * @brief Get the bounding box minimum Y of a point. Must use Full data format.
+    *
+    * @param index The index of the 4 light objects ranging from 0 to 3.
+    *
+    * @return The 7 bit bounding box minimum Y corresponing to the index.
+    */
+    int boxMinY(int index) const { return unpackedBoxMinY[index]; }
+
+    /*!
+    * @brief Get the bounding box maximum X of a point. Must use Full data format.
+    *
+    * @param index The index of the 4 light objects ranging from 0 to 3.
+    *
+    * @return The 7 bit bounding box maximum X corresponing to the index.
+    */
+    int boxMaxX(int index) const { return unpackedBoxMaxX[index]; }
+
+    /*!
+    * @brief Get the bounding box maximum Y of a point. Must use Full data format.
+    *
+    * @param index The index of the 4 light objects ranging from 0 to 3.
+    *
+    * @return The 7 bit bounding box maximum Y corresponing to the index.
+    */
+    int boxMaxY(int index) const { return unpackedBoxMaxY[index]; }
+
+    /*!
+    * @brief Get the 4 intensities. Must use Full data format.
+    *
+    * @return Pointer to array of 4 intensities.
+    */
+    const int* intensities() const { return unpackedIntensity; }
+
     /*!
     * @brief Get seen bit mask. Bits 0 through 3 are set to 1 when a position is seen and updated.
     *
@@ -19,6 +19,9 @@
     // use SAMD21 peripherals
     #define SAMCO_SAMD21 1
 
+    // no FPU, use the fixed-point position maths
+    #define SAMCO_POSITION_FIXED 1
+
     // DFRobot IR camera IIC clock
     // even with cheap clips and the full length IR cam cable 1MHz is fine
     #define DFROBOT_IR_IIC_CLOCK 1000000
@@ -49,6 +52,9 @@
     // ATmega32u4
     #define SAMCO_ATMEGA32U4 1
 
+    // no FPU, use the fixed-point position maths
+    #define SAMCO_POSITION_FIXED 1
+
     // AVR has EEPROM
     #define SAMCO_EEPROM_ENABLE 1
 
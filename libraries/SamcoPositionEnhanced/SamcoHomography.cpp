@@ -0,0 +1,178 @@
+/*!
+ * @file SamcoHomography.cpp
+ * @brief Light gun position from the homography of a 4 LED setup
+ * @n CPP file for the homography position engine
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include "SamcoHomography.h"
+
+// smallest determinant for the inverse mapping, anything smaller is a degenerate rectangle
+constexpr float MinDeterminant = 1.0e-6f;
+
+bool SamcoHomography::sortCorners(const float* x, const float* y)
+{
+    // with less than 45 degrees of tilt the corners are the extremes of x + y and x - y
+    int tl = 0, tr = 0, bl = 0, br = 0;
+    for(int i = 1; i < 4; ++i) {
+        if(x[i] + y[i] < x[tl] + y[tl]) {
+            tl = i;
+        }
+        if(x[i] + y[i] > x[br] + y[br]) {
+            br = i;
+        }
+        if(x[i] - y[i] > x[tr] - y[tr]) {
+            tr = i;
+        }
+        if(x[i] - y[i] < x[bl] - y[bl]) {
+            bl = i;
+        }
+    }
+
+    // each point must be a different corner
+    if(((1 << tl) | (1 << tr) | (1 << bl) | (1 << br)) != 0x0F) {
+        return false;
+    }
+
+    cornerX[0] = x[tl];
+    cornerY[0] = y[tl];
+    cornerX[1] = x[tr];
+    cornerY[1] = y[tr];
+    cornerX[2] = x[bl];
+    cornerY[2] = y[bl];
+    cornerX[3] = x[br];
+    cornerY[3] = y[br];
+    return true;
+}
+
+void SamcoHomography::trackCorners(const float* x, const float* y, unsigned int count)
+{
+    // each seen point moves the nearest corner that isn't taken
+    unsigned int taken = 0;
+    float dx = 0.0f;
+    float dy = 0.0f;
+    for(unsigned int i = 0; i < count; ++i) {
+        int nearest = -1;
+        float nearestDist = 0.0f;
+        for(int c = 0; c < 4; ++c) {
+            if(taken & (1 << c)) {
+                continue;
+            }
+            const float dist = (x[i] - cornerX[c]) * (x[i] - cornerX[c]) + (y[i] - cornerY[c]) * (y[i] - cornerY[c]);
+            if(nearest < 0 || dist < nearestDist) {
+                nearest = c;
+                nearestDist = dist;
+            }
+        }
+        taken |= 1 << nearest;
+        dx += x[i] - cornerX[nearest];
+        dy += y[i] - cornerY[nearest];
+        cornerX[nearest] = x[i];
+        cornerY[nearest] = y[i];
+    }
+
+    // the other corners follow the average motion
+    dx /= count;
+    dy /= count;
+    for(int c = 0; c < 4; ++c) {
+        if(!(taken & (1 << c))) {
+            cornerX[c] += dx;
+            cornerY[c] += dy;
+        }
+    }
+}
+
+void SamcoHomography::begin(const int* px, const int* py, unsigned int seen, int cx, int cy)
+{
+    seenFlags = seen;
+
+    // mouse units with X mirrored, same as SamcoPositionEnhanced
+    float x[4];
+    float y[4];
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < 4; ++i) {
+        if(seen & (1 << i)) {
+            x[count] = MouseMaxX - (px[i] << CamToMouseShift);
+            y[count] = py[i] << CamToMouseShift;
+            ++count;
+        }
+    }
+
+    // wait for all positions to be recognised before starting
+    if(count == 4) {
+        if(sortCorners(x, y)) {
+            start = true;
+        } else if(start) {
+            trackCorners(x, y, count);
+        } else {
+            return;
+        }
+    } else if(count && start) {
+        trackCorners(x, y, count);
+    } else {
+        return;
+    }
+
+    // closed-form homography from the unit square to the corners, see Heckbert's
+    // "Fundamentals of Texture Mapping and Image Warping", square (0,0) (1,0) (1,1) (0,1)
+    // maps to top left, top right, bottom right, bottom left
+    const float x0 = cornerX[0], y0 = cornerY[0];
+    const float x1 = cornerX[1], y1 = cornerY[1];
+    const float x2 = cornerX[3], y2 = cornerY[3];
+    const float x3 = cornerX[2], y3 = cornerY[2];
+    const float sx = x0 - x1 + x2 - x3;
+    const float sy = y0 - y1 + y2 - y3;
+    float a, b, d, e, g, k;
+    if(sx == 0.0f && sy == 0.0f) {
+        // parallelogram, the mapping is affine
+        a = x1 - x0;
+        b = x2 - x1;
+        d = y1 - y0;
+        e = y2 - y1;
+        g = 0.0f;
+        k = 0.0f;
+    } else {
+        const float dx1 = x1 - x2;
+        const float dx2 = x3 - x2;
+        const float dy1 = y1 - y2;
+        const float dy2 = y3 - y2;
+        const float den = dx1 * dy2 - dx2 * dy1;
+        if(den == 0.0f) {
+            return;
+        }
+        g = (sx * dy2 - dx2 * sy) / den;
+        k = (dx1 * sy - sx * dy1) / den;
+        a = x1 - x0 + g * x1;
+        b = x3 - x0 + k * x3;
+        d = y1 - y0 + g * y1;
+        e = y3 - y0 + k * y3;
+    }
+
+    // map the camera center back to the unit square, solving the 2x2 system from
+    // X = (a u + b v + x0) / (g u + k v + 1) and Y = (d u + e v + y0) / (g u + k v + 1)
+    const float m00 = a - g * cx;
+    const float m01 = b - k * cx;
+    const float m10 = d - g * cy;
+    const float m11 = e - k * cy;
+    const float r0 = cx - x0;
+    const float r1 = cy - y0;
+    const float det = m00 * m11 - m01 * m10;
+    if(fabs(det) < MinDeterminant) {
+        return;
+    }
+    const float u = (r0 * m11 - m01 * r1) / det;
+    const float v = (m00 * r1 - r0 * m10) / det;
+
+    // scale by the apparent size like the median offset of SamcoPositionEnhanced
+    const float width = (hypot(cornerX[1] - cornerX[0], cornerY[1] - cornerY[0]) + hypot(cornerX[3] - cornerX[2], cornerY[3] - cornerY[2])) / 2.0f;
+    height = (hypot(cornerX[2] - cornerX[0], cornerY[2] - cornerY[0]) + hypot(cornerX[3] - cornerX[1], cornerY[3] - cornerY[1])) / 2.0f;
+    xx = cx + round((0.5f - u) * width);
+    yy = cy + round((0.5f - v) * height);
+}
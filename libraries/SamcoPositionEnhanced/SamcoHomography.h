@@ -0,0 +1,76 @@
+/*!
+ * @file SamcoHomography.h
+ * @brief Light gun position from the homography of a 4 LED setup
+ * @n Header file for the homography position engine
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SamcoHomography_h_
+#define _SamcoHomography_h_
+
+#include <stdint.h>
+#include "SamcoConst.h"
+
+/*!
+ * @brief Position engine that maps the camera center through the homography of the LED rectangle.
+ * @details The 4 camera points are the corners of a rectangle seen in perspective. The closed-form
+ * unit square to quadrilateral homography is solved for the corners, then the camera center is mapped
+ * back through it to get the aim point as a fraction of the LED rectangle. Unlike the median and tilt
+ * angle of SamcoPositionEnhanced, perspective and off-axis distortion are corrected.
+ * The result uses the same units and orientation as SamcoPositionEnhanced so the calibration applies
+ * to either engine. Points that are not seen follow the motion of the seen points.
+ */
+class SamcoHomography {
+    /// @brief Corner positions, top left, top right, bottom left, bottom right
+    float cornerX[4];
+    float cornerY[4];
+
+    int xx = MouseMaxX / 2;
+    int yy = MouseMaxY / 2;
+    float height = 0.0f;
+
+    unsigned int seenFlags = 0;
+
+    /// @brief True once all 4 points have been seen
+    bool start = false;
+
+    /// @brief Assign the 4 points to the corners.
+    /// @return False if the points are not a rectangle in a usable orientation.
+    bool sortCorners(const float* x, const float* y);
+
+    /// @brief Move the corners to the seen points, the other corners follow the average motion.
+    void trackCorners(const float* x, const float* y, unsigned int count);
+
+public:
+
+    /// @brief Main function to calculate X, Y, and H
+    /// @param px Camera X positions
+    /// @param py Camera Y positions
+    /// @param seen Seen flags from the camera
+    /// @param cx Camera center X in mouse units, this is the point mapped through the homography
+    /// @param cy Camera center Y in mouse units
+    void begin(const int* px, const int* py, unsigned int seen, int cx, int cy);
+
+    int testX(int index) const { return (int)cornerX[index]; }
+    int testY(int index) const { return (int)cornerY[index]; }
+
+    /// @brief X position
+    int x() const { return xx; }
+
+    /// @brief Y position
+    int y() const { return yy; }
+
+    /// @brief Height
+    float h() const { return height; }
+
+    /// @brief Bit mask of positions the camera saw
+    unsigned int seen() const { return seenFlags; }
+};
+
+#endif // _SamcoHomography_h_
@@ -14,189 +14,455 @@
 #include <Arduino.h>
 #include "SamcoPositionEnhanced.h"
 
-constexpr int buff = 50 * CamToMouseMult;
+// tracking is lost when the points average further than this from the prediction, squared camera pixels
+constexpr uint32_t TrackResetCost = 100 * 100;
 
+typedef SamcoPositionEnhanced::Angle_t Angle_t;
+typedef SamcoPositionEnhanced::Dist_t Dist_t;
+
+#ifdef SAMCO_POSITION_FIXED
+// fixed-point maths for boards without an FPU, integer CORDIC for atan2 and hypot and a sine table
+// with all 4 points seen the position is within 1 mouse unit of the floating point maths
+
+// full turn and PI in fixed-point angle units
+constexpr int32_t AngleTurn = 1L << 20;
+constexpr Angle_t fPI = AngleTurn / 2;
+
+// sine table index is the top 7 bits of a quarter turn, the rest is interpolated
+constexpr int SinFracBits = 11;
+
+// quarter wave sine table, 1.0 is 32768
+static const uint16_t SinTable[129] PROGMEM = {
+    0, 402, 804, 1206, 1608, 2009, 2411, 2811,
+    3212, 3612, 4011, 4410, 4808, 5205, 5602, 5998,
+    6393, 6787, 7180, 7571, 7962, 8351, 8740, 9127,
+    9512, 9896, 10279, 10660, 11039, 11417, 11793, 12167,
+    12540, 12910, 13279, 13646, 14010, 14373, 14733, 15091,
+    15447, 15800, 16151, 16500, 16846, 17190, 17531, 17869,
+    18205, 18538, 18868, 19195, 19520, 19841, 20160, 20475,
+    20788, 21097, 21403, 21706, 22006, 22302, 22595, 22884,
+    23170, 23453, 23732, 24008, 24279, 24548, 24812, 25073,
+    25330, 25583, 25833, 26078, 26320, 26557, 26791, 27020,
+    27246, 27467, 27684, 27897, 28106, 28311, 28511, 28707,
+    28899, 29086, 29269, 29448, 29622, 29792, 29957, 30118,
+    30274, 30425, 30572, 30715, 30853, 30986, 31114, 31238,
+    31357, 31471, 31581, 31686, 31786, 31881, 31972, 32058,
+    32138, 32214, 32286, 32352, 32413, 32470, 32522, 32568,
+    32610, 32647, 32679, 32706, 32729, 32746, 32758, 32766,
+    32768
+};
+
+// CORDIC rotation angles atan(2^-i) in fixed-point angle units
+constexpr unsigned int CordicIterations = 18;
+static const int32_t CordicAngle[CordicIterations] PROGMEM = {
+    131072, 77376, 40884, 20753, 10417, 5213, 2607, 1304,
+    652, 326, 163, 81, 41, 20, 10, 5, 3, 1
+};
+
+// CORDIC input shift for precision, and the inverse of the CORDIC gain (1.0 is 65536)
+constexpr int CordicShift = 8;
+constexpr int32_t CordicGainInv = 39797;
+
+// sine with 1.0 as 32768
+static int32_t SamcoSin(Angle_t a)
+{
+    a &= AngleTurn - 1;
+    const bool negative = a >= AngleTurn / 2;
+    a &= AngleTurn / 2 - 1;
+    if(a > AngleTurn / 4) {
+        a = AngleTurn / 2 - a;
+    }
+    const unsigned int index = a >> SinFracBits;
+    const int32_t frac = a & ((1 << SinFracBits) - 1);
+    int32_t s = pgm_read_word(&SinTable[index]);
+    if(frac) {
+        const int32_t next = pgm_read_word(&SinTable[index + 1]);
+        s += ((next - s) * frac + (1 << (SinFracBits - 1))) >> SinFracBits;
+    }
+    return negative ? -s : s;
+}
+
+// cosine with 1.0 as 32768
+static inline int32_t SamcoCos(Angle_t a)
+{
+    return SamcoSin(a + AngleTurn / 4);
+}
+
+// atan2 and hypot together from CORDIC vectoring
+static Angle_t SamcoAtan2(int y, int x, Dist_t* dist = nullptr)
+{
+    int32_t xs = (int32_t)x << CordicShift;
+    int32_t ys = (int32_t)y << CordicShift;
+    Angle_t a = 0;
+
+    // CORDIC converges in the right half, so rotate the left half by PI
+    if(xs < 0) {
+        xs = -xs;
+        ys = -ys;
+        a = y >= 0 ? fPI : -fPI;
+    }
+
+    // rotate towards y = 0, the angle accumulates the rotations
+    for(unsigned int i = 0; i < CordicIterations; ++i) {
+        const int32_t xi = xs >> i;
+        const int32_t yi = ys >> i;
+        const int32_t ai = pgm_read_dword(&CordicAngle[i]);
+        if(ys > 0) {
+            xs += yi;
+            ys -= xi;
+            a += ai;
+        } else {
+            xs -= yi;
+            ys += xi;
+            a -= ai;
+        }
+    }
+
+    // x is now the length multiplied by the CORDIC gain
+    if(dist) {
+        constexpr int shift = CordicShift - SamcoPositionEnhanced::DistShift + 16;
+        *dist = (Dist_t)(((int64_t)xs * CordicGainInv + (1L << (shift - 1))) >> shift);
+    }
+    return a;
+}
+
+// round(d * cos(a)) in mouse units
+static int DistCos(Dist_t d, Angle_t a)
+{
+    // split the distance so the product fits 32 bits
+    constexpr int shift = SamcoPositionEnhanced::DistShift;
+    const int32_t c = SamcoCos(a);
+    return ((d >> shift) * c + (((d & ((1 << shift) - 1)) * c) >> shift) + (1 << 14)) >> 15;
+}
+
+// round(d * sin(a)) in mouse units
+static int DistSin(Dist_t d, Angle_t a)
+{
+    constexpr int shift = SamcoPositionEnhanced::DistShift;
+    const int32_t s = SamcoSin(a);
+    return ((d >> shift) * s + (((d & ((1 << shift) - 1)) * s) >> shift) + (1 << 14)) >> 15;
+}
+
+// rounded rotation of x, y by an angle
+static void Rotate(Angle_t a, int x, int y, int& rx, int& ry)
+{
+    const int32_t c = SamcoCos(a);
+    const int32_t s = SamcoSin(a);
+    rx = (c * x - s * y + (1 << 14)) >> 15;
+    ry = (s * x + c * y + (1 << 14)) >> 15;
+}
+#else
 // floating point PI
 constexpr float fPI = (float)PI;
 
-void SamcoPositionEnhanced::begin(const int* px, const int* py, unsigned int seen, int cx, int cy)
+// atan2 and hypot
+static inline Angle_t SamcoAtan2(int y, int x, Dist_t* dist = nullptr)
 {
-    // Remapping LED postions to use with library.
-  
-    positionXX[0] = px[0] << CamToMouseShift;
-    positionYY[0] = py[0] << CamToMouseShift;
-    positionXX[1] = px[1] << CamToMouseShift;
-    positionYY[1] = py[1] << CamToMouseShift;
-    positionXX[2] = px[2] << CamToMouseShift;
-    positionYY[2] = py[2] << CamToMouseShift;
-    positionXX[3] = px[3] << CamToMouseShift;
-    positionYY[3] = py[3] << CamToMouseShift;
+    if(dist) {
+        *dist = hypot(y, x);
+    }
+    return atan2(y, x);
+}
 
-    seenFlags = seen;
+// round(d * cos(a)) in mouse units
+static inline int DistCos(Dist_t d, Angle_t a)
+{
+    return round(d * cos(a));
+}
 
-    // Wait for all postions to be recognised before starting
+// round(d * sin(a)) in mouse units
+static inline int DistSin(Dist_t d, Angle_t a)
+{
+    return round(d * sin(a));
+}
+
+// rounded rotation of x, y by an angle
+static inline void Rotate(Angle_t a, int x, int y, int& rx, int& ry)
+{
+    float cosAngle = cos(a);
+    float sinAngle = sin(a);
+    rx = round(cosAngle * (float)x - sinAngle * (float)y);
+    ry = round(sinAngle * (float)x + cosAngle * (float)y);
+}
+#endif // SAMCO_POSITION_FIXED
+
+// squared distance in camera pixels so the sum of 4 fits 32 bits
+static inline uint32_t TrackDist(int dx, int dy)
+{
+    dx = constrain(dx >> CamToMouseShift, -CamResX, CamResX);
+    dy = constrain(dy >> CamToMouseShift, -CamResY, CamResY);
+    return (uint32_t)(dx * dx) + (uint32_t)(dy * dy);
+}
 
-    if(seenFlags == 0x0F) {
-        start = 0xFF;
-    } else if(!start) {
-        // all positions not yet seen
-        return;
+bool SamcoPositionEnhanced::sortPoints(const int* x, const int* y, int* ledPoint)
+{
+    // with less than 45 degrees of tilt the corners are the extremes of x + y and x - y
+    int tl = 0, tr = 0, bl = 0, br = 0;
+    for(int i = 1; i < 4; i++) {
+        if(x[i] + y[i] < x[tl] + y[tl]) {
+            tl = i;
+        }
+        if(x[i] + y[i] > x[br] + y[br]) {
+            br = i;
+        }
+        if(x[i] - y[i] > x[tr] - y[tr]) {
+            tr = i;
+        }
+        if(x[i] - y[i] < x[bl] - y[bl]) {
+            bl = i;
+        }
     }
 
-    for(unsigned int i = 0; i < 4; i++) {
-        // if LED not seen...
-        if (!(seenFlags & (1 << i))) {
-            // if unseen make sure all quadrants have a value if missing apply value with buffer and set to unseen (this step is important for 1 LED usage)
-            if (!(((positionY[0] < medianY) && (positionX[0] < medianX)) || ((positionY[1] < medianY) && (positionX[1] < medianX)) || ((positionY[2] < medianY) && (positionX[2] < medianX)) || ((positionY[3] < medianY) && (positionX[3] < medianX)))) {
-                positionX[i] = medianX + (medianX - FinalX[3]) - buff;
-                positionY[i] = medianY + (medianY - FinalY[3]) - buff;
-                see[0] = 0;
-            }
-            if (!(((positionY[0] < medianY) && (positionX[0] > medianX)) || ((positionY[1] < medianY) && (positionX[1] > medianX)) || ((positionY[2] < medianY) && (positionX[2] > medianX)) || ((positionY[3] < medianY) && (positionX[3] > medianX)))) {
-                positionX[i] = medianX + (medianX - FinalX[2]) + buff;
-                positionY[i] = medianY + (medianY - FinalY[2]) - buff;
-                see[1] = 0;
-            }
-            if (!(((positionY[0] > medianY) && (positionX[0] < medianX)) || ((positionY[1] > medianY) && (positionX[1] < medianX)) || ((positionY[2] > medianY) && (positionX[2] < medianX)) || ((positionY[3] > medianY) && (positionX[3] < medianX)))) {
-                positionX[i] = medianX + (medianX - FinalX[1]) - buff;
-                positionY[i] = medianY + (medianY - FinalY[1]) + buff;
-                see[2] = 0;
-            }
-            if (!(((positionY[0] > medianY) && (positionX[0] > medianX)) || ((positionY[1] > medianY) && (positionX[1] > medianX)) || ((positionY[2] > medianY) && (positionX[2] > medianX)) || ((positionY[3] > medianY) && (positionX[3] > medianX)))) {
-                positionX[i] = medianX + (medianX - FinalX[0]) + buff;
-                positionY[i] = medianY + (medianY - FinalY[0]) + buff;
-                see[3] = 0;
-            }
+    // each point must be a different corner
+    if(((1 << tl) | (1 << tr) | (1 << bl) | (1 << br)) != 0x0F) {
+        return false;
+    }
+    ledPoint[0] = tl;
+    ledPoint[1] = tr;
+    ledPoint[2] = bl;
+    ledPoint[3] = br;
+    return true;
+}
 
-            // if all quadrants have a value apply value with buffer and set to see/unseen            
-            if (positionY[i] < medianY) {
-                if (positionX[i] < medianX) {
-                    positionX[i] = medianX + (medianX - FinalX[3]) - buff;
-                    positionY[i] = medianY + (medianY - FinalY[3]) - buff;
-                    see[0] = 0;
-                }
-                if (positionX[i] > medianX) {
-                    positionX[i] = medianX + (medianX - FinalX[2]) + buff;
-                    positionY[i] = medianY + (medianY - FinalY[2]) - buff;
-                    see[1] = 0;
-                }
+uint32_t SamcoPositionEnhanced::trackCost(const int* x, const int* y, unsigned int count, int* ledPoint) const
+{
+    // cost of each point to each LED from the constant velocity prediction, no point costs nothing
+    uint32_t cost[4][4];
+    for(unsigned int p = 0; p < 4; p++) {
+        for(unsigned int i = 0; i < 4; i++) {
+            cost[p][i] = p < count ? TrackDist(x[p] - (FinalX[i] + velX[i]), y[p] - (FinalY[i] + velY[i])) : 0;
+        }
+    }
+
+    // minimum cost over the 24 ways to assign 4 points to 4 LEDs
+    uint32_t best = UINT32_MAX;
+    for(int a = 0; a < 4; a++) {
+        for(int b = 0; b < 4; b++) {
+            if(b == a) {
+                continue;
             }
-            if (positionY[i] > medianY) {
-                if (positionX[i] < medianX) {
-                    positionX[i] = medianX + (medianX - FinalX[1]) - buff;
-                    positionY[i] = medianY + (medianY - FinalY[1]) + buff;
-                    see[2] = 0;
+            for(int c = 0; c < 4; c++) {
+                if(c == a || c == b) {
+                    continue;
                 }
-                if (positionX[i] > medianX) {
-                    positionX[i] = medianX + (medianX - FinalX[0]) + buff;
-                    positionY[i] = medianY + (medianY - FinalY[0]) + buff;
-                    see[3] = 0;
+                const int d = 6 - a - b - c;
+                const uint32_t total = cost[0][a] + cost[1][b] + cost[2][c] + cost[3][d];
+                if(total < best) {
+                    best = total;
+                    ledPoint[a] = 0;
+                    ledPoint[b] = 1;
+                    ledPoint[c] = 2;
+                    ledPoint[d] = 3;
                 }
             }
+        }
+    }
 
-        } else {
-            // If LEDS have been seen place in correct quadrant, apply buffer an set to seen.
-            int mapXX = map(positionXX[i], 0, MouseMaxX, MouseMaxX, 0);
-            if (positionYY[i] < medianY) {
-                if (mapXX < medianX) {
-                    positionX[i] = mapXX - buff;
-                    positionY[i] = positionYY[i] - buff;
-                    see[0] <<= 1;
-                    see[0] |= 1;
-                } else if (mapXX > medianX) {
-                    positionX[i] = mapXX + buff;
-                    positionY[i] = positionYY[i] - buff;
-                    see[1] <<= 1;
-                    see[1] |= 1;
-                }
-            } else if (positionYY[i] > medianY) {
-                if (mapXX < medianX) {
-                    positionX[i] = mapXX - buff;
-                    positionY[i] = positionYY[i] + buff;
-                    see[2] <<= 1;
-                    see[2] |= 1;
-                } else if (mapXX > medianX) {
-                    positionX[i] = mapXX + buff;
-                    positionY[i] = positionYY[i] + buff;
-                    see[3] <<= 1;
-                    see[3] |= 1;
-                }
+    // LEDs assigned to points that don't exist are not seen
+    for(unsigned int i = 0; i < 4; i++) {
+        if(ledPoint[i] >= (int)count) {
+            ledPoint[i] = -1;
+        }
+    }
+    return best;
+}
+
+// signed division rounded to nearest, den must be positive
+static inline int32_t DivRound(int64_t num, int64_t den)
+{
+    return (int32_t)((num >= 0 ? num + den / 2 : num - den / 2) / den);
+}
+
+bool SamcoPositionEnhanced::rigidFit(const int* ledPoint)
+{
+    // centroids of the seen LEDs as sums, so the offsets from the centroids are multiplied by n
+    int32_t n = 0;
+    int32_t modelSumX = 0;
+    int32_t modelSumY = 0;
+    int32_t sumX = 0;
+    int32_t sumY = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        if(ledPoint[i] >= 0) {
+            n++;
+            modelSumX += modelX[i];
+            modelSumY += modelY[i];
+            sumX += FinalX[i];
+            sumY += FinalY[i];
+        }
+    }
+
+    // least squares similarity transform from the model to the seen LEDs,
+    // [c -s; s c] is the scale and rotation where c = a / d and s = b / d
+    int64_t a = 0;
+    int64_t b = 0;
+    int64_t d = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        if(ledPoint[i] >= 0) {
+            const int32_t mx = n * modelX[i] - modelSumX;
+            const int32_t my = n * modelY[i] - modelSumY;
+            const int32_t x = n * FinalX[i] - sumX;
+            const int32_t y = n * FinalY[i] - sumY;
+            a += (int64_t)mx * x + (int64_t)my * y;
+            b += (int64_t)mx * y - (int64_t)my * x;
+            d += (int64_t)mx * mx + (int64_t)my * my;
+        }
+    }
+    if(d == 0) {
+        return false;
+    }
+
+    // place the LEDs that are not seen
+    const int64_t den = d * n;
+    for(unsigned int i = 0; i < 4; i++) {
+        if(ledPoint[i] < 0) {
+            const int32_t mx = n * modelX[i] - modelSumX;
+            const int32_t my = n * modelY[i] - modelSumY;
+            FinalX[i] = DivRound((int64_t)sumX * d + a * mx - b * my, den);
+            FinalY[i] = DivRound((int64_t)sumY * d + b * mx + a * my, den);
+        }
+    }
+    return true;
+}
+
+void SamcoPositionEnhanced::begin(const int* px, const int* py, unsigned int seen, int cx, int cy)
+{
+    // Remapping LED postions to use with library, X is mirrored
+    int pointX[4];
+    int pointY[4];
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        if(seen & (1 << i)) {
+            pointX[count] = MouseMaxX - (px[i] << CamToMouseShift);
+            pointY[count] = py[i] << CamToMouseShift;
+            count++;
+        }
+    }
+
+    seenFlags = seen;
+
+    // Assign the points to the LEDs, FinalX/FinalY index is top left, top right, bottom left, bottom right
+    int ledPoint[4];
+    const uint32_t cost = trackCost(pointX, pointY, count, ledPoint);
+    bool restart = false;
+    if(!start || (count == 4 && cost > TrackResetCost * 4)) {
+        // Wait for all postions to be recognised before starting, or start over if the tracking is lost
+        if(count == 4 && sortPoints(pointX, pointY, ledPoint)) {
+            start = 0xFF;
+            restart = true;
+            for(unsigned int i = 0; i < 4; i++) {
+                velX[i] = 0;
+                velY[i] = 0;
             }
+        } else if(!start) {
+            return;
         }
+    }
 
-        // Arrange all values in to quadrants and remove buffer.
-        // If LEDS have been seen use there value
-        // If LEDS haven't been seen work out values form live positions
-        
-        if (positionY[i] < medianY) {
-            if (positionX[i] < medianX) {
-                if (see[0] & 0x02) { 
-                    FinalX[0] = positionX[i] + buff;
-                    FinalY[0] = positionY[i] + buff;
-                } else if (positionY[i] < 0) {
-                    float f = angleBottom + angleOffset[2];
-                    FinalX[0] = FinalX[2] + round(yDistLeft * cos(f));
-                    FinalY[0] = FinalY[2] + round(yDistLeft * -sin(f));
-                } else if (positionX[i] < 0) {
-                    float f = angleRight - angleOffset[1];
-                    FinalX[0] = FinalX[1] + round(xDistTop * -cos(f));
-                    FinalY[0] = FinalY[1] + round(xDistTop * sin(f));
-                }
-            } else if (positionX[i] > medianX) {
-                if (see[1] & 0x02) {
-                    FinalX[1] = positionX[i] - buff;
-                    FinalY[1] = positionY[i] + buff;
-                } else if (positionY[i] < 0) {
-                    float f = angleBottom - (angleOffset[3] - fPI);
-                    FinalX[1] = FinalX[3] + round(yDistRight * cos(f));
-                    FinalY[1] = FinalY[3] + round(yDistRight * -sin(f));
-                } else if (positionX[i] > MouseMaxX) {
-                    float f = angleLeft + (angleOffset[0] - fPI);
-                    FinalX[1] = FinalX[0] + round(xDistTop * cos(f));
-                    FinalY[1] = FinalY[0] + round(xDistTop * -sin(f));
-                }
+    int lastX[4];
+    int lastY[4];
+    for(unsigned int i = 0; i < 4; i++) {
+        lastX[i] = FinalX[i];
+        lastY[i] = FinalY[i];
+    }
+
+    // If LEDS have been seen use there value
+    for(unsigned int i = 0; i < 4; i++) {
+        if(ledPoint[i] >= 0) {
+            FinalX[i] = pointX[ledPoint[i]];
+            FinalY[i] = pointY[ledPoint[i]];
+            see[i] <<= 1;
+            see[i] |= 1;
+        } else {
+            see[i] = 0;
+        }
+    }
+
+    // With 2 or 3 LEDs seen the rigid model places the others in one solve, otherwise if
+    // LEDS haven't been seen work out values from the side to a seen LED,
+    // or keep moving at the same speed if neither LED beside it is seen
+    if(!(rigidEnabled && count >= 2 && count < 4 && rigidFit(ledPoint))) {
+        if(ledPoint[0] < 0) {
+            if(ledPoint[2] >= 0) {
+                Angle_t f = angleBottom + angleOffset[2];
+                FinalX[0] = FinalX[2] + DistCos(yDistLeft, f);
+                FinalY[0] = FinalY[2] - DistSin(yDistLeft, f);
+            } else if(ledPoint[1] >= 0) {
+                Angle_t f = angleRight - angleOffset[1];
+                FinalX[0] = FinalX[1] - DistCos(xDistTop, f);
+                FinalY[0] = FinalY[1] + DistSin(xDistTop, f);
+            } else {
+                FinalX[0] += velX[0];
+                FinalY[0] += velY[0];
             }
-        } else if (positionY[i] > medianY) {
-            if (positionX[i] < medianX) {
-                if (see[2] & 0x02) {
-                    FinalX[2] = positionX[i] + buff;
-                    FinalY[2] = positionY[i] - buff;
-                } else if (positionY[i] > MouseMaxY) {
-                    float f = angleTop - angleOffset[0];
-                    FinalX[2] = FinalX[0] + round(yDistLeft * cos(f));
-                    FinalY[2] = FinalY[0] + round(yDistLeft * -sin(f));
-                } else if (positionX[i] < 0) {
-                    float f = angleRight + angleOffset[3];
-                    FinalX[2] = FinalX[3] + round(xDistBottom * cos(f));
-                    FinalY[2] = FinalY[3] + round(xDistBottom * -sin(f));
-                }
-            } else if (positionX[i] > medianX) {
-                if ((see[3] & 0x02)) {
-                    FinalX[3] = positionX[i] - buff;
-                    FinalY[3] = positionY[i] - buff;
-                } else if (positionY[i] > MouseMaxY) {
-                    float f = angleTop + (angleOffset[1] - fPI);
-                    FinalX[3] = FinalX[1] + round(yDistRight * cos(f));
-                    FinalY[3] = FinalY[1] + round(yDistRight * -sin(f));
-                } else if (positionX[i] > MouseMaxX) {
-                    float f = angleLeft - (angleOffset[2] - fPI);
-                    FinalX[3] = FinalX[2] + round(xDistBottom * -cos(f));
-                    FinalY[3] = FinalY[2] + round(xDistBottom * sin(f));
-                }
+        }
+        if(ledPoint[1] < 0) {
+            if(ledPoint[3] >= 0) {
+                Angle_t f = angleBottom - (angleOffset[3] - fPI);
+                FinalX[1] = FinalX[3] + DistCos(yDistRight, f);
+                FinalY[1] = FinalY[3] - DistSin(yDistRight, f);
+            } else if(ledPoint[0] >= 0) {
+                Angle_t f = angleLeft + (angleOffset[0] - fPI);
+                FinalX[1] = FinalX[0] + DistCos(xDistTop, f);
+                FinalY[1] = FinalY[0] - DistSin(xDistTop, f);
+            } else {
+                FinalX[1] += velX[1];
+                FinalY[1] += velY[1];
+            }
+        }
+        if(ledPoint[2] < 0) {
+            if(ledPoint[0] >= 0) {
+                Angle_t f = angleTop - angleOffset[0];
+                FinalX[2] = FinalX[0] + DistCos(yDistLeft, f);
+                FinalY[2] = FinalY[0] - DistSin(yDistLeft, f);
+            } else if(ledPoint[3] >= 0) {
+                Angle_t f = angleRight + angleOffset[3];
+                FinalX[2] = FinalX[3] + DistCos(xDistBottom, f);
+                FinalY[2] = FinalY[3] - DistSin(xDistBottom, f);
+            } else {
+                FinalX[2] += velX[2];
+                FinalY[2] += velY[2];
+            }
+        }
+        if(ledPoint[3] < 0) {
+            if(ledPoint[1] >= 0) {
+                Angle_t f = angleTop + (angleOffset[1] - fPI);
+                FinalX[3] = FinalX[1] + DistCos(yDistRight, f);
+                FinalY[3] = FinalY[1] - DistSin(yDistRight, f);
+            } else if(ledPoint[2] >= 0) {
+                Angle_t f = angleLeft - (angleOffset[2] - fPI);
+                FinalX[3] = FinalX[2] - DistCos(xDistBottom, f);
+                FinalY[3] = FinalY[2] + DistSin(xDistBottom, f);
+            } else {
+                FinalX[3] += velX[3];
+                FinalY[3] += velY[3];
             }
         }
     }
 
-    // If all LEDS can be seen update median & angle offsets (resets sketch stop hangs on glitches)
-    
-    if (seenFlags == 0x0F) {
-        medianY = (positionY[0] + positionY[1] + positionY[2] + positionY[3] + 2) / 4;
-        medianX = (positionX[0] + positionX[1] + positionX[2] + positionX[3] + 2) / 4;
-    } else {
-        medianY = (FinalY[0] + FinalY[1] + FinalY[2] + FinalY[3] + 2) / 4;
-        medianX = (FinalX[0] + FinalX[1] + FinalX[2] + FinalX[3] + 2) / 4;
+    // The rigid model is the last rectangle with all 4 LEDs seen
+    if(count == 4) {
+        for(unsigned int i = 0; i < 4; i++) {
+            modelX[i] = FinalX[i];
+            modelY[i] = FinalY[i];
+        }
     }
 
+    // Constant velocity for the next prediction, averaged over 2 frames to reduce the noise
+    // the velocity decays while a LED isn't seen so the estimate doesn't run away
+    // the last positions are from before the tracking started over, so the velocity stays 0 for this frame
+    for(unsigned int i = 0; i < 4 && !restart; i++) {
+        if(ledPoint[i] >= 0) {
+            velX[i] = (velX[i] + FinalX[i] - lastX[i]) / 2;
+            velY[i] = (velY[i] + FinalY[i] - lastY[i]) / 2;
+        } else {
+            velX[i] /= 2;
+            velY[i] /= 2;
+        }
+    }
+
+    medianY = (FinalY[0] + FinalY[1] + FinalY[2] + FinalY[3] + 2) / 4;
+    medianX = (FinalX[0] + FinalX[1] + FinalX[2] + FinalX[3] + 2) / 4;
+
     // If 4 LEDS can be seen and loop has run through 5 times update offsets and height      
 
     if ((1 << 5) & see[0] & see[1] & see[2] & see[3]) {
@@ -204,35 +470,31 @@ void SamcoPositionEnhanced::begin(const int* px, const int* py, unsigned int see
         angleOffset[1] = -(angleTop - angleRight);
         angleOffset[2] = -(angleBottom - angleLeft);
         angleOffset[3] = angleBottom - (angleRight - fPI);
-        height = (yDistLeft + yDistRight) / 2.0f;
+        height = (yDistLeft + yDistRight) / 2;
     }
 
     // If 2 LEDS can be seen and loop has run through 5 times update angle and distances
 
     if ((1 << 5) & see[0] & see[2]) {
-        angleLeft = atan2(FinalY[2] - FinalY[0], FinalX[0] - FinalX[2]);
-        yDistLeft = hypot((FinalY[0] - FinalY[2]), (FinalX[0] - FinalX[2]));
+        angleLeft = SamcoAtan2(FinalY[2] - FinalY[0], FinalX[0] - FinalX[2], &yDistLeft);
     }
 
     if ((1 << 5) & see[3] & see[1]) {
-        angleRight = atan2(FinalY[3] - FinalY[1], FinalX[1] - FinalX[3]);
-        yDistRight = hypot((FinalY[3] - FinalY[1]), (FinalX[3] - FinalX[1]));
+        angleRight = SamcoAtan2(FinalY[3] - FinalY[1], FinalX[1] - FinalX[3], &yDistRight);
     }
     
     if ((1 << 5) & see[0] & see[1]) {
-        angleTop = atan2(FinalY[0] - FinalY[1], FinalX[1] - FinalX[0]);
-        xDistTop = hypot((FinalY[0] - FinalY[1]), (FinalX[0] - FinalX[1]));
+        angleTop = SamcoAtan2(FinalY[0] - FinalY[1], FinalX[1] - FinalX[0], &xDistTop);
     }
 
     if ((1 << 5) & see[3] & see[2]) {
-        angleBottom = atan2(FinalY[2] - FinalY[3], FinalX[3] - FinalX[2]);
-        xDistBottom = hypot((FinalY[2] - FinalY[3]), (FinalX[2] - FinalX[3]));
+        angleBottom = SamcoAtan2(FinalY[2] - FinalY[3], FinalX[3] - FinalX[2], &xDistBottom);
     }
 
     // Add tilt correction
-    angle = (atan2(FinalY[0] - FinalY[1], FinalX[1] - FinalX[0]) + atan2(FinalY[2] - FinalY[3], FinalX[3] - FinalX[2])) / 2.0f;
-    float cosAngle = cos(angle);
-    float sinAngle = sin(angle);
-    xx = cx + round(cosAngle * (float)(medianX - cx) - sinAngle * (float)(medianY - cy));
-    yy = cy + round(sinAngle * (float)(medianX - cx) + cosAngle * (float)(medianY - cy));
+    angle = (SamcoAtan2(FinalY[0] - FinalY[1], FinalX[1] - FinalX[0]) + SamcoAtan2(FinalY[2] - FinalY[3], FinalX[3] - FinalX[2])) / 2;
+    int rx, ry;
+    Rotate(angle, medianX - cx, medianY - cy, rx, ry);
+    xx = cx + rx;
+    yy = cy + ry;
 }
@@ -16,16 +16,40 @@
 
 #include <stdint.h>
 #include "SamcoConst.h"
+#include "SamcoBoard.h"
 
 class SamcoPositionEnhanced {
-  
-    int positionXX[4];   ///< position x.
-    int positionYY[4];   ///< position y.
+public:
+#ifdef SAMCO_POSITION_FIXED
+    /// @brief Fixed-point angle, 1 << 20 is a full turn
+    typedef int32_t Angle_t;
+
+    /// @brief Fixed-point distance, DistShift fraction bits of a mouse unit
+    typedef int32_t Dist_t;
+    static constexpr int DistShift = 4;
+#else
+    /// @brief Angle in radians
+    typedef float Angle_t;
+
+    /// @brief Distance in mouse units
+    typedef float Dist_t;
+#endif // SAMCO_POSITION_FIXED
+
+private:
+
+    /// @brief Consecutive frames each LED was seen, as a shift register
+    unsigned int see[4] = {0, 0, 0, 0};
 
-    int positionX[4];
-    int positionY[4];
+    /// @brief Last LED positions with all 4 seen, the model for the rigid reconstruction
+    int modelX[4] = {400 * CamToMouseMult, 623 * CamToMouseMult, 400 * CamToMouseMult, 623 * CamToMouseMult};
+    int modelY[4] = {200 * CamToMouseMult, 200 * CamToMouseMult, 568 * CamToMouseMult, 568 * CamToMouseMult};
 
-    unsigned int see[4];
+    /// @brief True to reconstruct LEDs that are not seen from the rigid model
+    bool rigidEnabled = false;
+
+    /// @brief LED velocity in mouse units per frame for the tracking prediction
+    int velX[4] = {0, 0, 0, 0};
+    int velY[4] = {0, 0, 0, 0};
 
     int medianY = MouseMaxY / 2;
     int medianX = MouseMaxX / 2;
@@ -33,20 +57,20 @@ class SamcoPositionEnhanced {
     int FinalX[4] = {400 * CamToMouseMult, 623 * CamToMouseMult, 400 * CamToMouseMult, 623 * CamToMouseMult};
     int FinalY[4] = {200 * CamToMouseMult, 200 * CamToMouseMult, 568 * CamToMouseMult, 568 * CamToMouseMult};
 
-    float xDistTop;
-    float xDistBottom;
-    float yDistLeft;
-    float yDistRight;
+    Dist_t xDistTop;
+    Dist_t xDistBottom;
+    Dist_t yDistLeft;
+    Dist_t yDistRight;
 
-    float angleTop;
-    float angleBottom;
-    float angleLeft;
-    float angleRight;
+    Angle_t angleTop;
+    Angle_t angleBottom;
+    Angle_t angleLeft;
+    Angle_t angleRight;
 
-    float angle;
-    float height;
+    Angle_t angle;
+    Dist_t height;
 
-    float angleOffset[4];
+    Angle_t angleOffset[4];
 
     int xx;
     int yy;
@@ -54,9 +78,30 @@ class SamcoPositionEnhanced {
     unsigned int start = 0;
 
     unsigned int seenFlags = 0;
+
+    /// @brief Assign 4 points to the LEDs from their positions, used to start the tracking.
+    /// @return False if the points are not a rectangle with less than 45 degrees of tilt.
+    bool sortPoints(const int* x, const int* y, int* ledPoint);
+
+    /// @brief Assign the points to the LEDs with the minimum total distance from the predicted positions.
+    /// @param ledPoint Point index for each LED, -1 if the LED is not seen.
+    /// @return Total squared distance in camera pixels.
+    uint32_t trackCost(const int* x, const int* y, unsigned int count, int* ledPoint) const;
+
+    /// @brief Place the LEDs that are not seen with a similarity transform of the rigid model fitted to the seen LEDs.
+    /// @return False if the fit is degenerate.
+    bool rigidFit(const int* ledPoint);
 public:
 
+    /// @brief Enable or disable the rigid model reconstruction
+    /// @details With 2 or 3 LEDs seen, the LEDs that are not seen are placed by fitting the scale, rotation
+    /// and translation of the last rectangle with all 4 LEDs seen, instead of from the cached edge angles
+    /// and distances. There are no trig calls and no seen history is required.
+    void rigidModel(bool enable) { rigidEnabled = enable; }
+
     /// @brief Main function to calculate X, Y, and H
+    /// @details Each LED keeps its identity between frames from the minimum cost assignment of the points
+    /// to the positions predicted at constant velocity, so heavy tilt and camera slot changes are tracked.
     void begin(const int* px, const int* py, unsigned int seen, int cx, int cy);
     
     int testX(int index) const { return FinalX[index]; }
@@ -72,7 +117,11 @@ public:
     int y() const { return yy; }
     
     /// @brief Height
+#ifdef SAMCO_POSITION_FIXED
+    float h() const { return height * (1.0f / (1 << DistShift)); }
+#else
     float h() const { return height; }
+#endif // SAMCO_POSITION_FIXED
     
     /// @brief Bit mask of positions the camera saw
     unsigned int seen() const { return seenFlags; }
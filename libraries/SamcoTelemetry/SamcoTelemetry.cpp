@@ -0,0 +1,195 @@
+/*!
+ * @file SamcoTelemetry.cpp
+ * @brief Samco Prow Enhanced light gun binary telemetry frames.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include "SamcoTelemetry.h"
+
+// CRC covers the bytes after the sync up to the CRC
+constexpr unsigned int CrcStart = 2;
+constexpr unsigned int CrcOffset = SamcoTelemetry::FrameSize - 2;
+
+// a sequence step past half the range is the sequence going back
+constexpr uint16_t MaxSeqStep = 0x7FFF;
+
+static inline uint8_t* Put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static inline uint8_t* Put32(uint8_t* p, uint32_t v)
+{
+    p = Put16(p, (uint16_t)v);
+    return Put16(p, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t Get16(const uint8_t*& p)
+{
+    const uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    return v;
+}
+
+static inline uint32_t Get32(const uint8_t*& p)
+{
+    const uint32_t v = Get16(p);
+    return v | ((uint32_t)Get16(p) << 16);
+}
+
+unsigned int SamcoTelemetry::encode(const Frame_t& frame, uint8_t* buf)
+{
+    uint8_t* p = buf;
+    *p++ = Sync0;
+    *p++ = Sync1;
+    *p++ = Version;
+    p = Put16(p, frame.seq);
+    p = Put32(p, frame.us);
+    for(unsigned int i = 0; i < 4; ++i) {
+        p = Put16(p, frame.rawX[i]);
+    }
+    for(unsigned int i = 0; i < 4; ++i) {
+        p = Put16(p, frame.rawY[i]);
+    }
+    *p++ = (frame.camSeen & 0x0F) | (frame.engineSeen << 4);
+    *p++ = frame.engine;
+    for(unsigned int i = 0; i < 4; ++i) {
+        p = Put16(p, frame.pointX[i]);
+    }
+    for(unsigned int i = 0; i < 4; ++i) {
+        p = Put16(p, frame.pointY[i]);
+    }
+    p = Put16(p, frame.x);
+    p = Put16(p, frame.y);
+    p = Put16(p, frame.medianX);
+    p = Put16(p, frame.medianY);
+    p = Put16(p, frame.homX);
+    p = Put16(p, frame.homY);
+    Put16(p, crc16(buf + CrcStart, CrcOffset - CrcStart));
+    return FrameSize;
+}
+
+void SamcoTelemetry::decode(const uint8_t* buf, Frame_t& frame)
+{
+    const uint8_t* p = buf + 3;
+    frame.seq = Get16(p);
+    frame.us = Get32(p);
+    for(unsigned int i = 0; i < 4; ++i) {
+        frame.rawX[i] = Get16(p);
+    }
+    for(unsigned int i = 0; i < 4; ++i) {
+        frame.rawY[i] = Get16(p);
+    }
+    frame.camSeen = *p & 0x0F;
+    frame.engineSeen = *p++ >> 4;
+    frame.engine = *p++;
+    for(unsigned int i = 0; i < 4; ++i) {
+        frame.pointX[i] = (int16_t)Get16(p);
+    }
+    for(unsigned int i = 0; i < 4; ++i) {
+        frame.pointY[i] = (int16_t)Get16(p);
+    }
+    frame.x = (int16_t)Get16(p);
+    frame.y = (int16_t)Get16(p);
+    frame.medianX = (int16_t)Get16(p);
+    frame.medianY = (int16_t)Get16(p);
+    frame.homX = (int16_t)Get16(p);
+    frame.homY = (int16_t)Get16(p);
+}
+
+bool SamcoTelemetry::valid(const uint8_t* buf)
+{
+    if(buf[0] != Sync0 || buf[1] != Sync1 || buf[2] != Version) {
+        return false;
+    }
+    const uint8_t* p = buf + CrcOffset;
+    return Get16(p) == crc16(buf + CrcStart, CrcOffset - CrcStart);
+}
+
+uint16_t SamcoTelemetry::crc16(const uint8_t* data, unsigned int len)
+{
+    uint16_t crc = 0xFFFF;
+    while(len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for(unsigned int i = 0; i < 8; ++i) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+bool SamcoTelemetryDecoder::push(uint8_t b)
+{
+    buf[count++] = b;
+    if(count == 1) {
+        if(b != SamcoTelemetry::Sync0) {
+            ++skippedCount;
+            count = 0;
+        }
+        return false;
+    }
+    if(count == 2) {
+        if(b != SamcoTelemetry::Sync1) {
+            resync();
+        }
+        return false;
+    }
+    if(count < SamcoTelemetry::FrameSize) {
+        return false;
+    }
+
+    if(!SamcoTelemetry::valid(buf)) {
+        ++errorCount;
+        resync();
+        return false;
+    }
+    count = 0;
+
+    const uint16_t lastSeq = last.seq;
+    SamcoTelemetry::decode(buf, last);
+    if(seqValid) {
+        const uint16_t step = last.seq - lastSeq;
+        if(step == 0 || step > MaxSeqStep) {
+            // the gun restarted, the frames before and after aren't a gap
+            ++restartCount;
+        } else {
+            gapCount += step - 1;
+        }
+    }
+    seqValid = true;
+    ++frameCount;
+    return true;
+}
+
+void SamcoTelemetryDecoder::resync()
+{
+    // the next sync word, or a first sync byte at the end, may start a frame
+    unsigned int i = 1;
+    while(i < count && !(buf[i] == SamcoTelemetry::Sync0 && (i + 1 == count || buf[i + 1] == SamcoTelemetry::Sync1))) {
+        ++i;
+    }
+    skippedCount += i;
+    count -= i;
+    for(unsigned int j = 0; j < count; ++j) {
+        buf[j] = buf[i + j];
+    }
+}
+
+void SamcoTelemetryDecoder::reset()
+{
+    count = 0;
+    seqValid = false;
+    frameCount = 0;
+    gapCount = 0;
+    restartCount = 0;
+    errorCount = 0;
+    skippedCount = 0;
+}
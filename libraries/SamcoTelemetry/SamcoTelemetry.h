@@ -0,0 +1,128 @@
+/*!
+ * @file SamcoTelemetry.h
+ * @brief Samco Prow Enhanced light gun binary telemetry frames.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOTELEMETRY_H_
+#define _SAMCOTELEMETRY_H_
+
+#include <stdint.h>
+
+/// @brief Binary telemetry frame of the IR camera points and the position engine outputs
+/// @details The frame is a fixed size and fits a single full speed USB packet.
+/// All values are little endian.
+/// | Offset | Size | Field |
+/// |--------|------|-------|
+/// | 0      | 2    | sync 0xA5 0x5A |
+/// | 2      | 1    | version |
+/// | 3      | 2    | sequence number |
+/// | 5      | 4    | timestamp in microseconds |
+/// | 9      | 16   | raw camera points, 4 x then 4 y, 1023 when not seen |
+/// | 25     | 1    | camera seen mask in bits 3:0, engine seen mask in bits 7:4 |
+/// | 26     | 1    | position engine in use |
+/// | 27     | 16   | Samco engine points, 4 x then 4 y |
+/// | 43     | 4    | Samco engine position x, y |
+/// | 47     | 4    | Samco engine median x, y |
+/// | 51     | 4    | homography engine position x, y |
+/// | 55     | 2    | CRC-16/CCITT-FALSE of bytes 2 to 54 |
+class SamcoTelemetry
+{
+public:
+    static constexpr uint8_t Sync0 = 0xA5;
+    static constexpr uint8_t Sync1 = 0x5A;
+    static constexpr uint8_t Version = 1;
+
+    /// @brief Encoded frame size in bytes
+    static constexpr unsigned int FrameSize = 57;
+
+    /// @brief Frame contents
+    typedef struct Frame_s {
+        uint16_t seq;           ///< sequence number, increments for every frame including ones not sent
+        uint32_t us;            ///< camera read time
+        uint16_t rawX[4];       ///< camera points
+        uint16_t rawY[4];
+        uint8_t camSeen;        ///< camera seen mask
+        uint8_t engineSeen;     ///< Samco engine seen mask
+        uint8_t engine;         ///< position engine in use
+        int16_t pointX[4];      ///< Samco engine points in mouse units
+        int16_t pointY[4];
+        int16_t x;              ///< Samco engine position in mouse units
+        int16_t y;
+        int16_t medianX;        ///< Samco engine median in mouse units
+        int16_t medianY;
+        int16_t homX;           ///< homography engine position in mouse units
+        int16_t homY;
+    } Frame_t;
+
+    /// @brief Encode a frame
+    /// @param frame Frame contents
+    /// @param buf Buffer of at least FrameSize bytes
+    /// @return Number of bytes, always FrameSize
+    static unsigned int encode(const Frame_t& frame, uint8_t* buf);
+
+    /// @brief Decode a frame, the sync, version and CRC must already be checked
+    static void decode(const uint8_t* buf, Frame_t& frame);
+
+    /// @brief True if a buffer holds a frame with the right sync, version and CRC
+    static bool valid(const uint8_t* buf);
+
+    /// @brief CRC-16/CCITT-FALSE
+    static uint16_t crc16(const uint8_t* data, unsigned int len);
+};
+
+/// @brief Finds the frames in a byte stream
+/// @details Bytes are pushed as they arrive in any size chunks. Bytes that aren't part of
+/// a valid frame are skipped and the decoder resynchronises on the next sync word.
+/// Missing sequence numbers are counted as gaps, and a sequence number that goes back,
+/// or repeats, is the gun restarting the sequence.
+class SamcoTelemetryDecoder
+{
+public:
+    /// @brief Add a byte
+    /// @return true if the byte completed a valid frame, see frame()
+    bool push(uint8_t b);
+
+    /// @brief The last valid frame
+    const SamcoTelemetry::Frame_t& frame() const { return last; }
+
+    /// @brief Valid frames decoded
+    uint32_t frames() const { return frameCount; }
+
+    /// @brief Frames missing from the sequence numbers
+    uint32_t gaps() const { return gapCount; }
+
+    /// @brief Times the sequence went back and restarted
+    uint32_t restarts() const { return restartCount; }
+
+    /// @brief Frames with a CRC or version error
+    uint32_t errors() const { return errorCount; }
+
+    /// @brief Bytes skipped looking for the sync word
+    uint32_t skipped() const { return skippedCount; }
+
+    /// @brief Clear the counters and restart the sequence
+    void reset();
+
+private:
+    /// @brief Drop the invalid frame in the buffer up to the next sync word
+    void resync();
+
+    uint8_t buf[SamcoTelemetry::FrameSize];
+    unsigned int count = 0;
+    SamcoTelemetry::Frame_t last = {};
+    bool seqValid = false;
+    uint32_t frameCount = 0;
+    uint32_t gapCount = 0;
+    uint32_t restartCount = 0;
+    uint32_t errorCount = 0;
+    uint32_t skippedCount = 0;
+};
+
+#endif // _SAMCOTELEMETRY_H_
@@ -0,0 +1,32 @@
+/*!
+ * @file AbsMouse5Test.cpp
+ * @brief Host tests for the AbsMouse5 HID mouse.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <AbsMouse5.h>
+#include "SamcoTest.h"
+
+TEST(scaleMatchesDivide)
+{
+    // every range with values spread across 16 bits and the values around the range
+    unsigned int mismatches = 0;
+    for(uint32_t max = 1; max <= 0xFFFF; ++max) {
+        const uint64_t mult = AbsMouse5_::ScaleMult(max);
+        for(uint32_t v = max % 97; v <= 0xFFFF; v += 97) {
+            mismatches += AbsMouse5_::Scale(v, mult) != (uint16_t)(32767ul * v / max);
+        }
+        for(uint32_t v : {0u, max - 1, max, max + 1, 0xFFFFu}) {
+            v &= 0xFFFF;
+            mismatches += AbsMouse5_::Scale(v, mult) != (uint16_t)(32767ul * v / max);
+        }
+    }
+    CHECK_EQ(mismatches, 0u);
+}
@@ -0,0 +1,15 @@
+/*!
+ * @file DFRobotIRPositionExAvr.cpp
+ * @brief DFRobotIRPositionEx built for the AVR Wire buffer as DFRobotIRPositionExAvr.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#define BUFFER_LENGTH 32
+#define DFRobotIRPositionEx DFRobotIRPositionExAvr
+#include <DFRobotIRPositionEx.cpp>
@@ -0,0 +1,26 @@
+/*!
+ * @file DFRobotIRPositionExAvr.h
+ * @brief DFRobotIRPositionEx built for the AVR Wire buffer as DFRobotIRPositionExAvr.
+ * @details The same source with a 32 byte BUFFER_LENGTH under another class name so a test can
+ * run the full format read in chunks.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _DFROBOTIRPOSITIONEXAVR_H_
+#define _DFROBOTIRPOSITIONEXAVR_H_
+
+// the class for the host buffer first, then the header again for the AVR class
+#include <DFRobotIRPositionEx.h>
+#undef DFRobotIRPositionEx_h
+
+#define DFRobotIRPositionEx DFRobotIRPositionExAvr
+#include <DFRobotIRPositionEx.h>
+#undef DFRobotIRPositionEx
+
+#endif // _DFROBOTIRPOSITIONEXAVR_H_
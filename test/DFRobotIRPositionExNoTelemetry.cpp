@@ -0,0 +1,15 @@
+/*!
+ * @file DFRobotIRPositionExNoTelemetry.cpp
+ * @brief DFRobotIRPositionEx built without the telemetry counters as DFRobotIRPositionExNoTelemetry.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#define DFROBOT_IR_TELEMETRY 0
+#define DFRobotIRPositionEx DFRobotIRPositionExNoTelemetry
+#include <DFRobotIRPositionEx.cpp>
@@ -0,0 +1,26 @@
+/*!
+ * @file DFRobotIRPositionExNoTelemetry.h
+ * @brief DFRobotIRPositionEx built without the telemetry counters as DFRobotIRPositionExNoTelemetry.
+ * @details The same source with DFROBOT_IR_TELEMETRY=0 under another class name so a test can
+ * measure what the counters cost.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _DFROBOTIRPOSITIONEXNOTELEMETRY_H_
+#define _DFROBOTIRPOSITIONEXNOTELEMETRY_H_
+
+// the class with the counters first, then the header again for the class without
+#include <DFRobotIRPositionEx.h>
+#undef DFRobotIRPositionEx_h
+
+#define DFRobotIRPositionEx DFRobotIRPositionExNoTelemetry
+#include <DFRobotIRPositionEx.h>
+#undef DFRobotIRPositionEx
+
+#endif // _DFROBOTIRPOSITIONEXNOTELEMETRY_H_
@@ -0,0 +1,1166 @@
+/*!
+ * @file DFRobotIRPositionExTest.cpp
+ * @brief Host tests for DFRobotIRPositionEx against the camera model.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <random>
+#include <vector>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <DFRobotIRPositionEx.h>
+#include "DFRobotIRPositionExNoTelemetry.h"
+#include "DFRobotIRPositionExAvr.h"
+#include "FakeIRCamera.h"
+#include "SamcoTest.h"
+
+typedef DFRobotIRPositionEx Cam;
+
+// a fresh bus, camera model and clock for each test
+struct Rig
+{
+    TwoWire wire;
+    FakeIRCamera fake;
+    Cam cam;
+
+    Rig() : fake(wire), cam(wire)
+    {
+        testSetMicros(1000);
+        // a pass of the sketch loop between config polls
+        testYieldUs = 10;
+        srand(1);
+    }
+
+    ~Rig()
+    {
+        testPins = nullptr;
+        testYieldUs = 0;
+    }
+
+    // configure with the blocking begin
+    void begin(uint32_t clock = 400000, Cam::DataFormat_e format = Cam::DataFormat_Basic)
+    {
+        cam.begin(clock, format);
+    }
+
+    // run a split-phase read to completion, counting the pollAtomic() calls
+    int atomic(Cam::DataFormat_e format, Cam::Retry_e retry, unsigned int* polls = nullptr)
+    {
+        cam.startAtomic(format, retry);
+        unsigned int n = 1;
+        while(!cam.pollAtomic()) {
+            ++n;
+        }
+        if(polls) {
+            *polls = n;
+        }
+        return cam.atomicResult();
+    }
+
+    // the unpacked positions match a whole frame of the scene read between two times
+    bool wholeFrame(uint64_t startNs, uint64_t endNs) const
+    {
+        for(uint32_t f = fake.frameAt(startNs); f <= fake.frameAt(endNs); ++f) {
+            FakeIRCamera::Point_t p[4];
+            fake.points(f, p);
+            bool same = true;
+            for(int i = 0; i < 4; ++i) {
+                same = same && cam.x(i) == p[i].x && cam.y(i) == p[i].y;
+            }
+            if(same) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// formats to run the read tests with
+static const Cam::DataFormat_e Formats[] = {Cam::DataFormat_Basic, Cam::DataFormat_Extended, Cam::DataFormat_Full};
+
+TEST(atomicStateSequence)
+{
+    Rig r;
+    r.begin();
+
+    // the initial read and one compare read, one read transaction each
+    r.cam.startAtomic(Cam::DataFormat_Basic, Cam::Retry_1);
+    CHECK_EQ(r.cam.atomicState(), Cam::ReadState_First);
+    CHECK(r.cam.atomicBusy());
+
+    // hold the camera still so the reads match
+    r.fake.timing(1000000000ULL, 0);
+    const unsigned int reads = r.fake.reads();
+    CHECK(!r.cam.pollAtomic());
+    CHECK_EQ(r.cam.atomicState(), Cam::ReadState_Compare);
+    CHECK_EQ(r.fake.reads(), reads + 1);
+    CHECK(r.cam.pollAtomic());
+    CHECK_EQ(r.cam.atomicState(), Cam::ReadState_Done);
+    CHECK_EQ(r.fake.reads(), reads + 2);
+    CHECK_EQ(r.cam.atomicResult(), Cam::Error_Success);
+    CHECK(!r.cam.atomicBusy());
+
+    // polling after the read is done does nothing
+    CHECK(!r.cam.pollAtomic());
+    CHECK_EQ(r.fake.reads(), reads + 2);
+}
+
+TEST(atomicRetryResults)
+{
+    // a camera that updates faster than a read means every compare mismatches
+    const Cam::Retry_e retries[] = {Cam::Retry_0, Cam::Retry_0s, Cam::Retry_1, Cam::Retry_1s, Cam::Retry_2, Cam::Retry_2s};
+    for(Cam::Retry_e retry : retries) {
+        Rig r;
+        r.begin();
+        r.fake.timing(20000, 0);
+        unsigned int polls;
+        const int result = r.atomic(Cam::DataFormat_Basic, retry, &polls);
+        CHECK_EQ(polls, 2 + (retry >> 1));
+        CHECK_EQ(result, (retry & 1) ? Cam::Error_SuccessMismatch : Cam::Error_DataMismatch);
+    }
+}
+
+TEST(atomicReadsAreWholeFrames)
+{
+    // reads at random times against the camera period, a successful read is never torn
+    for(Cam::DataFormat_e format : Formats) {
+        Rig r;
+        r.begin(400000, format);
+        unsigned int success = 0;
+        unsigned int mismatch = 0;
+        for(int i = 0; i < 5000; ++i) {
+            testAdvance(rand() % 5000);
+            const uint64_t start = testNanos;
+            const int result = r.atomic(format, Cam::Retry_2);
+            if(result == Cam::Error_Success) {
+                ++success;
+                if(!r.wholeFrame(start, testNanos)) {
+                    CHECK(r.wholeFrame(start, testNanos));
+                }
+            } else {
+                CHECK_EQ(result, Cam::Error_DataMismatch);
+                ++mismatch;
+            }
+        }
+        // make sure the model tore reads, or the test proves nothing
+        CHECK(r.fake.tornReads() > 100);
+        CHECK_EQ(mismatch, 0);
+        SamcoTestCase::report("format %d: %u reads, %u torn, %u successful atomic reads",
+            format, r.fake.reads(), r.fake.tornReads(), success);
+    }
+}
+
+TEST(atomicMatchesBlockingRead)
+{
+    // the blocking read is the split-phase read run to completion
+    Rig r;
+    r.begin(400000, Cam::DataFormat_Extended);
+    r.fake.timing(1000000000ULL, 0);
+    CHECK_EQ(r.cam.extendedAtomic(Cam::Retry_1s), Cam::Error_Success);
+    CHECK(r.wholeFrame(testNanos, testNanos));
+    for(int i = 0; i < 4; ++i) {
+        FakeIRCamera::Point_t p[4];
+        r.fake.points(0, p);
+        CHECK_EQ(r.cam.size(i), p[i].size);
+    }
+}
+
+TEST(atomicPollTiming)
+{
+    // each poll is one read transaction, so the time between polls bounds the loop latency
+    for(uint32_t clock : {100000UL, 400000UL, 1000000UL}) {
+        for(Cam::DataFormat_e format : Formats) {
+            Rig r;
+            r.begin(clock, format);
+            r.fake.timing(1000000000ULL, 0);
+            const unsigned int length = format == Cam::DataFormat_Basic ? 11 : format == Cam::DataFormat_Extended ? 13 : 37;
+
+            // the pointer write is the address and the register, the read is the address and the data,
+            // plus a bit for the start and stop of each
+            const double expectUs = (2 + 1 + length + 2.0 / 9) * 9 * 1e6 / clock;
+            r.cam.startAtomic(format, Cam::Retry_1);
+            uint64_t t = testNanos;
+            CHECK(!r.cam.pollAtomic());
+            CHECK_NEAR((testNanos - t) / 1000.0, expectUs, 1);
+            t = testNanos;
+            CHECK(r.cam.pollAtomic());
+            CHECK_NEAR((testNanos - t) / 1000.0, expectUs, 1);
+
+            Cam::Telemetry_t tm;
+            r.cam.telemetry(tm);
+            CHECK_NEAR(tm.latencyMax, 2 * expectUs, 2);
+        }
+    }
+}
+
+TEST(atomicCallback)
+{
+    Rig r;
+    r.begin();
+    r.fake.timing(1000000000ULL, 0);
+    struct Seen { int calls; int error; } seen = {0, 99};
+    r.cam.atomicCallback([](Cam& cam, int error, void* context) {
+        Seen* s = (Seen*)context;
+        ++s->calls;
+        s->error = error;
+    }, &seen);
+    r.cam.startAtomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+    CHECK(!r.cam.pollAtomic());
+    CHECK_EQ(seen.calls, 0);
+    CHECK(r.cam.pollAtomic());
+    CHECK_EQ(seen.calls, 1);
+    CHECK_EQ(seen.error, Cam::Error_Success);
+}
+
+TEST(atomicQueuedConfigFirst)
+{
+    // a queued write goes before the initial read, one transaction per poll
+    Rig r;
+    r.begin();
+    r.fake.timing(1000000000ULL, 0);
+    r.fake.clearWrites();
+    // past the settle time after the start write
+    testAdvance(10000);
+    r.cam.queueSensitivity(Cam::Sensitivity_Max);
+    CHECK(r.cam.configPending());
+    r.cam.startAtomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+    CHECK_EQ(r.cam.atomicState(), Cam::ReadState_Config);
+    const unsigned int reads = r.fake.reads();
+    CHECK(!r.cam.pollAtomic());
+    CHECK_EQ(r.fake.writes().size(), 1);
+    CHECK_EQ(r.fake.reads(), reads);
+    CHECK_EQ(r.cam.atomicState(), Cam::ReadState_First);
+    while(!r.cam.pollAtomic());
+    CHECK_EQ(r.cam.atomicResult(), Cam::Error_Success);
+
+    // the second write waits for the settle time, then goes with the next read
+    CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_Success);
+    CHECK_EQ(r.fake.writes().size(), 1);
+    CHECK(r.cam.configPending());
+    testAdvance(10000);
+    r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+    CHECK_EQ(r.fake.writes().size(), 2);
+    CHECK(!r.cam.configPending());
+    CHECK_EQ(r.fake.reg(0x08), 0x0C);
+    CHECK_EQ(r.fake.reg(0x1A), 0x00);
+}
+
+// the unpackers before the branch-free mask select, on the data after the header byte
+static constexpr int OldMaxY = 767;
+
+__attribute__((noinline)) static unsigned int oldUnpackBasicSeen(const uint8_t* data, int* x, int* y)
+{
+    unsigned int seen = 0;
+    for(int i = 0; i < 2; ++i, data += 5) {
+        const int high = data[2];
+        int py = (int)data[1] | ((high & 0xC0) << 2);
+        if(py <= OldMaxY) {
+            y[i * 2] = py;
+            x[i * 2] = (int)data[0] | ((high & 0x30) << 4);
+            seen |= 1 << (i * 2);
+        }
+        py = (int)data[4] | ((high & 0x0C) << 6);
+        if(py <= OldMaxY) {
+            y[i * 2 + 1] = py;
+            x[i * 2 + 1] = (int)data[3] | ((high & 0x03) << 8);
+            seen |= 2 << (i * 2);
+        }
+    }
+    return seen;
+}
+
+__attribute__((noinline)) static unsigned int oldUnpackExtendedSeen(const uint8_t* data, int* x, int* y, int* sizes)
+{
+    unsigned int seen = 0;
+    for(int i = 0; i < 4; ++i, data += 3) {
+        const int py = (int)data[1] | ((int)(data[2] & 0xC0U) << 2);
+        if(py <= OldMaxY) {
+            y[i] = py;
+            x[i] = (int)data[0] | ((int)(data[2] & 0x30U) << 4);
+            sizes[i] = data[2] & 0xF;
+            seen |= 1 << i;
+        }
+    }
+    return seen;
+}
+
+// unpacked points, starting from the same values so the kept positions compare too
+struct Unpacked
+{
+    int x[4] = {1, 2, 3, 4};
+    int y[4] = {5, 6, 7, 8};
+    int sizes[4] = {9, 10, 11, 12};
+    unsigned int seen = 0;
+
+    bool operator==(const Unpacked& o) const
+    {
+        return seen == o.seen && !memcmp(x, o.x, sizeof(x)) && !memcmp(y, o.y, sizeof(y)) && !memcmp(sizes, o.sizes, sizeof(sizes));
+    }
+};
+
+// moving points that each drop out of view in an irregular pattern, about 1 frame in 8
+static void dropoutScene(uint32_t frame, FakeIRCamera::Point_t* points, void* context)
+{
+    for(int i = 0; i < 4; ++i) {
+        points[i].x = 100 + (i & 1) * 600 + (int)(frame * 7 % 200);
+        points[i].y = 100 + (i >> 1) * 400 + (int)(frame * 3 % 150);
+        points[i].size = 2 + (int)(frame + i) % 4;
+        points[i].seen = ((frame * 2654435761u) >> (i * 5 + 8)) & 7;
+    }
+}
+
+// position data of a camera recorded in a format, the data after the header byte of each frame
+static std::vector<uint8_t> recordFrames(Cam::DataFormat_e format, unsigned int frames, unsigned int* stride)
+{
+    Rig r;
+    r.begin(400000, format);
+    r.fake.scene(dropoutScene);
+    std::vector<uint8_t> data;
+    uint8_t frame[FakeIRCamera::DataMax];
+    for(unsigned int f = 0; f < frames; ++f) {
+        *stride = r.fake.encode(f, frame) - 1;
+        data.insert(data.end(), frame + 1, frame + 1 + *stride);
+    }
+    return data;
+}
+
+TEST(unpackMatchesOldCode)
+{
+    for(Cam::DataFormat_e format : {Cam::DataFormat_Basic, Cam::DataFormat_Extended}) {
+        // random bytes, a quarter of the points aren't seen, then recorded frames
+        unsigned int stride;
+        std::vector<uint8_t> data = recordFrames(format, 10000, &stride);
+        std::mt19937 rng(1);
+        for(unsigned int i = 0; i < 1000000 * stride; ++i) {
+            data.push_back((uint8_t)rng());
+        }
+        Unpacked a, b;
+        unsigned int mismatches = 0;
+        unsigned int unseen = 0;
+        for(size_t i = 0; i + stride <= data.size(); i += stride) {
+            if(format == Cam::DataFormat_Basic) {
+                a.seen = oldUnpackBasicSeen(&data[i], a.x, a.y);
+                b.seen = Cam::unpackBasicSeen(&data[i], b.x, b.y);
+            } else {
+                a.seen = oldUnpackExtendedSeen(&data[i], a.x, a.y, a.sizes);
+                b.seen = Cam::unpackExtendedSeen(&data[i], b.x, b.y, b.sizes);
+            }
+            mismatches += !(a == b);
+            unseen += a.seen != 0x0F;
+        }
+        CHECK_EQ(mismatches, 0);
+        // the frames had points out of view, or the test proves nothing
+        CHECK(unseen > data.size() / stride / 2);
+    }
+}
+
+// host CPU time per frame to unpack a recording
+template<class F> static double unpackNs(const std::vector<uint8_t>& data, unsigned int stride, unsigned int passes, F unpack)
+{
+    Unpacked u;
+    unsigned int sum = 0;
+    timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for(unsigned int pass = 0; pass < passes; ++pass) {
+        for(size_t i = 0; i < data.size(); i += stride) {
+            sum += unpack(&data[i], u);
+        }
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    volatile unsigned int sink = sum + u.x[0] + u.y[3] + u.sizes[1];
+    (void)sink;
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (passes * (data.size() / stride));
+}
+
+TEST(unpackSpeed)
+{
+    // a million recorded frames of each format, the best of runs taken in turns,
+    // host time is only a guide to the board
+    constexpr unsigned int Frames = 4096;
+    constexpr unsigned int Passes = 250;
+    constexpr int Runs = 30;
+    for(Cam::DataFormat_e format : {Cam::DataFormat_Basic, Cam::DataFormat_Extended}) {
+        unsigned int stride;
+        const std::vector<uint8_t> data = recordFrames(format, Frames, &stride);
+        double oldNs = 1e9;
+        double newNs = 1e9;
+        for(int run = 0; run < Runs; ++run) {
+            if(format == Cam::DataFormat_Basic) {
+                oldNs = min(oldNs, unpackNs(data, stride, Passes, [](const uint8_t* d, Unpacked& u) { return oldUnpackBasicSeen(d, u.x, u.y); }));
+                newNs = min(newNs, unpackNs(data, stride, Passes, [](const uint8_t* d, Unpacked& u) { return Cam::unpackBasicSeen(d, u.x, u.y); }));
+            } else {
+                oldNs = min(oldNs, unpackNs(data, stride, Passes, [](const uint8_t* d, Unpacked& u) { return oldUnpackExtendedSeen(d, u.x, u.y, u.sizes); }));
+                newNs = min(newNs, unpackNs(data, stride, Passes, [](const uint8_t* d, Unpacked& u) { return Cam::unpackExtendedSeen(d, u.x, u.y, u.sizes); }));
+            }
+        }
+        SamcoTestCase::report("format %d: old %.2f ns, library %.2f ns per frame, best of %d runs of %u frames",
+            format, oldNs, newNs, Runs, Frames * Passes);
+        // the same stores under a branch, to within where the two copies of the code land
+        CHECK(newNs < oldNs * 1.25);
+    }
+}
+
+// plays back recorded position data, a read from the first position register moves to the next frame
+class RecordedCamera : public TwoWireDevice
+{
+public:
+    RecordedCamera(const std::vector<uint8_t>& data, unsigned int stride) : data(data), stride(stride) {}
+
+    uint8_t write(const uint8_t* bytes, size_t length, uint64_t startNs, uint64_t byteNs) override
+    {
+        if(length) {
+            pointer = bytes[0];
+        }
+        return 0;
+    }
+
+    size_t read(uint8_t* bytes, size_t length, uint64_t startNs, uint64_t byteNs) override
+    {
+        if(pointer == RegPosition) {
+            frame = (frame + stride) % data.size();
+        }
+        // the header is 0, then the recorded bytes of the frame
+        for(size_t i = 0; i < length; ++i) {
+            const unsigned int offset = pointer - RegPosition + i;
+            bytes[i] = offset && offset <= stride ? data[frame + offset - 1] : 0;
+        }
+        ++lengths[min<size_t>(length, FakeIRCamera::DataMax)];
+        return length;
+    }
+
+    /// reads of each length
+    unsigned int lengths[FakeIRCamera::DataMax + 1] = {};
+
+private:
+    static constexpr uint8_t RegPosition = 0x36;
+
+    const std::vector<uint8_t>& data;
+    const unsigned int stride;
+    size_t frame = data.size() - stride;
+    uint8_t pointer = 0;
+};
+
+// request and unpack a frame of a format
+template<class C> static bool readFrame(C& cam, Cam::DataFormat_e format)
+{
+    switch(format) {
+    case Cam::DataFormat_Basic:
+        cam.requestPositionBasic();
+        return cam.availableBasic();
+    case Cam::DataFormat_Extended:
+        cam.requestPositionExtended();
+        return cam.availableExtended();
+    default:
+        cam.requestPositionFull();
+        return cam.availableFull();
+    }
+}
+
+// bus and host CPU time per frame to read a recording through the Wire stand-in
+struct FrameCost
+{
+    double busUs;
+    double cpuNs;
+    double transactions;
+    unsigned int read;
+    uint64_t positions;     ///< hash of the positions and seen flags after each frame
+    uint64_t full;          ///< hash of the intensities and bounding boxes
+};
+
+template<class C> static FrameCost readCost(Cam::DataFormat_e format, const std::vector<uint8_t>& data, unsigned int stride,
+    size_t bufferLength, unsigned int* lengths = nullptr)
+{
+    const unsigned int frames = data.size() / stride;
+    TwoWire wire;
+    RecordedCamera recorded(data, stride);
+    wire.attach(FakeIRCamera::Address, &recorded);
+    wire.begin();
+    wire.setClock(400000);
+    wire.setBufferLength(bufferLength);
+    C cam(wire);
+
+    FrameCost cost = {};
+    const uint64_t startNs = testNanos;
+    timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for(unsigned int f = 0; f < frames; ++f) {
+        cost.read += readFrame(cam, format);
+        for(int i = 0; i < 4; ++i) {
+            cost.positions = cost.positions * 31 + cam.x(i) * 1024 + cam.y(i);
+            if(format == Cam::DataFormat_Full) {
+                cost.full = cost.full * 31 + cam.intensity(i) + cam.boxMinX(i) + cam.boxMinY(i) * 128
+                    + cam.boxMaxX(i) * 16384 + cam.boxMaxY(i) * 2097152;
+            }
+        }
+        cost.positions = cost.positions * 31 + cam.seen();
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    cost.busUs = (testNanos - startNs) / 1000.0 / frames;
+    cost.cpuNs = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / frames;
+    cost.transactions = (double)wire.transactions() / frames;
+    if(lengths) {
+        memcpy(lengths, recorded.lengths, sizeof(recorded.lengths));
+    }
+    return cost;
+}
+
+TEST(formatReadCost)
+{
+    // each format read from a recording at 400kHz, then the full format again in the 28 and 9 byte chunks
+    // of the 32 byte AVR Wire buffer, host CPU time is the library and the stand-in and only a guide to the board
+    constexpr unsigned int Frames = 4096;
+    constexpr int Runs = 10;
+    constexpr double ByteUs = 9 / 0.4;
+    struct Case { const char* name; Cam::DataFormat_e format; bool avr; unsigned int length; double busUs; };
+    // the pointer write is the address and the register, the read is the address and the data,
+    // plus a bit for the start and stop of each
+    const Case cases[] = {
+        {"basic", Cam::DataFormat_Basic, false, 11, (3 + 11 + 2 / 9.0) * ByteUs},
+        {"extended", Cam::DataFormat_Extended, false, 13, (3 + 13 + 2 / 9.0) * ByteUs},
+        {"full", Cam::DataFormat_Full, false, 37, (3 + 37 + 2 / 9.0) * ByteUs},
+        {"full AVR", Cam::DataFormat_Full, true, 28, (3 + 28 + 3 + 9 + 4 / 9.0) * ByteUs}
+    };
+    uint64_t positions = 0;
+    uint64_t full = 0;
+    for(const Case& c : cases) {
+        unsigned int stride;
+        const std::vector<uint8_t> data = recordFrames(c.format, Frames, &stride);
+        FrameCost cost = {};
+        double cpuNs = 1e9;
+        unsigned int lengths[FakeIRCamera::DataMax + 1];
+        for(int run = 0; run < Runs; ++run) {
+            cost = c.avr ? readCost<DFRobotIRPositionExAvr>(c.format, data, stride, 32, lengths)
+                : readCost<Cam>(c.format, data, stride, 64, lengths);
+            cpuNs = min(cpuNs, cost.cpuNs);
+        }
+        SamcoTestCase::report("%-8s bus %.1f us, %.1f transactions, host CPU %.0f ns per frame, best of %d runs of %u frames",
+            c.name, cost.busUs, cost.transactions, cpuNs, Runs, Frames);
+        CHECK_EQ(cost.read, Frames);
+        CHECK_NEAR(cost.busUs, c.busUs, 0.1);
+        CHECK_EQ(cost.transactions, c.avr ? 4 : 2);
+        CHECK_EQ(lengths[c.length], Frames);
+        if(c.avr) {
+            // the rest of the frames in the second chunk, from the register after the first
+            CHECK_EQ(lengths[9], Frames);
+        }
+
+        // every format unpacks the same positions from the same scene, both full reads the same boxes
+        if(!positions) {
+            positions = cost.positions;
+        }
+        CHECK_EQ(cost.positions, positions);
+        if(c.format == Cam::DataFormat_Full) {
+            if(!full) {
+                full = cost.full;
+            }
+            CHECK_EQ(cost.full, full);
+        }
+    }
+
+    // the full format in one read doesn't fit the AVR buffer
+    unsigned int stride;
+    const std::vector<uint8_t> data = recordFrames(Cam::DataFormat_Full, 16, &stride);
+    CHECK_EQ(readCost<Cam>(Cam::DataFormat_Full, data, stride, 32).read, 0);
+}
+
+// a read at the start of each camera frame like the sketch, returns the read time in microseconds
+// and the number of register writes that went with it
+static uint32_t tickRead(Rig& r, size_t* written)
+{
+    testAdvance((r.fake.frameStart(r.fake.frameAt(testNanos) + 1) - testNanos) / 1000 + 1);
+    const size_t before = r.fake.writes().size();
+    const uint64_t t = testNanos;
+    CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_Success);
+    *written = r.fake.writes().size() - before;
+    return (uint32_t)((testNanos - t) / 1000);
+}
+
+TEST(queuedConfigOneWritePerTick)
+{
+    // a sensitivity change costs each camera tick at most one register write, never a frame
+    Rig r;
+    r.begin();
+    size_t written;
+    const uint32_t plainUs = tickRead(r, &written);
+    CHECK_EQ(written, 0);
+
+    // queuing again before the writes are done only writes the last value
+    r.fake.clearWrites();
+    r.cam.queueSensitivity(Cam::Sensitivity_Max);
+    r.cam.queueSensitivity(Cam::Sensitivity_High);
+    unsigned int ticks = 0;
+    uint32_t worstUs = 0;
+    std::vector<unsigned int> writeTicks;
+    while(r.cam.configPending() && ticks < 100) {
+        if(ticks == 0) {
+            // a write that isn't acknowledged stays queued for a later tick
+            r.fake.nack(1);
+        }
+        worstUs = max(worstUs, tickRead(r, &written));
+        CHECK_LE(written, 1);
+        if(written) {
+            writeTicks.push_back(ticks);
+        }
+        ++ticks;
+    }
+    CHECK(!r.cam.configPending());
+    CHECK_EQ(writeTicks.size(), 2);
+    writeTicks.resize(2);
+    CHECK(writeTicks[0] > 0);
+    CHECK_EQ(r.fake.writes().size(), 2);
+    CHECK_EQ(r.fake.reg(0x06), 0x90);
+    CHECK_EQ(r.fake.reg(0x08), 0x41);
+    CHECK_EQ(r.fake.reg(0x1A), 0x40);
+
+    // the block 1 write is the register and 9 bytes plus the address at 400kHz, ~250 us
+    SamcoTestCase::report("read %u us, with a write %u us, writes on ticks %u and %u of %u",
+        plainUs, worstUs, writeTicks[0], writeTicks[1], ticks);
+    CHECK_LE(worstUs, plainUs + 300);
+    CHECK(worstUs * 4 < (uint32_t)(FakeIRCamera::PeriodNs / 1000));
+}
+
+// run the configuration sequence, counting the pollConfig() calls
+static int runConfig(Rig& r, unsigned int* polls = nullptr)
+{
+    r.cam.beginConfig(400000, Cam::DataFormat_Basic);
+    unsigned int n = 1;
+    while(!r.cam.pollConfig()) {
+        yield();
+        ++n;
+    }
+    if(polls) {
+        *polls = n;
+    }
+    return r.cam.configResult();
+}
+
+TEST(configWriteSequence)
+{
+    Rig r;
+    CHECK_EQ(runConfig(r), Cam::Error_Success);
+    CHECK(r.fake.running());
+    const std::vector<FakeIRCamera::RegWrite_t>& w = r.fake.writes();
+    CHECK_EQ(w.size(), 5);
+    if(w.size() == 5) {
+        CHECK(w[0].reg == 0x30 && w[0].data == std::vector<uint8_t>({0x01}));
+        CHECK(w[1].reg == 0x06 && w[1].data == std::vector<uint8_t>({0x90, 0x00, 0xC0}));
+        CHECK(w[2].reg == 0x1A && w[2].data == std::vector<uint8_t>({0x40}));
+        CHECK(w[3].reg == 0x33 && w[3].data == std::vector<uint8_t>({0x11}));
+        CHECK(w[4].reg == 0x30 && w[4].data == std::vector<uint8_t>({0x08}));
+    }
+}
+
+TEST(configWaitsForLatch)
+{
+    // 10 back to back attempts take well under a millisecond, the step deadline covers a slow latch
+    const uint64_t latches[] = {1000000, 5000000, 15000000};
+    for(uint64_t latch : latches) {
+        Rig r;
+        r.fake.latency(0, latch, 20000000);
+        unsigned int polls;
+        const unsigned int before = r.wire.transactions();
+        CHECK_EQ(runConfig(r, &polls), Cam::Error_Success);
+        CHECK_EQ(r.fake.writes().size(), 5);
+        CHECK(r.fake.busyNacks() > 10);
+        // each poll is a single write, or a position read once the camera is started, nothing blocks
+        CHECK_LE(r.wire.transactions() - before, polls * 2);
+        SamcoTestCase::report("latch %lu us: %u polls, %lu us", (unsigned long)(latch / 1000), polls, r.cam.configTime());
+    }
+}
+
+TEST(configSettlesBetweenWrites)
+{
+    // a camera that acknowledges while it latches and drops the write, only the settle time protects it
+    for(uint64_t latch : {1000000ULL, 8000000ULL}) {
+        Rig r;
+        r.fake.latency(0, latch, 0);
+        r.fake.dropWhileLatching(true);
+        CHECK_EQ(runConfig(r), Cam::Error_Success);
+        CHECK_EQ(r.fake.droppedWrites(), 0);
+        CHECK_EQ(r.fake.busyNacks(), 0);
+        const std::vector<FakeIRCamera::RegWrite_t>& w = r.fake.writes();
+        CHECK_EQ(w.size(), 5);
+        for(size_t i = 1; i < w.size(); ++i) {
+            CHECK(w[i].ns - w[i - 1].ns >= 10000000);
+        }
+        CHECK(r.fake.running());
+
+        // the queued writes also wait, reads go on meanwhile
+        r.fake.timing(1000000000ULL, 0);
+        r.fake.clearWrites();
+        r.cam.queueSensitivity(Cam::Sensitivity_Max);
+        unsigned int reads = 0;
+        while(r.cam.configPending()) {
+            CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_Success);
+            testAdvance(1000);
+            ++reads;
+        }
+        CHECK_EQ(r.fake.droppedWrites(), 0);
+        CHECK_EQ(r.fake.writes().size(), 2);
+        CHECK_EQ(r.fake.reg(0x08), 0x0C);
+        CHECK_EQ(r.fake.reg(0x1A), 0x00);
+        CHECK(reads > 10);
+        SamcoTestCase::report("latch %lu us: config %lu us, queued writes over %u reads",
+            (unsigned long)(latch / 1000), r.cam.configTime(), reads);
+    }
+}
+
+TEST(configWaitsForBoot)
+{
+    Rig r;
+    r.fake.latency(testNanos + 15000000, 0, 0);
+    CHECK_EQ(runConfig(r), Cam::Error_Success);
+    CHECK(r.fake.busyNacks() > 0);
+    CHECK_EQ(r.fake.writes().size(), 5);
+}
+
+TEST(configNoCamera)
+{
+    // a write that is never acknowledged fails at the step deadline
+    TwoWire wire;
+    Cam cam(wire);
+    testSetMicros(1000);
+    cam.beginConfig();
+    const unsigned long start = micros();
+    while(!cam.pollConfig());
+    CHECK_EQ(cam.configResult(), Cam::Error_IICerror);
+    CHECK(micros() - start >= 20000);
+    CHECK(micros() - start < 21000);
+}
+
+TEST(configNoFrames)
+{
+    // the camera acknowledges but never returns position data
+    Rig r;
+    r.fake.latency(0, 0, 1000000000ULL);
+    CHECK_EQ(runConfig(r), Cam::Error_Timeout);
+    CHECK(r.cam.configTime() >= 250000);
+    CHECK(r.cam.configTime() < 251000);
+}
+
+TEST(configBlockingWrite)
+{
+    // the blocking data format write retries through the latch
+    Rig r;
+    r.begin();
+    r.fake.latency(0, 5000000, 0);
+    r.fake.clearWrites();
+    r.cam.sensitivityLevel(Cam::Sensitivity_Max);
+    r.cam.dataFormat(Cam::DataFormat_Full);
+    const std::vector<FakeIRCamera::RegWrite_t>& w = r.fake.writes();
+    CHECK_EQ(w.size(), 3);
+    CHECK_EQ(r.fake.reg(0x33), 0x55);
+    CHECK_EQ(r.fake.reg(0x08), 0x0C);
+    CHECK_EQ(r.fake.reg(0x1A), 0x00);
+}
+
+// two small points and two missing, so auto-exposure increases the gain
+static void dimScene(uint32_t frame, FakeIRCamera::Point_t* points, void* context)
+{
+    for(int i = 0; i < 4; ++i) {
+        points[i].x = 200 + i * 150;
+        points[i].y = 300;
+        points[i].size = 1;
+        points[i].seen = i < 2;
+    }
+}
+
+// atomic reads until the auto-exposure writes are done, at least a few updates
+static void runExposure(Rig& r, unsigned int frames)
+{
+    for(unsigned int i = 0; i < frames || r.cam.configPending(); ++i) {
+        r.atomic(Cam::DataFormat_Extended, Cam::Retry_1s);
+    }
+}
+
+TEST(exposureLevelWritesGainOnly)
+{
+    // with a sensitivity level only the gain registers are written, never the zeroed parts of the blocks
+    Rig r;
+    r.begin(400000, Cam::DataFormat_Extended);
+    r.fake.scene(dimScene);
+    r.fake.clearWrites();
+    r.cam.autoExposure(true);
+    runExposure(r, 64);
+    CHECK(r.cam.exposureGain() < 0xC0);
+    CHECK(r.fake.writes().size() >= 2);
+    for(const FakeIRCamera::RegWrite_t& w : r.fake.writes()) {
+        const bool gain = (w.reg == 0x06 && w.data.size() == 3) || (w.reg == 0x1A && w.data.size() == 1);
+        CHECK(gain);
+    }
+    CHECK_EQ(r.fake.reg(0x06), 0x90);
+    CHECK_EQ(r.fake.reg(0x07), 0x00);
+    CHECK_EQ(r.fake.reg(0x08), r.cam.exposureGain());
+    CHECK_EQ(r.fake.reg(0x1A), r.cam.exposureGain() / 3);
+}
+
+TEST(exposureCustomKeepsBlocks)
+{
+    // with custom blocks the whole blocks are written with only the gain changed
+    static const uint8_t block1[9] = {0x02, 0x00, 0x00, 0x71, 0x01, 0x00, 0xAA, 0x00, 0x64};
+    static const uint8_t block2[2] = {0x63, 0x03};
+    Rig r;
+    r.begin(400000, Cam::DataFormat_Extended);
+    r.cam.sensitivityBlocks(block1, block2);
+    r.fake.scene(dimScene);
+    r.fake.clearWrites();
+    r.cam.autoExposure(true);
+    runExposure(r, 64);
+    CHECK(r.cam.exposureGain() < 0x64);
+    CHECK(r.fake.writes().size() >= 2);
+    for(int i = 0; i < 8; ++i) {
+        CHECK_EQ(r.fake.reg(i), block1[i]);
+    }
+    CHECK_EQ(r.fake.reg(0x08), r.cam.exposureGain());
+    CHECK_EQ(r.fake.reg(0x1A), r.cam.exposureGain() / 3);
+    CHECK_EQ(r.fake.reg(0x1B), block2[1]);
+}
+
+TEST(telemetrySnapshotAndReset)
+{
+    Rig r;
+    r.begin();
+    r.cam.resetTelemetry();
+
+    // a still camera, the first compare matches
+    r.fake.timing(1000000000ULL, 0);
+    for(int i = 0; i < 100; ++i) {
+        CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1), Cam::Error_Success);
+    }
+    // a camera faster than a read, every compare mismatches
+    r.fake.timing(20000, 0);
+    for(int i = 0; i < 10; ++i) {
+        CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_SuccessMismatch);
+        CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_0), Cam::Error_DataMismatch);
+    }
+    // a read and a queued write that aren't acknowledged
+    r.fake.timing(1000000000ULL, 0);
+    r.fake.nack(2);
+    CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1), Cam::Error_IICerror);
+    testAdvance(10000);
+    r.cam.queueSensitivity(Cam::Sensitivity_Max);
+    r.fake.nack(1);
+    CHECK(r.cam.pollPending());
+    CHECK(r.cam.configPending());
+
+    Cam::Telemetry_t t;
+    r.cam.telemetry(t);
+    CHECK_EQ(t.atomicReads, 121);
+    // each atomic read has an initial read and a compare read, Retry_1s adds one more
+    CHECK_EQ(t.reads, 100 * 2 + 10 * 3 + 10 * 2 + 1);
+    CHECK_EQ(t.retries, 10);
+    CHECK_EQ(t.mismatchUsed, 10);
+    CHECK_EQ(t.mismatchErrors, 10);
+    CHECK_EQ(t.iicErrors, 1);
+    CHECK_EQ(t.shortReads, 1);
+    CHECK_EQ(t.nacks, 1);
+    // the register byte and 11 data bytes for each read except the one without data,
+    // then the register and the 3 bytes from 0x06 of the block 1 write
+    CHECK_EQ(t.bytes, (t.reads - 1) * 12 + 1 + 4);
+    uint32_t histReads = 0;
+    for(unsigned int i = 0; i < Cam::TelemetryHistSize; ++i) {
+        histReads += t.latencyHist[i];
+    }
+    CHECK_EQ(histReads, t.atomicReads);
+    // two reads of ~320us at 400kHz are in the bucket up to 1024us
+    CHECK(t.latencyHist[3] >= 100);
+    CHECK(t.latencyMax > 512 && t.latencyMax <= 2048);
+
+    // a snapshot keeps the counters, a snapshot with reset clears them
+    Cam::Telemetry_t again;
+    r.cam.telemetry(again);
+    CHECK(!memcmp(&again, &t, sizeof(t)));
+    r.cam.telemetry(again, true);
+    CHECK(!memcmp(&again, &t, sizeof(t)));
+    const Cam::Telemetry_t zero = {};
+    r.cam.telemetry(again);
+    CHECK(!memcmp(&again, &zero, sizeof(zero)));
+    CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1), Cam::Error_Success);
+    r.cam.telemetry(again);
+    CHECK_EQ(again.atomicReads, 1);
+    CHECK_EQ(again.reads, 2);
+}
+
+// host CPU time per atomic read of a still camera, the time the test was switched out doesn't count
+template<class C> static double atomicReadNs(C& cam, unsigned int frames)
+{
+    timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for(unsigned int i = 0; i < frames; ++i) {
+        cam.startAtomic(C::DataFormat_Basic, C::Retry_1);
+        while(!cam.pollAtomic());
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / frames;
+}
+
+TEST(telemetryCost)
+{
+    // the same reads of the same camera built without the counters,
+    // the best of runs taken in turns so both see the same host
+    constexpr unsigned int Frames = 20000;
+    constexpr int Runs = 50;
+    Rig r;
+    DFRobotIRPositionExNoTelemetry without(r.wire);
+    without.begin();
+    r.begin();
+    r.fake.timing(UINT64_MAX / 2, 0);
+    r.cam.resetTelemetry();
+    double withoutNs = 1e9;
+    double withNs = 1e9;
+    for(int run = 0; run < Runs; ++run) {
+        withoutNs = min(withoutNs, atomicReadNs(without, Frames));
+        withNs = min(withNs, atomicReadNs(r.cam, Frames));
+    }
+    CHECK_EQ(without.atomicResult(), Cam::Error_Success);
+    CHECK_EQ(r.cam.atomicResult(), Cam::Error_Success);
+    DFRobotIRPositionExNoTelemetry::Telemetry_t t;
+    without.telemetry(t);
+    CHECK_EQ(t.atomicReads, 0);
+    Cam::Telemetry_t tm;
+    r.cam.telemetry(tm);
+    CHECK_EQ(tm.atomicReads, Runs * Frames);
+
+    // host time is only a guide to the board, the counters are a few adds per frame against the
+    // two reads through the camera model, a few ns with a few ns of noise
+    SamcoTestCase::report("atomic read %.1f ns with the counters, %.1f ns without, %+.1f ns per frame",
+        withNs, withoutNs, withNs - withoutNs);
+    CHECK(withNs - withoutNs < withoutNs * 0.1);
+}
+
+// atomic reads every 5ms after a fault until a read succeeds or the time is up
+static Cam::Telemetry_t runFault(Rig& r, unsigned long timeoutUs, unsigned int* failed)
+{
+    const unsigned long start = micros();
+    unsigned int n = 0;
+    int result;
+    do {
+        result = r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+        if(result < Cam::Error_Success) {
+            ++n;
+        }
+        testAdvance(5000);
+    } while(result != Cam::Error_Success && micros() - start < timeoutUs);
+    *failed = n;
+    Cam::Telemetry_t t;
+    r.cam.telemetry(t);
+    return t;
+}
+
+TEST(recoverStuckSda)
+{
+    // the camera holds SDA low part way through a byte, the recovery clocks SCL to release it
+    Rig r;
+    r.begin();
+    r.cam.autoRecover(true, SDA, SCL);
+    r.cam.resetTelemetry();
+    testPins = &r.fake;
+    r.fake.holdSda(5);
+    r.fake.clearWrites();
+    unsigned int failed;
+    const Cam::Telemetry_t t = runFault(r, 1000000, &failed);
+    CHECK_EQ(r.fake.sdaHeld(), 0);
+    CHECK_EQ(t.recoveries, 1);
+    // the errors that started the recovery, then a recovery step for each read until the camera is back
+    CHECK_EQ(t.iicErrors, 3);
+    CHECK_EQ(t.iicErrors + t.recoverySteps, failed);
+    CHECK(t.recoverySteps > 0);
+    CHECK(t.recoveryMax > 0);
+    // the configuration waits the settle time after each of its first 4 writes
+    CHECK(t.recoveryMax < 60000);
+    // the camera was configured again
+    CHECK(r.fake.writes().size() >= 5);
+    CHECK(r.fake.running());
+    CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_Success);
+    CHECK(r.wholeFrame(testNanos - r.fake.period(), testNanos));
+    SamcoTestCase::report("%u failed reads, recovery %lu us", failed, (unsigned long)t.recoveryMax);
+}
+
+TEST(recoverRepeatedNacks)
+{
+    // a couple of NACKs don't start the recovery
+    Rig r;
+    r.begin();
+    r.cam.autoRecover(true);
+    r.cam.resetTelemetry();
+    r.fake.nack(2);
+    unsigned int failed;
+    Cam::Telemetry_t t = runFault(r, 1000000, &failed);
+    CHECK(failed > 0);
+    CHECK(failed < 3);
+    CHECK_EQ(t.recoveries, 0);
+    CHECK(!r.cam.recovering());
+
+    // NACKs that outlast the config step deadline fail recovery attempts, retried every 100ms until
+    // the camera answers, a poll every 5ms uses ~5 NACKs per attempt
+    r.cam.resetTelemetry();
+    r.fake.nack(30);
+    r.fake.clearWrites();
+    t = runFault(r, 2000000, &failed);
+    CHECK_EQ(t.recoveries, 1);
+    CHECK_EQ(t.iicErrors, 3);
+    CHECK_EQ(t.iicErrors + t.recoverySteps, failed);
+    CHECK(t.recoveryMax >= 100000);
+    CHECK(t.recoveryMax < 1000000);
+    CHECK_EQ(r.fake.writes().size(), 5);
+    SamcoTestCase::report("%u failed reads, recovery %lu us", failed, (unsigned long)t.recoveryMax);
+}
+
+TEST(recoverBrownOut)
+{
+    // the camera loses power part way through a read, boots and has to be configured again
+    for(uint64_t bootNs : {10000000ULL, 60000000ULL}) {
+        Rig r;
+        r.begin();
+        r.cam.autoRecover(true);
+        r.cam.resetTelemetry();
+        r.fake.clearWrites();
+        // the power is lost during the first data bytes of the next read
+        r.fake.brownOut(testNanos + r.wire.byteNs() * 6, bootNs);
+        unsigned int failed;
+        const Cam::Telemetry_t t = runFault(r, 2000000, &failed);
+        CHECK(r.fake.running());
+        CHECK_EQ(t.recoveries, 1);
+        CHECK(failed >= 3);
+        CHECK_EQ(t.iicErrors + t.recoverySteps, failed);
+        CHECK(t.recoverySteps > 0);
+        CHECK(t.recoveryMax + 15000 >= bootNs / 1000);
+        CHECK(t.recoveryMax < bootNs / 1000 + 500000);
+        // the whole configuration was written, the mode and sensitivity are back
+        CHECK_EQ(r.fake.writes().size(), 5);
+        CHECK_EQ(r.fake.reg(0x33), 0x11);
+        CHECK_EQ(r.fake.reg(0x08), 0xC0);
+        CHECK_EQ(r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s), Cam::Error_Success);
+        SamcoTestCase::report("boot %lu us: %u failed reads, recovery %lu us", (unsigned long)(bootNs / 1000),
+            failed, (unsigned long)t.recoveryMax);
+    }
+}
+
+// phase lock run against a camera period, reads from a sample timer retuned like the sketch does
+struct PhaseRun
+{
+    bool locked;                // locked at the end
+    unsigned long lockUs;       // time to the first lock
+    unsigned int lockedFrames;  // camera frames while locked
+    unsigned int lockedReads;   // IIC position reads while locked
+    unsigned int tornUsed;      // reads that returned success with a torn frame while locked
+    long periodErrUs;           // period estimate error at the end
+};
+
+static PhaseRun runPhaseLock(uint32_t clock, uint64_t periodNs, unsigned long seconds,
+    uint32_t startUs = 1000, uint32_t pauseUs = 0)
+{
+    Rig r;
+    testSetMicros(startUs);
+    r.begin(clock);
+    r.fake.timing(periodNs, (uint64_t)(rand() % 5000) * 1000);
+    r.cam.phaseLock(true);
+
+    PhaseRun run = {false, 0, 0, 0, 0, 0};
+    const uint64_t startNs = testNanos;
+    const uint64_t pauseNs = testNanos + seconds * 500000000ULL;
+    const uint64_t endNs = testNanos + seconds * 1000000000ULL + pauseUs * 1000ULL;
+    uint64_t tickNs = testNanos;
+    bool wasLocked = false;
+    uint32_t lockFrame = 0;
+    unsigned int lockReads = 0;
+    while(testNanos < endNs) {
+        // the timer fires, the loop sees the tick a little later
+        testNanos = max(testNanos, tickNs) + rand() % 20000;
+        const uint64_t start = testNanos;
+        const bool locked = r.cam.phaseState() == Cam::PhaseState_Locked;
+        const int result = r.atomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+        if(locked && result == Cam::Error_Success && !r.wholeFrame(start, testNanos)) {
+            ++run.tornUsed;
+        }
+        if(locked && !wasLocked) {
+            if(!run.lockUs) {
+                run.lockUs = (testNanos - startNs) / 1000;
+            }
+            lockFrame = r.fake.frameAt(testNanos);
+            lockReads = r.fake.reads();
+        } else if(!locked && wasLocked) {
+            run.lockedFrames += r.fake.frameAt(testNanos) - lockFrame;
+            run.lockedReads += r.fake.reads() - lockReads;
+        }
+        wasLocked = locked;
+
+        // the timer runs at the sample period, IrCamPhaseUpdate() retunes it when the estimate changes,
+        // when locked it restarts to the delay, while tracking the phase is kept so the sample time sweeps
+        tickNs += r.cam.phaseSamplePeriod() * 1000ULL;
+        if(r.cam.phaseChanged() && r.cam.phaseState() == Cam::PhaseState_Locked) {
+            tickNs = testNanos + min(r.cam.phaseSampleDelay(micros()), r.cam.phaseSamplePeriod()) * 1000ULL;
+        }
+
+        // the loop stops reading half way, for example in pause mode, the timer keeps running
+        if(pauseUs && testNanos >= pauseNs && tickNs < pauseNs + pauseUs * 1000ULL) {
+            testAdvance(pauseUs);
+            tickNs += (testNanos - tickNs) / (r.cam.phaseSamplePeriod() * 1000ULL) * r.cam.phaseSamplePeriod() * 1000ULL;
+        }
+    }
+    if(wasLocked) {
+        run.lockedFrames += r.fake.frameAt(testNanos) - lockFrame;
+        run.lockedReads += r.fake.reads() - lockReads;
+    }
+    run.locked = wasLocked;
+    run.periodErrUs = (long)r.cam.phasePeriod() - (long)((periodNs + 500) / 1000);
+    return run;
+}
+
+TEST(phaseLockConverges)
+{
+    // camera periods from ~4% fast to ~3% slow of the nominal 4785us, a long read at 400kHz
+    // spans a lot of the sweep so both clocks are checked
+    for(uint32_t clock : {400000UL, 1000000UL}) {
+    for(uint64_t periodUs = 4600; periodUs <= 4950; periodUs += 50) {
+        const PhaseRun run = runPhaseLock(clock, periodUs * 1000 + 370, 20);
+        CHECK(run.locked);
+        CHECK_LE(run.lockUs, 6000000);
+        CHECK_EQ(run.tornUsed, 0);
+        CHECK_LE(labs(run.periodErrUs), 2);
+
+        // one read per frame plus a compared verify read
+        const double readsPerFrame = (double)run.lockedReads / max(run.lockedFrames, 1u);
+        CHECK_LE(readsPerFrame, 1.5);
+        SamcoTestCase::report("%luHz, period %lluus: locked after %.2fs, %.2f reads per frame, period error %ldus",
+            (unsigned long)clock, (unsigned long long)periodUs, run.lockUs / 1e6, readsPerFrame, run.periodErrUs);
+    }
+    }
+}
+
+TEST(phaseDelayPastManyPeriods)
+{
+    // while tracking the sample time is the margin after the estimate, 0 before the first update,
+    // micros() values up to 2^31 after it are many periods, a time << 4 overflows 32 bits past 2^28
+    Rig r;
+    r.cam.phaseLock(true, 4785, 150);
+    unsigned int mismatches = 0;
+    for(uint64_t t = 0; t < (1ULL << 31); t += 1000003) {
+        const uint32_t now = (uint32_t)t;
+        const uint32_t expected = now < 150 ? 150 - now : 4785 - (uint32_t)((t - 150) % 4785);
+        mismatches += r.cam.phaseSampleDelay(now) != expected;
+    }
+    CHECK_EQ(mismatches, 0u);
+}
+
+TEST(phaseLockAfterLongPause)
+{
+    // the clock is past 2^28 us and the reads stop for 5 minutes while locked, the estimate
+    // is more than 2^28 us old when the reads start again and the lock comes back
+    for(uint32_t startUs : {1000u, 0x30000000u, 0xF0000000u}) {
+        const PhaseRun run = runPhaseLock(1000000, 4785370, 30, startUs, 300000000);
+        CHECK(run.locked);
+        CHECK_EQ(run.tornUsed, 0);
+        CHECK_LE(labs(run.periodErrUs), 2);
+        SamcoTestCase::report("start %lu us: locked after %.2fs, %u reads over %u frames while locked",
+            (unsigned long)startUs, run.lockUs / 1e6, run.lockedReads, run.lockedFrames);
+    }
+}
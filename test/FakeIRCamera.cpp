@@ -0,0 +1,202 @@
+/*!
+ * @file FakeIRCamera.cpp
+ * @brief Model of the DFRobot IR positioning camera on the host test IIC bus.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <string.h>
+#include "FakeIRCamera.h"
+
+// mode register, the low nibble is the data format
+constexpr uint8_t RegMode = 0x33;
+constexpr uint8_t RegControl = 0x30;
+constexpr uint8_t ControlStart = 0x08;
+
+// every point moves every frame so a torn read always differs from both frames
+static void movingScene(uint32_t frame, FakeIRCamera::Point_t* points, void* context)
+{
+    for(int i = 0; i < 4; ++i) {
+        points[i].x = 100 + (i & 1) * 600 + (int)(frame * 7 % 200);
+        points[i].y = 100 + (i >> 1) * 400 + (int)(frame * 3 % 150);
+        points[i].size = 2 + (int)(frame + i) % 4;
+        points[i].seen = true;
+    }
+}
+
+FakeIRCamera::FakeIRCamera(TwoWire& wire) : sceneFunc(movingScene), sceneContext(nullptr)
+{
+    wire.attach(Address, this);
+}
+
+uint32_t FakeIRCamera::frameAt(uint64_t ns) const
+{
+    return ns < framePhaseNs ? 0 : (uint32_t)((ns - framePhaseNs) / framePeriodNs);
+}
+
+void FakeIRCamera::points(uint32_t frame, Point_t* p) const
+{
+    sceneFunc(frame, p, sceneContext);
+}
+
+unsigned int FakeIRCamera::encode(uint32_t frame, uint8_t* data) const
+{
+    Point_t p[4];
+    points(frame, p);
+    memset(data, 0, DataMax);
+
+    // a point that isn't seen is all 1s
+    const unsigned int format = regs[RegMode] & 0x0F;
+    if(format == 1) {
+        for(int i = 0; i < 2; ++i) {
+            const Point_t& a = p[i * 2];
+            const Point_t& b = p[i * 2 + 1];
+            uint8_t* d = &data[1 + i * 5];
+            d[0] = a.seen ? a.x & 0xFF : 0xFF;
+            d[1] = a.seen ? a.y & 0xFF : 0xFF;
+            d[2] = (a.seen ? ((a.y >> 2) & 0xC0) | ((a.x >> 4) & 0x30) : 0xF0)
+                | (b.seen ? ((b.y >> 6) & 0x0C) | ((b.x >> 8) & 0x03) : 0x0F);
+            d[3] = b.seen ? b.x & 0xFF : 0xFF;
+            d[4] = b.seen ? b.y & 0xFF : 0xFF;
+        }
+        return 11;
+    }
+
+    const unsigned int stride = format == 5 ? 9 : 3;
+    for(int i = 0; i < 4; ++i) {
+        uint8_t* d = &data[1 + i * stride];
+        if(!p[i].seen) {
+            memset(d, 0xFF, stride);
+            continue;
+        }
+        d[0] = p[i].x & 0xFF;
+        d[1] = p[i].y & 0xFF;
+        d[2] = ((p[i].y >> 2) & 0xC0) | ((p[i].x >> 4) & 0x30) | (p[i].size & 0x0F);
+        if(format == 5) {
+            d[3] = (p[i].x >> 3) & 0x7F;
+            d[4] = (p[i].y >> 3) & 0x7F;
+            d[5] = ((p[i].x >> 3) + 1) & 0x7F;
+            d[6] = ((p[i].y >> 3) + 1) & 0x7F;
+            d[8] = 0x20 + p[i].size * 16;
+        }
+    }
+    return 1 + 4 * stride;
+}
+
+void FakeIRCamera::run()
+{
+    regs[RegMode] = 0x11;
+    regs[RegControl] = ControlStart;
+    isRunning = true;
+}
+
+void FakeIRCamera::pinChanged(int pin, int level)
+{
+    // the camera clocks out the rest of the byte it was sending
+    if(pin == SCL && level == HIGH && sdaClocks) {
+        --sdaClocks;
+    }
+}
+
+void FakeIRCamera::power(uint64_t ns)
+{
+    if(ns < brownOutNs) {
+        return;
+    }
+    memset(regs, 0, sizeof(regs));
+    pointer = 0;
+    isRunning = false;
+    busyUntilNs = brownOutNs + brownOutBootNs;
+    latchUntilNs = 0;
+    brownOutNs = UINT64_MAX;
+}
+
+bool FakeIRCamera::busy(uint64_t ns)
+{
+    power(ns);
+    if(ns < busyUntilNs || (!latchDrops && ns < latchUntilNs) || nackCount) {
+        if(nackCount) {
+            --nackCount;
+        }
+        ++busyCount;
+        return true;
+    }
+    return false;
+}
+
+uint8_t FakeIRCamera::write(const uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs)
+{
+    // the address isn't acknowledged while the camera is busy
+    if(busy(startNs)) {
+        return 2;
+    }
+    if(!length) {
+        return 0;
+    }
+
+    // the first byte sets the register pointer, the rest are written from there
+    pointer = data[0];
+    if(length > 1 && startNs < latchUntilNs) {
+        // still latching the last write and acknowledging anyway
+        ++droppedCount;
+        return 0;
+    }
+    if(length > 1) {
+        writeLog.push_back({startNs, data[0], std::vector<uint8_t>(data + 1, data + length)});
+        for(size_t i = 1; i < length; ++i) {
+            regs[(uint8_t)(data[0] + i - 1)] = data[i];
+        }
+        if(data[0] <= RegControl && data[0] + length - 1 > RegControl) {
+            isRunning = regs[RegControl] == ControlStart;
+            startedNs = startNs;
+        }
+        latchUntilNs = startNs + (length + 1) * byteNs + writeLatchNs;
+    }
+    return 0;
+}
+
+size_t FakeIRCamera::read(uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs)
+{
+    if(busy(startNs)) {
+        return 0;
+    }
+    if(pointer < RegPosition || pointer >= RegPosition + DataMax) {
+        for(size_t i = 0; i < length; ++i) {
+            data[i] = regs[(uint8_t)(pointer + i)];
+        }
+        return length;
+    }
+
+    ++readCount;
+
+    // each byte is from the frame when it is on the bus, after the address byte
+    const unsigned int offset = pointer - RegPosition;
+    const bool started = isRunning && startNs >= startedNs + startDelayNs;
+    const uint64_t lostNs = brownOutNs;
+    uint32_t frame = frameAt(startNs + byteNs);
+    const uint32_t firstFrame = frame;
+    uint8_t frameData[DataMax];
+    encode(frame, frameData);
+    for(size_t i = 0; i < length; ++i) {
+        const uint32_t f = frameAt(startNs + (i + 1) * byteNs);
+        if(f != frame) {
+            frame = f;
+            encode(frame, frameData);
+        }
+        // the position data reads as 0 until the camera has started
+        data[i] = started && offset + i < DataMax ? frameData[offset + i] : 0;
+        if(startNs + (i + 1) * byteNs >= lostNs) {
+            data[i] = 0xFF;
+        }
+    }
+    power(startNs + (length + 1) * byteNs);
+    if(frame != firstFrame) {
+        ++tornCount;
+    }
+    return length;
+}
@@ -0,0 +1,179 @@
+/*!
+ * @file FakeIRCamera.h
+ * @brief Model of the DFRobot IR positioning camera on the host test IIC bus.
+ * @details The camera updates the position data at its own period, independent of the reads,
+ * and each byte of a read comes from the frame at the time the byte is on the bus so a read
+ * that spans an update is torn just like the real camera. Optional busy times model the camera
+ * not acknowledging while it boots and while it latches a register write, or acknowledging
+ * and dropping writes while it latches.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _FAKEIRCAMERA_H_
+#define _FAKEIRCAMERA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <Arduino.h>
+#include <Wire.h>
+
+class FakeIRCamera : public TwoWireDevice, public TestPinModel
+{
+public:
+    /// @brief IIC address
+    static constexpr int Address = 0xB0 >> 1;
+
+    /// @brief Nominal update period, ~209Hz
+    static constexpr uint64_t PeriodNs = 1000000000ULL / 209;
+
+    /// @brief Position data register
+    static constexpr uint8_t RegPosition = 0x36;
+
+    /// @brief Longest position data, the full format
+    static constexpr unsigned int DataMax = 37;
+
+    /// @brief A point in a frame
+    typedef struct Point_s {
+        int x;
+        int y;
+        int size;
+        bool seen;
+    } Point_t;
+
+    /// @brief Fills the 4 points of a frame
+    typedef void (*Scene_t)(uint32_t frame, Point_t* points, void* context);
+
+    /// @brief A register write the camera acknowledged
+    typedef struct RegWrite_s {
+        uint64_t ns;
+        uint8_t reg;
+        std::vector<uint8_t> data;
+    } RegWrite_t;
+
+    /// @brief Attach to a bus
+    explicit FakeIRCamera(TwoWire& wire);
+
+    /// @brief Set the scene, the default moves every point every frame
+    void scene(Scene_t func, void* context = nullptr) { sceneFunc = func; sceneContext = context; }
+
+    /// @brief Set the update period and the time of the first update
+    void timing(uint64_t periodNs, uint64_t phaseNs) { framePeriodNs = periodNs; framePhaseNs = phaseNs; }
+
+    /// @brief Set the busy times, the camera doesn't acknowledge its address while busy
+    /// @param bootNs Busy from power on until this time
+    /// @param latchNs Busy for this long after each register write
+    /// @param startNs The position data reads as 0 for this long after the camera is started
+    void latency(uint64_t bootNs, uint64_t latchNs, uint64_t startNs)
+    {
+        busyUntilNs = bootNs;
+        writeLatchNs = latchNs;
+        startDelayNs = startNs;
+    }
+
+    /// @brief Acknowledge register writes while latching the last one but drop them
+    void dropWhileLatching(bool drop) { latchDrops = drop; }
+
+    /// @brief Hold SDA low part way through a byte until SCL is clocked, set testPins to this camera
+    /// for the recovery to see it, the bus is held until then
+    void holdSda(unsigned int clocks) { sdaClocks = clocks; }
+
+    /// @brief SCL clocks still needed to release SDA
+    unsigned int sdaHeld() const { return sdaClocks; }
+
+    /// @brief Don't acknowledge the next transactions
+    void nack(unsigned int count) { nackCount = count; }
+
+    /// @brief Lose power at a time, the registers reset and the camera boots again
+    /// @details Bytes of a read after the power is lost read as 1s, the lines are released to the pull ups.
+    void brownOut(uint64_t atNs, uint64_t bootNs) { brownOutNs = atNs; brownOutBootNs = bootNs; }
+
+    /// @brief Update period
+    uint64_t period() const { return framePeriodNs; }
+
+    /// @brief Frame number at a time
+    uint32_t frameAt(uint64_t ns) const;
+
+    /// @brief Time a frame starts
+    uint64_t frameStart(uint32_t frame) const { return framePhaseNs + frame * framePeriodNs; }
+
+    /// @brief Points of a frame from the scene
+    void points(uint32_t frame, Point_t* points) const;
+
+    /// @brief Position data of a frame in the current data format
+    /// @return Length of the data
+    unsigned int encode(uint32_t frame, uint8_t* data) const;
+
+    /// @brief Start the camera as if it was configured, for tests that only read
+    void run();
+
+    /// @brief True once the camera is started
+    bool running() const { return isRunning; }
+
+    /// @brief Register value
+    uint8_t reg(unsigned int r) const { return regs[r & 0xFF]; }
+
+    /// @brief Transactions that weren't acknowledged because the camera was busy or set to NACK
+    unsigned int busyNacks() const { return busyCount; }
+
+    /// @brief Register writes that were acknowledged and dropped while latching, see dropWhileLatching()
+    unsigned int droppedWrites() const { return droppedCount; }
+
+    /// @brief Register writes that were acknowledged and applied
+    const std::vector<RegWrite_t>& writes() const { return writeLog; }
+
+    /// @brief Clear the write log
+    void clearWrites() { writeLog.clear(); }
+
+    /// @brief Position reads
+    unsigned int reads() const { return readCount; }
+
+    /// @brief Position reads that spanned a frame update
+    unsigned int tornReads() const { return tornCount; }
+
+    uint8_t write(const uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs) override;
+    size_t read(uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs) override;
+    bool busHeld() override { return sdaClocks > 0; }
+
+    bool pinHeldLow(int pin) override { return pin == SDA && sdaClocks > 0; }
+    void pinChanged(int pin, int level) override;
+
+private:
+    /// @brief Reset if the power was lost before a time
+    void power(uint64_t ns);
+
+    /// @brief True if the transaction isn't acknowledged
+    bool busy(uint64_t ns);
+
+    Scene_t sceneFunc;
+    void* sceneContext;
+    uint64_t framePeriodNs = PeriodNs;
+    uint64_t framePhaseNs = 0;
+
+    uint8_t regs[256] = {};
+    uint8_t pointer = 0;
+    bool isRunning = false;
+    uint64_t busyUntilNs = 0;
+    uint64_t writeLatchNs = 0;
+    uint64_t latchUntilNs = 0;
+    bool latchDrops = false;
+    uint64_t startDelayNs = 0;
+    uint64_t startedNs = 0;
+    unsigned int busyCount = 0;
+    unsigned int droppedCount = 0;
+    unsigned int sdaClocks = 0;
+    unsigned int nackCount = 0;
+    uint64_t brownOutNs = UINT64_MAX;
+    uint64_t brownOutBootNs = 0;
+    std::vector<RegWrite_t> writeLog;
+    unsigned int readCount = 0;
+    unsigned int tornCount = 0;
+};
+
+#endif // _FAKEIRCAMERA_H_
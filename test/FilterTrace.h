@@ -0,0 +1,105 @@
+/*!
+ * @file FilterTrace.h
+ * @brief Synthetic gun traces for the position filter tests.
+ * @details Still holds with camera noise and fast smooth moves between them at the camera
+ * update rate, scored against the true position when the output reaches the display.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _FILTERTRACE_H_
+#define _FILTERTRACE_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+struct FilterTrace
+{
+    /// @brief Camera update period in microseconds
+    static constexpr double PeriodUs = 1.0e6 / 209;
+
+    std::vector<double> truth;      ///< true position each frame in mouse units
+    std::vector<int> measured;      ///< position with the camera noise
+
+    /// @brief Make a trace of still holds of 100 to 300 frames and 20 to 60 frame moves
+    /// @param seconds Length of the trace
+    /// @param noise Standard deviation of the noise in mouse units
+    FilterTrace(unsigned int seconds, double noise, unsigned int seed = 3)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::normal_distribution<double> gauss(0.0, noise);
+        const size_t frames = (size_t)(seconds * 209);
+        double pos = 2000.0;
+        while(truth.size() < frames) {
+            const int hold = 100 + (int)(uniform(rng) * 200);
+            truth.insert(truth.end(), hold, pos);
+            const double target = 500.0 + uniform(rng) * 3000.0;
+            const int length = 20 + (int)(uniform(rng) * 40);
+            for(int i = 0; i < length; ++i) {
+                const double s = (i + 1.0) / length;
+                truth.push_back(pos + (target - pos) * (3 * s * s - 2 * s * s * s));
+            }
+            pos = target;
+        }
+        truth.resize(frames);
+        for(double t : truth) {
+            measured.push_back((int)lround(t + gauss(rng)));
+        }
+    }
+
+    /// @brief Frame time in microseconds
+    static uint32_t frameUs(size_t frame) { return (uint32_t)lround(frame * PeriodUs); }
+
+    /// @brief True position a time after a frame, between frames is interpolated
+    double truthAfter(size_t frame, double us) const
+    {
+        const double f = frame + us / PeriodUs;
+        const size_t f0 = (size_t)f;
+        if(f0 + 1 >= truth.size()) {
+            return truth.back();
+        }
+        return truth[f0] + (truth[f0 + 1] - truth[f0]) * (f - f0);
+    }
+
+    /// @brief True if the gun is still around a frame
+    bool still(size_t frame) const
+    {
+        return frame >= 5 && frame + 1 < truth.size() && truth[frame] == truth[frame - 5] && truth[frame] == truth[frame + 1];
+    }
+
+    /// @brief Jitter and error of a filter output
+    struct Score
+    {
+        double jitter;      ///< RMS change of the output between frames while still
+        double moving;      ///< mean error against the true position at the display time while moving
+    };
+
+    /// @brief Score an output with the time from the position to the display
+    Score score(const std::vector<int>& out, double latencyUs) const
+    {
+        double jitter = 0.0;
+        double moving = 0.0;
+        unsigned int stillCount = 0;
+        unsigned int movingCount = 0;
+        for(size_t k = 5; k + 1 < out.size(); ++k) {
+            if(still(k)) {
+                jitter += (double)(out[k] - out[k - 1]) * (out[k] - out[k - 1]);
+                ++stillCount;
+            } else {
+                moving += fabs(out[k] - truthAfter(k, latencyUs));
+                ++movingCount;
+            }
+        }
+        return {sqrt(jitter / stillCount), moving / movingCount};
+    }
+};
+
+#endif // _FILTERTRACE_H_
@@ -0,0 +1,546 @@
+/*!
+ * @file HidReportTest.cpp
+ * @brief Host tests for the HID mouse and keyboard reports with TinyUSB and a host polling the endpoint.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <Adafruit_TinyUSB.h>
+#include <AbsMouse5.h>
+#include <BasicKeyboard.h>
+#include <map>
+#include "SamcoTest.h"
+
+// report IDs like the sketch
+constexpr uint8_t MouseId = 2;
+constexpr uint8_t KeyboardId = 1;
+
+// time a yield() takes while the HID devices wait for the host
+constexpr unsigned long YieldUs = 5;
+
+// start the clock and a host polling every period
+static void hostBegin(uint32_t pollUs)
+{
+    testSetMicros(0);
+    testYieldUs = YieldUs;
+    testHidHost.begin(pollUs);
+}
+
+// presses seen by the host in the report stream, per report ID
+static unsigned int hostMousePresses(uint8_t buttons)
+{
+    unsigned int presses = 0;
+    uint8_t last = 0;
+    for(const TestHidHost::Report_t& r : testHidHost.reports) {
+        if(r.id == MouseId) {
+            presses += __builtin_popcount(r.data[0] & ~last & buttons);
+            last = r.data[0];
+        }
+    }
+    return presses;
+}
+
+static unsigned int hostKeyPresses(uint8_t key)
+{
+    unsigned int presses = 0;
+    bool last = false;
+    for(const TestHidHost::Report_t& r : testHidHost.reports) {
+        if(r.id == KeyboardId) {
+            bool down = false;
+            for(int i = 2; i < 8; ++i) {
+                down |= r.data[i] == key;
+            }
+            presses += down && !last;
+            last = down;
+        }
+    }
+    return presses;
+}
+
+// the sketch HID task, the keyboard first but not twice in a row while the mouse waits
+static void hidTask(AbsMouse5_& mouse, BasicKeyboard_& keyboard, bool& keyboardLast)
+{
+    if(keyboardLast && mouse.commit()) {
+        keyboardLast = false;
+        return;
+    }
+    if(keyboard.commit()) {
+        keyboardLast = true;
+    } else if(mouse.commit()) {
+        keyboardLast = false;
+    }
+}
+
+TEST(mouseReportBytes)
+{
+    hostBegin(1000);
+    AbsMouse5_ mouse(MouseId);
+    mouse.init(32767, 32767, false);
+    mouse.move(0x1234, 0x0765);
+    mouse.press(MOUSE_BTN_LEFT | MOUSE_BTN_5);
+    CHECK(mouse.commit());
+    CHECK_EQ(testHidHost.reports.size(), 1u);
+    const TestHidHost::Report_t& r = testHidHost.reports[0];
+    CHECK_EQ(r.id, MouseId);
+    CHECK_EQ(r.length, 5);
+    CHECK_EQ(r.data[0], MOUSE_BTN_LEFT | MOUSE_BTN_5);
+    CHECK_EQ(r.data[1] | r.data[2] << 8, 0x1234);
+    CHECK_EQ(r.data[3] | r.data[4] << 8, 0x0765);
+    CHECK_EQ(mouse.reportCount(), 1u);
+    CHECK_EQ(mouse.savedCount(), 1u);
+    CHECK(!mouse.pending());
+}
+
+TEST(keyboardReportBytes)
+{
+    hostBegin(1000);
+    BasicKeyboard_ keyboard(KeyboardId);
+    keyboard.setAutoReport(false);
+    keyboard.press(KEY_MOD_LEFTSHIFT, KEY_A);
+    keyboard.press(KEY_B);
+    CHECK(keyboard.commit());
+    CHECK_EQ(testHidHost.reports.size(), 1u);
+    const TestHidHost::Report_t& r = testHidHost.reports[0];
+    CHECK_EQ(r.id, KeyboardId);
+    CHECK_EQ(r.length, 8);
+    CHECK_EQ(r.data[0], KEY_MOD_LEFTSHIFT);
+    CHECK_EQ(r.data[2], KEY_A);
+    CHECK_EQ(r.data[3], KEY_B);
+    CHECK_EQ(r.data[4], 0);
+    CHECK_EQ(keyboard.savedCount(), 1u);
+}
+
+TEST(commitDoesNotWaitForTheHost)
+{
+    hostBegin(1000);
+    AbsMouse5_ mouse(MouseId);
+    mouse.init(32767, 32767, false);
+    mouse.move(100, 100);
+    CHECK(mouse.commit());
+
+    // the host hasn't taken the report, the moves stay pending without blocking
+    const uint64_t start = testNanos;
+    mouse.move(200, 100);
+    CHECK(!mouse.commit());
+    mouse.move(300, 100);
+    CHECK(!mouse.commit());
+    CHECK_EQ(testNanos, start);
+    CHECK(mouse.pending());
+
+    // one report with the latest position after the poll
+    testAdvance(1000);
+    CHECK(mouse.commit());
+    CHECK(!mouse.commit());
+    CHECK_EQ(testHidHost.reports.size(), 2u);
+    CHECK_EQ(testHidHost.reports[1].data[1] | testHidHost.reports[1].data[2] << 8, 300);
+    CHECK_EQ(mouse.savedCount(), 1u);
+}
+
+TEST(quickClickKeepsItsEdges)
+{
+    hostBegin(1000);
+    AbsMouse5_ mouse(MouseId);
+    mouse.init(32767, 32767, false);
+    mouse.move(100, 100);
+    mouse.commit();
+
+    // pressed and released before the host takes a report, the press goes in its own report
+    mouse.press(MOUSE_BTN_RIGHT);
+    mouse.release(MOUSE_BTN_RIGHT);
+    mouse.press(MOUSE_BTN_RIGHT);
+    mouse.release(MOUSE_BTN_RIGHT);
+    while(mouse.pending()) {
+        testAdvance(100);
+        mouse.commit();
+    }
+    CHECK_EQ(hostMousePresses(MOUSE_BTN_RIGHT), 2u);
+    CHECK_EQ(testHidHost.reports.back().data[0], 0);
+}
+
+// 10 s of a gun loop at the camera frame rate with the trigger, a quick right click and a key
+// toggled at random every 1 ms, host polling every 2 ms, and the HID task after each change
+static void gunLoop(bool frameCommit, unsigned int seed)
+{
+    hostBegin(2000);
+    srand(seed);
+    AbsMouse5_ mouse(MouseId);
+    BasicKeyboard_ keyboard(KeyboardId);
+    mouse.init(32767, 32767, !frameCommit);
+    keyboard.setAutoReport(!frameCommit);
+
+    // time the loop waits in the HID calls
+    uint64_t blockedNs = 0;
+    const auto call = [&](auto fn) {
+        const uint64_t start = testNanos;
+        fn();
+        blockedNs += testNanos - start;
+    };
+    const auto commit = [&]() {
+        call([&]() { mouse.commit(); keyboard.commit(); });
+    };
+
+    const uint64_t endUs = 10000000;
+    uint64_t nextButtonsUs = 0;
+    uint64_t nextFrameUs = 0;
+    unsigned int presses = 0;
+    unsigned int keyPresses = 0;
+    bool trigger = false;
+    bool key = false;
+    unsigned int x = 0;
+    while(testNanos / 1000 < endUs) {
+        const uint64_t us = testNanos / 1000;
+        if(us >= nextButtonsUs) {
+            nextButtonsUs += 1000;
+            if(rand() % 50 == 0) {
+                trigger = !trigger;
+                presses += trigger;
+                call([&]() { if(trigger) mouse.press(MOUSE_BTN_LEFT); else mouse.release(MOUSE_BTN_LEFT); });
+            }
+            if(rand() % 100 == 0) {
+                key = !key;
+                keyPresses += key;
+                call([&]() { if(key) keyboard.press(KEY_A); else keyboard.release(KEY_A); });
+            }
+            if(rand() % 200 == 0) {
+                ++presses;
+                call([&]() { mouse.press(MOUSE_BTN_RIGHT); mouse.release(MOUSE_BTN_RIGHT); });
+            }
+            commit();
+        }
+        if(us >= nextFrameUs) {
+            // 209 Hz camera frames
+            nextFrameUs += 4785;
+            x = (x + 97) % 32000;
+            call([&]() { mouse.move(x, 16000); });
+            commit();
+        }
+        testAdvance(50);
+    }
+    while(mouse.pending() || keyboard.pending()) {
+        testAdvance(50);
+        mouse.commit();
+        keyboard.commit();
+    }
+
+    const unsigned int hostPresses = hostMousePresses(MOUSE_BTN_LEFT | MOUSE_BTN_RIGHT);
+    const unsigned int hostKeys = hostKeyPresses(KEY_A);
+    SamcoTestCase::report("%s seed %u: mouse %u reports %u saved, keyboard %u reports %u saved, presses %u/%u, keys %u/%u, blocked %lu us",
+        frameCommit ? "frame commit" : "auto report ", seed, mouse.reportCount(), mouse.savedCount(),
+        keyboard.reportCount(), keyboard.savedCount(), hostPresses, presses, hostKeys, keyPresses,
+        (unsigned long)(blockedNs / 1000));
+    CHECK_EQ(hostPresses, presses);
+    CHECK_EQ(hostKeys, keyPresses);
+    // only the yield after each report, neither mode waits for a poll
+    CHECK_LE(blockedNs, (uint64_t)(mouse.reportCount() + keyboard.reportCount()) * YieldUs * 1000);
+}
+
+TEST(frameCommitKeepsEveryEdge)
+{
+    for(unsigned int seed = 1; seed <= 3; ++seed) {
+        gunLoop(false, seed);
+        gunLoop(true, seed);
+    }
+}
+
+TEST(fullQueueCoalescesWithoutWaiting)
+{
+    for(bool autoReport : {false, true}) {
+        hostBegin(8000);
+        AbsMouse5_ mouse(MouseId);
+        BasicKeyboard_ keyboard(KeyboardId);
+        mouse.init(32767, 32767, autoReport);
+        keyboard.setAutoReport(autoReport);
+        mouse.move(100, 100);
+        mouse.commit();
+
+        // the left button held and 20 right clicks, and 20 key presses, before the host polls
+        const uint64_t start = testNanos;
+        mouse.press(MOUSE_BTN_LEFT);
+        for(int i = 0; i < 20; ++i) {
+            mouse.press(MOUSE_BTN_RIGHT);
+            mouse.release(MOUSE_BTN_RIGHT);
+            keyboard.press(KEY_A);
+            keyboard.release(KEY_A);
+        }
+        CHECK_EQ(testNanos, start);
+        CHECK(mouse.coalescedCount() > 0);
+        CHECK(keyboard.coalescedCount() > 0);
+
+        while(mouse.pending() || keyboard.pending()) {
+            testAdvance(1000);
+            if(!keyboard.commit()) {
+                mouse.commit();
+            }
+        }
+        SamcoTestCase::report("%s: mouse %u clicks coalesced, keyboard %u presses coalesced",
+            autoReport ? "auto report " : "frame commit", mouse.coalescedCount(), keyboard.coalescedCount());
+        // each merge drops a click the host hasn't seen, the rest keep their edges
+        CHECK_EQ(hostMousePresses(MOUSE_BTN_LEFT), 1u);
+        CHECK_EQ(hostMousePresses(MOUSE_BTN_RIGHT), 20u - mouse.coalescedCount());
+        CHECK_EQ(hostKeyPresses(KEY_A), 20u - keyboard.coalescedCount());
+        const TestHidHost::Report_t& last = testHidHost.reports[testHidHost.reports.size() - (testHidHost.reports.back().id == MouseId ? 1 : 2)];
+        CHECK_EQ(last.data[0], MOUSE_BTN_LEFT);
+    }
+}
+
+TEST(suspendedCommitWakesTheHost)
+{
+    hostBegin(1000);
+    AbsMouse5_ mouse(MouseId);
+    BasicKeyboard_ keyboard(KeyboardId);
+    mouse.init(32767, 32767, false);
+    keyboard.setAutoReport(false);
+    mouse.move(100, 100);
+    CHECK(mouse.commit());
+    testAdvance(1000);
+
+    // suspended, commit asks for a wakeup and returns without waiting for the bus to resume
+    testHidHost.suspend();
+    mouse.move(200, 100);
+    mouse.press(MOUSE_BTN_LEFT);
+    keyboard.press(KEY_A);
+    const uint64_t start = testNanos;
+    CHECK(!mouse.commit());
+    CHECK(!keyboard.commit());
+    CHECK_EQ(testNanos, start);
+    CHECK_EQ(testHidHost.wakeups, 2u);
+    CHECK_EQ(testHidHost.reports.size(), 1u);
+    CHECK(mouse.pending());
+    CHECK(keyboard.pending());
+
+    // the reports go once the host resumes the bus
+    while(testHidHost.suspended()) {
+        testAdvance(1000);
+        mouse.commit();
+        keyboard.commit();
+    }
+    CHECK_LE(testNanos - start, (uint64_t)(testHidHost.wakeupUs + 1000) * 1000);
+    for(int i = 0; i < 4 && (mouse.pending() || keyboard.pending()); ++i) {
+        testAdvance(1000);
+        if(!keyboard.commit()) {
+            mouse.commit();
+        }
+    }
+    CHECK(!mouse.pending());
+    CHECK(!keyboard.pending());
+    CHECK_EQ(hostMousePresses(MOUSE_BTN_LEFT), 1u);
+    CHECK_EQ(hostKeyPresses(KEY_A), 1u);
+    const TestHidHost::Report_t& last = testHidHost.reports[testHidHost.reports.size() - (testHidHost.reports.back().id == MouseId ? 1 : 2)];
+    CHECK_EQ(last.id, MouseId);
+    CHECK_EQ(last.data[1] | last.data[2] << 8, 200);
+}
+
+// 20 s of the gun loop with buttons toggling every edgeMs on average, a press and release of the
+// middle button in the same millisecond now and then, and the HID task on every pass
+static void slowPoller(uint32_t pollUs, unsigned int edgeMs)
+{
+    // about 3.5 edges every edgeMs, the host keeps up with room to spare at 4 polls per edgeMs
+    const bool keepsUp = edgeMs * 1000 > 4 * pollUs;
+    bool keyboardLast = false;
+    hostBegin(pollUs);
+    srand(pollUs + edgeMs);
+    AbsMouse5_ mouse(MouseId);
+    BasicKeyboard_ keyboard(KeyboardId);
+    mouse.init(32767, 32767, false);
+    keyboard.setAutoReport(false);
+
+    // the time each position was set, the positions don't repeat in the run
+    std::map<unsigned int, uint64_t> moveUs;
+    unsigned int toggles[2] = {0, 0};
+    unsigned int keyToggles = 0;
+    uint8_t buttons = 0;
+    bool key = false;
+    uint64_t nextButtonsUs = 0;
+    uint64_t nextFrameUs = 0;
+    unsigned int x = 0;
+    uint64_t blockedNs = 0;
+    while(testNanos / 1000 < 20000000) {
+        const uint64_t us = testNanos / 1000;
+        if(us >= nextButtonsUs) {
+            nextButtonsUs += 1000;
+            for(int b = 0; b < 2; ++b) {
+                if(rand() % edgeMs == 0) {
+                    buttons ^= 1 << b;
+                    ++toggles[b];
+                    if(buttons & (1 << b)) {
+                        mouse.press(1 << b);
+                    } else {
+                        mouse.release(1 << b);
+                    }
+                }
+            }
+            if(rand() % (edgeMs * 4) == 0) {
+                mouse.press(MOUSE_BTN_MIDDLE);
+                mouse.release(MOUSE_BTN_MIDDLE);
+            }
+            if(rand() % edgeMs == 0) {
+                key = !key;
+                ++keyToggles;
+                if(key) {
+                    keyboard.press(KEY_A);
+                } else {
+                    keyboard.release(KEY_A);
+                }
+            }
+        }
+        if(us >= nextFrameUs) {
+            nextFrameUs += 4785;
+            x = (x + 7) % 32000;
+            mouse.move(x, 100);
+            moveUs[x] = testNanos / 1000;
+        }
+        // the HID task on every pass
+        const uint64_t start = testNanos;
+        hidTask(mouse, keyboard, keyboardLast);
+        blockedNs += testNanos - start;
+        testAdvance(50);
+    }
+    while(mouse.pending() || keyboard.pending()) {
+        testAdvance(50);
+        hidTask(mouse, keyboard, keyboardLast);
+    }
+
+    // the host view of the report stream, a position is stale from the time a newer one is set
+    // until the host takes a report with a newer one
+    unsigned int hostToggles[3] = {0, 0, 0};
+    unsigned int hostKeyToggles = 0;
+    uint8_t lastButtons = 0;
+    bool lastKey = false;
+    uint64_t maxStaleUs = 0;
+    for(const TestHidHost::Report_t& r : testHidHost.reports) {
+        if(r.id == MouseId) {
+            for(int b = 0; b < 3; ++b) {
+                hostToggles[b] += ((r.data[0] ^ lastButtons) >> b) & 1;
+            }
+            lastButtons = r.data[0];
+            const auto it = moveUs.find(r.data[1] | r.data[2] << 8);
+            CHECK(it != moveUs.end());
+            if(it != moveUs.end() && next(it) != moveUs.end() && next(it)->second < r.takenUs) {
+                maxStaleUs = max(maxStaleUs, r.takenUs - next(it)->second);
+            }
+        } else {
+            bool down = false;
+            for(int i = 2; i < 8; ++i) {
+                down |= r.data[i] == KEY_A;
+            }
+            hostKeyToggles += down != lastKey;
+            lastKey = down;
+        }
+    }
+    SamcoTestCase::report("poll %lu us, edges 1/%u ms: left %u/%u, right %u/%u, middle %u toggles, key %u/%u, mouse %u reports %u saved %u coalesced, keyboard %u coalesced, stale %lu us, blocked %lu us",
+        (unsigned long)pollUs, edgeMs, hostToggles[0], toggles[0], hostToggles[1], toggles[1], hostToggles[2],
+        hostKeyToggles, keyToggles, mouse.reportCount(), mouse.savedCount(), mouse.coalescedCount(),
+        keyboard.coalescedCount(), (unsigned long)maxStaleUs, (unsigned long)(blockedNs / 1000));
+    // each middle click is a press and a release
+    CHECK_EQ(hostToggles[2] % 2, 0u);
+    // only the yield after each report, never a wait for the host
+    CHECK_LE(blockedNs, (uint64_t)(mouse.reportCount() + keyboard.reportCount()) * YieldUs * 1000);
+    if(keepsUp) {
+        CHECK_EQ(mouse.coalescedCount(), 0u);
+        CHECK_EQ(keyboard.coalescedCount(), 0u);
+        CHECK_EQ(hostToggles[0], toggles[0]);
+        CHECK_EQ(hostToggles[1], toggles[1]);
+        CHECK_EQ(hostKeyToggles, keyToggles);
+        CHECK_LE(maxStaleUs, (uint64_t)pollUs);
+    } else {
+        // too many edges for the host, merged changes drop press and release pairs
+        // and the mouse and keyboard share the polls
+        CHECK_LE(hostToggles[0], toggles[0]);
+        CHECK_LE(hostToggles[1], toggles[1]);
+        CHECK_LE(hostKeyToggles, keyToggles);
+        CHECK_EQ((toggles[0] - hostToggles[0]) % 2, 0u);
+        CHECK_EQ((toggles[1] - hostToggles[1]) % 2, 0u);
+        CHECK_EQ((keyToggles - hostKeyToggles) % 2, 0u);
+        CHECK_LE(maxStaleUs, (uint64_t)pollUs * 2);
+        CHECK(mouse.reportCount() * 3 >= 20000000 / pollUs);
+    }
+}
+
+// 20 s of the gun loop with the trigger and right button toggling every 0.5 ms on average,
+// far more edges than the host can take, and the USB task committing on every pass
+static void overflowPoller(uint32_t pollUs)
+{
+    hostBegin(pollUs);
+    srand(pollUs);
+    AbsMouse5_ mouse(MouseId);
+    mouse.init(32767, 32767, false);
+
+    std::map<unsigned int, uint64_t> moveUs;
+    unsigned int toggles = 0;
+    uint8_t buttons = 0;
+    uint64_t nextFrameUs = 0;
+    unsigned int x = 0;
+    uint64_t blockedNs = 0;
+    while(testNanos / 1000 < 20000000) {
+        const uint64_t us = testNanos / 1000;
+        const uint64_t start = testNanos;
+        if(rand() % 10 == 0) {
+            const uint8_t b = 1 << (rand() % 2);
+            buttons ^= b;
+            ++toggles;
+            if(buttons & b) {
+                mouse.press(b);
+            } else {
+                mouse.release(b);
+            }
+        }
+        if(us >= nextFrameUs) {
+            nextFrameUs += 4785;
+            x = (x + 7) % 32000;
+            mouse.move(x, 100);
+            moveUs[x] = testNanos / 1000;
+        }
+        mouse.commit();
+        blockedNs += testNanos - start;
+        testAdvance(50);
+    }
+    while(mouse.pending()) {
+        testAdvance(50);
+        mouse.commit();
+    }
+
+    unsigned int hostToggles = 0;
+    uint8_t lastButtons = 0;
+    uint64_t maxStaleUs = 0;
+    for(const TestHidHost::Report_t& r : testHidHost.reports) {
+        hostToggles += __builtin_popcount(r.data[0] ^ lastButtons);
+        lastButtons = r.data[0];
+        const auto it = moveUs.find(r.data[1] | r.data[2] << 8);
+        if(it != moveUs.end() && next(it) != moveUs.end() && next(it)->second < r.takenUs) {
+            maxStaleUs = max(maxStaleUs, r.takenUs - next(it)->second);
+        }
+    }
+    SamcoTestCase::report("poll %lu us: toggles %u/%u, %u coalesced, %u reports, stale %lu us, blocked %lu us",
+        (unsigned long)pollUs, hostToggles, toggles, mouse.coalescedCount(), mouse.reportCount(),
+        (unsigned long)maxStaleUs, (unsigned long)(blockedNs / 1000));
+    CHECK(mouse.coalescedCount() > 0);
+    // merged changes drop press and release pairs, the host ends with the same buttons
+    CHECK_LE(hostToggles, toggles);
+    CHECK_EQ((toggles - hostToggles) % 2, 0u);
+    CHECK_EQ(lastButtons, buttons);
+    // only the yield after each report, the press and release never wait for the host
+    CHECK_LE(blockedNs, (uint64_t)mouse.reportCount() * YieldUs * 1000);
+    CHECK_LE(maxStaleUs, (uint64_t)pollUs);
+}
+
+TEST(slowPollerOverflowCoalesces)
+{
+    for(uint32_t pollUs : {4000u, 8000u}) {
+        overflowPoller(pollUs);
+    }
+}
+
+TEST(slowPollerKeepsEdgesAndFreshPosition)
+{
+    for(uint32_t pollUs : {1000u, 2000u, 4000u, 8000u}) {
+        for(unsigned int edgeMs : {50u, 20u, 5u}) {
+            slowPoller(pollUs, edgeMs);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/*!
+ * @file LedScene.h
+ * @brief Synthetic 4 LED frames for the position engine tests.
+ * @details A frame is the LED rectangle in camera pixels, rounded like the camera and with the LEDs
+ * outside the camera view not seen. The position engines mirror X, so the LED the engines call
+ * top left is the top right LED in the camera.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _LEDSCENE_H_
+#define _LEDSCENE_H_
+
+#include <math.h>
+#include <SamcoConst.h>
+
+struct LedFrame
+{
+    /// @brief True positions in camera pixels, top left, top right, bottom left, bottom right in the camera
+    double x[4];
+    double y[4];
+
+    /// @brief Camera points in camera slot order, and the seen flags
+    int px[4];
+    int py[4];
+    unsigned int seen;
+
+    /// @brief Camera slot of each LED, -1 if not seen
+    int slot[4];
+
+    /// @brief Place the LEDs on a rectangle with a center, half size and rotation
+    void rectangle(double cx, double cy, double hw, double hh, double rot)
+    {
+        static const int sx[4] = {-1, 1, -1, 1};
+        static const int sy[4] = {-1, -1, 1, 1};
+        const double c = cos(rot);
+        const double s = sin(rot);
+        for(int i = 0; i < 4; ++i) {
+            x[i] = cx + sx[i] * hw * c - sy[i] * hh * s;
+            y[i] = cy + sx[i] * hw * s + sy[i] * hh * c;
+        }
+    }
+
+    /// @brief Place the LEDs at the corners of a 4:3 screen seen by a pinhole camera aimed at a point
+    /// @param gx Gun position across the screen in screen widths from the center, positive is right
+    /// @param gy Gun position down the screen in screen widths from the center
+    /// @param gz Gun distance from the screen in screen widths
+    /// @param u Aim point across the screen, 0 is the left edge and 1 is the right edge
+    /// @param v Aim point down the screen, 0 is the top edge and 1 is the bottom edge
+    /// @param focal Camera focal length in pixels
+    void pinhole(double gx, double gy, double gz, double u, double v, double focal = 1000.0)
+    {
+        static const double sx[4] = {-0.5, 0.5, -0.5, 0.5};
+        static const double sy[4] = {-0.375, -0.375, 0.375, 0.375};
+
+        // camera axes, forward to the aim point, right level with the screen, down from those
+        double fx = u - 0.5 - gx;
+        double fy = (v - 0.5) * 0.75 - gy;
+        double fz = gz;
+        const double fl = sqrt(fx * fx + fy * fy + fz * fz);
+        fx /= fl;
+        fy /= fl;
+        fz /= fl;
+        const double rl = sqrt(fz * fz + fx * fx);
+        const double rx = fz / rl;
+        const double rz = -fx / rl;
+        const double dx = fy * rz;
+        const double dy = fz * rx - fx * rz;
+        const double dz = -fy * rx;
+        for(int i = 0; i < 4; ++i) {
+            const double px = sx[i] - gx;
+            const double py = sy[i] - gy;
+            const double pz = gz;
+            const double z = px * fx + py * fy + pz * fz;
+            x[i] = CamResX / 2 + focal * (px * rx + pz * rz) / z;
+            y[i] = CamResY / 2 + focal * (px * dx + py * dy + pz * dz) / z;
+        }
+    }
+
+    /// @brief Round the LEDs in view to camera points, in slot order if given
+    void capture(const int* order = nullptr)
+    {
+        seen = 0;
+        for(int k = 0; k < 4; ++k) {
+            const int i = order ? order[k] : k;
+            slot[i] = -1;
+            px[k] = 0x3FF;
+            py[k] = 0x3FF;
+            if(x[i] >= 0 && x[i] < CamResX && y[i] >= 0 && y[i] < CamResY) {
+                px[k] = lround(x[i]);
+                py[k] = lround(y[i]);
+                slot[i] = k;
+                seen |= 1 << k;
+            }
+        }
+    }
+
+    /// @brief Number of LEDs in view
+    unsigned int count() const { return __builtin_popcount(seen); }
+
+    /// @brief Camera LED for an engine LED index, the engines mirror X
+    static int cameraLed(int index) { return index ^ 1; }
+
+    /// @brief True position of an engine LED in mouse units
+    double mouseX(int index) const { return MouseMaxX - x[cameraLed(index)] * CamToMouseMult; }
+    double mouseY(int index) const { return y[cameraLed(index)] * CamToMouseMult; }
+};
+
+#endif // _LEDSCENE_H_
@@ -0,0 +1,281 @@
+/*!
+ * @file SamcoDualCameraTest.cpp
+ * @brief Host tests for two IR cameras read in turn with their points fused.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <math.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <SamcoDualCamera.h>
+#include "FakeIRCamera.h"
+#include "SamcoTest.h"
+
+typedef DFRobotIRPositionEx Cam;
+
+// the LED rectangle swept sideways over time, as one camera sees it
+struct Scene
+{
+    const FakeIRCamera* fake = nullptr;
+
+    // moves the rectangle, the second camera's view of the same LEDs
+    double dx = 0;
+    double dy = 0;
+
+    // sideways sweep in pixels per second
+    double speed = 0;
+
+    // camera LEDs out of view, a bit per LED
+    unsigned int hidden = 0;
+
+    double x(int led, double s) const { return (led & 1 ? 623 : 400) - 200 + dx + speed * s; }
+    double y(int led) const { return (led & 2 ? 568 : 200) + dy; }
+};
+
+static void sceneFrame(uint32_t frame, FakeIRCamera::Point_t* points, void* context)
+{
+    const Scene& scene = *(const Scene*)context;
+    const double s = scene.fake->frameStart(frame) * 1e-9;
+    for(int i = 0; i < 4; ++i) {
+        points[i].x = lround(scene.x(i, s));
+        points[i].y = lround(scene.y(i));
+        points[i].size = 4;
+        points[i].seen = !(scene.hidden & (1 << i));
+    }
+}
+
+// two cameras on their own buses, the second camera's bus can be left empty
+struct Rig
+{
+    TwoWire wire1;
+    TwoWire wire2;
+    TwoWire empty;
+    FakeIRCamera fake1;
+    FakeIRCamera fake2;
+    Cam cam1;
+    Cam cam2;
+    SamcoDualCamera dual;
+    Scene scene1;
+    Scene scene2;
+
+    explicit Rig(bool second = true) : fake1(wire1), fake2(wire2), cam1(wire1), cam2(second ? wire2 : empty), dual(cam1, cam2)
+    {
+        testSetMicros(1000);
+        testYieldUs = 10;
+        scene1.fake = &fake1;
+        scene2.fake = &fake2;
+        fake1.scene(sceneFrame, &scene1);
+        fake2.scene(sceneFrame, &scene2);
+        // the second camera updates half a frame after the first
+        fake2.timing(FakeIRCamera::PeriodNs, FakeIRCamera::PeriodNs / 2);
+    }
+
+    ~Rig()
+    {
+        testYieldUs = 0;
+    }
+
+    void begin()
+    {
+        dual.beginConfig(400000, Cam::DataFormat_Basic, Cam::Sensitivity_Default);
+        while(!dual.pollConfig()) {
+            yield();
+        }
+    }
+
+    // read at the sketch's timer rate, twice the camera rate with both cameras
+    int tick()
+    {
+        const uint64_t next = testNanos + FakeIRCamera::PeriodNs / dual.count();
+        const int error = dual.readAtomic(Cam::DataFormat_Basic, Cam::Retry_1s);
+        testAdvanceNs(next - testNanos);
+        return error;
+    }
+};
+
+// largest error of the fused points from the first camera's view of the LEDs, in camera pixels
+static double fusedError(const Rig& r, double s)
+{
+    double worst = 0;
+    for(int i = 0; i < 4; ++i) {
+        if(r.dual.seen() & (1 << i)) {
+            // the engines mirror X, so the fused top left is the top right LED in the camera
+            const int led = i ^ 1;
+            worst = max(worst, max(fabs(r.dual.xPositions()[i] - r.scene1.x(led, s)), fabs(r.dual.yPositions()[i] - r.scene1.y(led))));
+        }
+    }
+    return worst;
+}
+
+TEST(configBoth)
+{
+    Rig r;
+    r.begin();
+    CHECK_EQ(r.cam1.configResult(), Cam::Error_Success);
+    CHECK_EQ(r.cam2.configResult(), Cam::Error_Success);
+    CHECK_EQ(r.dual.count(), 2u);
+    CHECK(r.fake1.running());
+    CHECK(r.fake2.running());
+
+    // a sensitivity change goes to both cameras between the reads
+    r.fake1.clearWrites();
+    r.fake2.clearWrites();
+    r.dual.queueSensitivity(Cam::Sensitivity_Max);
+    for(unsigned int i = 0; i < 20; ++i) {
+        CHECK(r.tick() >= Cam::Error_Success);
+    }
+    CHECK(!r.cam1.configPending());
+    CHECK(!r.cam2.configPending());
+    CHECK_EQ(r.fake1.writes().size(), 2);
+    CHECK_EQ(r.fake2.writes().size(), 2);
+    for(unsigned int reg = 0; reg < 0x20; ++reg) {
+        CHECK_EQ(r.fake1.reg(reg), r.fake2.reg(reg));
+    }
+}
+
+TEST(configOneCamera)
+{
+    // without the second camera only the first is read
+    Rig r(false);
+    r.begin();
+    CHECK_EQ(r.cam1.configResult(), Cam::Error_Success);
+    CHECK_EQ(r.cam2.configResult(), Cam::Error_IICerror);
+    CHECK_EQ(r.dual.count(), 1u);
+
+    r.dual.queueSensitivity(Cam::Sensitivity_Max);
+    CHECK(!r.cam2.configPending());
+    const unsigned int reads = r.fake1.reads();
+    for(unsigned int i = 0; i < 20; ++i) {
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+        CHECK_EQ(r.dual.active(), 0u);
+        CHECK_EQ(r.dual.seen(), 0x0Fu);
+    }
+    CHECK(r.fake1.reads() >= reads + 40);
+    CHECK(!r.cam1.configPending());
+
+    // the points are the camera's points, in LED order
+    CHECK(r.dual.filled() == 0);
+    CHECK(fusedError(r, 0) <= 0.5);
+}
+
+TEST(alternateReads)
+{
+    Rig r;
+    r.begin();
+    unsigned int reads[2] = {0, 0};
+    // the first read is of the second camera
+    unsigned int last = 0;
+    bool alternate = true;
+    for(unsigned int i = 0; i < 100; ++i) {
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+        alternate = alternate && r.dual.active() != last;
+        last = r.dual.active();
+        ++reads[last];
+    }
+    CHECK(alternate);
+    CHECK_EQ(reads[0], 50u);
+    CHECK_EQ(reads[1], 50u);
+}
+
+TEST(offsetLearned)
+{
+    Rig r;
+    r.scene1.speed = 100;
+    r.scene2.speed = 100;
+    r.scene2.dx = -120;
+    r.scene2.dy = 35;
+    r.begin();
+    CHECK(!r.dual.offsetLearned());
+    CHECK_EQ(r.tick(), Cam::Error_Success);
+    CHECK(!r.dual.offsetLearned());
+    for(unsigned int i = 0; i < 100; ++i) {
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+    }
+    SamcoTestCase::report("offset %d, %d in 1/4 pixels", r.dual.offsetX(), r.dual.offsetY());
+    CHECK(r.dual.offsetLearned());
+    // the sweep moves the LEDs a pixel between the reads of the two cameras
+    CHECK_NEAR(r.dual.offsetX(), 120 * CamToMouseMult, CamToMouseMult * 1.5);
+    CHECK_NEAR(r.dual.offsetY(), -35 * CamToMouseMult, CamToMouseMult / 2);
+
+    // the second camera's points are in the view of the first
+    double worst = 0;
+    for(unsigned int i = 0; i < 100; ++i) {
+        const uint64_t startNs = testNanos;
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+        CHECK_EQ(r.dual.seen(), 0x0Fu);
+        if(r.dual.active()) {
+            worst = max(worst, fusedError(r, r.fake2.frameStart(r.fake2.frameAt(startNs)) * 1e-9));
+        }
+    }
+    SamcoTestCase::report("second camera error %.2f pixels", worst);
+    CHECK(worst <= 1.5);
+}
+
+TEST(fillLostLeds)
+{
+    Rig r;
+    r.scene2.dx = 80;
+    r.scene2.dy = -20;
+    r.begin();
+    for(unsigned int i = 0; i < 20; ++i) {
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+    }
+    CHECK(r.dual.offsetLearned());
+
+    // the first camera loses its top right LED, the fused top left, and the second camera fills it in
+    r.scene1.hidden = 0x02;
+    for(unsigned int i = 0; i < 20; ++i) {
+        CHECK_EQ(r.tick(), Cam::Error_Success);
+        CHECK_EQ(r.dual.seen(), 0x0Fu);
+        CHECK_EQ(r.dual.filled(), r.dual.active() ? 0u : 0x01u);
+        CHECK(fusedError(r, 0) <= 0.5);
+    }
+
+    // the other camera's read is too old to fill in
+    r.tick();
+    CHECK_EQ(r.dual.active(), 1u);
+    testAdvance(SamcoDualCamera::MaxAgeUs);
+    CHECK_EQ(r.tick(), Cam::Error_Success);
+    CHECK_EQ(r.dual.active(), 0u);
+    CHECK_EQ(r.dual.seen(), 0x0Eu);
+    CHECK_EQ(r.dual.filled(), 0u);
+
+    // and a failed read of the second camera isn't used
+    r.fake2.nack(100);
+    r.tick();
+    CHECK_EQ(r.dual.active(), 1u);
+    CHECK(r.dual.atomicResult() < Cam::Error_Success);
+    CHECK_EQ(r.tick(), Cam::Error_Success);
+    CHECK_EQ(r.dual.seen(), 0x0Eu);
+}
+
+TEST(sampleRate)
+{
+    // the LEDs sweep 3 pixels each camera frame, count the reads with new points
+    unsigned int updates[2] = {0, 0};
+    for(unsigned int second = 0; second < 2; ++second) {
+        Rig r(second);
+        r.scene1.speed = 600;
+        r.scene2.speed = 600;
+        r.scene2.dx = 10;
+        r.begin();
+        int lastX = -1;
+        const unsigned long start = micros();
+        while(micros() - start < 500000) {
+            if(r.tick() == Cam::Error_Success && r.dual.seen() == 0x0F && r.dual.xPositions()[0] != lastX) {
+                lastX = r.dual.xPositions()[0];
+                ++updates[second];
+            }
+        }
+    }
+    SamcoTestCase::report("new points in 0.5 s: one camera %u, two cameras %u", updates[0], updates[1]);
+    CHECK_NEAR(updates[0], 209 / 2, 3);
+    // a few reads round to the same points as the read before
+    CHECK(updates[1] >= updates[0] * 19 / 10);
+}
@@ -0,0 +1,409 @@
+/*!
+ * @file SamcoFilterTest.cpp
+ * @brief Host tests for the position filters with synthetic gun traces.
+ * @details Built twice, SamcoFilterFixedTest has the fixed-point maths of the boards without an FPU.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <time.h>
+#include <Arduino.h>
+#include <SamcoFilter.h>
+#include "FilterTrace.h"
+#include "SamcoTest.h"
+
+// time from the position to the display like the sketch measures it, the IIC read, half a camera frame
+// for the average age of the exposure and the USB poll
+constexpr uint32_t LatencyUs = 1200 + 500000 / 209 + 1000;
+
+// the sketch defaults, gains * 256
+constexpr unsigned int PredictAlpha = 128;
+constexpr unsigned int PredictBeta = 32;
+
+// the sketch One-Euro defaults, 1Hz and 0.02
+constexpr unsigned int EuroMinCutoff = 20;
+constexpr unsigned int EuroBeta = 40;
+
+#ifdef SAMCO_POSITION_FIXED
+static const char* const Build = "fixed-point";
+#else
+static const char* const Build = "floating point";
+#endif // SAMCO_POSITION_FIXED
+
+// the averaging run modes for comparison
+static std::vector<int> average(const FilterTrace& trace)
+{
+    std::vector<int> out;
+    int arr[2] = {0, 0};
+    int index = 0;
+    for(int m : trace.measured) {
+        index ^= 1;
+        arr[index] = m;
+        out.push_back((arr[0] + arr[1]) / 2);
+    }
+    return out;
+}
+
+static std::vector<int> average2(const FilterTrace& trace)
+{
+    std::vector<int> out;
+    int arr[3] = {0, 0, 0};
+    int index = 0;
+    for(int m : trace.measured) {
+        index = index < 2 ? index + 1 : 0;
+        arr[index] = m;
+        out.push_back((m + arr[0] + arr[1] + arr[1] + 2) / 4);
+    }
+    return out;
+}
+
+static std::vector<int> predict(const FilterTrace& trace, unsigned int alpha, unsigned int beta)
+{
+    SamcoPredictFilter filter;
+    std::vector<int> out;
+    for(size_t k = 0; k < trace.measured.size(); ++k) {
+        int x = trace.measured[k];
+        int y = 0;
+        filter.apply(x, y, FilterTrace::frameUs(k), alpha, beta, LatencyUs);
+        out.push_back(x);
+    }
+    return out;
+}
+
+TEST(predictLeadsTheLatency)
+{
+    const FilterTrace trace(20, 6.0);
+    const FilterTrace::Score normal = trace.score(trace.measured, LatencyUs);
+    const FilterTrace::Score avg = trace.score(average(trace), LatencyUs);
+    const FilterTrace::Score avg2 = trace.score(average2(trace), LatencyUs);
+    const FilterTrace::Score pred = trace.score(predict(trace, PredictAlpha, PredictBeta), LatencyUs);
+    SamcoTestCase::report("Normal: jitter RMS %.1f, moving error %.0f", normal.jitter, normal.moving);
+    SamcoTestCase::report("Averaging: jitter RMS %.1f, moving error %.0f", avg.jitter, avg.moving);
+    SamcoTestCase::report("Averaging2: jitter RMS %.1f, moving error %.0f", avg2.jitter, avg2.moving);
+    SamcoTestCase::report("Predict: jitter RMS %.1f, moving error %.0f", pred.jitter, pred.moving);
+
+    // less lag than any of the other modes, and less jitter than no filter
+    CHECK(pred.moving < normal.moving * 0.8);
+    CHECK(pred.moving < avg.moving);
+    CHECK(pred.moving < avg2.moving);
+    CHECK(pred.jitter < normal.jitter);
+}
+
+TEST(predictRestarts)
+{
+    // the first position and a position after a gap pass through with the velocity cleared
+    SamcoPredictFilter filter;
+    int x = 1000, y = 500;
+    filter.apply(x, y, 1000, PredictAlpha, PredictBeta, LatencyUs);
+    CHECK_EQ(x, 1000);
+    CHECK_EQ(y, 500);
+    uint32_t us = 1000;
+    for(int i = 1; i <= 20; ++i) {
+        us += 4785;
+        x = 1000 + i * 20;
+        y = 500;
+        filter.apply(x, y, us, PredictAlpha, PredictBeta, LatencyUs);
+    }
+    // moving right at 20 per frame, so the output leads by about a frame
+    CHECK(x > 1000 + 20 * 20 + 10);
+    CHECK_EQ(y, 500);
+
+    us += SamcoPredictFilter::ResetUs + 1;
+    x = 3000;
+    y = 2000;
+    filter.apply(x, y, us, PredictAlpha, PredictBeta, LatencyUs);
+    CHECK_EQ(x, 3000);
+    us += 4785;
+    x = 3000;
+    y = 2000;
+    filter.apply(x, y, us, PredictAlpha, PredictBeta, LatencyUs);
+    CHECK_EQ(x, 3000);
+    CHECK_EQ(y, 2000);
+
+    // reset() also starts over, even across the 32 bit micros() wrap
+    filter.reset();
+    us = 0xFFFFF000u;
+    x = 100;
+    filter.apply(x, y, us, PredictAlpha, PredictBeta, LatencyUs);
+    us += 4785;
+    x = 120;
+    filter.apply(x, y, us, PredictAlpha, PredictBeta, LatencyUs);
+    CHECK(x > 110 && x < 140);
+}
+
+static std::vector<int> euro(const FilterTrace& trace, unsigned int minCutoff, unsigned int beta)
+{
+    SamcoEuroFilter filter;
+    std::vector<int> out;
+    for(size_t k = 0; k < trace.measured.size(); ++k) {
+        int x = trace.measured[k];
+        int y = 0;
+        filter.apply(x, y, FilterTrace::frameUs(k), minCutoff, beta);
+        out.push_back(x);
+    }
+    return out;
+}
+
+TEST(euroAlpha)
+{
+    // 1 / (1 + tau / Te) where tau = 1 / (2 pi fc), the cutoff is in 0.05Hz steps
+    for(uint32_t cutoff : {1u, 20u, 100u, 1000u, 20000u}) {
+        for(uint32_t periodUs : {1000u, 4785u, 50000u}) {
+            const double w = 2.0 * PI * cutoff * 0.05 * periodUs * 1.0e-6;
+            const double expect = w / (w + 1.0);
+#ifdef SAMCO_POSITION_FIXED
+            CHECK_NEAR(SamcoEuroFilter::Alpha(cutoff, periodUs) / 65536.0, expect, 2.0 / 65536);
+#else
+            CHECK_NEAR(SamcoEuroFilter::Alpha(cutoff, periodUs), expect, 1.0e-6);
+#endif // SAMCO_POSITION_FIXED
+        }
+    }
+}
+
+TEST(euroSmoothsWhileStill)
+{
+    const FilterTrace trace(20, 6.0);
+    const FilterTrace::Score normal = trace.score(trace.measured, LatencyUs);
+    const FilterTrace::Score avg2 = trace.score(average2(trace), LatencyUs);
+    const FilterTrace::Score defaults = trace.score(euro(trace, EuroMinCutoff, EuroBeta), LatencyUs);
+    const FilterTrace::Score fast = trace.score(euro(trace, EuroMinCutoff, EuroBeta * 4), LatencyUs);
+    SamcoTestCase::report("%s One-Euro defaults: jitter RMS %.2f, moving error %.1f", Build, defaults.jitter, defaults.moving);
+    SamcoTestCase::report("%s One-Euro beta x4: jitter RMS %.2f, moving error %.1f", Build, fast.jitter, fast.moving);
+
+    // smoother than any averaging while still, a larger beta trades some of that for less lag
+    CHECK(defaults.jitter < avg2.jitter * 0.7);
+    CHECK(defaults.jitter < normal.jitter * 0.4);
+    CHECK(fast.moving < defaults.moving);
+    CHECK(fast.jitter >= defaults.jitter);
+}
+
+TEST(euroRestarts)
+{
+    // the first position and a position after a gap pass through
+    SamcoEuroFilter filter;
+    int x = 1000, y = 500;
+    filter.apply(x, y, 1000, EuroMinCutoff, EuroBeta);
+    CHECK_EQ(x, 1000);
+    CHECK_EQ(y, 500);
+    x = 1010;
+    filter.apply(x, y, 1000 + 4785, EuroMinCutoff, EuroBeta);
+    CHECK(x > 1000 && x < 1010);
+    x = 3000;
+    y = 2000;
+    filter.apply(x, y, 1000 + 4785 + SamcoEuroFilter::ResetUs + 1, EuroMinCutoff, EuroBeta);
+    CHECK_EQ(x, 3000);
+    CHECK_EQ(y, 2000);
+
+    // holding still converges on the position
+    uint32_t us = 100000;
+    for(int i = 0; i < 1000; ++i) {
+        us += 4785;
+        x = 3000;
+        y = 2000;
+        filter.apply(x, y, us, EuroMinCutoff, EuroBeta);
+    }
+    CHECK_EQ(x, 3000);
+    CHECK_EQ(y, 2000);
+}
+
+// the run mode switch the pipeline replaced, moveIndex was shared by both averages
+class RunModeSwitch
+{
+public:
+    explicit RunModeSwitch(int mode) : runMode(mode) {}
+
+    void apply(int& moveXAxis, int& moveYAxis)
+    {
+        switch(runMode) {
+        case 1:
+            // 2 position moving average
+            moveIndex ^= 1;
+            moveXAxisArr[moveIndex] = moveXAxis;
+            moveYAxisArr[moveIndex] = moveYAxis;
+            moveXAxis = (moveXAxisArr[0] + moveXAxisArr[1]) / 2;
+            moveYAxis = (moveYAxisArr[0] + moveYAxisArr[1]) / 2;
+            break;
+        case 2:
+            // weighted average of current position and previous 2
+            if(moveIndex < 2) {
+                ++moveIndex;
+            } else {
+                moveIndex = 0;
+            }
+            moveXAxisArr[moveIndex] = moveXAxis;
+            moveYAxisArr[moveIndex] = moveYAxis;
+            moveXAxis = (moveXAxis + moveXAxisArr[0] + moveXAxisArr[1] + moveXAxisArr[1] + 2) / 4;
+            moveYAxis = (moveYAxis + moveYAxisArr[0] + moveYAxisArr[1] + moveYAxisArr[1] + 2) / 4;
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    int runMode;
+    int moveXAxisArr[3] = {0, 0, 0};
+    int moveYAxisArr[3] = {0, 0, 0};
+    int moveIndex = 0;
+};
+
+// the sketch settings
+static SamcoFilterPipeline::Params_t pipelineParams()
+{
+    SamcoFilterPipeline::Params_t params;
+    params.glitchThreshold = 49 * 4;
+    params.glitchFrames = 3;
+    params.deadZone = 2 * 4;
+    params.maxX = 4095;
+    params.maxY = 3071;
+    params.predictAlpha = PredictAlpha;
+    params.predictBeta = PredictBeta;
+    params.predictHorizonUs = LatencyUs;
+    params.euroMinCutoff = EuroMinCutoff;
+    params.euroBeta = EuroBeta;
+    return params;
+}
+
+// pipelines of the Normal, Averaging and Averaging2 run modes
+static const uint32_t RunModeStages[3] = {0, FilterStages(FilterStage_Average), FilterStages(FilterStage_Average2)};
+
+// random positions across the screen and a little beyond
+static void randomPosition(uint32_t& r, int& x, int& y)
+{
+    r = r * 1664525 + 1013904223;
+    x = (int)((r >> 8) & 8191) - 2048;
+    y = (int)((r >> 19) & 4095) - 512;
+}
+
+TEST(pipelineMatchesRunModeSwitch)
+{
+    const SamcoFilterPipeline::Params_t params = pipelineParams();
+    for(int mode = 0; mode < 3; ++mode) {
+        RunModeSwitch old(mode);
+        SamcoFilterPipeline pipeline;
+        pipeline.begin(RunModeStages[mode], params);
+        CHECK_EQ(pipeline.count(), mode ? 1u : 0u);
+        uint32_t r = 1;
+        unsigned int mismatches = 0;
+        for(int i = 0; i < 100000; ++i) {
+            int x, y;
+            randomPosition(r, x, y);
+            int oldX = x, oldY = y;
+            pipeline.apply(x, y, i * 4785);
+            old.apply(oldX, oldY);
+            mismatches += x != oldX || y != oldY;
+        }
+        CHECK_EQ(mismatches, 0u);
+    }
+
+    // the predict and One-Euro stages are the filters on their own
+    const FilterTrace trace(5, 6.0);
+    const std::vector<int> pred = predict(trace, PredictAlpha, PredictBeta);
+    const std::vector<int> smooth = euro(trace, EuroMinCutoff, EuroBeta);
+    SamcoFilterPipeline predictPipeline;
+    SamcoFilterPipeline euroPipeline;
+    // the sketch sets the measured latency each frame
+    SamcoFilterPipeline::Params_t measured = params;
+    measured.predictHorizonUs = 0;
+    predictPipeline.begin(FilterStages(FilterStage_Predict), measured);
+    euroPipeline.begin(FilterStages(FilterStage_Euro), params);
+    unsigned int mismatches = 0;
+    for(size_t k = 0; k < trace.measured.size(); ++k) {
+        int x = trace.measured[k], y = 0;
+        predictPipeline.predictHorizon(LatencyUs);
+        predictPipeline.apply(x, y, FilterTrace::frameUs(k));
+        mismatches += x != pred[k];
+        x = trace.measured[k];
+        euroPipeline.apply(x, y, FilterTrace::frameUs(k));
+        mismatches += x != smooth[k];
+    }
+    CHECK_EQ(mismatches, 0u);
+}
+
+TEST(pipelineStages)
+{
+    const SamcoFilterPipeline::Params_t params = pipelineParams();
+    SamcoFilterPipeline pipeline;
+    pipeline.begin(FilterStages(FilterStage_Glitch, FilterStage_DeadZone, FilterStage_Clamp), params);
+    CHECK_EQ(pipeline.count(), 3u);
+
+    // a jump is held for up to 3 frames, a jump that stays is accepted
+    int x = 1000, y = 1000;
+    pipeline.apply(x, y, 0);
+    CHECK_EQ(x, 1000);
+    for(int i = 0; i < 3; ++i) {
+        x = 2000;
+        y = 1000;
+        pipeline.apply(x, y, 0);
+        CHECK_EQ(x, 1000);
+    }
+    x = 2000;
+    pipeline.apply(x, y, 0);
+    CHECK_EQ(pipeline.badMoves(), 1u);
+    // the dead zone follows 8 behind
+    CHECK_EQ(x, 2000 - 8);
+    x = 1995;
+    pipeline.apply(x, y, 0);
+    CHECK_EQ(x, 2000 - 8);
+
+    // clamped to the screen
+    x = -5000;
+    y = 5000;
+    pipeline.begin(FilterStages(FilterStage_Clamp), params);
+    pipeline.apply(x, y, 0);
+    CHECK_EQ(x, 0);
+    CHECK_EQ(y, 3071);
+
+    // a pipeline stops at the first empty stage
+    pipeline.begin(FilterStages(FilterStage_Average, FilterStage_None, FilterStage_Clamp), params);
+    CHECK_EQ(pipeline.count(), 1u);
+}
+
+// host CPU time per position of the run mode switch or the pipeline
+template<class F> static double positionNs(int count, F apply)
+{
+    volatile int sink = 0;
+    uint32_t r = 1;
+    timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for(int i = 0; i < count; ++i) {
+        int x, y;
+        randomPosition(r, x, y);
+        apply(x, y, i);
+        sink = sink + x + y;
+        // the sketch reads the camera and sends the mouse report between positions, so the
+        // dispatch reloads its state each frame instead of being hoisted out of a tight loop
+        asm volatile("" ::: "memory");
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / count;
+}
+
+TEST(pipelineSpeed)
+{
+    // host time per position, the best of runs taken in turns, only a guide to the board
+    const SamcoFilterPipeline::Params_t params = pipelineParams();
+    constexpr int Count = 200000;
+    constexpr int Runs = 50;
+    static const char* const Names[3] = {"Normal", "Averaging", "Averaging2"};
+    for(int mode = 0; mode < 3; ++mode) {
+        RunModeSwitch old(mode);
+        SamcoFilterPipeline pipeline;
+        pipeline.begin(RunModeStages[mode], params);
+        double switchNs = 1e9;
+        double pipelineNs = 1e9;
+        for(int run = 0; run < Runs; ++run) {
+            switchNs = min(switchNs, positionNs(Count, [&](int& x, int& y, uint32_t us) { old.apply(x, y); }));
+            pipelineNs = min(pipelineNs, positionNs(Count, [&](int& x, int& y, uint32_t us) { pipeline.apply(x, y, us); }));
+        }
+        SamcoTestCase::report("%s %s: switch %.2f ns, pipeline %.2f ns per position, best of %d runs",
+            Build, Names[mode], switchNs, pipelineNs, Runs);
+        // no more than the switch it replaced, to within the timing noise
+        CHECK(pipelineNs <= switchNs * 1.1 + 0.3);
+    }
+}
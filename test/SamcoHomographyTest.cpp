@@ -0,0 +1,132 @@
+/*!
+ * @file SamcoHomographyTest.cpp
+ * @brief Host tests for SamcoHomography against SamcoPositionEnhanced with a pinhole camera.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <SamcoPositionEnhanced.h>
+#include <SamcoHomography.h>
+#include "LedScene.h"
+#include "SamcoTest.h"
+
+// camera center in mouse units, the point the sketch passes in
+constexpr int CenterX = MouseMaxX / 2;
+constexpr int CenterY = MouseMaxY / 2;
+
+// aim points across the screen for each gun position
+constexpr int SweepSteps = 9;
+
+// frames at each aim point, the edge angles update after 5 frames with all LEDs seen
+constexpr int SettleFrames = 8;
+
+// worst error across the screen after an affine fit of the engine output to the aim point
+struct SweepError
+{
+    double x;   // percent of the screen width
+    double y;   // percent of the screen height
+};
+
+// least squares fit of t = a + b x + c y, returns the largest residual
+static double affineFitMax(const double* x, const double* y, const double* t, int n)
+{
+    // normal equations, solved with Cramer's rule
+    double s[3][4] = {};
+    for(int i = 0; i < n; ++i) {
+        const double r[3] = {1.0, x[i], y[i]};
+        for(int j = 0; j < 3; ++j) {
+            for(int k = 0; k < 3; ++k) {
+                s[j][k] += r[j] * r[k];
+            }
+            s[j][3] += r[j] * t[i];
+        }
+    }
+    auto det = [](double m[3][3]) {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    };
+    double m[3][3];
+    for(int j = 0; j < 3; ++j) {
+        for(int k = 0; k < 3; ++k) {
+            m[j][k] = s[j][k];
+        }
+    }
+    const double d = det(m);
+    double coef[3];
+    for(int c = 0; c < 3; ++c) {
+        for(int j = 0; j < 3; ++j) {
+            for(int k = 0; k < 3; ++k) {
+                m[j][k] = k == c ? s[j][3] : s[j][k];
+            }
+        }
+        coef[c] = det(m) / d;
+    }
+    double worst = 0.0;
+    for(int i = 0; i < n; ++i) {
+        worst = max(worst, fabs(coef[0] + coef[1] * x[i] + coef[2] * y[i] - t[i]));
+    }
+    return worst;
+}
+
+// sweep the aim over the screen from a gun position
+template<class Engine_t>
+static SweepError sweep(double gx, double gz)
+{
+    constexpr int n = SweepSteps * SweepSteps;
+    double ex[n], ey[n], u[n], v[n];
+    Engine_t engine;
+    LedFrame frame;
+    int k = 0;
+    for(int j = 0; j < SweepSteps; ++j) {
+        for(int i = 0; i < SweepSteps; ++i) {
+            u[k] = 0.05 + 0.9 * i / (SweepSteps - 1);
+            v[k] = 0.05 + 0.9 * j / (SweepSteps - 1);
+            frame.pinhole(gx, 0.0, gz, u[k], v[k]);
+            frame.capture();
+            for(int f = 0; f < SettleFrames; ++f) {
+                engine.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+            }
+            // the sketch maps the offset from the calibrated center scaled by the height
+            ex[k] = (engine.x() - CenterX) / engine.h();
+            ey[k] = (engine.y() - CenterY) / engine.h();
+            ++k;
+        }
+    }
+    return {affineFitMax(ex, ey, u, n) * 100.0, affineFitMax(ex, ey, v, n) * 100.0};
+}
+
+TEST(homographyOnAxis)
+{
+    // straight on, both engines are close to linear, the homography X scales by the apparent width
+    // which changes a little as the camera turns
+    const SweepError samco = sweep<SamcoPositionEnhanced>(0.0, 2.5);
+    const SweepError homography = sweep<SamcoHomography>(0.0, 2.5);
+    CHECK_LE(homography.x, 0.6);
+    CHECK_LE(homography.y, 0.3);
+    CHECK_LE(samco.x, 1.0);
+    CHECK_LE(samco.y, 1.5);
+    SamcoTestCase::report("worst error %%: Samco %.2f x, %.2f y; homography %.2f x, %.2f y",
+        samco.x, samco.y, homography.x, homography.y);
+}
+
+TEST(homographyOffAxis)
+{
+    // 1 screen width to the side, the perspective bends the Samco output but not the homography
+    for(double gz : {2.0, 2.5, 3.5}) {
+        const SweepError samco = sweep<SamcoPositionEnhanced>(1.0, gz);
+        const SweepError homography = sweep<SamcoHomography>(1.0, gz);
+        CHECK_LE(homography.x, 0.6);
+        CHECK_LE(homography.y, 0.3);
+        CHECK(samco.x > homography.x * 3);
+        CHECK(samco.y > homography.y * 5);
+        SamcoTestCase::report("distance %.1f worst error %%: Samco %.2f x, %.2f y; homography %.2f x, %.2f y",
+            gz, samco.x, samco.y, homography.x, homography.y);
+    }
+}
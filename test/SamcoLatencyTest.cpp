@@ -0,0 +1,155 @@
+/*!
+ * @file SamcoLatencyTest.cpp
+ * @brief Host tests for the pipeline latency histograms with a virtual clock.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include <SamcoLatency.h>
+#include "SamcoTest.h"
+
+// upper bound of the bucket a value is in, from the 50th percentile with a larger value
+static uint32_t bucketMax(uint32_t us)
+{
+    SamcoLatencyHistogram h;
+    h.add(us);
+    h.add(UINT32_MAX);
+    return h.percentile(50);
+}
+
+TEST(histogramBuckets)
+{
+    // exact below 16, then the bucket holds the value and is within 25% above it
+    for(uint32_t us = 0; us < 16; ++us) {
+        CHECK_EQ(bucketMax(us), us);
+    }
+    unsigned int buckets = 16;
+    uint32_t last = 15;
+    for(uint32_t us = 16; us < (1u << 21); ++us) {
+        const uint32_t max = bucketMax(us);
+        if(max == UINT32_MAX) {
+            // the last bucket counts anything over about 1 second
+            CHECK_EQ(us, 7u << 17);
+            ++buckets;
+            break;
+        }
+        CHECK(max >= us);
+        CHECK_LE(max - us, us / 4);
+        if(max != last) {
+            // each bucket starts just after the last one
+            CHECK_EQ(us, last + 1);
+            last = max;
+            ++buckets;
+        }
+    }
+    CHECK_EQ(buckets, SamcoLatencyHistogram::BucketCount);
+
+    // bounds past 16 bits, a 16 bit unsigned int shift lost these
+    CHECK_EQ(bucketMax(100000), (7u << 14) - 1);
+    CHECK_EQ(bucketMax(600000), (5u << 17) - 1);
+    CHECK_EQ(bucketMax(1u << 31), UINT32_MAX);
+    CHECK_EQ(bucketMax(UINT32_MAX - 1), UINT32_MAX);
+}
+
+TEST(histogramPercentiles)
+{
+    std::mt19937 rng(3);
+    std::exponential_distribution<double> dist(1.0 / 2000);
+    SamcoLatencyHistogram h;
+    std::vector<uint32_t> values;
+    for(int i = 0; i < 50000; ++i) {
+        const uint32_t us = (uint32_t)dist(rng);
+        h.add(us);
+        values.push_back(us);
+    }
+    std::sort(values.begin(), values.end());
+    CHECK_EQ(h.count(), values.size());
+    CHECK_EQ(h.min(), values.front());
+    CHECK_EQ(h.max(), values.back());
+    for(unsigned int pct : {1u, 10u, 50u, 90u, 99u}) {
+        const uint32_t exact = values[(values.size() * pct + 99) / 100 - 1];
+        const uint32_t p = h.percentile(pct);
+        CHECK(p >= exact);
+        CHECK_LE(p - exact, exact / 4 + 1);
+    }
+    CHECK_EQ(h.percentile(100), values.back());
+}
+
+TEST(histogramFullBucket)
+{
+    // a bucket filling halves all the counts and keeps the proportions
+    SamcoLatencyHistogram h;
+    for(int i = 0; i < 200000; ++i) {
+        h.add(i % 4 ? 1000 : 5000);
+    }
+    CHECK_EQ(h.count(), 200000u);
+    CHECK_EQ(h.avg(), 2000u);
+    CHECK_EQ(h.percentile(75), bucketMax(1000));
+    CHECK_EQ(h.percentile(76), 5000u);
+}
+
+TEST(stagesWithVirtualClock)
+{
+    // frames at the camera rate with the read late every 100 frames and no report every 10 frames,
+    // the clock wraps part way through
+    SamcoLatency latency;
+    std::mt19937 rng(5);
+    uint32_t tick = 0xFFFF0000u;
+    uint32_t reportMax = 0;
+    for(int frame = 0; frame < 100000; ++frame) {
+        tick += 4785;
+        latency.stamp(SamcoLatency::Stamp_Tick, tick);
+        uint32_t us = tick + 900 + rng() % 200;
+        if(frame % 100 == 0) {
+            us += 3000;
+        }
+        latency.stamp(SamcoLatency::Stamp_Read, us);
+        us += 150;
+        latency.stamp(SamcoLatency::Stamp_Position, us);
+        us += 20;
+        latency.stamp(SamcoLatency::Stamp_Move, us);
+        if(frame % 10 == 0) {
+            latency.cancel();
+            continue;
+        }
+        const uint32_t wait = rng() % 1000;
+        reportMax = std::max(reportMax, wait);
+        latency.stamp(SamcoLatency::Stamp_Report, us + wait);
+    }
+
+    for(unsigned int s = 0; s < SamcoLatency::Stage_Count; ++s) {
+        const SamcoLatencyHistogram& h = latency.stage(s);
+        SamcoTestCase::report("%-10s min %u avg %u max %u p50 %u p99 %u", SamcoLatency::StageLabel(s),
+            h.min(), h.avg(), h.max(), h.percentile(50), h.percentile(99));
+        CHECK_EQ(h.count(), 90000u);
+    }
+
+    // the late reads are in frames that were cancelled, so none reach the histogram
+    const SamcoLatencyHistogram& read = latency.stage(SamcoLatency::Stage_Read);
+    CHECK(read.min() >= 900);
+    CHECK(read.max() < 1100);
+    CHECK_EQ(latency.stage(SamcoLatency::Stage_Position).min(), 150u);
+    CHECK_EQ(latency.stage(SamcoLatency::Stage_Position).max(), 150u);
+    CHECK_EQ(latency.stage(SamcoLatency::Stage_Move).avg(), 20u);
+    CHECK_EQ(latency.stage(SamcoLatency::Stage_Report).max(), reportMax);
+    const SamcoLatencyHistogram& total = latency.stage(SamcoLatency::Stage_Total);
+    CHECK(total.min() >= 1070);
+    CHECK(total.max() < 1070 + 200 + 1000);
+    CHECK_NEAR(total.avg(), 900 + 100 + 170 + 500, 20);
+
+    // a report without the earlier stamps of its frame isn't counted
+    latency.reset();
+    latency.stamp(SamcoLatency::Stamp_Tick, 0);
+    latency.stamp(SamcoLatency::Stamp_Read, 1000);
+    latency.stamp(SamcoLatency::Stamp_Report, 2000);
+    CHECK_EQ(latency.stage(SamcoLatency::Stage_Total).count(), 0u);
+}
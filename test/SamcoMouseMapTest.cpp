@@ -0,0 +1,93 @@
+/*!
+ * @file SamcoMouseMapTest.cpp
+ * @brief Host tests for the camera to mouse mapping against map().
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <SamcoMouseMap.h>
+#include "SamcoTest.h"
+
+// the sketch mouse range
+constexpr int MouseMaxX = 4095;
+constexpr int MouseMaxY = 3071;
+
+// map() from the Arduino core
+static long arduinoMap(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+TEST(mulHiMatches64Bit)
+{
+    uint32_t r = 1;
+    unsigned int mismatches = 0;
+    for(int i = 0; i < 2000000; ++i) {
+        r = r * 1664525 + 1013904223;
+        const uint32_t value = r >> 16;
+        r = r * 1664525 + 1013904223;
+        const uint64_t mult = ((uint64_t)(r >> 17) << 32) | (r * 2654435761u);
+        mismatches += SamcoMouseMap::MulHi(value, mult) != (uint32_t)((value * mult) >> 32);
+    }
+    CHECK_EQ(mismatches, 0u);
+}
+
+TEST(mapMatchesArduinoMap)
+{
+    // every half width the sketch can see, centers across the camera and positions up to 0xFFFF from the offset
+    uint32_t r = 7;
+    unsigned int count = 0;
+    unsigned int mismatches = 0;
+    for(int half = 1; half < 8192; ++half) {
+        for(int outMax : {MouseMaxX, MouseMaxY}) {
+            r = r * 1664525 + 1013904223;
+            const int center = (int)(r >> 20) - 1024;
+            SamcoMouseMap map;
+            map.update(half, center, outMax);
+            const int offset = center + half;
+            for(int i = 0; i < 200; ++i) {
+                r = r * 1664525 + 1013904223;
+                // most near the mapped width, some anywhere in range
+                const int d = i & 1 ? (int)(r % 0x1FFFF) - 0xFFFF : (int)(r % (half * 6 + 1)) - half * 3;
+                mismatches += map.map(offset + d) != arduinoMap(offset + d, offset, offset - half * 2, 0, outMax);
+                ++count;
+            }
+            // both edges and the center
+            mismatches += map.map(offset) != 0;
+            mismatches += map.map(center) != arduinoMap(center, offset, offset - half * 2, 0, outMax);
+            mismatches += map.map(center - half) != outMax;
+        }
+    }
+    SamcoTestCase::report("%u positions", count);
+    CHECK_EQ(mismatches, 0u);
+}
+
+TEST(mapBeyondRangeStaysOffScreen)
+{
+    SamcoMouseMap map;
+    map.update(200, 2000, MouseMaxX);
+    const int atLimit = map.map(2200 - 0xFFFF);
+    CHECK_EQ(atLimit, arduinoMap(2200 - 0xFFFF, 2200, 1800, 0, MouseMaxX));
+    CHECK_EQ(map.map(2200 - 0x10000 * 4), atLimit);
+    CHECK_EQ(map.map(2200 + 0x10000 * 4), -atLimit);
+}
+
+TEST(mapRecomputedOnChange)
+{
+    SamcoMouseMap map;
+    map.update(500, 2000, MouseMaxX);
+    CHECK_EQ(map.map(1500), MouseMaxX);
+    map.update(500, 2000, MouseMaxY);
+    CHECK_EQ(map.map(1500), MouseMaxY);
+    map.update(500, 1000, MouseMaxY);
+    CHECK_EQ(map.map(500), MouseMaxY);
+    map.update(250, 1000, MouseMaxY);
+    CHECK_EQ(map.map(750), MouseMaxY);
+    CHECK_EQ(map.map(1250), 0);
+}
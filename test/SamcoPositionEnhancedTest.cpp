@@ -0,0 +1,195 @@
+/*!
+ * @file SamcoPositionEnhancedTest.cpp
+ * @brief Host tests for SamcoPositionEnhanced with synthetic LED frames.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <SamcoPositionEnhanced.h>
+#include "SamcoPositionFixed.h"
+#include "LedScene.h"
+#include "SamcoTest.h"
+
+// camera center in mouse units, the point the sketch passes in
+constexpr int CenterX = MouseMaxX / 2;
+constexpr int CenterY = MouseMaxY / 2;
+
+// a gun moving over the screen with some tilt and distance change, the LEDs go out of view at the edges
+static void sweepFrame(unsigned int f, LedFrame& frame)
+{
+    const double t = f * 0.002;
+    const double scale = 1.0 + 0.3 * sin(t * 1.7);
+    frame.rectangle(512 + 320 * sin(t * 2.3), 384 + 260 * cos(t * 1.9), 200 * scale, 150 * scale, 0.4 * sin(t * 3.1));
+    frame.capture();
+}
+
+TEST(fixedMatchesFloat)
+{
+    // the fixed-point maths for boards without an FPU against the floating point maths
+    SamcoPositionEnhanced flt;
+    SamcoPositionFixed fix;
+    LedFrame frame;
+    unsigned int frames4 = 0;
+    unsigned int framesEst = 0;
+    unsigned int est2 = 0;
+    int max4 = 0;
+    int maxEst = 0;
+    double maxH = 0;
+    for(unsigned int f = 0; f < 100000; ++f) {
+        sweepFrame(f, frame);
+        flt.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+        fix.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+        const int err = max(abs(flt.x() - fix.x()), abs(flt.y() - fix.y()));
+        if(frame.count() == 4) {
+            ++frames4;
+            max4 = max(max4, err);
+            maxH = max(maxH, fabs((double)flt.h() - fix.h()));
+        } else {
+            ++framesEst;
+            maxEst = max(maxEst, err);
+            est2 += err > 1;
+        }
+    }
+    CHECK(frames4 > 40000);
+    CHECK(framesEst > 40000);
+    CHECK_LE(max4, 1);
+    CHECK_LE(maxH, 0.25);
+    CHECK_LE(maxEst, 2);
+    CHECK_LE(est2 * 1000, framesEst);
+    SamcoTestCase::report("all seen: %u frames, max %d; estimated: %u frames, max %d, %u off by 2; height max %.3f",
+        frames4, max4, framesEst, maxEst, est2, maxH);
+}
+
+// every LED is at its true position within a distance in mouse units
+template<class Engine_t>
+static bool ledsAt(const Engine_t& engine, const LedFrame& frame, double dist)
+{
+    for(int i = 0; i < 4; ++i) {
+        if(hypot(engine.testX(i) - frame.mouseX(i), engine.testY(i) - frame.mouseY(i)) > dist) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(trackingKeepsIdentity)
+{
+    // tilt up to 80 degrees with the camera slots shuffled every frame
+    SamcoPositionEnhanced pos;
+    LedFrame frame;
+    srand(7);
+    unsigned int lost = 0;
+    double worst = 0.0;
+    for(unsigned int f = 0; f < 4000; ++f) {
+        const double cx = 512 + 100 * sin(f * 0.011);
+        const double cy = 384 + 60 * cos(f * 0.013);
+        frame.rectangle(cx, cy, 200, 150, 1.4 * sin(f * 0.003));
+        int order[4] = {0, 1, 2, 3};
+        for(int i = 3; i > 0; --i) {
+            const int j = rand() % (i + 1);
+            const int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+        frame.capture(order);
+        pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+
+        // each LED is its own rounded camera point, and the median is the rectangle center
+        lost += !ledsAt(pos, frame, CamToMouseMult);
+        worst = max(worst, hypot(pos.testMedianX() - (MouseMaxX - cx * CamToMouseMult), pos.testMedianY() - cy * CamToMouseMult) / CamToMouseMult);
+    }
+    CHECK_EQ(lost, 0);
+    CHECK_LE(worst, 0.6);
+    SamcoTestCase::report("identity lost in %u of 4000 frames, median within %.2f camera pixels", lost, worst);
+}
+
+TEST(trackingRestartHasNoVelocity)
+{
+    // the frame the tracking starts over doesn't measure a velocity from the old positions
+    SamcoPositionEnhanced pos;
+    LedFrame frame;
+    frame.rectangle(300, 250, 150, 110, 0.1);
+    frame.capture();
+    for(int f = 0; f < 20; ++f) {
+        pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+    }
+
+    // a jump too far to track starts over, then a frame with no LEDs seen keeps them where they were
+    frame.rectangle(700, 500, 150, 110, -0.1);
+    frame.capture();
+    pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+    CHECK(ledsAt(pos, frame, CamToMouseMult));
+    const int none[4] = {0x3FF, 0x3FF, 0x3FF, 0x3FF};
+    pos.begin(none, none, 0, CenterX, CenterY);
+    CHECK(ledsAt(pos, frame, CamToMouseMult));
+
+    // a vertical jump of a whole camera height is also a restart
+    frame.rectangle(700, 120, 150, 110, 0.0);
+    frame.capture();
+    for(int f = 0; f < 10; ++f) {
+        pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+    }
+    frame.rectangle(700, 650, 150, 110, 0.0);
+    frame.capture();
+    pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+    pos.begin(none, none, 0, CenterX, CenterY);
+    CHECK(ledsAt(pos, frame, CamToMouseMult));
+}
+
+// error of the LEDs that are not seen while 2 or 3 are, in camera pixels
+struct RigidError
+{
+    unsigned int samples;
+    double mean;
+    double max;
+};
+
+static RigidError rigidSweep(bool rigid)
+{
+    // the rectangle sweeps across the camera edges with tilt and distance changes
+    SamcoPositionEnhanced pos;
+    pos.rigidModel(rigid);
+    LedFrame frame;
+    RigidError e = {0, 0.0, 0.0};
+    bool started = false;
+    for(unsigned int f = 0; f < 6000; ++f) {
+        const double t = f * 0.002;
+        const double scale = 1.0 + 0.3 * sin(t * 1.7);
+        frame.rectangle(512 + 300 * sin(t * 2.3), 384 + 250 * cos(t * 1.9), 200 * scale, 150 * scale, 0.5 * sin(t * 3.0));
+        frame.capture();
+        pos.begin(frame.px, frame.py, frame.seen, CenterX, CenterY);
+        started = started || frame.count() == 4;
+        if(!started || frame.count() < 2 || frame.count() == 4) {
+            continue;
+        }
+        for(int i = 0; i < 4; ++i) {
+            if(frame.slot[LedFrame::cameraLed(i)] < 0) {
+                const double d = hypot(pos.testX(i) - frame.mouseX(i), pos.testY(i) - frame.mouseY(i)) / CamToMouseMult;
+                ++e.samples;
+                e.mean += d;
+                e.max = max(e.max, d);
+            }
+        }
+    }
+    e.mean /= e.samples;
+    return e;
+}
+
+TEST(rigidModelReconstruction)
+{
+    const RigidError edge = rigidSweep(false);
+    const RigidError rigid = rigidSweep(true);
+    CHECK_EQ(rigid.samples, edge.samples);
+    CHECK(rigid.samples > 500);
+    CHECK_LE(rigid.mean, 1.5);
+    CHECK_LE(rigid.max, 4.0);
+    CHECK(edge.mean > rigid.mean * 10);
+    SamcoTestCase::report("%u LEDs out of view: edge angles %.2f mean, %.1f max; rigid model %.2f mean, %.1f max camera pixels",
+        rigid.samples, edge.mean, edge.max, rigid.mean, rigid.max);
+}
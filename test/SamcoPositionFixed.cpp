@@ -0,0 +1,15 @@
+/*!
+ * @file SamcoPositionFixed.cpp
+ * @brief SamcoPositionEnhanced built with the fixed-point maths as SamcoPositionFixed.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#define SAMCO_POSITION_FIXED 1
+#define SamcoPositionEnhanced SamcoPositionFixed
+#include <SamcoPositionEnhanced.cpp>
@@ -0,0 +1,28 @@
+/*!
+ * @file SamcoPositionFixed.h
+ * @brief SamcoPositionEnhanced built with the fixed-point maths as SamcoPositionFixed.
+ * @details The host has an FPU so SamcoPositionEnhanced uses the floating point maths, this is the
+ * same source with SAMCO_POSITION_FIXED under another class name so a test can compare the two.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOPOSITIONFIXED_H_
+#define _SAMCOPOSITIONFIXED_H_
+
+// the floating point class first, then the header again for the fixed-point class
+#include <SamcoPositionEnhanced.h>
+#undef _SamcoPositionEnhanced_h_
+
+#define SAMCO_POSITION_FIXED 1
+#define SamcoPositionEnhanced SamcoPositionFixed
+#include <SamcoPositionEnhanced.h>
+#undef SamcoPositionEnhanced
+#undef SAMCO_POSITION_FIXED
+
+#endif // _SAMCOPOSITIONFIXED_H_
@@ -0,0 +1,170 @@
+/*!
+ * @file SamcoPositionRingTest.cpp
+ * @brief Host tests for the position handoff between cores, with a thread for each core.
+ * @details Run it under ThreadSanitizer with make tsan.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <atomic>
+#include <thread>
+#include <Arduino.h>
+#include <SamcoPositionRing.h>
+#include "SamcoTest.h"
+
+// positions for the stress test
+constexpr uint32_t StressCount = 10000000;
+
+// every field from the sequence number so a torn entry shows
+static SamcoPositionRing::Position_t position(uint32_t seq)
+{
+    SamcoPositionRing::Position_t pos;
+    pos.x = (int)seq;
+    pos.y = ~(int)seq;
+    pos.h = (float)(seq & 0xFFFF);
+    pos.seen = seq & 0x0F;
+    pos.error = (int)(seq * 7);
+    pos.tickUs = seq * 3;
+    pos.readStartUs = seq * 5;
+    pos.readUs = seq ^ 0x55AA55AA;
+    pos.positionUs = seq * 11;
+    return pos;
+}
+
+static bool intact(const SamcoPositionRing::Position_t& pos)
+{
+    const SamcoPositionRing::Position_t e = position((uint32_t)pos.x);
+    return pos.y == e.y && pos.h == e.h && pos.seen == e.seen && pos.error == e.error && pos.tickUs == e.tickUs
+        && pos.readStartUs == e.readStartUs && pos.readUs == e.readUs && pos.positionUs == e.positionUs;
+}
+
+TEST(ringOrderAndCounts)
+{
+    SamcoPositionRing ring;
+    SamcoPositionRing::Position_t pos;
+    CHECK(!ring.pop(pos));
+    CHECK_EQ(ring.popLatest(pos), 0u);
+
+    // a full ring drops the new position
+    for(uint32_t i = 0; i < SamcoPositionRing::Size; ++i) {
+        CHECK(ring.push(position(i)));
+    }
+    CHECK(!ring.push(position(100)));
+    CHECK_EQ(ring.dropped(), 1u);
+
+    CHECK(ring.pop(pos));
+    CHECK_EQ(pos.x, 0);
+    CHECK(ring.pop(pos));
+    CHECK_EQ(pos.x, 1);
+
+    // the newest position, the others are skipped
+    CHECK_EQ(ring.popLatest(pos), SamcoPositionRing::Size - 2);
+    CHECK_EQ(pos.x, (int)SamcoPositionRing::Size - 1);
+    CHECK(intact(pos));
+    CHECK_EQ(ring.skipped(), SamcoPositionRing::Size - 3);
+    CHECK(!ring.pop(pos));
+
+    ring.push(position(200));
+    ring.push(position(201));
+    ring.clear();
+    CHECK(!ring.pop(pos));
+    CHECK(ring.push(position(202)));
+    CHECK(ring.pop(pos));
+    CHECK_EQ(pos.x, 202);
+}
+
+TEST(ringStress)
+{
+    // the producer retries a full ring so every position goes through, the consumer takes
+    // one position at a time or the newest like core0. Both yield to the other thread rather
+    // than spin when they can't go on, for hosts with fewer cores than threads.
+    SamcoPositionRing ring;
+    std::atomic<bool> done{false};
+    std::thread producer([&]() {
+        for(uint32_t seq = 1; seq <= StressCount; ++seq) {
+            while(!ring.push(position(seq))) {
+                std::this_thread::yield();
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint32_t outOfOrder = 0;
+    uint32_t last = 0;
+    uint32_t pass = 0;
+    SamcoPositionRing::Position_t pos;
+    for(;;) {
+        const bool finished = done.load(std::memory_order_acquire);
+        const bool got = ++pass % 4 ? ring.pop(pos) : ring.popLatest(pos) > 0;
+        if(got) {
+            ++received;
+            torn += !intact(pos);
+            outOfOrder += (uint32_t)pos.x <= last;
+            last = (uint32_t)pos.x;
+        } else if(finished) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    SamcoTestCase::report("%u pushed: %u received, %u skipped, %u pushes to a full ring", StressCount, received, ring.skipped(), ring.dropped());
+    CHECK_EQ(torn, 0u);
+    CHECK_EQ(outOfOrder, 0u);
+    CHECK_EQ(last, StressCount);
+    // every position is received or skipped by popLatest()
+    CHECK_EQ(received + ring.skipped(), StressCount);
+}
+
+TEST(gateStopsTheWorker)
+{
+    SamcoCoreGate gate;
+    std::atomic<bool> inside{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> work{0};
+    gate.open();
+    std::thread worker([&]() {
+        while(!stop.load(std::memory_order_relaxed)) {
+            if(gate.enter()) {
+                inside.store(true, std::memory_order_relaxed);
+                work.fetch_add(1, std::memory_order_relaxed);
+                inside.store(false, std::memory_order_relaxed);
+                gate.leave();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    unsigned int caught = 0;
+    uint32_t workDuringClose = 0;
+    for(int i = 0; i < 2000; ++i) {
+        gate.close();
+        caught += inside.load(std::memory_order_relaxed);
+        // no work while the gate is closed
+        const uint32_t w = work.load(std::memory_order_relaxed);
+        for(int spin = 0; spin < 10; ++spin) {
+            caught += inside.load(std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+        workDuringClose += work.load(std::memory_order_relaxed) - w;
+        gate.open();
+        // let the worker run a little
+        const uint32_t before = work.load(std::memory_order_relaxed);
+        while(work.load(std::memory_order_relaxed) == before) {
+            std::this_thread::yield();
+        }
+    }
+    stop.store(true, std::memory_order_relaxed);
+    worker.join();
+    CHECK_EQ(caught, 0u);
+    CHECK_EQ(workDuringClose, 0u);
+}
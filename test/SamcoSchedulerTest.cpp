@@ -0,0 +1,215 @@
+/*!
+ * @file SamcoSchedulerTest.cpp
+ * @brief Host tests for the cooperative task scheduler with a virtual clock.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include <SamcoScheduler.h>
+#include "SamcoTest.h"
+
+static uint32_t clockUs()
+{
+    return micros();
+}
+
+// the task run times in microseconds, tasks advance the virtual clock by their run time
+static unsigned int buttonsRuns = 0;
+static unsigned int cameraRuns = 0;
+static unsigned int usbRuns = 0;
+static unsigned int slowEvery = 0;
+
+static void buttonsTask()
+{
+    ++buttonsRuns;
+    testAdvance(20);
+}
+
+static void usbTask()
+{
+    ++usbRuns;
+    testAdvance(30);
+}
+
+static void cameraTask()
+{
+    // every slowEvery runs takes 5ms like a blocking IIC recovery
+    ++cameraRuns;
+    testAdvance(slowEvery && cameraRuns % slowEvery == 0 ? 5000 : 100);
+}
+
+static const SamcoScheduler::Task_t RunTasks[] = {
+    {buttonsTask, 1000, 200, "Buttons"},
+    {usbTask, 2000, 200, "USB"},
+    {cameraTask, 0, 1000, "Camera"}
+};
+
+static void resetRuns(uint32_t startUs)
+{
+    testSetMicros(startUs);
+    buttonsRuns = 0;
+    cameraRuns = 0;
+    usbRuns = 0;
+    slowEvery = 0;
+}
+
+// run the scheduler for a time, the clock idles forward when nothing is due
+static void runFor(SamcoScheduler& scheduler, uint32_t us)
+{
+    const uint32_t start = micros();
+    while((uint32_t)micros() - start < us) {
+        if(!scheduler.run()) {
+            testAdvance(10);
+        }
+    }
+}
+
+TEST(periodsWithWrappingClock)
+{
+    // the clock wraps a little after the start
+    resetRuns(0xFFF00000u);
+    SamcoScheduler scheduler(clockUs);
+    scheduler.begin(RunTasks, 3);
+    runFor(scheduler, 2000000);
+    CHECK(micros() < 0xFFF00000u);
+
+    SamcoTestCase::report("2s: buttons %u runs, USB %u runs, camera %u runs", buttonsRuns, usbRuns, cameraRuns);
+    CHECK_NEAR(buttonsRuns, 2000, 2);
+    CHECK_NEAR(usbRuns, 1000, 2);
+    // the continuous task has the rest of the time
+    CHECK_NEAR(cameraRuns, (2000000 - 2000 * 20 - 1000 * 30) / 100, 20);
+    for(unsigned int i = 0; i < scheduler.taskCount(); ++i) {
+        CHECK_EQ(scheduler.stats(i).late, 0u);
+        CHECK_EQ(scheduler.stats(i).overruns, 0u);
+    }
+    CHECK_EQ(scheduler.stats(0).runs, buttonsRuns);
+    CHECK_EQ(scheduler.stats(0).maxUs, 20u);
+    CHECK_EQ(scheduler.stats(2).maxUs, 100u);
+}
+
+TEST(idleWithoutContinuousTask)
+{
+    // only the periodic tasks, run() returns false between their releases
+    resetRuns(1000);
+    SamcoScheduler scheduler(clockUs);
+    scheduler.begin(RunTasks, 2);
+    unsigned int idle = 0;
+    const uint32_t start = micros();
+    while((uint32_t)micros() - start < 100000) {
+        if(!scheduler.run()) {
+            ++idle;
+            testAdvance(10);
+        }
+    }
+    CHECK_NEAR(buttonsRuns, 100, 1);
+    CHECK_NEAR(usbRuns, 50, 1);
+    CHECK(idle > 9000);
+}
+
+TEST(overrunsAndLateReleases)
+{
+    resetRuns(0);
+    slowEvery = 10;
+    SamcoScheduler scheduler(clockUs);
+    scheduler.begin(RunTasks, 3);
+    runFor(scheduler, 1000000);
+
+    const SamcoScheduler::TaskStats_t& camera = scheduler.stats(2);
+    SamcoTestCase::report("1s: camera %u runs, %u overruns, buttons %u late, USB %u late",
+        camera.runs, camera.overruns, scheduler.stats(0).late, scheduler.stats(1).late);
+    CHECK_EQ(camera.overruns, camera.runs / 10);
+    CHECK_EQ(camera.maxUs, 5000u);
+    CHECK_EQ(scheduler.overruns(), camera.overruns);
+
+    // each 5ms run makes both periodic tasks miss a release, and they start their period again
+    // instead of running back to back to catch up
+    CHECK_NEAR(scheduler.stats(0).late, camera.overruns, 1);
+    CHECK_NEAR(scheduler.stats(1).late, camera.overruns, 1);
+    CHECK(scheduler.stats(0).runs < 1000);
+
+    scheduler.resetStats();
+    CHECK_EQ(scheduler.overruns(), 0u);
+    CHECK_EQ(scheduler.stats(2).runs, 0u);
+}
+
+TEST(earliestReleaseRunsFirst)
+{
+    static char order[8];
+    static unsigned int orderCount;
+    struct Tasks {
+        static void a() { order[orderCount++] = 'a'; }
+        static void b() { order[orderCount++] = 'b'; testAdvance(1500); }
+    };
+    static const SamcoScheduler::Task_t tasks[] = {
+        {Tasks::a, 1000, 0, "A"},
+        {Tasks::b, 500, 0, "B"}
+    };
+    resetRuns(0);
+    orderCount = 0;
+    SamcoScheduler scheduler(clockUs);
+    scheduler.begin(tasks, 2);
+    // both released at 0 and A is first. B runs 1.5ms so its release at 0.5ms is before A's at 1ms,
+    // then B has missed its release at 1ms and starts its period again at 2ms, after A's release.
+    // A runs at 3ms, past its next release at 2ms, so both count a late release
+    for(int i = 0; i < 4; ++i) {
+        while(!scheduler.run()) {
+            testAdvance(10);
+        }
+    }
+    order[orderCount] = 0;
+    CHECK(strcmp(order, "abba") == 0);
+    CHECK_EQ(scheduler.stats(0).late, 1u);
+    CHECK_EQ(scheduler.stats(1).late, 1u);
+}
+
+static SamcoScheduler* swapScheduler = nullptr;
+static unsigned int swapRuns = 0;
+static void swapTask();
+
+static const SamcoScheduler::Task_t SwapTasks[] = {
+    {swapTask, 0, 0, "Swap"}
+};
+
+static void swapTask()
+{
+    // swap to the run tasks from inside run() like SetMode()
+    ++swapRuns;
+    testAdvance(50);
+    swapScheduler->begin(RunTasks, 3);
+}
+
+TEST(taskSwapsTheSet)
+{
+    resetRuns(0);
+    swapRuns = 0;
+    SamcoScheduler scheduler(clockUs);
+    swapScheduler = &scheduler;
+    scheduler.begin(SwapTasks, 1);
+    CHECK(scheduler.run());
+    CHECK_EQ(swapRuns, 1u);
+    CHECK_EQ(scheduler.taskCount(), 3u);
+    CHECK(scheduler.task(0).label == RunTasks[0].label);
+    // the swapped in set starts with clean stats and every task released
+    CHECK_EQ(scheduler.stats(0).runs, 0u);
+    for(int i = 0; i < 3; ++i) {
+        CHECK(scheduler.run());
+    }
+    CHECK_EQ(buttonsRuns, 1u);
+    CHECK_EQ(usbRuns, 1u);
+    CHECK_EQ(cameraRuns, 1u);
+    CHECK_EQ(swapRuns, 1u);
+
+    // a set larger than MaxTasks is limited
+    SamcoScheduler::Task_t many[SamcoScheduler::MaxTasks + 2];
+    for(auto& t : many) {
+        t = RunTasks[2];
+    }
+    scheduler.begin(many, SamcoScheduler::MaxTasks + 2);
+    CHECK_EQ(scheduler.taskCount(), SamcoScheduler::MaxTasks);
+}
@@ -0,0 +1,200 @@
+/*!
+ * @file SamcoSofSyncTest.cpp
+ * @brief Host tests for the USB start of frame synchronised sampling with a simulated host and virtual clock.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <random>
+#include <Arduino.h>
+#include <SamcoSofSync.h>
+#include "SamcoTest.h"
+
+// camera read and position calculation times, 209 Hz camera frames
+constexpr uint32_t ReadUs = 450;
+constexpr uint32_t PositionUs = 120;
+constexpr uint64_t CameraPeriodNs = 1000000000ull / 209;
+
+// time from the SOF to the host poll
+constexpr uint64_t PollOffsetNs = 37000;
+
+// statistics from the first seconds are left out while the timing locks
+constexpr uint64_t RunNs = 20000000000ull;
+constexpr uint64_t SettleNs = 5000000000ull;
+
+/// @brief The host, a SOF every frame period from t0 with the clock off by ppm, a ppm of the 1 ms frame is 1 ns,
+/// and a poll on the frames with the frame number modulo the poll interval equal to the phase
+class SimHost
+{
+public:
+    SimHost(uint64_t t0Ns, int ppm, unsigned int pollFrames, unsigned int phase) :
+        t0Ns(t0Ns), periodNs(1000000 + ppm), pollFrames(pollFrames), phase(phase) {}
+
+    /// @brief Frame number at a time
+    uint16_t frameNumber(uint64_t ns) const
+    {
+        return (uint16_t)((ns - t0Ns) / periodNs) & SamcoSofSync::FrameMask;
+    }
+
+    /// @brief First poll at or after a time
+    uint64_t nextPoll(uint64_t ns) const
+    {
+        uint64_t k = ns > t0Ns + PollOffsetNs ? (ns - t0Ns - PollOffsetNs + periodNs - 1) / periodNs : 0;
+        while(k % pollFrames != phase) {
+            ++k;
+        }
+        return t0Ns + k * periodNs + PollOffsetNs;
+    }
+
+    const uint64_t t0Ns;
+    const uint64_t periodNs;
+    const unsigned int pollFrames;
+    const unsigned int phase;
+};
+
+/// @brief Results of a run
+struct SimResult
+{
+    SamcoLatencyHistogram age;      ///< sample age at the poll that took it
+    unsigned int misses = 0;        ///< samples that missed the poll they were timed for
+    uint32_t pollErrorUs = 0;       ///< worst error of the next poll estimate
+};
+
+// the gun loop with a pass of 10 us to the jitter, reading the camera when a frame is ready,
+// at once or at the read slot, and queuing the report when the position is ready
+static void simulate(SimResult& r, SamcoSofSync& sync, const SimHost& host, bool synced,
+    uint32_t leadUs, uint32_t jitterUs, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> loopUs(10, jitterUs);
+
+    const uint64_t startNs = testNanos;
+    uint64_t nextFrameNs = startNs + 1000000;
+    uint64_t readStartNs = 0;
+    uint64_t sampleNs = 0;
+    uint64_t takenNs = 0;
+    uint32_t slot = 0;
+    bool frameReady = false;
+    bool slotSet = false;
+    bool reading = false;
+    bool pending = false;
+    bool busy = false;
+    while(testNanos - startNs < RunNs) {
+        testAdvance(loopUs(rng));
+        uint32_t now = micros();
+        sync.frame(host.frameNumber(testNanos), now);
+
+        // the host took the last report at its poll
+        if(busy && testNanos >= takenNs) {
+            busy = false;
+            sync.polled(now);
+        }
+
+        if(testNanos >= nextFrameNs) {
+            nextFrameNs += CameraPeriodNs;
+            frameReady = true;
+        }
+        if(frameReady && !reading) {
+            if(!slotSet) {
+                slot = synced ? sync.readSlot(now, ReadUs) : now;
+                slotSet = true;
+            }
+            if((int32_t)(now - slot) >= 0) {
+                frameReady = false;
+                slotSet = false;
+                reading = true;
+                readStartNs = testNanos;
+            }
+        }
+        if(reading && testNanos >= readStartNs + ReadUs * 1000) {
+            reading = false;
+            sampleNs = readStartNs + ReadUs * 1000;
+            testAdvance(PositionUs);
+            now = micros();
+            sync.sampled((uint32_t)(sampleNs / 1000), now);
+            pending = true;
+        }
+
+        if(pending && !busy) {
+            pending = false;
+            busy = true;
+            takenNs = host.nextPoll(testNanos);
+            if(testNanos - startNs < SettleNs) {
+                continue;
+            }
+            const uint32_t ageUs = (uint32_t)((takenNs - sampleNs) / 1000);
+            r.age.add(ageUs);
+            r.misses += ageUs > leadUs + jitterUs + 50;
+
+            // the estimate against the nearest poll of the host
+            const uint64_t estNs = testNanos + (int64_t)(int32_t)(sync.nextPoll(now) - now) * 1000;
+            const uint64_t pollNs = host.nextPoll(estNs - host.periodNs * host.pollFrames / 2);
+            const uint32_t errorUs = (uint32_t)((estNs > pollNs ? estNs - pollNs : pollNs - estNs) / 1000);
+            r.pollErrorUs = max(r.pollErrorUs, errorUs);
+        }
+    }
+}
+
+// the lead covers the position time, a loop pass either side of the read and the poll estimate error
+static uint32_t leadFor(uint32_t jitterUs)
+{
+    return PositionUs + 2 * jitterUs + jitterUs / 2;
+}
+
+TEST(learnsTheHostTiming)
+{
+    for(unsigned int pollFrames : {1u, 2u, 4u, 8u}) {
+        // across the micros() wrap
+        testSetMicros(UINT32_MAX - 3000000);
+        const unsigned int phase = pollFrames - 1;
+        const SimHost host(testNanos - 12345600, 0, pollFrames, phase);
+        SamcoSofSync sync;
+        sync.begin(pollFrames, leadFor(40));
+        SimResult r;
+        simulate(r, sync, host, true, leadFor(40), 40, pollFrames);
+
+        CHECK(sync.synced());
+        CHECK_EQ(sync.pollPhase(), phase);
+        // a frame number change or a poll is seen up to a loop pass late
+        const uint64_t sofNs = testNanos - (testNanos - host.t0Ns) % host.periodNs;
+        const int32_t sofError = (int32_t)(sync.sofMicros() - (uint32_t)(sofNs / 1000));
+        const int32_t offsetError = (int32_t)sync.pollOffset() - (int32_t)(PollOffsetNs / 1000);
+        SamcoTestCase::report("poll %u frames: SOF error %d us, poll offset error %d us, poll error %u us", pollFrames, sofError, offsetError, r.pollErrorUs);
+        CHECK(sofError >= -40 && sofError <= 40);
+        CHECK(offsetError >= -40 && offsetError <= 40);
+    }
+}
+
+TEST(syncedReadsAreFresher)
+{
+    for(unsigned int pollFrames : {1u, 2u, 4u}) {
+        for(int ppm : {-500, 0, 500}) {
+            for(uint32_t jitterUs : {40u, 200u}) {
+                const unsigned int phase = pollFrames > 1 ? 1 : 0;
+                const uint32_t leadUs = leadFor(jitterUs);
+                SimResult free;
+                SimResult synced;
+                for(bool sync : {false, true}) {
+                    testSetMicros(1000000);
+                    const SimHost host(testNanos - 12345600, ppm, pollFrames, phase);
+                    SamcoSofSync sofSync;
+                    sofSync.begin(pollFrames, leadUs);
+                    simulate(sync ? synced : free, sofSync, host, sync, leadUs, jitterUs, 1);
+                }
+                SamcoTestCase::report("poll %u frames, %+d ppm, jitter %u us: age avg/p99/max free %u/%u/%u, synced %u/%u/%u, missed %u of %u, poll error %u us",
+                    pollFrames, ppm, jitterUs, free.age.avg(), free.age.percentile(99), free.age.max(),
+                    synced.age.avg(), synced.age.percentile(99), synced.age.max(),
+                    synced.misses, synced.age.count(), synced.pollErrorUs);
+                CHECK(synced.age.avg() < free.age.avg());
+                // nearly every sample is taken by the poll it was timed for
+                CHECK_LE(synced.misses * 1000, synced.age.count());
+                CHECK_LE(synced.pollErrorUs, jitterUs / 2);
+            }
+        }
+    }
+}
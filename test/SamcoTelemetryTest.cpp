@@ -0,0 +1,250 @@
+/*!
+ * @file SamcoTelemetryTest.cpp
+ * @brief Host tests for the binary telemetry frames and the stream decoder.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <deque>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include <SamcoTelemetry.h>
+#include "SamcoTest.h"
+
+// a frame with every field random across its range
+static SamcoTelemetry::Frame_t randomFrame(std::mt19937& r, uint16_t seq, uint32_t us)
+{
+    std::uniform_int_distribution<int> mouse(-32768, 32767);
+    std::uniform_int_distribution<int> camera(0, 1023);
+    SamcoTelemetry::Frame_t f;
+    f.seq = seq;
+    f.us = us;
+    for(int i = 0; i < 4; ++i) {
+        f.rawX[i] = camera(r);
+        f.rawY[i] = camera(r);
+        f.pointX[i] = mouse(r);
+        f.pointY[i] = mouse(r);
+    }
+    f.camSeen = r() & 0x0F;
+    f.engineSeen = r() & 0x0F;
+    f.engine = r() & 1;
+    f.x = mouse(r);
+    f.y = mouse(r);
+    f.medianX = mouse(r);
+    f.medianY = mouse(r);
+    f.homX = mouse(r);
+    f.homY = mouse(r);
+    return f;
+}
+
+static bool sameFrame(const SamcoTelemetry::Frame_t& a, const SamcoTelemetry::Frame_t& b)
+{
+    bool same = a.seq == b.seq && a.us == b.us && a.camSeen == b.camSeen && a.engineSeen == b.engineSeen
+        && a.engine == b.engine && a.x == b.x && a.y == b.y && a.medianX == b.medianX && a.medianY == b.medianY
+        && a.homX == b.homX && a.homY == b.homY;
+    for(int i = 0; i < 4; ++i) {
+        same = same && a.rawX[i] == b.rawX[i] && a.rawY[i] == b.rawY[i]
+            && a.pointX[i] == b.pointX[i] && a.pointY[i] == b.pointY[i];
+    }
+    return same;
+}
+
+// push the frames with these sequence numbers through a decoder
+static void pushSeqs(SamcoTelemetryDecoder& decoder, std::initializer_list<uint16_t> seqs)
+{
+    std::mt19937 r(1);
+    uint8_t buf[SamcoTelemetry::FrameSize];
+    for(uint16_t seq : seqs) {
+        SamcoTelemetry::encode(randomFrame(r, seq, 0), buf);
+        for(uint8_t b : buf) {
+            decoder.push(b);
+        }
+    }
+}
+
+TEST(crcCheckValue)
+{
+    // the CRC-16/CCITT-FALSE check value
+    const uint8_t check[] = "123456789";
+    CHECK_EQ(SamcoTelemetry::crc16(check, 9), 0x29B1);
+}
+
+TEST(encodeDecodeRoundTrip)
+{
+    std::mt19937 r(1);
+    uint8_t buf[SamcoTelemetry::FrameSize + 1];
+    unsigned int mismatches = 0;
+    for(unsigned int i = 0; i < 10000; ++i) {
+        const SamcoTelemetry::Frame_t f = randomFrame(r, r(), r());
+        buf[SamcoTelemetry::FrameSize] = 0x55;
+        CHECK_EQ(SamcoTelemetry::encode(f, buf), SamcoTelemetry::FrameSize);
+        CHECK_EQ(buf[SamcoTelemetry::FrameSize], 0x55);
+        CHECK(SamcoTelemetry::valid(buf));
+        SamcoTelemetry::Frame_t d = {};
+        SamcoTelemetry::decode(buf, d);
+        mismatches += !sameFrame(f, d);
+    }
+    CHECK_EQ(mismatches, 0u);
+
+    // the layout, little endian after the sync and version
+    SamcoTelemetry::Frame_t f = randomFrame(r, 0x1234, 0x89ABCDEF);
+    f.homY = -2;
+    SamcoTelemetry::encode(f, buf);
+    CHECK_EQ(buf[0], SamcoTelemetry::Sync0);
+    CHECK_EQ(buf[1], SamcoTelemetry::Sync1);
+    CHECK_EQ(buf[2], SamcoTelemetry::Version);
+    CHECK_EQ(buf[3] | buf[4] << 8, 0x1234);
+    CHECK_EQ(buf[5] | buf[6] << 8 | buf[7] << 16 | (uint32_t)buf[8] << 24, 0x89ABCDEFu);
+    CHECK_EQ(buf[25], f.camSeen | f.engineSeen << 4);
+    CHECK_EQ(buf[53] | buf[54] << 8, 0xFFFE);
+
+    // any single bit error is caught
+    unsigned int missed = 0;
+    for(unsigned int bit = 0; bit < SamcoTelemetry::FrameSize * 8; ++bit) {
+        buf[bit / 8] ^= 1 << (bit % 8);
+        missed += SamcoTelemetry::valid(buf);
+        buf[bit / 8] ^= 1 << (bit % 8);
+    }
+    CHECK_EQ(missed, 0u);
+}
+
+TEST(chunkedPipe)
+{
+    // a minute at 209 Hz through a 256 byte CDC buffer, the host takes up to a 64 byte packet
+    // every 1 ms frame in reads of random sizes
+    constexpr size_t CdcSize = 256;
+    constexpr uint64_t RunUs = 60000000;
+    std::mt19937 r(1);
+    std::deque<uint8_t> cdc;
+    std::vector<SamcoTelemetry::Frame_t> sent;
+    SamcoTelemetryDecoder decoder;
+    uint8_t buf[SamcoTelemetry::FrameSize];
+    unsigned int dropped = 0;
+    unsigned int mismatches = 0;
+    size_t decoded = 0;
+    size_t maxFill = 0;
+    uint64_t nextCameraUs = 0;
+    uint16_t seq = 0;
+    for(uint64_t us = 0; us < RunUs; us += 10) {
+        if(us >= nextCameraUs) {
+            nextCameraUs += 1000000 / 209;
+            const SamcoTelemetry::Frame_t f = randomFrame(r, seq++, (uint32_t)us);
+            if(CdcSize - cdc.size() < SamcoTelemetry::FrameSize) {
+                // the sketch skips the frame rather than wait
+                ++dropped;
+            } else {
+                SamcoTelemetry::encode(f, buf);
+                cdc.insert(cdc.end(), buf, buf + sizeof(buf));
+                sent.push_back(f);
+            }
+            maxFill = max(maxFill, cdc.size());
+        }
+        if(us % 1000 == 0) {
+            size_t n = min<size_t>(64, cdc.size());
+            while(n) {
+                const size_t k = min<size_t>(n, 1 + r() % 23);
+                n -= k;
+                for(size_t i = 0; i < k; ++i) {
+                    const uint8_t b = cdc.front();
+                    cdc.pop_front();
+                    if(decoder.push(b)) {
+                        mismatches += decoded >= sent.size() || !sameFrame(decoder.frame(), sent[decoded]);
+                        ++decoded;
+                    }
+                }
+            }
+        }
+    }
+    SamcoTestCase::report("sent %zu, dropped %u, decoded %u, max CDC fill %zu bytes, %.0f bytes/s",
+        sent.size(), dropped, decoder.frames(), maxFill, sent.size() * SamcoTelemetry::FrameSize * 1e6 / RunUs);
+    CHECK_EQ(dropped, 0u);
+    CHECK_EQ(mismatches, 0u);
+    // the last frame may still be in the buffer
+    CHECK_LE(sent.size() - decoder.frames(), 1u);
+    CHECK_EQ(decoder.gaps(), 0u);
+    CHECK_EQ(decoder.restarts(), 0u);
+    CHECK_EQ(decoder.errors(), 0u);
+    CHECK_EQ(decoder.skipped(), 0u);
+}
+
+TEST(noisyStream)
+{
+    // bit errors, lost frames and text between frames, the decoder resynchronises and counts the gaps
+    constexpr unsigned int Frames = 20000;
+    std::mt19937 r(2);
+    SamcoTelemetryDecoder decoder;
+    uint8_t buf[SamcoTelemetry::FrameSize];
+    unsigned int corrupted = 0;
+    unsigned int lost = 0;
+    unsigned int noise = 0;
+    unsigned int mismatches = 0;
+    for(unsigned int seq = 0; seq < Frames; ++seq) {
+        const SamcoTelemetry::Frame_t f = randomFrame(r, seq, seq * 4785u);
+        SamcoTelemetry::encode(f, buf);
+        const unsigned int what = r() % 100;
+        if(what < 3) {
+            buf[r() % sizeof(buf)] ^= 1 << (r() % 8);
+            ++corrupted;
+        } else if(what < 5) {
+            ++lost;
+            continue;
+        } else if(what < 7) {
+            // noise with sync bytes in it
+            const unsigned int n = r() % 80;
+            for(unsigned int i = 0; i < n; ++i) {
+                decoder.push(i % 5 == 0 ? SamcoTelemetry::Sync0 : (uint8_t)r());
+            }
+            noise += n;
+        }
+        for(uint8_t b : buf) {
+            if(decoder.push(b)) {
+                mismatches += !sameFrame(decoder.frame(), f);
+            }
+        }
+    }
+    SamcoTestCase::report("%u frames, %u corrupted, %u lost, %u noise bytes: decoded %u, gaps %u, errors %u, skipped %u",
+        Frames, corrupted, lost, noise, decoder.frames(), decoder.gaps(), decoder.errors(), decoder.skipped());
+    CHECK_EQ(mismatches, 0u);
+    CHECK_EQ(decoder.restarts(), 0u);
+    // every frame is decoded or a gap, the noise can hide a few frames after it
+    CHECK_EQ(decoder.frames() + decoder.gaps(), Frames);
+    CHECK_LE(Frames - corrupted - lost, decoder.frames() + 10);
+    CHECK(decoder.errors() <= corrupted);
+}
+
+TEST(sequenceGapsAndRestarts)
+{
+    SamcoTelemetryDecoder decoder;
+    pushSeqs(decoder, {100, 101, 105, 106});
+    CHECK_EQ(decoder.frames(), 4u);
+    CHECK_EQ(decoder.gaps(), 3u);
+    CHECK_EQ(decoder.restarts(), 0u);
+
+    // the sequence number wraps
+    decoder.reset();
+    pushSeqs(decoder, {65534, 65535, 0, 2});
+    CHECK_EQ(decoder.frames(), 4u);
+    CHECK_EQ(decoder.gaps(), 1u);
+    CHECK_EQ(decoder.restarts(), 0u);
+
+    // the gun restarted, going back isn't a gap of most of the sequence
+    decoder.reset();
+    pushSeqs(decoder, {5000, 5001, 0, 1, 2});
+    CHECK_EQ(decoder.frames(), 5u);
+    CHECK_EQ(decoder.gaps(), 0u);
+    CHECK_EQ(decoder.restarts(), 1u);
+    pushSeqs(decoder, {2, 4});
+    CHECK_EQ(decoder.gaps(), 1u);
+    CHECK_EQ(decoder.restarts(), 2u);
+    CHECK_EQ(decoder.frame().seq, 4);
+
+    decoder.reset();
+    CHECK_EQ(decoder.restarts(), 0u);
+    CHECK_EQ(decoder.gaps(), 0u);
+}
@@ -0,0 +1,79 @@
+/*!
+ * @file SamcoTest.cpp
+ * @brief Minimal test cases and checks for the Samco host tests.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "SamcoTest.h"
+
+// failures printed for each test case, the rest are only counted
+constexpr unsigned int MaxFailPrints = 10;
+
+static SamcoTestCase* firstCase = nullptr;
+static SamcoTestCase* lastCase = nullptr;
+static const char* runningName = "";
+static unsigned int runningFails = 0;
+
+SamcoTestCase::SamcoTestCase(const char* name, Func_t func) : name(name), func(func), next(nullptr)
+{
+    // run in the order they are defined
+    if(lastCase) {
+        lastCase->next = this;
+    } else {
+        firstCase = this;
+    }
+    lastCase = this;
+}
+
+int SamcoTestCase::runAll(const char* filter)
+{
+    int failed = 0;
+    int run = 0;
+    for(SamcoTestCase* t = firstCase; t; t = t->next) {
+        if(filter && !strstr(t->name, filter)) {
+            continue;
+        }
+        runningName = t->name;
+        runningFails = 0;
+        t->func();
+        ++run;
+        if(runningFails) {
+            ++failed;
+            printf("FAIL %s (%u checks)\n", t->name, runningFails);
+        } else {
+            printf("PASS %s\n", t->name);
+        }
+    }
+    printf("%d of %d passed\n", run - failed, run);
+    return failed;
+}
+
+void SamcoTestCase::fail(const char* file, int line, const char* message)
+{
+    if(++runningFails <= MaxFailPrints) {
+        printf("  %s:%d: %s: check failed: %s\n", file, line, runningName, message);
+    }
+}
+
+void SamcoTestCase::report(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printf("  %s: ", runningName);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+int main(int argc, char** argv)
+{
+    return SamcoTestCase::runAll(argc > 1 ? argv[1] : nullptr) ? 1 : 0;
+}
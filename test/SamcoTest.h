@@ -0,0 +1,95 @@
+/*!
+ * @file SamcoTest.h
+ * @brief Minimal test cases and checks for the Samco host tests.
+ * @details Each test file is its own program linked with SamcoTest.cpp for main().
+ * A failed check reports the file and line and the test carries on so one run shows every failure.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _SAMCOTEST_H_
+#define _SAMCOTEST_H_
+
+#include <stdio.h>
+#include <math.h>
+
+/// @brief A test case, registered by the TEST macro before main() runs
+class SamcoTestCase
+{
+public:
+    typedef void (*Func_t)();
+
+    SamcoTestCase(const char* name, Func_t func);
+
+    /// @brief Run every test case
+    /// @param filter Only run test cases with this in the name, or null for all
+    /// @return Number of test cases that failed
+    static int runAll(const char* filter);
+
+    /// @brief Record a failed check in the running test case
+    static void fail(const char* file, int line, const char* message);
+
+    /// @brief Print a measurement, for the statistics and benchmarks the tests report
+    static void report(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+private:
+    const char* name;
+    Func_t func;
+    SamcoTestCase* next;
+};
+
+#define SAMCO_TEST_CAT2(a, b) a##b
+#define SAMCO_TEST_CAT(a, b) SAMCO_TEST_CAT2(a, b)
+
+/// @brief Define a test case
+#define TEST(name) \
+    static void name(); \
+    static SamcoTestCase SAMCO_TEST_CAT(name, _case)(#name, name); \
+    static void name()
+
+/// @brief Check a condition
+#define CHECK(cond) \
+    do { if(!(cond)) { SamcoTestCase::fail(__FILE__, __LINE__, #cond); } } while(0)
+
+/// @brief Check two integer values are equal
+#define CHECK_EQ(a, b) \
+    do { \
+        const long long _a = (long long)(a); \
+        const long long _b = (long long)(b); \
+        if(_a != _b) { \
+            char _m[160]; \
+            snprintf(_m, sizeof(_m), "%s == %s (%lld != %lld)", #a, #b, _a, _b); \
+            SamcoTestCase::fail(__FILE__, __LINE__, _m); \
+        } \
+    } while(0)
+
+/// @brief Check a value is within a tolerance
+#define CHECK_NEAR(a, b, tol) \
+    do { \
+        const double _a = (double)(a); \
+        const double _b = (double)(b); \
+        if(!(fabs(_a - _b) <= (double)(tol))) { \
+            char _m[160]; \
+            snprintf(_m, sizeof(_m), "%s ~= %s (%g, %g, tolerance %g)", #a, #b, _a, _b, (double)(tol)); \
+            SamcoTestCase::fail(__FILE__, __LINE__, _m); \
+        } \
+    } while(0)
+
+/// @brief Check a value is at most a limit
+#define CHECK_LE(a, b) \
+    do { \
+        const double _a = (double)(a); \
+        const double _b = (double)(b); \
+        if(!(_a <= _b)) { \
+            char _m[160]; \
+            snprintf(_m, sizeof(_m), "%s <= %s (%g > %g)", #a, #b, _a, _b); \
+            SamcoTestCase::fail(__FILE__, __LINE__, _m); \
+        } \
+    } while(0)
+
+#endif // _SAMCOTEST_H_
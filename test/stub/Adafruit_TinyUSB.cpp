@@ -0,0 +1,84 @@
+/*!
+ * @file Adafruit_TinyUSB.cpp
+ * @brief Host stand-in for the TinyUSB HID device calls used by the Samco host tests.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <string.h>
+#include "Adafruit_TinyUSB.h"
+
+TestHidHost testHidHost;
+Adafruit_USBD_Device TinyUSBDevice;
+
+void TestHidHost::begin(uint32_t pollUs)
+{
+    this->pollUs = pollUs;
+    startUs = now();
+    freeUs = startUs;
+    resumeUs = UINT64_MAX;
+    isSuspended = false;
+    reports.clear();
+    wakeups = 0;
+}
+
+bool TestHidHost::suspended()
+{
+    if(isSuspended && now() >= resumeUs) {
+        resume();
+    }
+    return isSuspended;
+}
+
+bool TestHidHost::ready()
+{
+    return !suspended() && now() >= freeUs;
+}
+
+bool TestHidHost::send(uint8_t id, const void* data, uint16_t length)
+{
+    if(!ready()) {
+        return false;
+    }
+    // taken at the next poll
+    const uint64_t us = now();
+    Report_t r = {id, (uint8_t)min<uint16_t>(length, sizeof(r.data)), {0}, us, 0};
+    memcpy(r.data, data, r.length);
+    freeUs = startUs + ((us - startUs) / pollUs + 1) * pollUs;
+    r.takenUs = freeUs;
+    reports.push_back(r);
+    return true;
+}
+
+bool TestHidHost::remoteWakeup()
+{
+    ++wakeups;
+    if(isSuspended && resumeUs == UINT64_MAX) {
+        resumeUs = now() + wakeupUs;
+    }
+    return true;
+}
+
+bool tud_hid_ready()
+{
+    return testHidHost.ready();
+}
+
+bool tud_hid_report(uint8_t reportId, const void* report, uint16_t length)
+{
+    return testHidHost.send(reportId, report, length);
+}
+
+bool tud_hid_keyboard_report(uint8_t reportId, uint8_t modifier, const uint8_t keycode[6])
+{
+    uint8_t report[8] = {modifier, 0};
+    if(keycode) {
+        memcpy(report + 2, keycode, 6);
+    }
+    return testHidHost.send(reportId, report, sizeof(report));
+}
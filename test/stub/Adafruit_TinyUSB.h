@@ -0,0 +1,95 @@
+/*!
+ * @file Adafruit_TinyUSB.h
+ * @brief Host stand-in for the TinyUSB HID device calls used by the Samco host tests.
+ * @details The HID endpoint goes to a model of the host that takes a report at each poll,
+ * on the virtual clock, and records the report stream.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _ADAFRUIT_TINYUSB_H_
+#define _ADAFRUIT_TINYUSB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <Arduino.h>
+
+/// @brief Host side of the HID endpoint
+class TestHidHost
+{
+public:
+    /// @brief A report the device sent
+    typedef struct Report_s {
+        uint8_t id;
+        uint8_t length;
+        uint8_t data[8];
+        uint64_t sentUs;        ///< time the device sent it
+        uint64_t takenUs;       ///< time the host polled it
+    } Report_t;
+
+    /// @brief Start over with a host polling every period from now, not suspended
+    void begin(uint32_t pollUs);
+
+    /// @brief Suspend the bus, the host stops polling until resume() or a remote wakeup
+    void suspend() { isSuspended = true; resumeUs = UINT64_MAX; }
+
+    /// @brief Resume the bus
+    void resume() { isSuspended = false; resumeUs = UINT64_MAX; }
+
+    /// @brief Time from a remote wakeup to the host resuming the bus
+    uint32_t wakeupUs = 10000;
+
+    /// @brief True while the bus is suspended
+    bool suspended();
+
+    /// @brief True if the endpoint can take a report, the host has taken the last one
+    bool ready();
+
+    /// @brief Send a report
+    /// @return false if the endpoint isn't ready
+    bool send(uint8_t id, const void* data, uint16_t length);
+
+    /// @brief Device remote wakeup, the host resumes after wakeupUs
+    bool remoteWakeup();
+
+    /// @brief Reports sent
+    std::vector<Report_t> reports;
+
+    /// @brief Remote wakeups
+    unsigned int wakeups = 0;
+
+private:
+    static uint64_t now() { return testNanos / 1000; }
+
+    uint64_t pollUs = 1000;
+    uint64_t startUs = 0;
+    uint64_t freeUs = 0;            ///< time the host takes the last report
+    uint64_t resumeUs = UINT64_MAX; ///< time the bus resumes after a remote wakeup
+    bool isSuspended = false;
+};
+
+/// @brief The host on the other end of the HID endpoint
+extern TestHidHost testHidHost;
+
+/// @brief TinyUSB device
+class Adafruit_USBD_Device
+{
+public:
+    bool mounted() { return !testHidHost.suspended(); }
+    bool suspended() { return testHidHost.suspended(); }
+    bool remoteWakeup() { return testHidHost.remoteWakeup(); }
+};
+
+extern Adafruit_USBD_Device TinyUSBDevice;
+
+bool tud_hid_ready();
+bool tud_hid_report(uint8_t reportId, const void* report, uint16_t length);
+bool tud_hid_keyboard_report(uint8_t reportId, uint8_t modifier, const uint8_t keycode[6]);
+
+#endif // _ADAFRUIT_TINYUSB_H_
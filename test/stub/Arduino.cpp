@@ -0,0 +1,151 @@
+/*!
+ * @file Arduino.cpp
+ * @brief Host stand-in for the Arduino core used by the Samco host tests.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+
+// pins on the boards the sketch supports fit easily
+constexpr int TestPinCount = 64;
+
+uint64_t testNanos = 0;
+unsigned long testYieldUs = 0;
+TestPinModel* testPins = nullptr;
+Serial_ Serial;
+
+static uint8_t pinModes[TestPinCount];
+static uint8_t pinOutputs[TestPinCount];
+static uint8_t pinLevels[TestPinCount] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+void testAdvanceNs(uint64_t ns)
+{
+    testNanos += ns;
+}
+
+void testSetMicros(uint32_t us)
+{
+    testNanos = (uint64_t)us * 1000;
+}
+
+unsigned long millis()
+{
+    return (uint32_t)(testNanos / 1000000);
+}
+
+unsigned long micros()
+{
+    // 32 bits like the boards
+    return (uint32_t)(testNanos / 1000);
+}
+
+void delay(unsigned long ms)
+{
+    testAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    testAdvance(us);
+}
+
+void yield()
+{
+    testAdvance(testYieldUs);
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// the level is low if the board drives it low or the model holds it low
+static void updatePin(int pin)
+{
+    const uint8_t level = (pinModes[pin] == OUTPUT && !pinOutputs[pin])
+        || (testPins && testPins->pinHeldLow(pin)) ? LOW : HIGH;
+    if(level != pinLevels[pin]) {
+        pinLevels[pin] = level;
+        if(testPins) {
+            testPins->pinChanged(pin, level);
+        }
+    }
+}
+
+void pinMode(int pin, int mode)
+{
+    if(pin >= 0 && pin < TestPinCount) {
+        pinModes[pin] = mode;
+        updatePin(pin);
+    }
+}
+
+int digitalRead(int pin)
+{
+    if(pin < 0 || pin >= TestPinCount) {
+        return HIGH;
+    }
+    updatePin(pin);
+    return pinLevels[pin];
+}
+
+void digitalWrite(int pin, int value)
+{
+    if(pin >= 0 && pin < TestPinCount) {
+        pinOutputs[pin] = value ? HIGH : LOW;
+        updatePin(pin);
+    }
+}
+
+size_t Print::write(uint8_t b)
+{
+    output.push_back(b);
+    return 1;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    output.insert(output.end(), buffer, buffer + size);
+    return size;
+}
+
+size_t Print::print(const char* s)
+{
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(long n, int base)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%ld", n);
+    return print(buf);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", n);
+    return print(buf);
+}
+
+size_t Print::print(double n, int digits)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+}
@@ -0,0 +1,137 @@
+/*!
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core used by the Samco host tests.
+ * @details Time is a virtual clock that only moves when a test or a stand-in advances it,
+ * delay() and delayMicroseconds() advance it instead of waiting.
+ * The pins are open drain lines with a model to drive them from the test.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _ARDUINO_H_
+#define _ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+using std::min;
+using std::max;
+
+#define PI 3.1415926535897932384626433832795
+
+#define LOW 0
+#define HIGH 1
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+static const uint8_t SDA = 18;
+static const uint8_t SCL = 19;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+void digitalWrite(int pin, int value);
+
+/// @brief Virtual clock in nanoseconds so IIC byte times don't accumulate rounding
+extern uint64_t testNanos;
+
+/// @brief Move the virtual clock forward
+void testAdvanceNs(uint64_t ns);
+
+/// @brief Move the virtual clock forward
+inline void testAdvance(unsigned long us) { testAdvanceNs((uint64_t)us * 1000); }
+
+/// @brief Set the virtual clock, for tests that start from a known time or check the wrap
+void testSetMicros(uint32_t us);
+
+/// @brief Time each yield() takes, for code that waits in yield() for something on the virtual clock
+extern unsigned long testYieldUs;
+
+/// @brief Something attached to the pins, the lines are open drain with pull ups
+/// so a line is low if the board or the model drives it low
+class TestPinModel
+{
+public:
+    virtual ~TestPinModel() {}
+
+    /// @brief True if the model drives the pin low
+    virtual bool pinHeldLow(int pin) { return false; }
+
+    /// @brief The level on a pin changed
+    virtual void pinChanged(int pin, int level) {}
+};
+
+/// @brief Pin model, or null for nothing attached
+extern TestPinModel* testPins;
+
+/// @brief Print that records the output
+class Print
+{
+public:
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t print(const char* s);
+    size_t print(char c);
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+    size_t println() { return print("\r\n"); }
+    template<typename T> size_t println(T v) { return print(v) + println(); }
+    template<typename T> size_t println(T v, int f) { return print(v, f) + println(); }
+
+    /// @brief Everything written
+    std::vector<uint8_t> output;
+};
+
+/// @brief USB CDC serial with a limited write buffer the test drains
+class Serial_ : public Print
+{
+public:
+    void begin(unsigned long) {}
+    operator bool() { return true; }
+    bool dtr() { return true; }
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+    int availableForWrite() { return writeSpace; }
+
+    /// @brief Space left in the write buffer, the test sets it
+    int writeSpace = 64;
+};
+
+extern Serial_ Serial;
+
+#endif // _ARDUINO_H_
@@ -0,0 +1,19 @@
+/*!
+ * @file HID.h
+ * @brief Host stand-in for the Arduino HID library used by the Samco host tests.
+ * @details _USING_HID isn't defined so the HID devices build without a USB stack and send nothing.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _HID_H_
+#define _HID_H_
+
+#include <stdint.h>
+
+#endif // _HID_H_
@@ -0,0 +1,135 @@
+/*!
+ * @file Wire.cpp
+ * @brief Host stand-in for the Arduino Wire library used by the Samco host tests.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#include <Arduino.h>
+#include "Wire.h"
+
+// Wire endTransmission() result for a bus error
+constexpr uint8_t WireErrorOther = 4;
+
+TwoWire Wire;
+TwoWire Wire1;
+
+void TwoWire::begin()
+{
+    running = true;
+    ++beginCount;
+}
+
+void TwoWire::end()
+{
+    running = false;
+}
+
+void TwoWire::setClock(uint32_t clock)
+{
+    clockHz = clock ? clock : 100000;
+}
+
+void TwoWire::attach(int address, TwoWireDevice* dev)
+{
+    for(unsigned int i = 0; i < MaxDevices; ++i) {
+        if(!devices[i] || addresses[i] == address) {
+            addresses[i] = address;
+            devices[i] = dev;
+            return;
+        }
+    }
+}
+
+TwoWireDevice* TwoWire::device(int address) const
+{
+    for(unsigned int i = 0; i < MaxDevices; ++i) {
+        if(devices[i] && addresses[i] == address) {
+            return devices[i];
+        }
+    }
+    return nullptr;
+}
+
+void TwoWire::beginTransmission(int address)
+{
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t b)
+{
+    if(txLength >= bufferLength) {
+        return 0;
+    }
+    txBuffer[txLength++] = b;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length)
+{
+    size_t n = 0;
+    while(n < length && write(data[n])) {
+        ++n;
+    }
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+    ++transactionCount;
+    TwoWireDevice* dev = device(txAddress);
+    if(!running || (dev && dev->busHeld())) {
+        return WireErrorOther;
+    }
+
+    // the address byte, the data, and a bit for the start and stop
+    const uint64_t start = testNanos;
+    const uint64_t byte = byteNs();
+    uint8_t result = 2;
+    if(dev) {
+        result = dev->write(txBuffer, txLength, start, byte);
+    }
+    testAdvanceNs(byte * (result == 2 ? 1 : txLength + 1) + byte / 9);
+    return result;
+}
+
+uint8_t TwoWire::requestFrom(int address, int length, bool stop)
+{
+    ++transactionCount;
+    rxLength = 0;
+    rxIndex = 0;
+    TwoWireDevice* dev = device(address);
+    if(!running || length <= 0 || (dev && dev->busHeld())) {
+        return 0;
+    }
+    if(length > bufferLength) {
+        length = bufferLength;
+    }
+
+    const uint64_t start = testNanos;
+    const uint64_t byte = byteNs();
+    if(dev) {
+        rxLength = dev->read(rxBuffer, length, start, byte);
+    }
+    testAdvanceNs(byte * (rxLength + 1) + byte / 9);
+    return rxLength;
+}
+
+int TwoWire::available()
+{
+    return rxLength - rxIndex;
+}
+
+int TwoWire::read()
+{
+    if(rxIndex >= rxLength) {
+        return -1;
+    }
+    return rxBuffer[rxIndex++];
+}
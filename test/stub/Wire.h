@@ -0,0 +1,117 @@
+/*!
+ * @file Wire.h
+ * @brief Host stand-in for the Arduino Wire library used by the Samco host tests.
+ * @details Transactions go to device models attached by address. Each transaction advances the
+ * virtual clock by the time the bytes take on the bus at the set clock, and the device sees the
+ * time of each byte so a model can change its data part way through a read.
+ *
+ * @copyright Mike Lynch, 2021
+ * @copyright GNU Lesser General Public License
+ *
+ * @author Mike Lynch
+ * @version V1.0
+ * @date 2021
+ */
+
+#ifndef _WIRE_H_
+#define _WIRE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// same as the SAMD and RP2040 cores so the camera full format reads in one transaction,
+// a library built with 32 splits its reads like on AVR, see TwoWire::setBufferLength()
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 64
+#endif
+
+/// @brief A device on the bus
+class TwoWireDevice
+{
+public:
+    virtual ~TwoWireDevice() {}
+
+    /// @brief A write transaction
+    /// @param data Bytes written
+    /// @param length Number of bytes
+    /// @param startNs Time of the start condition
+    /// @param byteNs Time for each byte on the bus
+    /// @return Wire endTransmission() result, 0 for success, 2 address NACK, 3 data NACK
+    virtual uint8_t write(const uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs) = 0;
+
+    /// @brief A read transaction
+    /// @param data Buffer for the bytes read
+    /// @param length Number of bytes requested
+    /// @param startNs Time of the start condition
+    /// @param byteNs Time for each byte on the bus
+    /// @return Number of bytes read, 0 if the address isn't acknowledged
+    virtual size_t read(uint8_t* data, size_t length, uint64_t startNs, uint64_t byteNs) = 0;
+
+    /// @brief True if the device is holding SDA low so the bus can't be used
+    virtual bool busHeld() { return false; }
+};
+
+class TwoWire
+{
+public:
+    void begin();
+    void end();
+    void setClock(uint32_t clock);
+
+    void beginTransmission(int address);
+    uint8_t endTransmission(bool stop = true);
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* data, size_t length);
+
+    uint8_t requestFrom(int address, int length, bool stop = true);
+    int available();
+    int read();
+
+    /// @brief Attach a device model at an address
+    void attach(int address, TwoWireDevice* device);
+
+    /// @brief IIC clock set by the library
+    uint32_t clock() const { return clockHz; }
+
+    /// @brief Number of times begin() was called
+    unsigned int begins() const { return beginCount; }
+
+    /// @brief Transactions started, writes and reads
+    unsigned int transactions() const { return transactionCount; }
+
+    /// @brief Time for bytes on the bus at the current clock, 9 bits per byte
+    uint64_t byteNs() const { return 9000000000ULL / clockHz; }
+
+    /// @brief Limit the transactions to a smaller buffer, 32 for the AVR Wire library
+    /// @details Longer writes are cut short and longer reads return the first bytes, like the board.
+    void setBufferLength(size_t length) { bufferLength = length < BufferMax ? length : BufferMax; }
+
+private:
+    static constexpr size_t BufferMax = 64;
+
+    TwoWireDevice* device(int address) const;
+
+    static constexpr unsigned int MaxDevices = 4;
+
+    int addresses[MaxDevices] = {};
+    TwoWireDevice* devices[MaxDevices] = {};
+    uint32_t clockHz = 100000;
+    bool running = false;
+    unsigned int beginCount = 0;
+    unsigned int transactionCount = 0;
+
+    size_t bufferLength = BufferMax;
+
+    int txAddress = 0;
+    uint8_t txBuffer[BufferMax];
+    size_t txLength = 0;
+
+    uint8_t rxBuffer[BufferMax];
+    size_t rxLength = 0;
+    size_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif // _WIRE_H_